@@ -0,0 +1,102 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include "Config.hpp"
+
+#include <limits>
+
+struct AABB
+{
+	glm::vec3 min{ std::numeric_limits<float>::max() };
+	glm::vec3 max{ -std::numeric_limits<float>::max() };
+
+	void Grow(const glm::vec3& point) { min = glm::min(min, point); max = glm::max(max, point); }
+	void Grow(const AABB& other) { min = glm::min(min, other.min); max = glm::max(max, other.max); }
+
+	bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+	glm::vec3 Center() const { return (min + max) * 0.5f; }
+	glm::vec3 Extent() const { return max - min; }
+
+	float SurfaceArea() const
+	{
+		if (!IsValid())
+			return 0.0f;
+		glm::vec3 extent = Extent();
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	bool Overlaps(const AABB& other) const
+	{
+		return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y &&
+			min.z <= other.max.z && max.z >= other.min.z;
+	}
+};
+
+struct Sphere
+{
+	glm::vec3 center{ 0.0f };
+	float radius = 0.0f;
+};
+
+struct Ray
+{
+	glm::vec3 origin{ 0.0f };
+	glm::vec3 direction{ 0.0f, 0.0f, 1.0f };
+};
+
+// Six inward facing planes (xyz = normal, w = distance) in the order left, right, bottom, top, near, far.
+struct Frustum
+{
+	std::array<glm::vec4, 6> planes;
+};
+
+// Bounds of box after transforming it by matrix (Arvo's method).
+inline AABB TransformAABB(const AABB& box, const glm::mat4& matrix)
+{
+	AABB result;
+	result.min = result.max = glm::vec3(matrix[3]);
+
+	for (int column = 0; column < 3; column++)
+	{
+		glm::vec3 a = glm::vec3(matrix[column]) * box.min[column];
+		glm::vec3 b = glm::vec3(matrix[column]) * box.max[column];
+		result.min += glm::min(a, b);
+		result.max += glm::max(a, b);
+	}
+
+	return result;
+}
+
+// Extracts the frustum planes of a Vulkan style (depth 0 to 1) view-projection matrix.
+inline Frustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+	glm::mat4 m = glm::transpose(viewProjection);
+
+	Frustum frustum;
+	frustum.planes[0] = m[3] + m[0];
+	frustum.planes[1] = m[3] - m[0];
+	frustum.planes[2] = m[3] + m[1];
+	frustum.planes[3] = m[3] - m[1];
+	frustum.planes[4] = m[2];
+	frustum.planes[5] = m[3] - m[2];
+
+	for (glm::vec4& plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	return frustum;
+}
+
+// False if box is entirely outside one of the planes, conservative near the edges and corners of the frustum.
+inline bool FrustumContainsBox(const Frustum& frustum, const AABB& box)
+{
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		glm::vec3 farCorner = glm::vec3(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), farCorner) + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+#endif // !BOUNDS_HPP
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+#include "Config.hpp"
+#include "Bounds.hpp"
+
+// The default camera keeps the old behaviour, world space is clip space.
+struct Camera
+{
+	glm::mat4 view{ 1.0f };
+	glm::mat4 projection{ 1.0f };
+
+	glm::mat4 GetViewProjection() const { return projection * view; }
+	Frustum GetFrustum() const { return ExtractFrustum(GetViewProjection()); }
+};
+
+#endif // !CAMERA_HPP
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "CommandCache.hpp"
+
+CommandCache::CommandCache(const Input& input) : m_Device(input.device), m_CommandPool(input.commandPool)
+{
+}
+
+CommandCache::~CommandCache()
+{
+	Free();
+}
+
+void CommandCache::Reset()
+{
+	Free();
+}
+
+void CommandCache::Invalidate()
+{
+	for (auto& [key, buckets] : m_Buckets)
+		for (Bucket& bucket : buckets)
+			bucket.recorded = false;
+}
+
+void CommandCache::Execute(const RenderGraph::PassContext& context, uint32_t frame, uint32_t view, const std::vector<size_t>& hashes,
+	const RecordFunction& record)
+{
+	PROFILE_SCOPE("CommandCache::Execute");
+	std::vector<Bucket>& buckets = m_Buckets[Key(frame, view)];
+
+	// Buckets past the ones this frame uses keep their recordings, the draws may grow back into them.
+	if (buckets.size() < hashes.size())
+	{
+		vk::CommandBufferAllocateInfo allocInfo{};
+		allocInfo.commandPool = m_CommandPool;
+		allocInfo.level = vk::CommandBufferLevel::eSecondary;
+		allocInfo.commandBufferCount = static_cast<uint32_t>(hashes.size() - buckets.size());
+
+		try
+		{
+			for (vk::CommandBuffer commandBuffer : m_Device.allocateCommandBuffers(allocInfo))
+				buckets.push_back({ commandBuffer });
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to allocate secondary command buffers! %s", err.what());
+			return;
+		}
+	}
+
+	// The framebuffer is only a hint, the recording stays valid for every framebuffer of the render pass.
+	vk::CommandBufferInheritanceInfo inheritance{};
+	inheritance.renderPass = context.renderPass;
+	inheritance.subpass = 0;
+	inheritance.pipelineStatistics = context.pipelineStatistics;
+
+	vk::CommandBufferBeginInfo beginInfo{};
+	beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	// The render pass is part of every hash, a recording cannot be executed in a render pass it is not compatible with.
+	// Neither can it be executed inside a statistics query it did not inherit.
+	uint64_t renderPass = reinterpret_cast<uint64_t>(static_cast<VkRenderPass>(context.renderPass));
+	uint64_t statistics = static_cast<VkQueryPipelineStatisticFlags>(context.pipelineStatistics);
+
+	m_Executed.clear();
+	for (uint32_t i = 0; i < hashes.size(); i++)
+	{
+		Bucket& bucket = buckets[i];
+		size_t hash = hashes[i];
+		HashCombine(hash, renderPass);
+		HashCombine(hash, statistics);
+
+		if (!bucket.recorded || bucket.hash != hash)
+		{
+			try
+			{
+				bucket.commandBuffer.reset();
+				bucket.commandBuffer.begin(beginInfo);
+				record(bucket.commandBuffer, i);
+				bucket.commandBuffer.end();
+			}
+			catch (const vk::SystemError& err)
+			{
+				CONSOLE_ERROR("Failed to record secondary command buffer! %s", err.what());
+				bucket.recorded = false;
+				continue;
+			}
+
+			bucket.hash = hash;
+			bucket.recorded = true;
+			m_Stats.recorded++;
+		}
+
+		m_Executed.push_back(bucket.commandBuffer);
+	}
+
+	if (!m_Executed.empty())
+		context.commandBuffer.executeCommands(m_Executed);
+	m_Stats.executed += static_cast<uint32_t>(m_Executed.size());
+}
+
+CommandCache::Stats CommandCache::TakeStats()
+{
+	Stats stats = m_Stats;
+	m_Stats = Stats{};
+	return stats;
+}
+
+void CommandCache::Free()
+{
+	for (auto& [key, buckets] : m_Buckets)
+		for (Bucket& bucket : buckets)
+			m_Device.freeCommandBuffers(m_CommandPool, bucket.commandBuffer);
+	m_Buckets.clear();
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef COMMAND_CACHE_HPP
+#define COMMAND_CACHE_HPP
+
+#include "Config.hpp"
+#include "RenderGraph.hpp"
+
+#include <functional>
+#include <unordered_map>
+
+// Secondary command buffers recorded once and executed every frame until what they draw changes.
+// A pass's draws are split into buckets, each recorded into its own secondary command buffer along with a hash of
+// everything its commands depend on. A bucket is only recorded again when its hash changes, so a frame whose draws
+// match the last one records nothing but vkCmdExecuteCommands. Every frame in flight owns its own buffers, which are
+// only recorded again once the frame that last executed them has finished.
+class CommandCache
+{
+public:
+	struct Input
+	{
+		vk::Device device;
+		vk::CommandPool commandPool;	// Must allow resetting single command buffers.
+	};
+
+	// Counts since the last TakeStats.
+	struct Stats
+	{
+		uint32_t executed = 0;		// Buckets executed.
+		uint32_t recorded = 0;		// Of those, the ones recorded again.
+	};
+
+	// Records the commands of bucket into commandBuffer. Secondary command buffers inherit no state, every bucket binds its own.
+	using RecordFunction = std::function<void(vk::CommandBuffer commandBuffer, uint32_t bucket)>;
+
+	CommandCache(const Input& input);
+	CommandCache(const CommandCache&) = delete;
+	CommandCache& operator=(const CommandCache&) = delete;
+	~CommandCache();
+
+	/// @brief Frees every buffer, e.g. when the number of frames in flight changes. The device must be idle.
+	void Reset();
+
+	/// @brief Records every bucket again the next time it is executed, e.g. after pipelines were recreated.
+	void Invalidate();
+
+	/// @brief Executes one secondary command buffer per hash in the render pass of context, which must have been begun
+	/// for secondary command buffers. Buckets whose hash differs from the one they were recorded with are recorded again
+	/// with record first. view tells apart the passes a frame draws through the cache.
+	void Execute(const RenderGraph::PassContext& context, uint32_t frame, uint32_t view, const std::vector<size_t>& hashes,
+		const RecordFunction& record);
+
+	/// @brief Returns the stats gathered since the last call.
+	Stats TakeStats();
+
+	static void HashCombine(size_t& seed, uint64_t value) { seed ^= std::hash<uint64_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2); }
+private:
+	struct Bucket
+	{
+		vk::CommandBuffer commandBuffer;
+		size_t hash = 0;
+		bool recorded = false;
+	};
+
+	static uint64_t Key(uint32_t frame, uint32_t view) { return (static_cast<uint64_t>(frame) << 32) | view; }
+
+	void Free();
+private:
+	vk::Device m_Device;
+	vk::CommandPool m_CommandPool;
+
+	// Buckets of every frame in flight and view.
+	std::unordered_map<uint64_t, std::vector<Bucket>> m_Buckets;
+
+	// Scratch of Execute.
+	std::vector<vk::CommandBuffer> m_Executed;
+
+	Stats m_Stats;
+};
+
+#endif // !COMMAND_CACHE_HPP
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <vulkan/vulkan.hpp>
 #include "Logger.hpp"
+#include "Profiler.hpp"
 
 #include <string>
 #include <vector>
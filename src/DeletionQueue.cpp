@@ -0,0 +1,122 @@
+#include "DeletionQueue.hpp"
+
+namespace
+{
+	template<typename Handle>
+	uint64_t ToBits(Handle handle)
+	{
+		return reinterpret_cast<uint64_t>(static_cast<typename Handle::CType>(handle));
+	}
+
+	template<typename Handle>
+	Handle FromBits(uint64_t bits)
+	{
+		return Handle(reinterpret_cast<typename Handle::CType>(bits));
+	}
+}
+
+DeletionQueue::DeletionQueue(const Input& input) : m_Device(input.device), m_Scheduler(*input.scheduler), m_Heap(input.heap)
+{
+}
+
+DeletionQueue::~DeletionQueue()
+{
+	for (const Retired& retired : m_Queue)
+		Destroy(retired);
+	m_Queue.clear();
+}
+
+void DeletionQueue::Retire(vk::Buffer buffer)
+{
+	if (buffer)
+		Push(ResourceType::Buffer, ToBits(buffer));
+}
+
+void DeletionQueue::Retire(vk::Image image)
+{
+	if (image)
+		Push(ResourceType::Image, ToBits(image));
+}
+
+void DeletionQueue::Retire(vk::ImageView view)
+{
+	if (view)
+		Push(ResourceType::ImageView, ToBits(view));
+}
+
+void DeletionQueue::Retire(vk::DeviceMemory memory)
+{
+	if (memory)
+		Push(ResourceType::Memory, ToBits(memory));
+}
+
+void DeletionQueue::Retire(vk::Pipeline pipeline)
+{
+	if (pipeline)
+		Push(ResourceType::Pipeline, ToBits(pipeline));
+}
+
+void DeletionQueue::Retire(vk::RenderPass renderPass)
+{
+	if (renderPass)
+		Push(ResourceType::RenderPass, ToBits(renderPass));
+}
+
+void DeletionQueue::Retire(vk::Framebuffer framebuffer)
+{
+	if (framebuffer)
+		Push(ResourceType::Framebuffer, ToBits(framebuffer));
+}
+
+void DeletionQueue::Retire(const vkInit::Buffer& buffer, uint32_t slot)
+{
+	// Frames in flight index the heap with the slot, it is only handed out again once they have finished.
+	Retire(buffer.buffer);
+	Retire(buffer.bufferMemory);
+	Retire(vkInit::BindlessStorageBuffers, slot);
+}
+
+void DeletionQueue::Retire(vkInit::BindlessBinding binding, uint32_t slot)
+{
+	if (slot != vkInit::InvalidBindlessIndex && m_Heap)
+		Push(ResourceType::BindlessSlot, (static_cast<uint64_t>(binding) << 32) | slot);
+}
+
+void DeletionQueue::Collect()
+{
+	PROFILE_SCOPE("DeletionQueue::Collect");
+	if (m_Queue.empty())
+		return;
+
+	uint64_t completed = m_Scheduler.GetCompletedValue(QueueType::Graphics);
+	while (!m_Queue.empty() && m_Queue.front().value <= completed)
+	{
+		Destroy(m_Queue.front());
+		m_Queue.pop_front();
+	}
+}
+
+void DeletionQueue::Push(ResourceType type, uint64_t handle)
+{
+	// Whatever is being recorded goes out with the next submission, everything before it has been submitted already.
+	uint64_t value = m_Scheduler.GetSubmittedValue(QueueType::Graphics) + 1;
+	m_Queue.push_back({ value, type, handle });
+}
+
+void DeletionQueue::Destroy(const Retired& retired)
+{
+	switch (retired.type)
+	{
+	case ResourceType::Buffer:		m_Device.destroyBuffer(FromBits<vk::Buffer>(retired.handle)); break;
+	case ResourceType::Image:		m_Device.destroyImage(FromBits<vk::Image>(retired.handle)); break;
+	case ResourceType::ImageView:	m_Device.destroyImageView(FromBits<vk::ImageView>(retired.handle)); break;
+	case ResourceType::Memory:		vkInit::FreeMemory(m_Device, FromBits<vk::DeviceMemory>(retired.handle)); break;
+	case ResourceType::Pipeline:	m_Device.destroyPipeline(FromBits<vk::Pipeline>(retired.handle)); break;
+	case ResourceType::RenderPass:	m_Device.destroyRenderPass(FromBits<vk::RenderPass>(retired.handle)); break;
+	case ResourceType::Framebuffer:	m_Device.destroyFramebuffer(FromBits<vk::Framebuffer>(retired.handle)); break;
+	case ResourceType::BindlessSlot:
+		vkInit::ReleaseBindlessSlot(*m_Heap, static_cast<vkInit::BindlessBinding>(retired.handle >> 32), static_cast<uint32_t>(retired.handle));
+		break;
+	}
+	m_Destroyed++;
+}
\ No newline at end of file
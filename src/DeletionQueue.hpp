@@ -0,0 +1,91 @@
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+
+#include "Config.hpp"
+#include "FrameScheduler.hpp"
+#include "Vulkan/Descriptors.hpp"
+#include "Vulkan/Memory.hpp"
+
+#include <deque>
+
+// Destroys resources once the GPU is done with them instead of waiting for the device to go idle. Everything retired is
+// tagged with the graphics timeline value the next submission will signal, which covers the frame being recorded and
+// every frame before it, and is destroyed in a batch by Collect once that value is reached. Work on other queues that
+// reads a resource has to be waited on by a graphics submission before it is retired. Not thread safe, resources are
+// retired from the thread recording frames.
+class DeletionQueue
+{
+public:
+	struct Stats
+	{
+		uint32_t pending = 0;
+		uint64_t destroyed = 0;		// Since startup.
+	};
+
+	struct Input
+	{
+		vk::Device device;
+		FrameScheduler* scheduler;
+		vkInit::BindlessHeap* heap;		// Slots are released with their resources, may be null without the bindless heap.
+	};
+
+	DeletionQueue(const Input& input);
+	DeletionQueue(const DeletionQueue&) = delete;
+	DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+	/// @brief Destroys everything still queued. The device must be idle.
+	~DeletionQueue();
+
+	/// @brief Null handles are ignored.
+	void Retire(vk::Buffer buffer);
+	void Retire(vk::Image image);
+	void Retire(vk::ImageView view);
+	void Retire(vk::DeviceMemory memory);
+	void Retire(vk::Pipeline pipeline);
+	void Retire(vk::RenderPass renderPass);
+	void Retire(vk::Framebuffer framebuffer);
+
+	/// @brief Retires the buffer, its memory and its storage buffer slot in the bindless heap.
+	void Retire(const vkInit::Buffer& buffer, uint32_t slot = vkInit::InvalidBindlessIndex);
+
+	/// @brief Releases slot of binding in the bindless heap once the frames that may index it have finished. Slots are handed
+	/// out again right away otherwise, and writing the new descriptor would change what those frames read. Invalid slots are ignored.
+	void Retire(vkInit::BindlessBinding binding, uint32_t slot);
+
+	/// @brief Destroys everything whose frames have finished. Never blocks, called once per frame.
+	void Collect();
+
+	Stats GetStats() const { return { static_cast<uint32_t>(m_Queue.size()), m_Destroyed }; }
+private:
+	enum class ResourceType : uint8_t
+	{
+		Buffer,
+		Image,
+		ImageView,
+		Memory,
+		Pipeline,
+		RenderPass,
+		Framebuffer,
+		BindlessSlot
+	};
+
+	struct Retired
+	{
+		uint64_t value;			// On the graphics timeline.
+		ResourceType type;
+		uint64_t handle;		// The Vulkan handle, or the binding in the high and the slot in the low 32 bits.
+	};
+
+	void Push(ResourceType type, uint64_t handle);
+	void Destroy(const Retired& retired);
+private:
+	vk::Device m_Device;
+	FrameScheduler& m_Scheduler;
+	vkInit::BindlessHeap* m_Heap;
+
+	// Values only grow, so the queue is in completion order and Collect stops at the first pending entry.
+	std::deque<Retired> m_Queue;
+	uint64_t m_Destroyed = 0;
+};
+
+#endif // !DELETION_QUEUE_HPP
\ No newline at end of file
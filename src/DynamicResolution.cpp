@@ -0,0 +1,71 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Weight of each new measurement in the smoothed GPU time.
+	constexpr double Smoothing = 0.2;
+
+	// Largest step toward the wanted scale per frame, dropping is faster than recovering.
+	constexpr float MaxDecrease = 0.1f;
+	constexpr float MaxIncrease = 0.02f;
+
+	// Within this fraction below the budget the scale is left alone.
+	constexpr double DeadBand = 0.1;
+
+	constexpr uint32_t Tile = 8;
+}
+
+DynamicResolution::DynamicResolution(const DynamicResolutionSettings& settings) : m_Settings(settings)
+{
+	m_Settings.minScale = std::clamp(m_Settings.minScale, 0.1f, 1.0f);
+	m_Settings.maxScale = std::clamp(m_Settings.maxScale, m_Settings.minScale, 1.0f);
+	m_Scale = m_Settings.maxScale;
+}
+
+void DynamicResolution::ReportGpuTime(double milliseconds)
+{
+	if (milliseconds <= 0.0)
+		return;
+
+	m_GpuMilliseconds = m_GpuMilliseconds == 0.0 ? milliseconds : m_GpuMilliseconds + (milliseconds - m_GpuMilliseconds) * Smoothing;
+
+	double target = m_Settings.targetMilliseconds;
+	if (m_GpuMilliseconds <= target && m_GpuMilliseconds >= target * (1.0 - DeadBand))
+		return;
+
+	float wanted = m_Scale * static_cast<float>(std::sqrt(target / m_GpuMilliseconds));
+	float step = std::clamp(wanted - m_Scale, -MaxDecrease, MaxIncrease);
+	m_Scale = std::clamp(m_Scale + step, m_Settings.minScale, m_Settings.maxScale);
+}
+
+vk::Extent2D DynamicResolution::GetTargetExtent(vk::Extent2D swapchainExtent) const
+{
+	auto scale = [&](uint32_t size) { return std::max(1u, static_cast<uint32_t>(std::ceil(size * m_Settings.maxScale))); };
+	return vk::Extent2D(scale(swapchainExtent.width), scale(swapchainExtent.height));
+}
+
+vk::Extent2D DynamicResolution::GetRenderExtent(vk::Extent2D swapchainExtent)
+{
+	vk::Extent2D target = GetTargetExtent(swapchainExtent);
+	auto scale = [&](uint32_t size, uint32_t limit)
+	{
+		uint32_t tiles = static_cast<uint32_t>(std::lround(size * m_Scale / Tile));
+		return std::clamp(tiles * Tile, std::min(Tile, limit), limit);
+	};
+
+	vk::Extent2D extent(scale(swapchainExtent.width, target.width), scale(swapchainExtent.height, target.height));
+	if (extent != m_LastExtent)
+		m_Changes++;
+	m_LastExtent = extent;
+	return extent;
+}
+
+DynamicResolution::Stats DynamicResolution::TakeStats()
+{
+	Stats stats{ m_Scale, m_GpuMilliseconds, m_Changes };
+	m_Changes = 0;
+	return stats;
+}
\ No newline at end of file
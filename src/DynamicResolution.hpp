@@ -0,0 +1,51 @@
+#ifndef DYNAMIC_RESOLUTION_HPP
+#define DYNAMIC_RESOLUTION_HPP
+
+#include "Config.hpp"
+
+struct DynamicResolutionSettings
+{
+	bool enabled = false;
+	float minScale = 0.5f;				// Of the swapchain extent on each axis.
+	float maxScale = 1.0f;				// The render target is allocated at this scale and never resized.
+	double targetMilliseconds = 14.0;	// GPU frame time to hold, a little below the frame interval leaves headroom.
+};
+
+// Picks the resolution the scene is rendered at from measured GPU frame times. GPU time is taken to grow with the
+// rendered pixel count, so the scale that meets the budget is the current one times the square root of target over
+// measured. Measurements are smoothed and the scale drops faster than it recovers, so a spike is answered right away
+// while the resolution does not oscillate around the budget.
+class DynamicResolution
+{
+public:
+	struct Stats
+	{
+		float scale = 1.0f;
+		double gpuMilliseconds = 0.0;	// Smoothed.
+		uint32_t changes = 0;			// Render extent changes since the last TakeStats.
+	};
+
+	DynamicResolution(const DynamicResolutionSettings& settings);
+
+	/// @brief Feeds the GPU time of a finished frame and moves the scale toward the one that meets the budget.
+	void ReportGpuTime(double milliseconds);
+
+	/// @brief Extent the render target is allocated at for a swapchain extent.
+	vk::Extent2D GetTargetExtent(vk::Extent2D swapchainExtent) const;
+
+	/// @brief Extent to render at this frame, rounded to whole tiles of 8 pixels so small scale changes keep it the same.
+	vk::Extent2D GetRenderExtent(vk::Extent2D swapchainExtent);
+
+	float GetScale() const { return m_Scale; }
+
+	/// @brief Returns the stats gathered since the last call.
+	Stats TakeStats();
+private:
+	DynamicResolutionSettings m_Settings;
+	float m_Scale;
+	double m_GpuMilliseconds = 0.0;
+	vk::Extent2D m_LastExtent;
+	uint32_t m_Changes = 0;
+};
+
+#endif // !DYNAMIC_RESOLUTION_HPP
\ No newline at end of file
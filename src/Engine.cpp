@@ -4,46 +4,193 @@
 #include "Vulkan/Device.hpp"
 #include "Vulkan/Swapchain.hpp"
 #include "Vulkan/Pipeline.hpp"
-#include "Vulkan/Framebuffer.hpp"
 #include "Vulkan/Command.hpp"
 #include "Vulkan/Sync.hpp"
+#include "Vulkan/Image.hpp"
 #include <limits>
+#include <chrono>
+#include <iomanip>
 
-Engine::Engine(uint32_t width, uint32_t height) : m_Width(width), m_Height(height)
+namespace
 {
-    // Create Window!
-    CreateGLFWWindow();
+    // Batches recorded into each secondary command buffer of the scene passes. Smaller buckets record less again when
+    // a few batches change, larger ones execute fewer command buffers.
+    constexpr uint32_t SceneBucketBatches = 64;
+
+    // Every shader a pipeline is built from, loaded on the workers during startup.
+    const char* const StartupShaders[] =
+    {
+        PROJECT_DIR"/src/Shaders/TriangleVert.spv",
+        PROJECT_DIR"/src/Shaders/TriangleIndirectVert.spv",
+        PROJECT_DIR"/src/Shaders/TriangleFrag.spv",
+        PROJECT_DIR"/src/Shaders/ParticleVert.spv"
+    };
+
+    // Their multiview variants, only loaded when more than one view is asked for.
+    const char* const MultiviewShaders[] =
+    {
+        PROJECT_DIR"/src/Shaders/TriangleIndirectMultiviewVert.spv",
+        PROJECT_DIR"/src/Shaders/ParticleMultiviewVert.spv"
+    };
+}
+
+Engine::Engine(const EngineSettings& settings) : m_Width(settings.width), m_Height(settings.height), m_Settings(settings)
+{
+    PROFILE_SCOPE("Engine::Engine");
+    m_StartupStart = std::chrono::steady_clock::now();
+    m_StartupPhaseStart = m_StartupStart;
 
-    // Create Vulkan Instance!
-    CreateVulkanInstance();
+    m_JobSystem = std::make_unique<JobSystem>(settings.jobs);
+    m_FramePipeline = std::make_unique<FramePipeline>(*m_JobSystem, settings.pipelineDepth);
+    m_FramePipeline->SetSortFrontToBack(settings.sortFrontToBack);
+    EndStartupPhase("Job system");
+
+    // The instance does not need the window, so it is created on a worker while this thread creates the window,
+    // which GLFW only allows on the main thread. Both need GLFW initialized.
+    CONSOLE_INFO("Intializing GLFW!");
+    glfwInit();
+    JobCounter instanceJob;
+    m_JobSystem->Run([this]() { CreateVulkanInstance(); }, &instanceJob);
+    CreateGLFWWindow();
+    m_JobSystem->Wait(instanceJob);
+    CreateSurface();
+    EndStartupPhase("Instance and window");
 
     // Create Device
     CreateDevice();
+    EndStartupPhase("Device");
 
-    // Create Pipeline
-    CreatePipeline();
+    // Shaders load on the workers while this thread creates the swapchain, the global bindless descriptor heap and the
+    // frame's passes, whose render passes the pipelines are built against.
+    JobCounter shaderJobs;
+    LoadShaderModules(shaderJobs);
+    CreateSwapchain();
+    CreateDescriptorHeap();
+    ChooseViewCount();
+    CreateDynamicResolution();
+    CreateRenderGraph();
+    m_JobSystem->Wait(shaderJobs);
+    EndStartupPhase("Swapchain, render graph and shaders");
+
+    // Pipelines compile and the assets upload on the workers, while this thread sets up the command buffers,
+    // synchronization and the systems that only need the device.
+    JobCounter pipelineJobs;
+    CreatePipeline(pipelineJobs);
+    m_JobSystem->Run([this]() { CreateAssets(); }, &pipelineJobs);
 
     // Do all the other things like
-    // create framebuffers, command pool, use synchronization.
+    // create command pool, use synchronization.
     FinalRenderingSetup();
 
-    // Create Assets
-    CreateAssets();
+    if (m_BindlessSupported && settings.cacheCommands)
+        m_CommandCache = std::make_unique<CommandCache>(CommandCache::Input{ m_Device, m_CommandPool });
+
+    if ((m_SwapchainUsage & vk::ImageUsageFlagBits::eTransferSrc) && FrameCapture::IsSupported(m_SwapchainFormat))
+    {
+        FrameCapture::Input captureInput{ m_Device, m_PhysicalDevice, m_JobSystem.get(), m_Scheduler.get(), settings.capture };
+        m_FrameCapture = std::make_unique<FrameCapture>(captureInput);
+    }
+    else if (settings.capture.enabled)
+    {
+        CONSOLE_WARN("Swapchain images of format %s cannot be copied from, frame capture is disabled.", vk::to_string(m_SwapchainFormat).c_str());
+    }
+
+    if (settings.gpuTimestamps)
+    {
+        GpuProfiler::Input profilerInput{};
+        profilerInput.device = m_Device;
+        profilerInput.physicalDevice = m_PhysicalDevice;
+        profilerInput.queueFamily = m_QueueFamilies.graphicsFamily.value();
+        profilerInput.framesInFlight = static_cast<uint32_t>(m_MaxFramesInFlight);
+        profilerInput.pipelineStatistics = settings.gpuPipelineStatistics;
+        profilerInput.inheritedQueries = m_Capabilities.inheritedQueries;
+        m_GpuProfiler = std::make_unique<GpuProfiler>(profilerInput);
+        if (m_GpuProfiler->IsSupported())
+            m_RenderGraph->SetGpuProfiler(m_GpuProfiler.get());
+        else
+            m_GpuProfiler.reset();
+    }
+
+    m_JobSystem->Wait(pipelineJobs);
+    DestroyShaderModules();
+    EndStartupPhase("Pipelines, assets and command buffers");
+
+    if (m_BindlessSupported)
+    {
+        SceneBuffers::Input sceneInput{ m_Device, m_PhysicalDevice, &m_BindlessHeap, m_DeletionQueue.get(), static_cast<uint32_t>(m_MaxFramesInFlight) };
+        m_SceneBuffers = std::make_unique<SceneBuffers>(sceneInput);
+    }
+
+    if (m_IndirectPipeline)
+    {
+        PROFILE_SCOPE("Engine::CreateOcclusionCuller");
+        OcclusionCuller::Input cullerInput{ m_Device, m_PhysicalDevice, &m_BindlessHeap, m_DeletionQueue.get(), m_SceneBuffers.get(),
+            m_SwapchainExtent, static_cast<uint32_t>(m_MaxFramesInFlight) };
+        m_OcclusionCuller = std::make_unique<OcclusionCuller>(cullerInput);
+    }
+
+    if (m_InstancePipeline && settings.particles.capacity > 0)
+    {
+        PROFILE_SCOPE("Engine::CreateParticleSystem");
+        ParticleSystem::Input particleInput{ m_Device, m_PhysicalDevice, &m_BindlessHeap, static_cast<uint32_t>(m_MaxFramesInFlight), settings.particles };
+        m_ParticleSystem = std::make_unique<ParticleSystem>(particleInput);
+    }
+
+    if (m_InstancePipeline && settings.streaming.enabled)
+    {
+        PROFILE_SCOPE("Engine::CreateWorldStreamer");
+        WorldStreamer::Input streamerInput{ m_Device, m_PhysicalDevice, &m_BindlessHeap, m_JobSystem.get(), m_DeletionQueue.get(),
+            m_TriangleMesh->bounds, settings.streaming };
+        m_WorldStreamer = std::make_unique<WorldStreamer>(streamerInput);
+    }
+
+    SetDepthMode(settings.depthPrepass, settings.sortFrontToBack);
+    EndStartupPhase("Culling, particles and streaming");
+    CONSOLE_INFO("Startup took %.2f ms.", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_StartupStart).count());
 }
 
 Engine::~Engine()
 {
+    m_FramePipeline->Flush();
     m_Device.waitIdle();
 
-    m_TriangleMesh->Destroy();
+    // Writes the frames still in flight before the job system goes away.
+    m_FrameCapture.reset();
+
+    m_TriangleMesh->Destroy(*m_DeletionQueue);
     DestroySwapchain();
+    m_CommandCache.reset();
     m_Device.destroyCommandPool(m_CommandPool);
-    m_Device.destroyPipeline(m_Pipeline);
+    for (const ScenePipeline& pipeline : m_ScenePipelines)
+    {
+        m_Device.destroyPipeline(pipeline.forward);
+        m_Device.destroyPipeline(pipeline.equal);
+        m_Device.destroyPipeline(pipeline.depth);
+    }
+    m_Device.destroyPipeline(m_IndirectPipeline);
+    m_Device.destroyPipeline(m_InstancePipeline);
     m_Device.destroyPipelineLayout(m_PipelineLayout);
-    m_Device.destroyRenderPass(m_RenderPass);
+    m_RenderGraph.reset();
+    m_OcclusionCuller.reset();
+    m_ParticleSystem.reset();
+    m_WorldStreamer.reset();
+    m_SceneBuffers.reset();
+    DestroySceneViews();
+    m_DeletionQueue.reset();
+    m_GpuProfiler.reset();
+    m_FramePacer.reset();
+    m_Scheduler.reset();
+    if (m_BindlessHeap.pool)
+        vkInit::DestroyBindlessHeap(m_BindlessHeap);
+
+    // Every allocation should be gone by now.
+    MemoryTracker::Get().RemoveBudgetCallback(m_BudgetCallback);
+    MemoryTracker::Get().LogReport();
+    MemoryTracker::Get().ReportLeaks();
+
     m_Device.destroy(); 
     m_Instance.destroySurfaceKHR(m_Surface);
-    if(m_DebugMode)
+    if(m_Settings.validation)
         m_Instance.destroyDebugUtilsMessengerEXT(m_DebugMessenger, nullptr, m_Dldi);
     m_Instance.destroy();
 
@@ -55,8 +202,7 @@ Engine::~Engine()
 
 void Engine::CreateGLFWWindow()
 {
-    CONSOLE_INFO("Intializing GLFW!");
-    glfwInit();
+    PROFILE_SCOPE("Engine::CreateGLFWWindow");
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
     m_Window = glfwCreateWindow(m_Width, m_Height, "Vulkan Renderer", nullptr, nullptr);
@@ -69,11 +215,15 @@ void Engine::CreateGLFWWindow()
 
 void Engine::CreateVulkanInstance()
 {
-    m_Instance = vkInit::CreateInstance("Vulkan Renderer", m_DebugMode);
+    PROFILE_SCOPE("Engine::CreateVulkanInstance");
+    m_Instance = vkInit::CreateInstance("Vulkan Renderer", m_Settings.validation);
     m_Dldi = vk::DispatchLoaderDynamic(m_Instance, vkGetInstanceProcAddr);
-    if (m_DebugMode)
+    if (m_Settings.validation)
         m_DebugMessenger = vkInit::CreateDebugMessenger(m_Instance, m_Dldi);
+}
 
+void Engine::CreateSurface()
+{
     VkSurfaceKHR surface;
     if (glfwCreateWindowSurface(m_Instance, m_Window, nullptr, &surface) != VK_SUCCESS)
         CONSOLE_ERROR("Failed to abstract the glfw surface for Vulkan.");
@@ -84,44 +234,481 @@ void Engine::CreateVulkanInstance()
 
 void Engine::CreateDevice()
 {
-    m_PhysicalDevice = vkInit::ChoosePhysicalDevice(m_Instance);
-    m_Device = vkInit::CreateLogicalDevice(m_PhysicalDevice, m_Surface);
-    std::array<vk::Queue, 2> queues = vkInit::GetQueue(m_PhysicalDevice, m_Device, m_Surface);
+    PROFILE_SCOPE("Engine::CreateDevice");
+    // Everything asked about the device while choosing it is kept, nothing queries it again.
+    vkInit::PhysicalDeviceChoice choice = vkInit::ChoosePhysicalDevice(m_Instance, m_Surface);
+    m_PhysicalDevice = choice.device;
+    m_Capabilities = choice.capabilities;
+    m_QueueFamilies = choice.queueFamilies;
+    vkInit::LogDeviceCapabilities(m_Capabilities);
+    m_Device = vkInit::CreateLogicalDevice(m_PhysicalDevice, m_QueueFamilies, m_Capabilities, m_Settings.validation);
+    std::array<vk::Queue, 4> queues = vkInit::GetQueue(m_Device, m_QueueFamilies);
 
     m_GraphicsQueue = queues[0];
     m_PresentQueue = queues[1];
 
-    CreateSwapchain();
+    FrameScheduler::Input schedulerInput{};
+    schedulerInput.device = m_Device;
+    schedulerInput.queues = { queues[0], queues[2], queues[3] };
+    schedulerInput.timelineSemaphores = m_Capabilities.timelineSemaphores;
+    schedulerInput.synchronization2 = m_Capabilities.synchronization2;
+    m_Scheduler = std::make_unique<FrameScheduler>(schedulerInput);
+    m_DeletionQueue = std::make_unique<DeletionQueue>(DeletionQueue::Input{ m_Device, m_Scheduler.get(), &m_BindlessHeap });
+
+    m_FramePacer = std::make_unique<FramePacer>(m_Settings.pacing, *m_Scheduler);
+    MemoryTracker::Get().Initialize(m_PhysicalDevice, m_Capabilities.memoryBudget);
+    MemoryTracker::Get().SetSoftBudget(m_Settings.memorySoftBudget);
+    m_BudgetCallback = MemoryTracker::Get().AddBudgetCallback([this](uint32_t heap, vk::DeviceSize usage, vk::DeviceSize softBudget)
+    {
+        // Only the world streamer can evict anything, so only say so once per heap.
+        if (m_ReportedOverBudget & (1u << heap))
+            return;
+        m_ReportedOverBudget |= 1u << heap;
+        CONSOLE_WARN("Memory heap %u is over its soft budget, %.1f of %.1f MB used.", heap, usage / (1024.0 * 1024.0), softBudget / (1024.0 * 1024.0));
+    });
+
+    m_PresentWaitSupported = m_Capabilities.presentWait;
+    if (m_PresentWaitSupported)
+        m_Dldd = vk::DispatchLoaderDynamic(m_Instance, vkGetInstanceProcAddr, m_Device, vkGetDeviceProcAddr);
+
+    m_SwapchainSupport = vkInit::QuerySwapChainSupport(m_PhysicalDevice, m_Surface);
+    vkInit::LogSwapChainSupport(m_SwapchainSupport);
     m_FrameNumber = 0;
 }
 
-void Engine::CreatePipeline()
+void Engine::CreateDescriptorHeap()
+{
+    PROFILE_SCOPE("Engine::CreateDescriptorHeap");
+    m_BindlessSupported = m_Capabilities.descriptorIndexing;
+    if (!m_BindlessSupported)
+    {
+        CONSOLE_WARN("Descriptor indexing is not supported, the bindless heap is disabled.");
+        return;
+    }
+
+    vkInit::BindlessHeapInput input{};
+    input.device = m_Device;
+    input.physicalDevice = m_PhysicalDevice;
+    m_BindlessHeap = vkInit::CreateBindlessHeap(input);
+    m_BindlessSupported = static_cast<bool>(m_BindlessHeap.set);
+}
+
+void Engine::ChooseViewCount()
+{
+    m_ViewCount = 1;
+    m_ViewMask = 0;
+    if (m_Settings.multiview.viewCount <= 1)
+        return;
+
+    // The views read their transforms through the bindless heap and are copied into the swapchain image side by side.
+    if (!m_Capabilities.multiview || !m_BindlessSupported || !(m_SwapchainUsage & vk::ImageUsageFlagBits::eTransferDst))
+    {
+        CONSOLE_WARN("Multiview needs the multiview feature, the bindless heap and swapchain images that can be copied to, rendering a single view.");
+        return;
+    }
+
+    m_ViewCount = std::min({ m_Settings.multiview.viewCount, m_Capabilities.maxMultiviewViews, 32u });
+    m_ViewMask = m_ViewCount == 32 ? UINT32_MAX : (1u << m_ViewCount) - 1;
+    CONSOLE_INFO("Rendering %u views with multiview.", m_ViewCount);
+
+    // The depth pyramid only holds one view.
+    if (m_Settings.occlusionCulling)
+        CONSOLE_WARN("Occlusion culling is disabled while rendering more than one view.");
+}
+
+void Engine::CreateDynamicResolution()
+{
+    const DynamicResolutionSettings& settings = m_Settings.dynamicResolution;
+    if (!settings.enabled)
+        return;
+
+    // The controller follows the GPU timestamps, the scene is blitted into the swapchain image with a linear filter.
+    vk::FormatFeatureFlags blit = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    vk::FormatFeatureFlags features = m_PhysicalDevice.getFormatProperties(m_SwapchainFormat).optimalTilingFeatures;
+    if (m_ViewCount > 1 || !m_Settings.gpuTimestamps || !(m_SwapchainUsage & vk::ImageUsageFlagBits::eTransferDst) || (features & blit) != blit)
+    {
+        CONSOLE_WARN("Dynamic resolution needs a single view, GPU timestamps and swapchain images that can be blitted to, rendering at the swapchain resolution.");
+        return;
+    }
+
+    m_DynamicResolution = std::make_unique<DynamicResolution>(settings);
+    CONSOLE_INFO("Dynamic resolution holding %.2f ms of GPU time.", settings.targetMilliseconds);
+
+    // The depth pyramid is built at the full extent.
+    if (m_Settings.occlusionCulling)
+        CONSOLE_WARN("Occlusion culling is disabled while the resolution is dynamic.");
+}
+
+vk::Extent2D Engine::GetViewExtent() const
+{
+    return vk::Extent2D(std::max(1u, m_SwapchainExtent.width / m_ViewCount), m_SwapchainExtent.height);
+}
+
+void Engine::CreateRenderGraph()
+{
+    PROFILE_SCOPE("Engine::CreateRenderGraph");
+    m_RenderGraph = std::make_unique<RenderGraph>(m_Device, m_PhysicalDevice);
+    m_RenderGraph->SetDeletionQueue(m_DeletionQueue.get());
+    m_DepthFormat = vkInit::FindDepthFormat(m_PhysicalDevice);
+
+    // Compiled with the pre-pass so every render pass a pipeline is built against exists.
+    m_DepthPrepass = true;
+    m_RenderExtent = GetViewExtent();
+    FramePacket empty;
+    DeclareRenderGraph(empty, nullptr);
+    m_RenderGraph->Compile();
+}
+
+void Engine::DeclareRenderGraph(const FramePacket& packet, const vkInit::SwapChainFrame* target)
 {
+    m_RenderGraph->Begin();
+
+    RenderImageDesc backbufferDesc{};
+    backbufferDesc.format = m_SwapchainFormat;
+    backbufferDesc.extent = m_SwapchainExtent;
+
+    // The acquire semaphore is waited on at the color attachment output stage, the first barrier has to chain with it.
+    RenderImageImport backbufferImport{};
+    backbufferImport.image = target ? target->image : nullptr;
+    backbufferImport.view = target ? target->imageView : nullptr;
+    backbufferImport.initialLayout = vk::ImageLayout::eUndefined;
+    backbufferImport.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+    backbufferImport.initialStages = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    RenderResource backbuffer = m_RenderGraph->ImportImage("Backbuffer", backbufferDesc, backbufferImport);
+
+    // At a dynamic resolution the target is allocated at the largest scale, only the area drawn to changes from frame to frame.
+    vk::Extent2D targetExtent = m_DynamicResolution ? m_DynamicResolution->GetTargetExtent(m_SwapchainExtent) : GetViewExtent();
+
+    // With several views the scene is drawn into one layer per view, which are composed into the backbuffer at the end.
+    // At a dynamic resolution it is drawn into a target of its own, which is upscaled into the backbuffer.
+    RenderResource color = backbuffer;
+    if (m_ViewCount > 1)
+    {
+        RenderImageDesc viewsDesc{};
+        viewsDesc.format = m_SwapchainFormat;
+        viewsDesc.extent = targetExtent;
+        viewsDesc.arrayLayers = m_ViewCount;
+        color = m_RenderGraph->CreateImage("Views", viewsDesc);
+    }
+    else if (m_DynamicResolution)
+    {
+        RenderImageDesc sceneDesc{};
+        sceneDesc.format = m_SwapchainFormat;
+        sceneDesc.extent = targetExtent;
+        color = m_RenderGraph->CreateImage("Scene", sceneDesc);
+    }
+
+    // Transient, so it follows the swapchain extent and is recreated with it.
+    RenderImageDesc depthDesc{};
+    depthDesc.format = m_DepthFormat;
+    depthDesc.extent = targetExtent;
+    depthDesc.aspect = vkInit::GetDepthAspect(m_DepthFormat);
+    depthDesc.arrayLayers = m_ViewCount;
+    RenderResource depth = m_RenderGraph->CreateImage("Depth", depthDesc);
+
+    vk::ClearColorValue clearColor(std::array<float, 4>{ 0.02f, 0.04f, 0.08f, 1.0f });
+    vk::ClearDepthStencilValue clearDepth(1.0f, 0);
+
+    // Before any pass reads the scene's transforms or bounds.
+    if (m_SceneBuffers)
+        m_SceneBuffers->AddUploadPass(*m_RenderGraph);
+
+    // Simulated first, the particles are drawn over the finished scene.
+    ParticleSystem::FrameResources particles{};
+    if (m_ParticleSystem)
+    {
+        particles = m_ParticleSystem->Import(*m_RenderGraph);
+        m_ParticleSystem->AddSimulatePass(*m_RenderGraph, particles);
+    }
+
+    if (m_OcclusionCuller)
+    {
+        OcclusionCuller::FrameResources culling = m_OcclusionCuller->Import(*m_RenderGraph);
+        m_OcclusionCuller->AddEarlyCullPass(*m_RenderGraph, culling);
+
+        m_RenderGraph->AddPass("Forward", RenderGraph::PassType::Graphics)
+            .Read(culling.earlyDraws, ResourceUsage::IndirectBuffer)
+            .Read(culling.instances, ResourceUsage::StorageRead)
+            .WriteColor(backbuffer, clearColor)
+            .WriteDepth(depth, clearDepth)
+            .SetExecute([this](const RenderGraph::PassContext& context) { DrawSceneIndirect(context, false); });
+
+        m_OcclusionCuller->AddDepthPyramidPass(*m_RenderGraph, culling, depth);
+        m_OcclusionCuller->AddLateCullPass(*m_RenderGraph, culling);
+
+        m_RenderGraph->AddPass("ForwardLate", RenderGraph::PassType::Graphics)
+            .Read(culling.lateDraws, ResourceUsage::IndirectBuffer)
+            .Read(culling.instances, ResourceUsage::StorageRead)
+            .WriteColor(backbuffer)
+            .WriteDepth(depth)
+            .SetExecute([this](const RenderGraph::PassContext& context) { DrawSceneIndirect(context, true); });
+
+        m_OcclusionCuller->AddStatsReadbackPass(*m_RenderGraph, culling);
+    }
+    else if (m_DepthPrepass)
+    {
+        m_RenderGraph->AddPass("DepthPrepass", RenderGraph::PassType::Graphics)
+            .WriteDepth(depth, clearDepth)
+            .SetViewMask(m_ViewMask)
+            .SetRenderArea(m_RenderExtent)
+            .SetSecondaryCommandBuffers(m_CommandCache != nullptr)
+            .SetExecute([this, &packet](const RenderGraph::PassContext& context) { DrawScene(context, &ScenePipeline::depth, packet); });
+
+        m_RenderGraph->AddPass("Forward", RenderGraph::PassType::Graphics)
+            .WriteColor(color, clearColor)
+            .ReadDepth(depth)
+            .SetViewMask(m_ViewMask)
+            .SetRenderArea(m_RenderExtent)
+            .SetSecondaryCommandBuffers(m_CommandCache != nullptr)
+            .SetExecute([this, &packet](const RenderGraph::PassContext& context) { DrawScene(context, &ScenePipeline::equal, packet); });
+    }
+    else
+    {
+        m_RenderGraph->AddPass("Forward", RenderGraph::PassType::Graphics)
+            .WriteColor(color, clearColor)
+            .WriteDepth(depth, clearDepth)
+            .SetViewMask(m_ViewMask)
+            .SetRenderArea(m_RenderExtent)
+            .SetSecondaryCommandBuffers(m_CommandCache != nullptr)
+            .SetExecute([this, &packet](const RenderGraph::PassContext& context) { DrawScene(context, &ScenePipeline::forward, packet); });
+    }
+
+    if (m_WorldStreamer)
+    {
+        m_WorldStreamer->AddUploadPass(*m_RenderGraph);
+        m_RenderGraph->AddPass("Chunks", RenderGraph::PassType::Graphics)
+            .WriteColor(color)
+            .WriteDepth(depth)
+            .SetViewMask(m_ViewMask)
+            .SetRenderArea(m_RenderExtent)
+            .SetExecute([this, &packet](const RenderGraph::PassContext& context) { DrawChunks(context, packet); });
+    }
+
+    if (m_ParticleSystem)
+    {
+        m_RenderGraph->AddPass("Particles", RenderGraph::PassType::Graphics)
+            .Read(particles.control, ResourceUsage::IndirectBuffer)
+            .Read(particles.instances, ResourceUsage::StorageRead)
+            .WriteColor(color)
+            .WriteDepth(depth)
+            .SetViewMask(m_ViewMask)
+            .SetRenderArea(m_RenderExtent)
+            .SetExecute([this, &packet](const RenderGraph::PassContext& context) { DrawParticles(context, packet); });
+
+        m_ParticleSystem->AddReadbackPass(*m_RenderGraph, particles);
+    }
+
+    if (m_ViewCount > 1)
+    {
+        m_RenderGraph->AddPass("ComposeViews", RenderGraph::PassType::Transfer)
+            .Read(color, ResourceUsage::TransferSrc)
+            .Write(backbuffer, ResourceUsage::TransferDst)
+            .SetExecute([this, color, backbuffer](const RenderGraph::PassContext& context) { ComposeViews(context, color, backbuffer); });
+    }
+
+    if (m_DynamicResolution)
+    {
+        m_RenderGraph->AddPass("Upscale", RenderGraph::PassType::Transfer)
+            .Read(color, ResourceUsage::TransferSrc)
+            .Write(backbuffer, ResourceUsage::TransferDst)
+            .SetExecute([this, color, backbuffer](const RenderGraph::PassContext& context) { Upscale(context, color, backbuffer); });
+    }
+
+    // Last, so the capture holds everything drawn this frame.
+    if (m_FrameCapture && target)
+        m_FrameCapture->AddCapturePass(*m_RenderGraph, backbuffer, m_SwapchainFormat, m_SwapchainExtent, m_SimulatedFrame);
+}
+
+void Engine::LoadShaderModules(JobCounter& jobs)
+{
+    // Every module gets its entry before the jobs start, so each job only writes its own.
+    for (const char* path : StartupShaders)
+        m_ShaderModules[path] = nullptr;
+    if (m_Settings.multiview.viewCount > 1)
+        for (const char* path : MultiviewShaders)
+            m_ShaderModules[path] = nullptr;
+
+    for (auto& [path, module] : m_ShaderModules)
+    {
+        const std::string& file = path;
+        vk::ShaderModule& target = module;
+        m_JobSystem->Run([this, &file, &target]() { target = CreateModule(file, m_Device); }, &jobs);
+    }
+}
+
+void Engine::DestroyShaderModules()
+{
+    for (auto& [path, module] : m_ShaderModules)
+        m_Device.destroyShaderModule(module);
+    m_ShaderModules.clear();
+}
+
+void Engine::CreatePipeline(JobCounter& jobs)
+{
+    PROFILE_SCOPE("Engine::CreatePipeline");
+    // Shared by every pipeline, so it is created before any of them.
+    std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+    if (m_BindlessSupported)
+        descriptorSetLayouts.push_back(m_BindlessHeap.layout);
+    m_PipelineLayout = vkInit::CreatePipelineLayout(m_Device, descriptorSetLayouts);
+
+    // Each pipeline compiles on its own worker from a copy of the specification and only writes its own handle.
+    auto build = [this, &jobs](const vkInit::GraphicsPipelineInBundle& specification, vk::Pipeline* target)
+    {
+        m_JobSystem->Run([specification, target]() { *target = vkInit::MakeGraphicsPipeline(specification).pipeline; }, &jobs);
+    };
+    auto setShaders = [this](vkInit::GraphicsPipelineInBundle& specification, const std::string& vertex, const std::string& fragment)
+    {
+        specification.vertexShaderFilePath = vertex;
+        specification.vertexShader = m_ShaderModules[vertex];
+        specification.fragmentShaderFilePath = fragment;
+        specification.fragmentShader = fragment.empty() ? vk::ShaderModule() : m_ShaderModules[fragment];
+    };
+
     vkInit::GraphicsPipelineInBundle specification{};
     specification.device = m_Device;
-    specification.vertexShaderFilePath = PROJECT_DIR"/src/Shaders/TriangleVert.spv";
-    specification.fragmentShaderFilePath = PROJECT_DIR"/src/Shaders/TriangleFrag.spv";
-    specification.swapchainExtent = m_SwapchainExtent;
+    // With the bindless heap the scene is drawn in instanced batches that read their world matrices from the scene buffers.
+    const char* sceneVertexShader = m_BindlessSupported ? PROJECT_DIR"/src/Shaders/TriangleIndirectVert.spv" : PROJECT_DIR"/src/Shaders/TriangleVert.spv";
+    if (m_ViewCount > 1)
+        sceneVertexShader = PROJECT_DIR"/src/Shaders/TriangleIndirectMultiviewVert.spv";
+    const char* fragmentShader = PROJECT_DIR"/src/Shaders/TriangleFrag.spv";
+    setShaders(specification, sceneVertexShader, fragmentShader);
+    specification.swapchainExtent = GetViewExtent();
+    specification.dynamicViewport = true;
     specification.swapchainImageFormat = m_SwapchainFormat;
+    specification.descriptorSetLayouts = descriptorSetLayouts;
+    specification.layout = m_PipelineLayout;
+    specification.renderPass = m_RenderGraph->GetRenderPass("Forward");
+    specification.depthTest = true;
+    specification.depthWrite = true;
+    specification.depthCompare = vk::CompareOp::eLessOrEqual;
+
+    // Materials select scene pipelines by index, the renderer only has one so far.
+    m_ScenePipelines.resize(1);
+    ScenePipeline& scenePipeline = m_ScenePipelines[0];
+    build(specification, &scenePipeline.forward);
+
+    // Same layout and compatible render pass, only the depth state differs.
+    vkInit::GraphicsPipelineInBundle equal = specification;
+    equal.depthWrite = false;
+    equal.depthCompare = vk::CompareOp::eEqual;
+    build(equal, &scenePipeline.equal);
+
+    if (m_Settings.occlusionCulling && m_ViewCount == 1 && !m_DynamicResolution && OcclusionCuller::IsSupported(m_PhysicalDevice, m_Capabilities, m_BindlessSupported, m_DepthFormat))
+    {
+        vkInit::GraphicsPipelineInBundle indirect = specification;
+        setShaders(indirect, PROJECT_DIR"/src/Shaders/TriangleIndirectVert.spv", fragmentShader);
+        build(indirect, &m_IndirectPipeline);
+    }
+    else if (m_Settings.occlusionCulling && m_ViewCount == 1 && !m_DynamicResolution)
+    {
+        CONSOLE_WARN("Occlusion culling is not supported by this device, drawing everything that passes frustum culling.");
+    }
+
+    // Instances come from the bindless heap, render pass compatibility only depends on the formats.
+    bool instanced = m_Settings.particles.capacity > 0 || m_Settings.streaming.enabled;
+    if (instanced && m_BindlessSupported)
+    {
+        vkInit::GraphicsPipelineInBundle instance = specification;
+        setShaders(instance, m_ViewCount > 1 ? PROJECT_DIR"/src/Shaders/ParticleMultiviewVert.spv" : PROJECT_DIR"/src/Shaders/ParticleVert.spv", fragmentShader);
+        build(instance, &m_InstancePipeline);
+    }
+    else if (instanced)
+    {
+        CONSOLE_WARN("GPU particles and world streaming need the bindless heap, which this device does not support.");
+    }
+
+    vkInit::GraphicsPipelineInBundle depth = specification;
+    setShaders(depth, sceneVertexShader, "");
+    depth.renderPass = m_RenderGraph->GetRenderPass("DepthPrepass");
+    build(depth, &scenePipeline.depth);
+}
+
+void Engine::EndStartupPhase(const char* name)
+{
+    auto now = std::chrono::steady_clock::now();
+    CONSOLE_INFO("Startup: %s took %.2f ms.", name, std::chrono::duration<double, std::milli>(now - m_StartupPhaseStart).count());
+    m_StartupPhaseStart = now;
+}
 
-    vkInit::GraphicsPipelineOutBundle output = vkInit::MakeGraphicsPipeline(specification);
-    m_PipelineLayout = output.layout;
-    m_Pipeline = output.pipeline;
-    m_RenderPass = output.renderpass;
+void Engine::SetDepthMode(bool depthPrepass, bool sortFrontToBack)
+{
+    m_DepthPrepass = depthPrepass;
+    m_FramePipeline->SetSortFrontToBack(sortFrontToBack);
+    CONSOLE_INFO("Depth pre-pass %s, front to back sorting %s.", depthPrepass ? "on" : "off", sortFrontToBack ? "on" : "off");
+}
+
+void Engine::UpdateDepthBenchmark()
+{
+    struct DepthMode
+    {
+        bool prepass, sort;
+        const char* name;
+    };
+    static const std::array<DepthMode, 4> modes =
+    { {
+        { false, false, "no pre-pass, submission order" },
+        { false, true, "no pre-pass, front to back" },
+        { true, false, "pre-pass, submission order" },
+        { true, true, "pre-pass, front to back" },
+    } };
+
+    // Frames simulated before a mode switch still carry the old draw order.
+    const uint32_t warmupFrames = 30;
+
+    if (!m_Settings.depthBenchmark || m_BenchmarkMode >= modes.size())
+        return;
+
+    if (m_BenchmarkFrame == 0)
+        SetDepthMode(modes[m_BenchmarkMode].prepass, modes[m_BenchmarkMode].sort);
+    if (m_BenchmarkFrame == warmupFrames)
+        m_BenchmarkStart = glfwGetTime();
+
+    if (++m_BenchmarkFrame < warmupFrames + m_Settings.benchmarkFrames)
+        return;
+
+    double milliseconds = (glfwGetTime() - m_BenchmarkStart) * 1000.0 / std::max(1u, m_Settings.benchmarkFrames);
+    m_BenchmarkResults.push_back(milliseconds);
+    CONSOLE_INFO("Depth benchmark, %s: %.3f ms per frame (%+.1f%% against %s).", modes[m_BenchmarkMode].name, milliseconds,
+        (milliseconds / m_BenchmarkResults.front() - 1.0) * 100.0, modes[0].name);
+
+    m_BenchmarkFrame = 0;
+    if (++m_BenchmarkMode == modes.size())
+        SetDepthMode(m_Settings.depthPrepass, m_Settings.sortFrontToBack);
 }
 
 void Engine::CreateSwapchain()
 {
-    vkInit::SwapChainBundle bundle = vkInit::CreateSwapChain(m_Device, m_PhysicalDevice, m_Surface, m_Width, m_Height);
+    PROFILE_SCOPE("Engine::CreateSwapchain");
+    vkInit::SwapChainInput input{};
+    input.device = m_Device;
+    input.physicalDevice = m_PhysicalDevice;
+    input.surface = m_Surface;
+    input.queueFamilies = m_QueueFamilies;
+    input.support = m_SwapchainSupport;
+    input.width = m_Width;
+    input.height = m_Height;
+    input.preferredPresentMode = m_Settings.presentMode;
+    vkInit::SwapChainBundle bundle = vkInit::CreateSwapChain(input);
     m_Swapchain = bundle.swapchain;
     m_SwapchainFrames = bundle.frames;
     m_SwapchainFormat = bundle.format;
     m_SwapchainExtent = bundle.extent;
+    m_PresentMode = bundle.presentMode;
+    m_SwapchainUsage = bundle.usage;
     m_MaxFramesInFlight = static_cast<int>(m_SwapchainFrames.size());
+
+    // The image count can shrink on recreation, frames in flight start over with the new swapchain.
+    m_FrameNumber = 0;
+
+    // Present ids restart with the swapchain, waits on older presents go to the GPU timeline instead.
+    if (m_PresentWaitSupported)
+        m_FramePacer->SetPresentWait(m_Device, m_Swapchain, &m_Dldd, m_SimulatedFrame);
 }
 
 void Engine::RecreateSwapchain()
 {
+    PROFILE_SCOPE("Engine::RecreateSwapchain");
     m_Width = 0;
     m_Height = 0;
 
@@ -132,10 +719,21 @@ void Engine::RecreateSwapchain()
     }
 
     m_Device.waitIdle();
+    m_RenderGraph->Invalidate();
     DestroySwapchain();
 
     CreateSwapchain();
-    CreateFramebuffers();
+    if (m_OcclusionCuller)
+        m_OcclusionCuller->Resize(m_SwapchainExtent, static_cast<uint32_t>(m_MaxFramesInFlight));
+    if (m_ParticleSystem)
+        m_ParticleSystem->Resize(static_cast<uint32_t>(m_MaxFramesInFlight));
+    if (m_SceneBuffers)
+        m_SceneBuffers->Resize(static_cast<uint32_t>(m_MaxFramesInFlight));
+    DestroySceneViews();
+    if (m_CommandCache)
+        m_CommandCache->Reset();
+    if (m_GpuProfiler)
+        m_GpuProfiler->Resize(static_cast<uint32_t>(m_MaxFramesInFlight));
     CreateSyncObjects();
     vkInit::CommandBufferInputChunk commandBufferInput = { m_Device, m_CommandPool, m_SwapchainFrames };
     vkInit::CreateFrameCommandBuffers(commandBufferInput);
@@ -146,8 +744,6 @@ void Engine::DestroySwapchain()
     for (const vkInit::SwapChainFrame& frame : m_SwapchainFrames)
     {
         m_Device.destroyImageView(frame.imageView);
-        m_Device.destroyFramebuffer(frame.framebuffer);
-        m_Device.destroyFence(frame.inFlight);
         m_Device.destroySemaphore(frame.imageAvailable);
         m_Device.destroySemaphore(frame.renderComplete);
         m_Device.freeCommandBuffers(m_CommandPool, frame.commandBuffer);
@@ -155,20 +751,13 @@ void Engine::DestroySwapchain()
     m_Device.destroySwapchainKHR(m_Swapchain);
 }
 
-void Engine::CreateFramebuffers()
-{
-    vkInit::FramebufferInput input;
-    input.device = m_Device;
-    input.renderPass = m_RenderPass;
-    input.swapchainextent = m_SwapchainExtent;
-    vkInit::CreateFramebuffers(input, m_SwapchainFrames);
-}
-
 void Engine::CreateSyncObjects()
 {
+    // Every earlier frame has finished once the device is idle, so the old points do not need to carry over.
+    m_FrameCompletion.assign(m_SwapchainFrames.size(), TimelinePoint{});
+
     for (vkInit::SwapChainFrame& frame : m_SwapchainFrames)
     {
-        frame.inFlight = vkInit::CreateFence(m_Device);
         frame.imageAvailable = vkInit::CreateSemaphore(m_Device);
         frame.renderComplete = vkInit::CreateSemaphore(m_Device);
     }
@@ -176,9 +765,8 @@ void Engine::CreateSyncObjects()
 
 void Engine::FinalRenderingSetup()
 {
-    CreateFramebuffers();
-
-    m_CommandPool = vkInit::CreateCommandPool(m_Device, m_PhysicalDevice, m_Surface);
+    PROFILE_SCOPE("Engine::FinalRenderingSetup");
+    m_CommandPool = vkInit::CreateCommandPool(m_Device, m_QueueFamilies.graphicsFamily.value());
 
     vkInit::CommandBufferInputChunk commandBufferInput = { m_Device, m_CommandPool, m_SwapchainFrames };
     m_MainCommandBuffer = vkInit::CreateCommandBuffer(commandBufferInput);
@@ -191,62 +779,85 @@ void Engine::RenderLoop(Scene* scene)
 {
     while (!glfwWindowShouldClose(m_Window))
     {
+        PROFILE_FRAME(m_SimulatedFrame);
+        PROFILE_SCOPE("Frame");
+
+        // Sleeps until the predicted start when pacing, so input is sampled as late as possible.
+        m_FramePacer->BeginFrame(m_SimulatedFrame);
         glfwPollEvents();
+        HandleDebugKeys();
+        MemoryTracker::Get().Update();
+        if (m_FrameCapture)
+            m_FrameCapture->Update();
         DisplayFramerate();
+        UpdateDepthBenchmark();
+
+        // Simulation and culling of the next frames run on the workers while this thread records and submits the current one.
+        m_FramePipeline->Kick(scene, m_SimulatedFrame);
+        const FramePacket& packet = m_FramePipeline->Acquire(m_SimulatedFrame);
 
-        m_Device.waitForFences(1, &m_SwapchainFrames[m_FrameNumber].inFlight, VK_TRUE, UINT32_MAX);
+        // Frame N - frames in flight used the same command buffer and semaphores.
+        m_Scheduler->Wait(m_FrameCompletion[m_FrameNumber]);
+        m_DeletionQueue->Collect();
+
+        // Whole scene uploads read the scene, the simulations of upcoming frames that write it have to finish first.
+        if (m_SceneBuffers && m_SceneBuffers->NeedsSceneUpload(packet))
+        {
+            m_FramePipeline->Flush();
+            m_SceneBuffers->UploadScene(*scene);
+        }
 
         uint32_t imageIndex = -1;
         try
         {
-            vk::ResultValue acquire = m_Device.acquireNextImageKHR(m_Swapchain, UINT32_MAX, m_SwapchainFrames[m_FrameNumber].imageAvailable, nullptr);
+            PROFILE_SCOPE("AcquireNextImage");
+            vk::ResultValue acquire = m_Device.acquireNextImageKHR(m_Swapchain, UINT64_MAX, m_SwapchainFrames[m_FrameNumber].imageAvailable, nullptr);
             imageIndex = acquire.value;
         }
         catch (const vk::OutOfDateKHRError& err)
         {
             CONSOLE_INFO("Recreate Swapchain!");
             RecreateSwapchain();
+            m_SimulatedFrame++;
             continue;
         }
-        m_Device.resetFences(1, &m_SwapchainFrames[m_FrameNumber].inFlight);
 
         vk::CommandBuffer commandBuffer = m_SwapchainFrames[m_FrameNumber].commandBuffer;
+        auto recordStart = std::chrono::steady_clock::now();
         commandBuffer.reset();
-        RecordDrawCommands(commandBuffer, imageIndex, scene);
-
-        vk::SubmitInfo submitInfo{};
-        vk::Semaphore waitSemaphores[] = { m_SwapchainFrames[m_FrameNumber].imageAvailable };
-        vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-        
-        vk::Semaphore signalSemaphores[] = { m_SwapchainFrames[m_FrameNumber].renderComplete };
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+        RecordDrawCommands(commandBuffer, imageIndex, packet);
 
-        try
-        {
-            m_GraphicsQueue.submit(submitInfo, m_SwapchainFrames[m_FrameNumber].inFlight);
-        }
-        catch (const vk::SystemError& err)
-        {
-            CONSOLE_ERROR("Failed to submit commands to the graphics queue! %s", err.what());
-        }
+        QueueSubmission submission{};
+        submission.commandBuffers.push_back(commandBuffer);
+        submission.waitSemaphore = m_SwapchainFrames[m_FrameNumber].imageAvailable;
+        submission.waitSemaphoreStages = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+        submission.signalSemaphore = m_SwapchainFrames[m_FrameNumber].renderComplete;
+        m_FrameCompletion[m_FrameNumber] = m_Scheduler->Submit(QueueType::Graphics, submission);
+        m_FramePacer->OnSubmit(m_SimulatedFrame, m_FrameCompletion[m_FrameNumber]);
+        if (m_FrameCapture)
+            m_FrameCapture->OnSubmit(m_FrameCompletion[m_FrameNumber]);
+        uint64_t presentId = m_FramePacer->GetPresentId(m_SimulatedFrame);
+
+        m_RecordMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+        m_SimulateMilliseconds += packet.simulateMilliseconds;
+        m_SimulatedFrame++;
 
         vk::PresentInfoKHR presentInfo{};
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &submission.signalSemaphore;
         vk::SwapchainKHR swapchains[] = { m_Swapchain };
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = swapchains;
         presentInfo.pImageIndices = &imageIndex;
 
+        vk::PresentIdKHR presentIdInfo(1, &presentId);
+        if (presentId != 0)
+            presentInfo.pNext = &presentIdInfo;
+
         vk::Result present;
         try
         {
+            PROFILE_SCOPE("Present");
             present = m_PresentQueue.presentKHR(presentInfo);
         }
         catch (const vk::OutOfDateKHRError& err)
@@ -261,8 +872,55 @@ void Engine::RenderLoop(Scene* scene)
             continue;
         }
 
+        if (!m_FirstFramePresented)
+        {
+            m_FirstFramePresented = true;
+            CONSOLE_INFO("First frame presented %.2f ms after startup began.",
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_StartupStart).count());
+        }
+
         m_FrameNumber = (m_FrameNumber + 1) % m_MaxFramesInFlight;
     }
+
+    // The simulations already kicked for upcoming frames still reference the scene.
+    m_FramePipeline->Flush();
+}
+
+void Engine::HandleDebugKeys()
+{
+    // F11 logs the memory report.
+    bool reportPressed = glfwGetKey(m_Window, GLFW_KEY_F11) == GLFW_PRESS;
+    if (reportPressed && !m_ReportKeyDown)
+    {
+        MemoryTracker::Get().LogReport();
+        if (m_WorldStreamer)
+            m_WorldStreamer->LogStats();
+    }
+    m_ReportKeyDown = reportPressed;
+
+    // F9 starts and stops capturing frames to disk.
+    bool capturePressed = glfwGetKey(m_Window, GLFW_KEY_F9) == GLFW_PRESS;
+    if (capturePressed && !m_CaptureKeyDown && m_FrameCapture)
+    {
+        if (m_FrameCapture->IsCapturing())
+            m_FrameCapture->Stop();
+        else
+            m_FrameCapture->Start(m_Settings.capture.frameCount);
+    }
+    m_CaptureKeyDown = capturePressed;
+
+#ifdef ENABLE_PROFILING
+    // F12 captures the next frames into a trace named after the first of them.
+    bool pressed = glfwGetKey(m_Window, GLFW_KEY_F12) == GLFW_PRESS;
+    if (pressed && !m_TraceKeyDown)
+    {
+        uint64_t first = m_SimulatedFrame + 1;
+        Profiler::Get().CaptureFrames(first, m_Settings.traceFrameCount, "trace_frame" + std::to_string(first) + ".json");
+        CONSOLE_INFO("Capturing a trace of frames %llu to %llu.", static_cast<unsigned long long>(first),
+            static_cast<unsigned long long>(first + m_Settings.traceFrameCount - 1));
+    }
+    m_TraceKeyDown = pressed;
+#endif
 }
 
 void Engine::DisplayFramerate()
@@ -273,18 +931,93 @@ void Engine::DisplayFramerate()
     if (delta >= 1)
     {
         int framerate{ std::max(1, int(m_NumFrames / delta)) };
+        double frames = std::max(1, m_NumFrames);
         std::stringstream title;
-        title << "Running at " << framerate << " fps.";
+        title << std::fixed << std::setprecision(2);
+        title << "Running at " << framerate << " fps (simulate " << m_SimulateMilliseconds / frames
+            << " ms, record " << m_RecordMilliseconds / frames << " ms";
+        GpuProfiler::Stats gpu = m_GpuProfiler ? m_GpuProfiler->TakeStats() : GpuProfiler::Stats{};
+        if (gpu.frames > 0)
+            title << ", gpu " << gpu.frameMilliseconds << " ms (max " << gpu.maxFrameMilliseconds << ")";
+        title << ").";
+        FramePacer::Stats pacing = m_FramePacer->TakeStats();
+        title << " Interval " << pacing.averageIntervalMilliseconds << " ms (max " << pacing.maxIntervalMilliseconds
+            << "), latency " << pacing.averageLatencyMilliseconds << " ms (max " << pacing.maxLatencyMilliseconds << ")";
+        if (m_PresentWaitSupported)
+            title << ", display " << pacing.averageDisplayLatencyMilliseconds << " ms";
+        title << ", " << vk::to_string(m_PresentMode) << ".";
+        MemoryTracker::Report memory = MemoryTracker::Get().GetReport();
+        for (const MemoryTracker::HeapStats& heap : memory.heaps)
+        {
+            if (heap.deviceLocal)
+            {
+                title << " VRAM " << heap.usage / (1024.0 * 1024.0) << " of " << heap.budget / (1024.0 * 1024.0) << " MB.";
+                break;
+            }
+        }
+        DeletionQueue::Stats deletions = m_DeletionQueue->GetStats();
+        if (deletions.pending > 0)
+            title << " " << deletions.pending << " resources waiting to be freed.";
+        if (m_CommandCache)
+        {
+            CommandCache::Stats commands = m_CommandCache->TakeStats();
+            title << " Cached commands: " << commands.recorded << " of " << commands.executed << " buckets recorded.";
+        }
+        title << " Queue: " << m_QueueStats.items << " items in " << m_QueueStats.batches << " batches, "
+            << m_QueueStats.pipelineChanges << " pipeline, " << m_QueueStats.materialChanges << " material and "
+            << m_QueueStats.meshChanges << " mesh changes, sorted in " << m_QueueStats.sortMilliseconds << " ms.";
+        if (m_DynamicResolution)
+        {
+            DynamicResolution::Stats resolution = m_DynamicResolution->TakeStats();
+            title << " Resolution " << resolution.scale * 100.0f << "% (" << m_RenderExtent.width << "x" << m_RenderExtent.height
+                << ", gpu " << resolution.gpuMilliseconds << " ms), " << resolution.changes << " changes.";
+        }
+        if (m_OcclusionCuller)
+        {
+            const OcclusionCuller::Stats& stats = m_OcclusionCuller->GetStats();
+            title << " Occlusion: " << stats.occluded << " of " << stats.tested << " culled, "
+                << stats.drawnEarly << " drawn early, " << stats.drawnLate << " late.";
+        }
+        if (m_FrameCapture && (m_FrameCapture->IsCapturing() || m_FrameCapture->GetStats().copied > 0))
+        {
+            const FrameCapture::Stats& capture = m_FrameCapture->GetStats();
+            title << " Capture: " << capture.written << " written, " << capture.dropped << " dropped, "
+                << capture.averageEncodeMilliseconds << " ms to encode.";
+        }
+        if (m_ParticleSystem)
+            title << " Particles: " << m_ParticleSystem->GetAliveCount() << " of " << m_ParticleSystem->GetCapacity() << ".";
+        if (m_WorldStreamer)
+        {
+            const WorldStreamer::Stats& streaming = m_WorldStreamer->GetStats();
+            title << " Chunks: " << streaming.drawnChunks << " drawn, " << streaming.resident << " resident ("
+                << streaming.residentBytes / (1024.0 * 1024.0) << " of " << streaming.budget / (1024.0 * 1024.0) << " MB), "
+                << streaming.queued + streaming.decoding << " loading.";
+        }
+        if (gpu.frames > 0)
+        {
+            title << " Passes:";
+            for (const GpuProfiler::PassStats& pass : gpu.passes)
+            {
+                title << " " << pass.name << " " << pass.milliseconds << " ms";
+                if (m_GpuProfiler->CollectsPipelineStatistics())
+                    title << " (vs " << pass.statistics.vertexShaderInvocations << ", fs " << pass.statistics.fragmentShaderInvocations
+                        << ", cs " << pass.statistics.computeShaderInvocations << ", clipped " << pass.statistics.clippingPrimitives << ")";
+            }
+            title << ".";
+        }
         glfwSetWindowTitle(m_Window, title.str().c_str());
         m_LastTime = m_CurrentTime;
         m_NumFrames = -1;
+        m_SimulateMilliseconds = 0.0;
+        m_RecordMilliseconds = 0.0;
     }
 
     m_NumFrames++;
 }
 
-void Engine::RecordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene)
+void Engine::RecordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex, const FramePacket& packet)
 {
+    PROFILE_SCOPE("Engine::RecordDrawCommands");
     vk::CommandBufferBeginInfo beginInfo{};
 
     try
@@ -296,32 +1029,44 @@ void Engine::RecordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageI
         CONSOLE_ERROR("Failed to begin recording command buffer! %s", err.what());
     }
 
-    vk::RenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.renderPass = m_RenderPass;
-    renderPassInfo.framebuffer = m_SwapchainFrames[imageIndex].framebuffer;
-    renderPassInfo.renderArea.offset.x = 0;
-    renderPassInfo.renderArea.offset.y = 0;
-    renderPassInfo.renderArea.extent = m_SwapchainExtent;
-    vk::ClearValue clearColor = { std::array<float, 4>{ 0.02f, 0.04f, 0.08f, 1.0f} };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-
-    commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_Pipeline);
+    // This frame slot's previous frame has finished, its timings are read back without waiting.
+    if (m_GpuProfiler && m_GpuProfiler->BeginFrame(commandBuffer, m_FrameNumber))
+    {
+        m_FramePacer->ReportGpuTime(m_GpuProfiler->GetLastFrameMilliseconds());
+        if (m_DynamicResolution)
+            m_DynamicResolution->ReportGpuTime(m_GpuProfiler->GetLastFrameMilliseconds());
+    }
+    m_RenderExtent = m_DynamicResolution ? m_DynamicResolution->GetRenderExtent(m_SwapchainExtent) : GetViewExtent();
 
-    PrepareScene(commandBuffer);
+    if (m_SceneBuffers)
+    {
+        m_SceneBuffers->BeginFrame(m_FrameNumber, packet);
+        UploadSceneViews(packet);
+    }
+    if (m_OcclusionCuller)
+        m_OcclusionCuller->BeginFrame(m_FrameNumber, packet);
+    if (m_ParticleSystem)
+        m_ParticleSystem->BeginFrame(m_FrameNumber);
+    if (m_WorldStreamer)
+        m_WorldStreamer->BeginFrame(packet.cameraPosition, packet.cameraForward);
+    m_QueueStats = packet.queue.GetStats();
 
-    for (glm::vec3 pos : scene->trianglePositions)
+    // Declared every frame for the current swapchain image, only compiled again when the passes change.
+    DeclareRenderGraph(packet, &m_SwapchainFrames[imageIndex]);
+    if (m_RenderGraph->Compile())
     {
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
-        vkInit::Constants constant;
-        constant.model = model;
-        commandBuffer.pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(constant), &constant);
-        commandBuffer.draw(3, 1, 0, 0);
+        if (m_OcclusionCuller)
+            m_OcclusionCuller->OnGraphCompiled();
+
+        // Render passes were created again, possibly with the handles of the old ones.
+        if (m_CommandCache)
+            m_CommandCache->Invalidate();
     }
-    
-    commandBuffer.endRenderPass();
-    
+    m_RenderGraph->Execute(commandBuffer);
+
+    if (m_GpuProfiler)
+        m_GpuProfiler->EndFrame(commandBuffer);
+
     try
     {
         commandBuffer.end();
@@ -334,6 +1079,7 @@ void Engine::RecordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageI
 
 void Engine::CreateAssets()
 {
+    PROFILE_SCOPE("Engine::CreateAssets");
     m_TriangleMesh = std::make_unique<TriangleMesh>(m_Device, m_PhysicalDevice);
 }
 
@@ -342,4 +1088,251 @@ void Engine::PrepareScene(vk::CommandBuffer commandBuffer)
     vk::Buffer vertexBuffers[] = { m_TriangleMesh->vertexBuffer.buffer };
     vk::DeviceSize offsets[] = { 0 };
     commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+}
+
+void Engine::DrawScene(const RenderGraph::PassContext& context, vk::Pipeline ScenePipeline::* variant, const FramePacket& packet)
+{
+    const std::vector<RenderQueue::Batch>& batches = packet.queue.GetBatches();
+    if (!m_CommandCache)
+    {
+        DrawSceneBatches(context.commandBuffer, context.extent, variant, packet, 0, static_cast<uint32_t>(batches.size()));
+        return;
+    }
+
+    // The batched pipelines read every transform from the scene buffers, there is nothing to draw without them.
+    uint32_t instanceBuffer = m_SceneBuffers ? m_SceneBuffers->GetDrawBuffer() : vkInit::InvalidBindlessIndex;
+    uint32_t transformBuffer = m_SceneBuffers ? m_SceneBuffers->GetTransformBuffer() : vkInit::InvalidBindlessIndex;
+    if (instanceBuffer == vkInit::InvalidBindlessIndex || transformBuffer == vkInit::InvalidBindlessIndex)
+        return;
+
+    // Transforms and view projections are read from buffers, so a bucket's commands only change with its batches, the
+    // pipelines they bind or the buffers they read. Moving objects or the camera alone never records anything again.
+    const uint32_t bucketCount = static_cast<uint32_t>((batches.size() + SceneBucketBatches - 1) / SceneBucketBatches);
+    m_BucketHashes.assign(bucketCount, 0);
+    for (uint32_t bucket = 0; bucket < bucketCount; bucket++)
+    {
+        size_t& hash = m_BucketHashes[bucket];
+        CommandCache::HashCombine(hash, instanceBuffer);
+        CommandCache::HashCombine(hash, transformBuffer);
+        CommandCache::HashCombine(hash, GetViewBuffer());
+        CommandCache::HashCombine(hash, context.extent.width);
+        CommandCache::HashCombine(hash, context.extent.height);
+        CommandCache::HashCombine(hash, reinterpret_cast<uint64_t>(static_cast<VkBuffer>(m_TriangleMesh->vertexBuffer.buffer)));
+
+        uint32_t last = std::min(static_cast<uint32_t>(batches.size()), (bucket + 1) * SceneBucketBatches);
+        for (uint32_t i = bucket * SceneBucketBatches; i < last; i++)
+        {
+            uint32_t pipeline = RenderQueue::GetPipeline(batches[i].key);
+            vk::Pipeline handle = m_ScenePipelines[pipeline < m_ScenePipelines.size() ? pipeline : 0].*variant;
+            CommandCache::HashCombine(hash, reinterpret_cast<uint64_t>(static_cast<VkPipeline>(handle)));
+            CommandCache::HashCombine(hash, batches[i].key >> RenderQueue::DepthBits);
+            CommandCache::HashCombine(hash, batches[i].first);
+            CommandCache::HashCombine(hash, batches[i].count);
+        }
+    }
+
+    // The depth pre-pass and the pass shading after it are both drawn every frame, each needs its own buffers.
+    uint32_t view = variant == &ScenePipeline::depth ? 1 : 0;
+    m_CommandCache->Execute(context, static_cast<uint32_t>(m_FrameNumber), view, m_BucketHashes,
+        [&](vk::CommandBuffer commandBuffer, uint32_t bucket)
+        {
+            uint32_t first = bucket * SceneBucketBatches;
+            uint32_t count = std::min(static_cast<uint32_t>(batches.size()) - first, SceneBucketBatches);
+            DrawSceneBatches(commandBuffer, context.extent, variant, packet, first, count);
+        });
+}
+
+void Engine::DrawSceneBatches(vk::CommandBuffer commandBuffer, vk::Extent2D extent, vk::Pipeline ScenePipeline::* variant, const FramePacket& packet, uint32_t first, uint32_t count)
+{
+    SetViewport(commandBuffer, extent);
+
+    // The whole frame is drawn with this single descriptor bind, or one per secondary command buffer.
+    if (m_BindlessSupported)
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0, m_BindlessHeap.set, nullptr);
+
+    // The batched pipelines read every transform from the scene buffers, there is nothing to draw without them.
+    vkInit::Constants constants{};
+    constants.viewBuffer = GetViewBuffer();
+    if (m_SceneBuffers)
+    {
+        constants.instanceBuffer = m_SceneBuffers->GetDrawBuffer();
+        constants.transformBuffer = m_SceneBuffers->GetTransformBuffer();
+        if (constants.instanceBuffer == vkInit::InvalidBindlessIndex || constants.transformBuffer == vkInit::InvalidBindlessIndex ||
+            constants.viewBuffer == vkInit::InvalidBindlessIndex)
+            return;
+    }
+
+    // Batches come sorted by state, so state is only bound when it differs from the batch before.
+    uint32_t boundPipeline = UINT32_MAX, boundMesh = UINT32_MAX;
+    const std::vector<RenderQueue::Batch>& batches = packet.queue.GetBatches();
+    for (uint32_t b = first; b < first + count; b++)
+    {
+        const RenderQueue::Batch& batch = batches[b];
+        uint32_t pipeline = RenderQueue::GetPipeline(batch.key);
+        if (pipeline >= m_ScenePipelines.size())
+            pipeline = 0;
+        if (pipeline != boundPipeline)
+        {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ScenePipelines[pipeline].*variant);
+            boundPipeline = pipeline;
+        }
+
+        // Every mesh id draws the triangle until there are other meshes.
+        uint32_t mesh = RenderQueue::GetMesh(batch.key);
+        if (mesh != boundMesh)
+        {
+            PrepareScene(commandBuffer);
+            boundMesh = mesh;
+        }
+
+        // One instanced draw per batch, the vertex shader looks up each instance's object and its world matrix.
+        if (m_BindlessSupported)
+        {
+            constants.materialIndex = RenderQueue::GetMaterial(batch.key);
+            commandBuffer.pushConstants(m_PipelineLayout, vkInit::ConstantsStages, 0, sizeof(constants), &constants);
+            commandBuffer.draw(3, batch.count, 0, batch.first);
+            continue;
+        }
+
+        for (uint32_t i = batch.first; i < batch.first + batch.count; i++)
+        {
+            commandBuffer.pushConstants(m_PipelineLayout, vkInit::ConstantsStages, 0, sizeof(packet.draws[i]), &packet.draws[i]);
+            commandBuffer.draw(3, 1, 0, 0);
+        }
+    }
+}
+
+void Engine::DrawSceneIndirect(const RenderGraph::PassContext& context, bool late)
+{
+    vk::CommandBuffer commandBuffer = context.commandBuffer;
+    SetViewport(commandBuffer, context.extent);
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_IndirectPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0, m_BindlessHeap.set, nullptr);
+    PrepareScene(commandBuffer);
+    m_OcclusionCuller->DrawIndirect(commandBuffer, m_PipelineLayout, late, GetViewBuffer());
+}
+
+void Engine::DrawParticles(const RenderGraph::PassContext& context, const FramePacket& packet)
+{
+    vk::CommandBuffer commandBuffer = context.commandBuffer;
+    SetViewport(commandBuffer, context.extent);
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_InstancePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0, m_BindlessHeap.set, nullptr);
+    PrepareScene(commandBuffer);
+    m_ParticleSystem->Draw(commandBuffer, m_PipelineLayout, packet.viewProjection, GetViewBuffer());
+}
+
+void Engine::DrawChunks(const RenderGraph::PassContext& context, const FramePacket& packet)
+{
+    vk::CommandBuffer commandBuffer = context.commandBuffer;
+    SetViewport(commandBuffer, context.extent);
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_InstancePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0, m_BindlessHeap.set, nullptr);
+    PrepareScene(commandBuffer);
+    m_WorldStreamer->Draw(commandBuffer, m_PipelineLayout, packet.viewProjection, GetViewBuffer());
+}
+
+void Engine::SetViewport(vk::CommandBuffer commandBuffer, vk::Extent2D extent)
+{
+    // Every graphics pipeline takes its viewport and scissor at draw time, so a new render extent needs no new pipelines.
+    vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f);
+    commandBuffer.setViewport(0, viewport);
+    commandBuffer.setScissor(0, vk::Rect2D({ 0, 0 }, extent));
+}
+
+void Engine::Upscale(const RenderGraph::PassContext& context, RenderResource scene, RenderResource backbuffer)
+{
+    // The drawn area in the top left corner of the target is stretched over the whole swapchain image.
+    vk::ImageBlit region{};
+    region.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+    region.srcOffsets[1] = vk::Offset3D(static_cast<int32_t>(m_RenderExtent.width), static_cast<int32_t>(m_RenderExtent.height), 1);
+    region.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+    region.dstOffsets[1] = vk::Offset3D(static_cast<int32_t>(m_SwapchainExtent.width), static_cast<int32_t>(m_SwapchainExtent.height), 1);
+
+    context.commandBuffer.blitImage(context.graph->GetImage(scene), vk::ImageLayout::eTransferSrcOptimal,
+        context.graph->GetImage(backbuffer), vk::ImageLayout::eTransferDstOptimal, region, vk::Filter::eLinear);
+}
+
+void Engine::ComposeViews(const RenderGraph::PassContext& context, RenderResource views, RenderResource backbuffer)
+{
+    vk::Image source = context.graph->GetImage(views);
+    vk::Image target = context.graph->GetImage(backbuffer);
+    vk::Extent2D viewExtent = GetViewExtent();
+
+    // Columns left over when the width does not divide evenly would show whatever the image held before.
+    if (viewExtent.width * m_ViewCount != m_SwapchainExtent.width)
+    {
+        vk::ClearColorValue black(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f });
+        vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+        context.commandBuffer.clearColorImage(target, vk::ImageLayout::eTransferDstOptimal, black, range);
+
+        vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite);
+        context.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(), barrier, nullptr, nullptr);
+    }
+
+    // Same format and size, so every view is a plain copy of its layer next to the one before.
+    std::vector<vk::ImageCopy> regions(m_ViewCount);
+    for (uint32_t view = 0; view < m_ViewCount; view++)
+    {
+        regions[view].srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, view, 1);
+        regions[view].dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+        regions[view].dstOffset = vk::Offset3D(static_cast<int32_t>(view * viewExtent.width), 0, 0);
+        regions[view].extent = vk::Extent3D(viewExtent.width, viewExtent.height, 1);
+    }
+    context.commandBuffer.copyImage(source, vk::ImageLayout::eTransferSrcOptimal, target, vk::ImageLayout::eTransferDstOptimal, regions);
+}
+
+uint32_t Engine::GetViewBuffer() const
+{
+    if (m_SceneViews.empty())
+        return vkInit::InvalidBindlessIndex;
+    return m_SceneViews[m_FrameNumber].slot;
+}
+
+void Engine::UploadSceneViews(const FramePacket& packet)
+{
+    if (m_SceneViews.empty())
+        m_SceneViews.resize(m_MaxFramesInFlight);
+
+    // The last frame that used this buffer has finished, so it can be refilled right away.
+    SceneViews& views = m_SceneViews[m_FrameNumber];
+    if (!views.mapped)
+    {
+        vkInit::BufferInput input{};
+        input.device = m_Device;
+        input.physicalDevice = m_PhysicalDevice;
+        input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+        input.category = MemoryCategory::Other;
+        input.name = "Scene views";
+        input.size = sizeof(glm::mat4) * m_ViewCount;
+        views.buffer = vkInit::CreateBuffer(input);
+        if (!views.buffer.bufferMemory)
+            return;
+        views.mapped = static_cast<glm::mat4*>(m_Device.mapMemory(views.buffer.bufferMemory, 0, VK_WHOLE_SIZE));
+        views.slot = vkInit::RegisterStorageBuffer(m_BindlessHeap, views.buffer.buffer);
+    }
+
+    // Views sit next to each other along the camera's right axis, centered on the camera. Each one is its own eye: the
+    // camera's view moved by the eye's offset in view space, then projected, so near objects get the per-eye parallax.
+    for (uint32_t view = 0; view < m_ViewCount; view++)
+    {
+        glm::mat4 offset(1.0f);
+        offset[3].x = -(view - (m_ViewCount - 1) * 0.5f) * m_Settings.multiview.viewSeparation;
+        views.mapped[view] = packet.projection * offset * packet.view;
+    }
+}
+
+void Engine::DestroySceneViews()
+{
+    for (SceneViews& views : m_SceneViews)
+    {
+        if (views.slot != vkInit::InvalidBindlessIndex)
+            vkInit::ReleaseBindlessSlot(m_BindlessHeap, vkInit::BindlessStorageBuffers, views.slot);
+        if (views.mapped)
+            m_Device.unmapMemory(views.buffer.bufferMemory);
+        m_Device.destroyBuffer(views.buffer.buffer);
+        vkInit::FreeMemory(m_Device, views.buffer.bufferMemory);
+    }
+    m_SceneViews.clear();
 }
\ No newline at end of file
@@ -3,10 +3,31 @@
 
 #include "Scene.hpp"
 #include "TriangleMesh.hpp"
+#include "JobSystem.hpp"
+#include "FramePipeline.hpp"
+#include "RenderGraph.hpp"
+#include "CommandCache.hpp"
+#include "SceneBuffers.hpp"
+#include "OcclusionCuller.hpp"
+#include "ParticleSystem.hpp"
+#include "WorldStreamer.hpp"
+#include "FrameScheduler.hpp"
+#include "FramePacer.hpp"
+#include "DeletionQueue.hpp"
+#include "DynamicResolution.hpp"
+#include "FrameCapture.hpp"
+#include "GpuProfiler.hpp"
+#include "MemoryTracker.hpp"
+#include "Vulkan/Descriptors.hpp"
+#include "Vulkan/Device.hpp"
+#include "Vulkan/Swapchain.hpp"
 
 #include <GLFW/glfw3.h>
 
+#include <chrono>
 #include <cstdint>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace vkInit
@@ -14,27 +35,134 @@ namespace vkInit
     struct SwapChainFrame;
 }
 
+// Views of the scene rendered at once with multiview and shown side by side, such as the eyes of a stereo pair.
+struct MultiviewSettings
+{
+    uint32_t viewCount = 1;         // 2 for stereo, 1 renders a single view without multiview.
+    float viewSeparation = 0.065f;  // Distance between neighbouring views along the camera's right axis.
+};
+
+struct EngineSettings
+{
+    uint32_t width = 1280, height = 720;
+
+    // Worker threads and core pinning for the job system.
+    JobSystemSettings jobs;
+
+    // Frames in the CPU pipeline at once, 1 simulates and records each frame back to back.
+    uint32_t pipelineDepth = 2;
+
+    // Preferred present mode, FIFO is used when the surface does not offer it.
+    vk::PresentModeKHR presentMode = vk::PresentModeKHR::eMailbox;
+    FramePacingSettings pacing;
+
+    // Lay down depth in a depth-only pass first and shade with an equal depth test, and sort draws front to back.
+    bool depthPrepass = false;
+    bool sortFrontToBack = true;
+
+    // Draw through GPU occlusion culling against last frame's visibility and a depth pyramid, when the device allows it.
+    // Replaces the depth pre-pass.
+    bool occlusionCulling = true;
+
+    // Record the scene passes into secondary command buffers that are executed again until their draws change.
+    // Needs the bindless heap, without it every draw carries its own transform and is recorded every frame.
+    bool cacheCommands = true;
+
+    // Several views drawn by one set of draw calls, needs the bindless heap and replaces occlusion culling.
+    MultiviewSettings multiview;
+
+    // Render the scene below the swapchain resolution when the GPU runs over budget and upscale it, needs GPU timestamps.
+    // Replaces multiview and occlusion culling.
+    DynamicResolutionSettings dynamicResolution;
+
+    // Particles simulated and drawn on the GPU, disabled while the capacity is 0.
+    ParticleSettings particles;
+
+    // Chunks of a larger world streamed in and out around the camera, drawn over the scene.
+    StreamingSettings streaming;
+
+    // Runs benchmarkFrames frames in every depth mode on startup and logs the average frame time of each.
+    bool depthBenchmark = false;
+    uint32_t benchmarkFrames = 600;
+
+    // Time every render graph pass on the GPU, and count pipeline statistics for each.
+    bool gpuTimestamps = true;
+    bool gpuPipelineStatistics = false;
+
+    // Fraction of each memory heap's budget above which the memory tracker's budget callbacks fire.
+    float memorySoftBudget = 0.9f;
+
+    // Rendered frames copied back and written to disk, F9 starts and stops capturing.
+    CaptureSettings capture;
+
+    // Frames captured into a CPU trace when F12 is pressed.
+    uint32_t traceFrameCount = 120;
+
+    // Enable the Khronos validation layer and the debug messenger. Slows every API call down, so it is opt-in.
+    bool validation = false;
+};
+
+// Pipelines a Material::pipeline selects, with a variant for every way the scene is drawn.
+struct ScenePipeline
+{
+    vk::Pipeline forward; // Depth test and write.
+    vk::Pipeline equal; // Shades what the depth pre-pass left visible.
+    vk::Pipeline depth; // Depth-only pre-pass.
+};
+
+// View projection of every view the scene passes draw, one buffer per frame in flight. A multiview frame moves each view
+// along the camera's right axis.
+struct SceneViews
+{
+    vkInit::Buffer buffer;
+    glm::mat4* mapped = nullptr;
+    uint32_t slot = vkInit::InvalidBindlessIndex;
+};
+
 class Engine
 {
 public:
-    Engine(uint32_t width = 1280, uint32_t height = 720);
+    Engine(const EngineSettings& settings = EngineSettings());
     ~Engine();
     void RenderLoop(Scene* scene);
 private:
     void CreateGLFWWindow();
     void CreateVulkanInstance();
+    void CreateSurface();
     void CreateDevice();
-    void CreatePipeline();
+    void CreateDescriptorHeap();
+    void ChooseViewCount();
+    void CreateDynamicResolution();
+    void CreateRenderGraph();
+    void DeclareRenderGraph(const FramePacket& packet, const vkInit::SwapChainFrame* target);
+    void LoadShaderModules(JobCounter& jobs);
+    void DestroyShaderModules();
+    void CreatePipeline(JobCounter& jobs);
+    void EndStartupPhase(const char* name);
+    void SetDepthMode(bool depthPrepass, bool sortFrontToBack);
+    void UpdateDepthBenchmark();
     void CreateSwapchain();
     void RecreateSwapchain();
     void DestroySwapchain();
-    void CreateFramebuffers();
     void CreateSyncObjects();
     void FinalRenderingSetup();
+    void HandleDebugKeys();
     void DisplayFramerate();
-    void RecordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene);
+    void RecordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex, const FramePacket& packet);
     void CreateAssets();
     void PrepareScene(vk::CommandBuffer commandBuffer);
+    void DrawScene(const RenderGraph::PassContext& context, vk::Pipeline ScenePipeline::* variant, const FramePacket& packet);
+    void DrawSceneBatches(vk::CommandBuffer commandBuffer, vk::Extent2D extent, vk::Pipeline ScenePipeline::* variant, const FramePacket& packet, uint32_t first, uint32_t count);
+    void DrawSceneIndirect(const RenderGraph::PassContext& context, bool late);
+    void DrawParticles(const RenderGraph::PassContext& context, const FramePacket& packet);
+    void DrawChunks(const RenderGraph::PassContext& context, const FramePacket& packet);
+    void SetViewport(vk::CommandBuffer commandBuffer, vk::Extent2D extent);
+    void Upscale(const RenderGraph::PassContext& context, RenderResource scene, RenderResource backbuffer);
+    void ComposeViews(const RenderGraph::PassContext& context, RenderResource views, RenderResource backbuffer);
+    vk::Extent2D GetViewExtent() const;
+    uint32_t GetViewBuffer() const;
+    void UploadSceneViews(const FramePacket& packet);
+    void DestroySceneViews();
 private:
     // Window Properties and Window
     int m_Width, m_Height;
@@ -44,22 +172,75 @@ private:
     vk::Instance m_Instance{ nullptr }; // Vulkan Instance
     vk::DebugUtilsMessengerEXT m_DebugMessenger{ nullptr }; // Debug Callback
     vk::DispatchLoaderDynamic m_Dldi; // Dynamic Instance Dispatcher
+    vk::DispatchLoaderDynamic m_Dldd; // Dynamic Device Dispatcher, for device extensions like present wait.
     vk::SurfaceKHR m_Surface; // Surface
 
     // Device-Related Variables.
     vk::PhysicalDevice m_PhysicalDevice{ nullptr }; // Vulkan Physical Device
+    vkInit::DeviceCapabilities m_Capabilities; // Features negotiated with the physical device.
+    vkInit::QueueFamilyIndices m_QueueFamilies; // Found once while choosing the physical device.
     vk::Device m_Device{ nullptr }; // Vulkan Logical Device
     vk::Queue m_GraphicsQueue{ nullptr };  //Graphics Queue is the first queue from the graphics queue family.
     vk::Queue m_PresentQueue{ nullptr };
+    std::unique_ptr<FrameScheduler> m_Scheduler; // Submits to the graphics, compute and transfer queues.
+    std::unique_ptr<FramePacer> m_FramePacer;
+    std::unique_ptr<DeletionQueue> m_DeletionQueue; // Destroys retired resources once the frames using them have finished.
+    bool m_PresentWaitSupported = false;
     vk::SwapchainKHR m_Swapchain{ nullptr };
     std::vector<vkInit::SwapChainFrame> m_SwapchainFrames;
     vk::Format m_SwapchainFormat;
     vk::Extent2D m_SwapchainExtent;
+    vk::PresentModeKHR m_PresentMode;
+    vk::ImageUsageFlags m_SwapchainUsage;
+    vkInit::SwapChainSupportDetails m_SwapchainSupport; // Formats and present modes of the surface, queried once.
+
+    // Descriptor-Related Variables.
+    bool m_BindlessSupported = false;
+    vkInit::BindlessHeap m_BindlessHeap; // Global heap bound once per frame.
 
     // Pipeline-Related Variables.
     vk::PipelineLayout m_PipelineLayout;
-    vk::RenderPass m_RenderPass;
-    vk::Pipeline m_Pipeline;
+    std::vector<ScenePipeline> m_ScenePipelines; // Indexed by Material::pipeline.
+    vk::Pipeline m_IndirectPipeline; // Draws the culler's indirect commands.
+    vk::Pipeline m_InstancePipeline; // Draws instances read from the bindless heap, the particles and the streamed chunks.
+    std::unordered_map<std::string, vk::ShaderModule> m_ShaderModules; // Loaded during startup, destroyed once every pipeline is built.
+
+    // Passes of a frame, render passes and framebuffers are owned by the graph.
+    std::unique_ptr<RenderGraph> m_RenderGraph;
+    vk::Format m_DepthFormat;
+    bool m_DepthPrepass = false;
+
+    // Views the scene passes draw at once, more than one renders them with multiview into layers that are composed side by side.
+    uint32_t m_ViewCount = 1;
+    uint32_t m_ViewMask = 0;
+    std::vector<SceneViews> m_SceneViews;
+
+    // Picks the extent the scene is rendered at each frame, null when rendering at the swapchain resolution.
+    std::unique_ptr<DynamicResolution> m_DynamicResolution;
+    vk::Extent2D m_RenderExtent;
+
+    // GPU-driven culling, null when unsupported or disabled.
+    std::unique_ptr<OcclusionCuller> m_OcclusionCuller;
+
+    // GPU particle simulation, null when disabled or without the bindless heap.
+    std::unique_ptr<ParticleSystem> m_ParticleSystem;
+
+    // Streamed world chunks, null when disabled or without the bindless heap.
+    std::unique_ptr<WorldStreamer> m_WorldStreamer;
+
+    // World matrices and bounds of the scene objects and the objects each frame draws, null without the bindless heap.
+    std::unique_ptr<SceneBuffers> m_SceneBuffers;
+    RenderQueue::Stats m_QueueStats; // Of the last recorded frame.
+
+    // Scene passes recorded once and reused, null when disabled or without the bindless heap.
+    std::unique_ptr<CommandCache> m_CommandCache;
+    std::vector<size_t> m_BucketHashes;
+
+    // Writes rendered frames to disk, null when the swapchain images cannot be copied from.
+    std::unique_ptr<FrameCapture> m_FrameCapture;
+
+    // Per-pass GPU timings, null when disabled.
+    std::unique_ptr<GpuProfiler> m_GpuProfiler;
 
     //Command-Related Variables
     vk::CommandPool m_CommandPool;
@@ -67,6 +248,13 @@ private:
 
     //Synchronization-Related Objects
     int m_MaxFramesInFlight, m_FrameNumber;
+    std::vector<TimelinePoint> m_FrameCompletion; // Reached once the GPU is done with the resources of each frame in flight.
+
+    // Worker threads for CPU-side scene work.
+    EngineSettings m_Settings;
+    std::unique_ptr<JobSystem> m_JobSystem;
+    std::unique_ptr<FramePipeline> m_FramePipeline;
+    uint64_t m_SimulatedFrame = 0; // Monotonic, unlike m_FrameNumber which indexes the swapchain frames.
 
     // Assets
     std::unique_ptr<TriangleMesh> m_TriangleMesh;
@@ -74,12 +262,22 @@ private:
     //Framerate-Related Variables
     double m_CurrentTime = 0.0, m_LastTime = 0.0;
     int m_NumFrames = 0;
+    double m_SimulateMilliseconds = 0.0, m_RecordMilliseconds = 0.0; // Stage times summed since the last title update.
+
+    // Depth benchmark progress.
+    uint32_t m_BenchmarkMode = 0, m_BenchmarkFrame = 0;
+    double m_BenchmarkStart = 0.0;
+    std::vector<double> m_BenchmarkResults;
+
+    // Startup timing, each phase is logged as it ends and the first frame once it is presented.
+    std::chrono::steady_clock::time_point m_StartupStart, m_StartupPhaseStart;
+    bool m_FirstFramePresented = false;
+
+    bool m_TraceKeyDown = false, m_ReportKeyDown = false, m_CaptureKeyDown = false;
 
-    #ifdef NDEBUG
-    const bool m_DebugMode = false;
-    #else
-    const bool m_DebugMode = true;
-    #endif
+    // Budget callback registered with the memory tracker, and the heaps it has warned about.
+    uint32_t m_BudgetCallback = 0;
+    uint32_t m_ReportedOverBudget = 0;
 };
 
 #endif
\ No newline at end of file
@@ -2,14 +2,168 @@
 #define ENTRYPOINT_CPP
 
 #include "Engine.hpp"
+#include "SoftwareRenderer.hpp"
 
-int main()
+#include <cstring>
+#include <cstdlib>
+
+int main(int argc, char** argv)
 {
-    // Create Vulkan Engine.
-    Engine vulkanEngine;
-    
-    // Create a default scene.
-    Scene scene;
+    PROFILE_THREAD("Main");
+
+    EngineSettings settings;
+    SoftwareSettings software;
+    uint32_t overdrawLayers = 0;
+    const char* startupTracePath = nullptr;
+    const char* scenePath = nullptr;
+    const char* saveScenePath = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--depth-prepass") == 0)
+        {
+            settings.depthPrepass = true;
+            settings.occlusionCulling = false;
+        }
+        else if (strcmp(argv[i], "--no-sort") == 0)
+            settings.sortFrontToBack = false;
+        else if (strcmp(argv[i], "--depth-benchmark") == 0)
+        {
+            settings.depthBenchmark = true;
+            settings.occlusionCulling = false;
+            overdrawLayers = 64;
+        }
+        else if (strcmp(argv[i], "--no-occlusion") == 0)
+            settings.occlusionCulling = false;
+        else if (strcmp(argv[i], "--no-command-cache") == 0)
+            settings.cacheCommands = false;
+        else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc)
+            settings.multiview.viewCount = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--view-separation") == 0 && i + 1 < argc)
+            settings.multiview.viewSeparation = static_cast<float>(atof(argv[++i]));
+        else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc)
+        {
+            settings.dynamicResolution.enabled = true;
+            settings.dynamicResolution.targetMilliseconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--resolution-scale") == 0 && i + 2 < argc)
+        {
+            settings.dynamicResolution.minScale = static_cast<float>(atof(argv[i + 1]));
+            settings.dynamicResolution.maxScale = static_cast<float>(atof(argv[i + 2]));
+            i += 2;
+        }
+        else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+            settings.particles.capacity = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--stream") == 0)
+            settings.streaming.enabled = true;
+        else if (strcmp(argv[i], "--stream-dir") == 0 && i + 1 < argc)
+        {
+            settings.streaming.enabled = true;
+            settings.streaming.directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stream-radius") == 0 && i + 2 < argc)
+        {
+            settings.streaming.loadRadius = static_cast<float>(atof(argv[i + 1]));
+            settings.streaming.unloadRadius = static_cast<float>(atof(argv[i + 2]));
+            i += 2;
+        }
+        else if (strcmp(argv[i], "--stream-budget") == 0 && i + 1 < argc)
+            settings.streaming.budget = static_cast<vk::DeviceSize>(atof(argv[++i]) * 1024.0 * 1024.0);
+        else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "fifo") == 0)
+                settings.presentMode = vk::PresentModeKHR::eFifo;
+            else if (strcmp(mode, "immediate") == 0)
+                settings.presentMode = vk::PresentModeKHR::eImmediate;
+            else
+                settings.presentMode = vk::PresentModeKHR::eMailbox;
+        }
+        else if (strcmp(argv[i], "--pace") == 0)
+            settings.pacing.enabled = true;
+        else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc)
+            settings.pacing.targetFrameRate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--max-queued") == 0 && i + 1 < argc)
+            settings.pacing.maxQueuedFrames = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            settings.capture.enabled = true;
+            settings.capture.directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc)
+            settings.capture.frameCount = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--capture-raw") == 0)
+            settings.capture.format = CaptureFormat::Raw;
+        else if (strcmp(argv[i], "--capture-bmp") == 0)
+            settings.capture.format = CaptureFormat::Bmp;
+        else if (strcmp(argv[i], "--software") == 0)
+            software.enabled = true;
+        else if (strcmp(argv[i], "--software-size") == 0 && i + 2 < argc)
+        {
+            software.width = static_cast<uint32_t>(atoi(argv[i + 1]));
+            software.height = static_cast<uint32_t>(atoi(argv[i + 2]));
+            i += 2;
+        }
+        else if (strcmp(argv[i], "--software-frames") == 0 && i + 1 < argc)
+            software.frameCount = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--no-gpu-timestamps") == 0)
+            settings.gpuTimestamps = false;
+        else if (strcmp(argv[i], "--gpu-stats") == 0)
+            settings.gpuPipelineStatistics = true;
+        else if (strcmp(argv[i], "--validation") == 0)
+            settings.validation = true;
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            scenePath = argv[++i];
+        else if (strcmp(argv[i], "--save-scene") == 0 && i + 1 < argc)
+            saveScenePath = argv[++i];
+        else if (strcmp(argv[i], "--trace-startup") == 0 && i + 1 < argc)
+            startupTracePath = argv[++i];
+        else if (strcmp(argv[i], "--trace-frames") == 0 && i + 3 < argc)
+        {
+            uint64_t first = strtoull(argv[i + 1], nullptr, 10);
+            uint32_t count = static_cast<uint32_t>(atoi(argv[i + 2]));
+            Profiler::Get().CaptureFrames(first, count, argv[i + 3]);
+            i += 3;
+        }
+    }
+
+#ifndef ENABLE_PROFILING
+    if (startupTracePath)
+        CONSOLE_WARN("Built without ENABLE_PROFILING, the trace will be empty.");
+#endif
+
+    if (!FrameCapture::IsFormatAvailable(settings.capture.format))
+    {
+        CONSOLE_WARN("Built without stb_image_write, frames are captured as raw RGBA.");
+        settings.capture.format = CaptureFormat::Raw;
+    }
+
+    // Create a default scene, with heavy overdraw when benchmarking depth.
+    Scene scene(overdrawLayers);
+    if (scenePath && !scene.Load(scenePath))
+        CONSOLE_WARN("Could not load %s, using the default scene.", scenePath);
+    if (saveScenePath)
+        scene.Save(saveScenePath);
+
+    // Render on the CPU without creating a device, writing the frames where captures would go.
+    if (software.enabled)
+    {
+        software.format = settings.capture.format;
+        if (settings.capture.enabled)
+            software.directory = settings.capture.directory;
+
+        JobSystem jobs(settings.jobs);
+        SoftwareRenderer renderer({ &jobs, settings.pipelineDepth, software });
+        renderer.Run(&scene);
+        return 0;
+    }
+
+    // Create Vulkan Engine, tracing its initialization when asked to.
+    if (startupTracePath)
+        Profiler::Get().BeginCapture();
+    Engine vulkanEngine(settings);
+    if (startupTracePath)
+        Profiler::Get().EndCapture(startupTracePath);
 
     // Start the Render Loop!
     vulkanEngine.RenderLoop(&scene);
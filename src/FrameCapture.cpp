@@ -0,0 +1,298 @@
+#include "FrameCapture.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+#ifdef HAS_STB_IMAGE_WRITE
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#endif
+
+namespace
+{
+	bool WriteRaw(const std::string& path, const uint8_t* data, size_t size)
+	{
+		FILE* output = fopen(path.c_str(), "wb");
+		if (!output)
+			return false;
+		bool written = fwrite(data, 1, size, output) == size;
+		return fclose(output) == 0 && written;
+	}
+}
+
+FrameCapture::FrameCapture(const Input& input) : m_Device(input.device), m_PhysicalDevice(input.physicalDevice), m_Jobs(*input.jobs),
+	m_Scheduler(*input.scheduler), m_Settings(input.settings)
+{
+	using Memory = vk::MemoryPropertyFlagBits;
+	m_MemoryProperties = Memory::eHostVisible | Memory::eHostCoherent | Memory::eHostCached;
+	if (vkInit::FindMemoryTypeIndex(m_PhysicalDevice, ~0u, m_MemoryProperties) == UINT32_MAX)
+	{
+		CONSOLE_WARN("No host cached memory, reading captured frames back will be slow.");
+		m_MemoryProperties = Memory::eHostVisible | Memory::eHostCoherent;
+	}
+
+	m_Ring.resize(std::max(m_Settings.ringSize, 1u));
+	for (std::unique_ptr<Readback>& readback : m_Ring)
+		readback = std::make_unique<Readback>();
+
+#ifdef HAS_STB_IMAGE_WRITE
+	// Captures have to keep up with the frame rate, size matters less.
+	stbi_write_png_compression_level = 1;
+#endif
+
+	if (m_Settings.enabled)
+		Start(m_Settings.frameCount);
+}
+
+FrameCapture::~FrameCapture()
+{
+	// The device is idle, so every submitted copy has landed.
+	Update();
+	for (std::unique_ptr<Readback>& readback : m_Ring)
+	{
+		if (readback->state == ReadbackState::Writing)
+		{
+			m_Jobs.Wait(readback->job);
+			Finish(*readback);
+		}
+		Destroy(*readback);
+	}
+
+	if (m_Stats.copied > 0)
+		CONSOLE_INFO("Captured %llu frames, %llu written, %llu dropped, %llu failed.", static_cast<unsigned long long>(m_Stats.copied),
+			static_cast<unsigned long long>(m_Stats.written), static_cast<unsigned long long>(m_Stats.dropped), static_cast<unsigned long long>(m_Stats.failed));
+}
+
+bool FrameCapture::IsSupported(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eB8G8R8A8Unorm:
+	case vk::Format::eB8G8R8A8Srgb:
+	case vk::Format::eR8G8B8A8Unorm:
+	case vk::Format::eR8G8B8A8Srgb:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void FrameCapture::Start(uint32_t frameCount)
+{
+	std::error_code error;
+	std::filesystem::create_directories(m_Settings.directory, error);
+	if (error)
+	{
+		CONSOLE_ERROR("Failed to create capture directory %s! %s", m_Settings.directory.c_str(), error.message().c_str());
+		return;
+	}
+
+	m_Capturing = true;
+	m_Remaining = frameCount;
+	CONSOLE_INFO("Capturing %s to %s.", frameCount > 0 ? (std::to_string(frameCount) + " frames").c_str() : "frames",
+		m_Settings.directory.c_str());
+}
+
+void FrameCapture::Stop()
+{
+	if (!m_Capturing)
+		return;
+
+	m_Capturing = false;
+	m_Remaining = 0;
+	CONSOLE_INFO("Stopped capturing, %llu frames dropped so far.", static_cast<unsigned long long>(m_Stats.dropped));
+}
+
+void FrameCapture::Update()
+{
+	PROFILE_SCOPE("FrameCapture::Update");
+	for (std::unique_ptr<Readback>& slot : m_Ring)
+	{
+		Readback* readback = slot.get();
+		if (readback->state == ReadbackState::Submitted && m_Scheduler.IsComplete(readback->completion))
+		{
+			readback->state = ReadbackState::Writing;
+			m_Jobs.Run([this, readback]() { Write(*readback); }, &readback->job);
+		}
+		else if (readback->state == ReadbackState::Writing && readback->job.IsDone())
+		{
+			Finish(*readback);
+		}
+	}
+}
+
+void FrameCapture::AddCapturePass(RenderGraph& graph, RenderResource image, vk::Format format, vk::Extent2D extent, uint64_t frame)
+{
+	if (!m_Capturing)
+		return;
+
+	Readback* readback = Claim(4ull * extent.width * extent.height);
+	if (readback)
+	{
+		readback->state = ReadbackState::Recorded;
+		readback->frame = frame;
+		readback->extent = extent;
+		readback->format = format;
+	}
+	else
+	{
+		m_Stats.dropped++;
+	}
+	m_Recording = readback;
+
+	if (m_Remaining > 0 && --m_Remaining == 0)
+		Stop();
+
+	graph.AddPass("Capture", RenderGraph::PassType::Transfer)
+		.Read(image, ResourceUsage::TransferSrc)
+		.SetSideEffects()
+		.SetExecute([readback, image, extent](const RenderGraph::PassContext& context)
+		{
+			if (!readback)
+				return;
+
+			// Tightly packed rows, the encoder reads them as they are.
+			vk::BufferImageCopy region{};
+			region.imageSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+			region.imageExtent = vk::Extent3D(extent.width, extent.height, 1);
+			context.commandBuffer.copyImageToBuffer(context.graph->GetImage(image), vk::ImageLayout::eTransferSrcOptimal,
+				readback->buffer.buffer, region);
+
+			vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+			context.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+				vk::DependencyFlags(), barrier, nullptr, nullptr);
+		});
+}
+
+void FrameCapture::OnSubmit(const TimelinePoint& completion)
+{
+	if (!m_Recording)
+		return;
+
+	m_Recording->completion = completion;
+	m_Recording->state = ReadbackState::Submitted;
+	m_Stats.copied++;
+	m_Recording = nullptr;
+}
+
+FrameCapture::Readback* FrameCapture::Claim(vk::DeviceSize size)
+{
+	for (std::unique_ptr<Readback>& slot : m_Ring)
+	{
+		Readback& readback = *slot;
+		if (readback.state != ReadbackState::Free)
+			continue;
+		if (readback.size >= size)
+			return &readback;
+
+		// Too small for the current extent, the buffer is idle so it is replaced right away.
+		Destroy(readback);
+		vkInit::BufferInput input{};
+		input.size = size;
+		input.usage = vk::BufferUsageFlagBits::eTransferDst;
+		input.device = m_Device;
+		input.physicalDevice = m_PhysicalDevice;
+		input.properties = m_MemoryProperties;
+		input.category = MemoryCategory::Staging;
+		input.name = "Frame capture readback";
+		readback.buffer = vkInit::CreateBuffer(input);
+		if (!readback.buffer.bufferMemory)
+		{
+			Destroy(readback);
+			return nullptr;
+		}
+		readback.size = size;
+		readback.mapped = static_cast<uint8_t*>(m_Device.mapMemory(readback.buffer.bufferMemory, 0, VK_WHOLE_SIZE));
+		return &readback;
+	}
+
+	return nullptr;
+}
+
+void FrameCapture::Write(Readback& readback) const
+{
+	PROFILE_SCOPE("FrameCapture::Write");
+	auto start = std::chrono::steady_clock::now();
+
+	// Swizzled in place to RGBA. The swapchain is composited opaque, so its alpha is not meaningful.
+	const size_t pixelCount = static_cast<size_t>(readback.extent.width) * readback.extent.height;
+	const bool bgra = readback.format == vk::Format::eB8G8R8A8Unorm || readback.format == vk::Format::eB8G8R8A8Srgb;
+	uint8_t* pixels = readback.mapped;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		uint8_t* pixel = pixels + i * 4;
+		if (bgra)
+			std::swap(pixel[0], pixel[2]);
+		pixel[3] = 255;
+	}
+
+	readback.succeeded = WriteImage(m_Settings.directory, m_Settings.format, readback.frame, readback.extent, pixels);
+
+	readback.encodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool FrameCapture::IsFormatAvailable(CaptureFormat format)
+{
+#ifdef HAS_STB_IMAGE_WRITE
+	return true;
+#else
+	return format == CaptureFormat::Raw;
+#endif
+}
+
+bool FrameCapture::WriteImage(const std::string& directory, CaptureFormat format, uint64_t frame, vk::Extent2D extent, const uint8_t* rgba)
+{
+	if (!IsFormatAvailable(format))
+		return false;
+
+	char name[64];
+	unsigned long long index = static_cast<unsigned long long>(frame);
+	switch (format)
+	{
+	case CaptureFormat::Png:	snprintf(name, sizeof(name), "frame_%06llu.png", index); break;
+	case CaptureFormat::Bmp:	snprintf(name, sizeof(name), "frame_%06llu.bmp", index); break;
+	case CaptureFormat::Raw:	snprintf(name, sizeof(name), "frame_%06llu_%ux%u.rgba", index, extent.width, extent.height); break;
+	}
+	std::string path = (std::filesystem::path(directory) / name).string();
+
+	if (format == CaptureFormat::Raw)
+		return WriteRaw(path, rgba, static_cast<size_t>(extent.width) * extent.height * 4);
+
+#ifdef HAS_STB_IMAGE_WRITE
+	const int width = static_cast<int>(extent.width), height = static_cast<int>(extent.height);
+	if (format == CaptureFormat::Png)
+		return stbi_write_png(path.c_str(), width, height, 4, rgba, width * 4) != 0;
+	return stbi_write_bmp(path.c_str(), width, height, 4, rgba) != 0;
+#else
+	return false;
+#endif
+}
+
+void FrameCapture::Finish(Readback& readback)
+{
+	if (readback.succeeded)
+	{
+		m_Stats.written++;
+		m_EncodeMilliseconds += readback.encodeMilliseconds;
+		m_Encoded++;
+		m_Stats.averageEncodeMilliseconds = m_EncodeMilliseconds / m_Encoded;
+	}
+	else
+	{
+		m_Stats.failed++;
+		CONSOLE_ERROR("Failed to write captured frame %llu!", static_cast<unsigned long long>(readback.frame));
+	}
+	readback.state = ReadbackState::Free;
+}
+
+void FrameCapture::Destroy(Readback& readback)
+{
+	if (readback.mapped)
+		m_Device.unmapMemory(readback.buffer.bufferMemory);
+	m_Device.destroyBuffer(readback.buffer.buffer);
+	vkInit::FreeMemory(m_Device, readback.buffer.bufferMemory);
+	readback.buffer = vkInit::Buffer{};
+	readback.mapped = nullptr;
+	readback.size = 0;
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include "Config.hpp"
+#include "JobSystem.hpp"
+#include "RenderGraph.hpp"
+#include "FrameScheduler.hpp"
+#include "Vulkan/Memory.hpp"
+
+enum class CaptureFormat
+{
+	Png,
+	Bmp,	// Uncompressed, cheaper to encode than a PNG.
+	Raw		// Headerless RGBA8 rows, top to bottom, the extent is part of the file name.
+};
+
+struct CaptureSettings
+{
+	bool enabled = false;				// Capture from the first frame on, F9 starts and stops capturing at runtime.
+	std::string directory = "captures";
+	CaptureFormat format = CaptureFormat::Png;
+	uint32_t frameCount = 0;			// Frames captured before stopping, 0 captures until stopped.
+	uint32_t ringSize = 6;				// Readback buffers. Frames are dropped instead of stalling while every one is busy.
+};
+
+// Captures rendered frames to disk without stalling the frame. The swapchain image is copied into one buffer of a ring
+// of host visible readback buffers, which is picked up a few frames later once the GPU has reached the frame's completion
+// point and is then encoded and written on the job system. The buffer returns to the ring once its file is written.
+class FrameCapture
+{
+public:
+	// Totals since startup.
+	struct Stats
+	{
+		uint64_t copied = 0;
+		uint64_t written = 0;
+		uint64_t dropped = 0;		// No readback buffer was free.
+		uint64_t failed = 0;
+		double averageEncodeMilliseconds = 0.0;
+	};
+
+	struct Input
+	{
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		JobSystem* jobs;
+		FrameScheduler* scheduler;
+		CaptureSettings settings;
+	};
+
+	FrameCapture(const Input& input);
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	/// @brief Writes every frame that was already copied and waits for the writes. The device must be idle.
+	~FrameCapture();
+
+	/// @brief False for image formats the encoder cannot read, only 8-bit RGBA and BGRA are supported.
+	static bool IsSupported(vk::Format format);
+
+	/// @brief PNG and BMP need stb_image_write, raw RGBA is always available.
+	static bool IsFormatAvailable(CaptureFormat format);
+
+	/// @brief Writes tightly packed RGBA8 rows, top to bottom, as frame's file in directory. Safe to call from any thread.
+	static bool WriteImage(const std::string& directory, CaptureFormat format, uint64_t frame, vk::Extent2D extent, const uint8_t* rgba);
+
+	/// @brief Captures the next frameCount frames, 0 captures until Stop.
+	void Start(uint32_t frameCount);
+	void Stop();
+	bool IsCapturing() const { return m_Capturing; }
+
+	/// @brief Starts writing the readbacks whose frames have finished and returns written buffers to the ring. Never blocks.
+	void Update();
+
+	/// @brief Adds a pass copying image into a free readback buffer while capturing, writing it as the given frame.
+	/// The pass is declared even when no buffer is free, so dropping a frame does not compile the graph again.
+	void AddCapturePass(RenderGraph& graph, RenderResource image, vk::Format format, vk::Extent2D extent, uint64_t frame);
+
+	/// @brief Tags the readback of the frame just submitted with the point its copy has landed at.
+	void OnSubmit(const TimelinePoint& completion);
+
+	const Stats& GetStats() const { return m_Stats; }
+private:
+	enum class ReadbackState
+	{
+		Free,
+		Recorded,		// Copy recorded, the frame has not been submitted yet.
+		Submitted,		// Waiting for the GPU to reach completion.
+		Writing			// Encoded and written on the job system.
+	};
+
+	struct Readback
+	{
+		vkInit::Buffer buffer;
+		vk::DeviceSize size = 0;
+		uint8_t* mapped = nullptr;
+		ReadbackState state = ReadbackState::Free;
+
+		TimelinePoint completion;
+		uint64_t frame = 0;
+		vk::Extent2D extent;
+		vk::Format format = vk::Format::eUndefined;
+
+		// Written by the job, read once it has finished.
+		JobCounter job;
+		bool succeeded = false;
+		double encodeMilliseconds = 0.0;
+	};
+
+	Readback* Claim(vk::DeviceSize size);
+	void Write(Readback& readback) const;
+	void Finish(Readback& readback);
+	void Destroy(Readback& readback);
+private:
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+	JobSystem& m_Jobs;
+	FrameScheduler& m_Scheduler;
+	CaptureSettings m_Settings;
+
+	// Cached memory makes the CPU reads of the encoder fast, uncached memory is read one uncombined load at a time.
+	vk::MemoryPropertyFlags m_MemoryProperties;
+
+	std::vector<std::unique_ptr<Readback>> m_Ring;
+	Readback* m_Recording = nullptr;		// Claimed by the capture pass of the frame being recorded.
+
+	bool m_Capturing = false;
+	uint32_t m_Remaining = 0;				// Frames left to capture, 0 captures until stopped.
+
+	Stats m_Stats;
+	uint64_t m_Encoded = 0;
+	double m_EncodeMilliseconds = 0.0;
+};
+
+#endif // !FRAME_CAPTURE_HPP
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "FramePacer.hpp"
+
+#include <thread>
+
+namespace
+{
+	// Covers jitter in the CPU estimate. Submitting late idles the GPU, which costs more than a little latency.
+	constexpr double SafetyMarginMilliseconds = 1.0;
+
+	// Bounds a present wait, presents can get lost when the swapchain goes out of date.
+	constexpr uint64_t PresentWaitTimeout = 100'000'000;
+
+	double Milliseconds(FramePacer::Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	FramePacer::Clock::duration FromMilliseconds(double milliseconds)
+	{
+		return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<double, std::milli>(milliseconds));
+	}
+
+	void Smooth(double& average, double sample)
+	{
+		average = average == 0.0 ? sample : average + (sample - average) * 0.1;
+	}
+}
+
+FramePacer::FramePacer(const FramePacingSettings& settings, FrameScheduler& scheduler) : m_Settings(settings), m_Scheduler(scheduler)
+{
+	m_Settings.maxQueuedFrames = std::min(m_Settings.maxQueuedFrames, HistorySize / 2);
+
+	if (m_Settings.enabled)
+		CONSOLE_INFO("Frame pacing on, target %.1f fps, at most %u queued frames.", m_Settings.targetFrameRate, m_Settings.maxQueuedFrames);
+}
+
+void FramePacer::SetPresentWait(vk::Device device, vk::SwapchainKHR swapchain, const vk::DispatchLoaderDynamic* dispatcher, uint64_t firstFrame)
+{
+	m_Device = device;
+	m_Swapchain = swapchain;
+	m_Dispatcher = dispatcher;
+	m_FirstPresentId = firstFrame + 1;
+}
+
+void FramePacer::BeginFrame(uint64_t frame)
+{
+	Clock::time_point entry = Clock::now();
+	CollectCompletions(frame, entry);
+
+	if (m_Settings.enabled)
+	{
+		LimitLatency(frame);
+
+		Clock::time_point now = Clock::now();
+		Clock::time_point wake = PredictStart(frame, now);
+		if (wake > now)
+			SleepUntil(wake);
+	}
+
+	Clock::time_point start = Clock::now();
+	FrameRecord& record = m_History[frame % HistorySize];
+	record = FrameRecord{};
+	record.frame = frame;
+	record.start = start;
+
+	if (m_Started)
+	{
+		double interval = Milliseconds(start - m_LastStart);
+		m_Window.averageIntervalMilliseconds += interval;
+		m_Window.maxIntervalMilliseconds = std::max(m_Window.maxIntervalMilliseconds, interval);
+		m_Window.averageSleepMilliseconds += Milliseconds(start - entry);
+		m_Window.frames++;
+	}
+
+	m_LastStart = start;
+	m_Started = true;
+}
+
+void FramePacer::OnSubmit(uint64_t frame, const TimelinePoint& completion)
+{
+	FrameRecord* record = FindRecord(frame);
+	if (!record)
+		return;
+
+	record->submit = Clock::now();
+	record->point = completion;
+	record->submitted = true;
+	Smooth(m_CpuMilliseconds, Milliseconds(record->submit - record->start));
+}
+
+void FramePacer::ReportGpuTime(double milliseconds)
+{
+	m_MeasuredGpuTime = true;
+	Smooth(m_GpuMilliseconds, milliseconds);
+}
+
+FramePacer::Stats FramePacer::TakeStats()
+{
+	Stats stats = m_Window;
+	double frames = std::max(1u, stats.frames);
+	stats.averageIntervalMilliseconds /= frames;
+	stats.averageSleepMilliseconds /= frames;
+	stats.averageLatencyMilliseconds /= std::max(1u, m_LatencySamples);
+	stats.averageDisplayLatencyMilliseconds /= std::max(1u, m_DisplayLatencySamples);
+	stats.cpuMilliseconds = m_CpuMilliseconds;
+	stats.gpuMilliseconds = m_GpuMilliseconds;
+
+	m_Window = Stats{};
+	m_LatencySamples = 0;
+	m_DisplayLatencySamples = 0;
+	return stats;
+}
+
+FramePacer::FrameRecord* FramePacer::FindRecord(uint64_t frame)
+{
+	FrameRecord& record = m_History[frame % HistorySize];
+	return record.frame == frame ? &record : nullptr;
+}
+
+void FramePacer::LimitLatency(uint64_t frame)
+{
+	if (frame <= m_Settings.maxQueuedFrames)
+		return;
+
+	FrameRecord* record = FindRecord(frame - m_Settings.maxQueuedFrames - 1);
+	if (!record || !record->submitted)
+		return;
+
+	// Displayed implies finished on the GPU, so the timeline wait below returns right away after this.
+	uint64_t presentId = GetPresentId(record->frame);
+	if (presentId != 0 && presentId >= m_FirstPresentId)
+	{
+		try
+		{
+			if (m_Device.waitForPresentKHR(m_Swapchain, presentId, PresentWaitTimeout, *m_Dispatcher) == vk::Result::eSuccess)
+			{
+				m_Window.averageDisplayLatencyMilliseconds += Milliseconds(Clock::now() - record->start);
+				m_DisplayLatencySamples++;
+			}
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_DEBUG("Present wait failed, falling back to the GPU timeline. %s", err.what());
+		}
+	}
+
+	if (!record->completed)
+	{
+		bool blocking = !m_Scheduler.IsComplete(record->point);
+		m_Scheduler.Wait(record->point);
+		Complete(*record, Clock::now(), blocking);
+	}
+}
+
+FramePacer::Clock::time_point FramePacer::PredictStart(uint64_t frame, Clock::time_point now)
+{
+	Clock::time_point wake = now;
+	if (m_Settings.targetFrameRate > 0.0 && m_Started)
+		wake = std::max(wake, m_LastStart + FromMilliseconds(1000.0 / m_Settings.targetFrameRate));
+
+	// Frames still on the GPU finish one GPU frame time apart, aim to submit as the last of them completes.
+	uint32_t outstanding = 0;
+	const FrameRecord* oldest = nullptr;
+	for (uint64_t i = 1; i < HistorySize && i <= frame; i++)
+	{
+		const FrameRecord* record = FindRecord(frame - i);
+		if (record && record->submitted && !record->completed)
+		{
+			outstanding++;
+			oldest = record;
+		}
+	}
+
+	if (oldest && m_GpuMilliseconds > 0.0)
+	{
+		Clock::time_point gpuStart = oldest->submit;
+		const FrameRecord* previous = FindRecord(oldest->frame - 1);
+		if (previous && previous->completed)
+			gpuStart = std::max(gpuStart, previous->completion);
+
+		Clock::time_point gpuIdle = gpuStart + FromMilliseconds(outstanding * m_GpuMilliseconds);
+		wake = std::max(wake, gpuIdle - FromMilliseconds(m_CpuMilliseconds + SafetyMarginMilliseconds));
+	}
+
+	return wake;
+}
+
+void FramePacer::CollectCompletions(uint64_t frame, Clock::time_point now)
+{
+	for (uint64_t i = 1; i < HistorySize && i <= frame; i++)
+	{
+		FrameRecord* record = FindRecord(frame - i);
+		if (record && record->submitted && !record->completed && m_Scheduler.IsComplete(record->point))
+			Complete(*record, now, false);
+	}
+}
+
+void FramePacer::Complete(FrameRecord& record, Clock::time_point time, bool exact)
+{
+	record.completed = true;
+	record.completion = time;
+	record.exactCompletion = exact;
+
+	// Polled completions are only seen on the next frame, so latency is an upper bound unless the pacer waited for it.
+	double latency = Milliseconds(time - record.start);
+	m_Window.averageLatencyMilliseconds += latency;
+	m_Window.maxLatencyMilliseconds = std::max(m_Window.maxLatencyMilliseconds, latency);
+	m_LatencySamples++;
+
+	if (!exact || m_MeasuredGpuTime)
+		return;
+
+	// The GPU starts a frame once it has been submitted and the one before it has finished. Only measure when
+	// that start is known, otherwise the estimate would include time spent queued.
+	Clock::time_point gpuStart = record.submit;
+	const FrameRecord* previous = FindRecord(record.frame - 1);
+	if (previous && previous->completed)
+	{
+		if (!previous->exactCompletion && previous->completion > record.submit)
+			return;
+		gpuStart = std::max(gpuStart, previous->completion);
+	}
+
+	Smooth(m_GpuMilliseconds, Milliseconds(time - gpuStart));
+}
+
+void FramePacer::SleepUntil(Clock::time_point time)
+{
+	PROFILE_SCOPE("FramePacer::Sleep");
+
+	// Sleeps overshoot by up to a scheduler tick, so the last stretch is spent yielding.
+	const Clock::duration spin = std::chrono::microseconds(1500);
+	if (time - Clock::now() > spin)
+		std::this_thread::sleep_until(time - spin);
+
+	while (Clock::now() < time)
+		std::this_thread::yield();
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include "Config.hpp"
+#include "FrameScheduler.hpp"
+
+#include <chrono>
+
+struct FramePacingSettings
+{
+	// Sleep before each frame instead of running as fast as the swapchain lets us.
+	bool enabled = false;
+
+	// Frames per second to aim for, 0 leaves the rate to the GPU and the present mode.
+	double targetFrameRate = 0.0;
+
+	// Earlier frames the GPU may still be working on when a frame starts. Lower trades throughput for latency.
+	uint32_t maxQueuedFrames = 1;
+};
+
+// Paces the render loop for low and even input-to-photon latency. Before a frame samples input the pacer waits until
+// at most maxQueuedFrames earlier frames are still in flight, then sleeps until the predicted time at which the new
+// frame's submission lands just as the GPU runs out of work, and no earlier than the target frame rate allows.
+// The prediction uses the measured CPU and GPU frame times. With VK_KHR_present_wait the limiter waits for frames to
+// reach the display rather than for the GPU to finish them.
+class FramePacer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Stats
+	{
+		uint32_t frames = 0;
+		double averageIntervalMilliseconds = 0.0, maxIntervalMilliseconds = 0.0;	// Start to start.
+		double averageLatencyMilliseconds = 0.0, maxLatencyMilliseconds = 0.0;		// Start to GPU completion.
+		double averageDisplayLatencyMilliseconds = 0.0;								// Start to display, only with present wait.
+		double averageSleepMilliseconds = 0.0;
+		double cpuMilliseconds = 0.0, gpuMilliseconds = 0.0;						// Current estimates.
+	};
+
+	FramePacer(const FramePacingSettings& settings, FrameScheduler& scheduler);
+
+	/// @brief Enables waiting on presents of swapchain from firstFrame on, call again whenever it is recreated.
+	/// dispatcher must have the device functions of VK_KHR_present_wait loaded.
+	void SetPresentWait(vk::Device device, vk::SwapchainKHR swapchain, const vk::DispatchLoaderDynamic* dispatcher, uint64_t firstFrame);
+
+	/// @brief Blocks until frame should start, call right before sampling input.
+	void BeginFrame(uint64_t frame);
+
+	/// @brief Records the submission of frame, completion is reached once the GPU has finished it.
+	void OnSubmit(uint64_t frame, const TimelinePoint& completion);
+
+	/// @brief Present id to chain into the present of frame, 0 when present wait is off.
+	uint64_t GetPresentId(uint64_t frame) const { return m_Swapchain ? frame + 1 : 0; }
+
+	/// @brief Feeds a GPU frame time measured with timestamps. Once reported, it replaces the estimate from completion times.
+	void ReportGpuTime(double milliseconds);
+
+	/// @brief Returns the stats gathered since the last call.
+	Stats TakeStats();
+
+	const FramePacingSettings& GetSettings() const { return m_Settings; }
+private:
+	struct FrameRecord
+	{
+		uint64_t frame = UINT64_MAX;
+		Clock::time_point start, submit, completion;
+		TimelinePoint point;
+		bool submitted = false;
+		bool completed = false;
+		bool exactCompletion = false;	// Completion time seen by a blocking wait rather than by polling.
+	};
+
+	FrameRecord* FindRecord(uint64_t frame);
+	void LimitLatency(uint64_t frame);
+	Clock::time_point PredictStart(uint64_t frame, Clock::time_point now);
+	void CollectCompletions(uint64_t frame, Clock::time_point now);
+	void Complete(FrameRecord& record, Clock::time_point time, bool exact);
+	static void SleepUntil(Clock::time_point time);
+private:
+	static constexpr uint32_t HistorySize = 16;
+
+	FramePacingSettings m_Settings;
+	FrameScheduler& m_Scheduler;
+	std::array<FrameRecord, HistorySize> m_History;
+	Clock::time_point m_LastStart;
+	bool m_Started = false;
+
+	// Moving averages feeding the prediction.
+	double m_CpuMilliseconds = 0.0, m_GpuMilliseconds = 0.0;
+	bool m_MeasuredGpuTime = false;
+
+	vk::Device m_Device;
+	vk::SwapchainKHR m_Swapchain;
+	const vk::DispatchLoaderDynamic* m_Dispatcher = nullptr;
+	uint64_t m_FirstPresentId = 0;	// Present ids before it belong to an older swapchain.
+
+	// Sums since the last TakeStats.
+	Stats m_Window;
+	uint32_t m_LatencySamples = 0, m_DisplayLatencySamples = 0;
+};
+
+#endif // !FRAME_PACER_HPP
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "FramePipeline.hpp"
+
+#include <chrono>
+
+FramePipeline::FramePipeline(JobSystem& jobs, uint32_t depth) : m_Jobs(jobs)
+{
+	depth = std::max(1u, depth);
+	for (uint32_t i = 0; i < depth; i++)
+		m_Packets.push_back(std::make_unique<FramePacket>());
+
+	CONSOLE_INFO("Frame pipeline depth: %u.", depth);
+}
+
+FramePipeline::~FramePipeline()
+{
+	Flush();
+}
+
+void FramePipeline::Kick(Scene* scene, uint64_t frame)
+{
+	const uint64_t depth = m_Packets.size();
+
+	while (m_NextFrame < frame + depth)
+	{
+		// The slot was last used by frame m_NextFrame - depth, which has already been acquired.
+		FramePacket& packet = *m_Packets[m_NextFrame % depth];
+		packet.frame = m_NextFrame;
+
+		auto simulate = [this, scene, &packet]() { Simulate(scene, packet); };
+
+		// Each simulation reads the scene state the previous one left behind.
+		FramePacket& previous = *m_Packets[(m_NextFrame + depth - 1) % depth];
+		if (m_NextFrame > 0 && &previous != &packet)
+			m_Jobs.RunAfter(previous.ready, simulate, &packet.ready);
+		else
+			m_Jobs.Run(simulate, &packet.ready);
+
+		m_NextFrame++;
+	}
+}
+
+const FramePacket& FramePipeline::Acquire(uint64_t frame)
+{
+	PROFILE_SCOPE("FramePipeline::Acquire");
+	FramePacket& packet = *m_Packets[frame % m_Packets.size()];
+	m_Jobs.Wait(packet.ready);
+
+	if (packet.frame != frame)
+		CONSOLE_ERROR("Frame pipeline acquired frame %llu, but the packet holds frame %llu!",
+			static_cast<unsigned long long>(frame), static_cast<unsigned long long>(packet.frame));
+
+	return packet;
+}
+
+void FramePipeline::Flush()
+{
+	for (std::unique_ptr<FramePacket>& packet : m_Packets)
+		m_Jobs.Wait(packet->ready);
+}
+
+void FramePipeline::Simulate(Scene* scene, FramePacket& packet)
+{
+	PROFILE_SCOPE("FramePipeline::Simulate");
+	auto start = std::chrono::steady_clock::now();
+
+	scene->Update(m_Jobs);
+
+	// Bake the final per-draw constants so the record stage only copies them into the command buffer.
+	glm::mat4 viewProjection = scene->camera.GetViewProjection();
+	uint32_t drawCount = static_cast<uint32_t>(scene->visibleObjects.size());
+	packet.viewProjection = viewProjection;
+	packet.view = scene->camera.view;
+	packet.projection = scene->camera.projection;
+	glm::mat4 cameraWorld = glm::inverse(scene->camera.view);
+	packet.cameraPosition = glm::vec3(cameraWorld[3]);
+	packet.cameraForward = -glm::vec3(cameraWorld[2]);
+	packet.objectCount = scene->transforms.Size();
+	packet.draws.resize(drawCount);
+	m_Jobs.ParallelFor(drawCount, 1024, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			uint32_t object = scene->visibleObjects[i];
+			packet.draws[i].model = viewProjection * scene->transforms.GetWorldMatrix(object);
+			packet.draws[i].objectIndex = object;
+			packet.draws[i].materialIndex = scene->materialIds[object];
+		}
+	});
+
+	// Grouped by state, then by the clip space depth of each object's origin, the same ordering the depth test uses.
+	const bool sortDepth = m_SortFrontToBack;
+	packet.queue.Clear();
+	packet.queue.Reserve(drawCount);
+	for (uint32_t i = 0; i < drawCount; i++)
+	{
+		uint32_t object = scene->visibleObjects[i];
+		uint32_t material = packet.draws[i].materialIndex;
+		uint32_t pipeline = scene->materials[material < scene->materials.size() ? material : 0].pipeline;
+		float depth = sortDepth ? packet.draws[i].model[3].z / packet.draws[i].model[3].w : 0.0f;
+		packet.queue.Push(RenderQueue::MakeKey(RenderQueue::PassOpaque, pipeline, material, scene->meshIds[object], depth), i);
+	}
+	packet.queue.Sort(m_Jobs);
+
+	const std::vector<RenderQueue::Item>& items = packet.queue.GetItems();
+	m_SortedDraws.resize(drawCount);
+	for (uint32_t i = 0; i < drawCount; i++)
+		m_SortedDraws[i] = packet.draws[items[i].index];
+	packet.draws.swap(m_SortedDraws);
+
+	// Copied in whole runs, the record stage uploads them without looking at the scene.
+	const std::vector<TransformStore::Range>& moved = scene->transforms.GetLastUpdatedRanges();
+	const std::vector<glm::mat4>& world = scene->transforms.GetWorldMatrices();
+	packet.movedAll = moved.size() == 1 && moved[0].count == packet.objectCount;
+	packet.movedRanges.clear();
+	packet.movedWorld.clear();
+	packet.movedBounds.clear();
+	if (!packet.movedAll)
+	{
+		packet.movedRanges.assign(moved.begin(), moved.end());
+		for (const TransformStore::Range& range : moved)
+		{
+			packet.movedWorld.insert(packet.movedWorld.end(), world.begin() + range.first, world.begin() + range.first + range.count);
+			packet.movedBounds.insert(packet.movedBounds.end(), scene->objectBounds.data() + range.first,
+				scene->objectBounds.data() + range.first + range.count);
+		}
+	}
+
+	packet.simulateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
\ No newline at end of file
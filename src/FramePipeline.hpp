@@ -0,0 +1,76 @@
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include "Config.hpp"
+#include "JobSystem.hpp"
+#include "Scene.hpp"
+#include "RenderQueue.hpp"
+#include "Vulkan/PushConstants.hpp"
+
+// Everything the record stage needs from the simulation of one frame, so recording never touches the Scene.
+struct FramePacket
+{
+	uint64_t frame = 0;
+	glm::mat4 viewProjection{ 1.0f };
+	glm::mat4 view{ 1.0f };
+	glm::mat4 projection{ 1.0f };
+	glm::vec3 cameraPosition{ 0.0f };
+	glm::vec3 cameraForward{ 0.0f, 0.0f, -1.0f };
+	uint32_t objectCount = 0;
+
+	// One entry per object that passed frustum culling, in the order of the render queue's items, its batches index into them.
+	std::vector<vkInit::Constants> draws;
+	RenderQueue queue;
+
+	// World matrices and world space bounds of the objects this frame's update moved, as runs of consecutive objects so
+	// each run uploads with one copy. When everything moved, e.g. in the first update of a scene, they stay empty and
+	// movedAll is set instead, the whole scene is then uploaded from the scene itself.
+	std::vector<TransformStore::Range> movedRanges;
+	std::vector<glm::mat4> movedWorld;
+	std::vector<AABB> movedBounds;
+	bool movedAll = false;
+	double simulateMilliseconds = 0.0;
+
+	// Zero once the simulation of this frame has finished.
+	JobCounter ready;
+};
+
+// Runs simulation and culling of upcoming frames on the job system while the calling thread records
+// and submits the current one. Up to depth frames are in the pipeline at once: with a depth of 2 the
+// simulation of frame N + 1 overlaps the recording and submission of frame N.
+class FramePipeline
+{
+public:
+	FramePipeline(JobSystem& jobs, uint32_t depth);
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+	~FramePipeline();
+
+	/// @brief Starts the simulation of every frame up to frame + depth - 1 that has not been started yet.
+	/// Simulations depend on each other, so they still run one after another.
+	void Kick(Scene* scene, uint64_t frame);
+
+	/// @brief Waits for the simulation of frame, running jobs on the calling thread in the meantime.
+	const FramePacket& Acquire(uint64_t frame);
+
+	/// @brief Waits for every simulation that has been started.
+	void Flush();
+
+	uint32_t GetDepth() const { return static_cast<uint32_t>(m_Packets.size()); }
+
+	// Sorts the draws of each state batch of frames simulated from now on front to back, so early depth testing rejects more fragments.
+	void SetSortFrontToBack(bool sort) { m_SortFrontToBack = sort; }
+	bool GetSortFrontToBack() const { return m_SortFrontToBack; }
+private:
+	void Simulate(Scene* scene, FramePacket& packet);
+private:
+	JobSystem& m_Jobs;
+	std::vector<std::unique_ptr<FramePacket>> m_Packets;
+	uint64_t m_NextFrame = 0;
+	std::atomic<bool> m_SortFrontToBack{ false };
+
+	// Scratch of the simulation stage, simulations never overlap.
+	std::vector<vkInit::Constants> m_SortedDraws;
+};
+
+#endif // !FRAME_PIPELINE_HPP
\ No newline at end of file
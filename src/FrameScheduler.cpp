@@ -0,0 +1,248 @@
+#include "FrameScheduler.hpp"
+#include "Vulkan/Sync.hpp"
+
+namespace
+{
+	// Stages that exist in both APIs share their bits, which covers everything the renderer waits on.
+	vk::PipelineStageFlags ToLegacyStages(vk::PipelineStageFlags2 stages)
+	{
+		return vk::PipelineStageFlags(static_cast<VkPipelineStageFlags>(static_cast<VkPipelineStageFlags2>(stages) & 0xFFFFFFFFull));
+	}
+
+	const char* GetQueueName(QueueType queue)
+	{
+		switch (queue)
+		{
+		case QueueType::Graphics:	return "graphics";
+		case QueueType::Compute:	return "compute";
+		case QueueType::Transfer:	return "transfer";
+		default:					return "unknown";
+		}
+	}
+}
+
+FrameScheduler::FrameScheduler(const Input& input)
+	: m_Device(input.device), m_TimelineSemaphores(input.timelineSemaphores), m_Synchronization2(input.synchronization2 && input.timelineSemaphores)
+{
+	for (size_t i = 0; i < m_Timelines.size(); i++)
+	{
+		m_Timelines[i].queue = input.queues[i];
+		if (m_TimelineSemaphores)
+			m_Timelines[i].semaphore = vkInit::CreateTimelineSemaphore(m_Device);
+	}
+
+	CONSOLE_INFO("Frame scheduler uses %s, submitting with %s.", m_TimelineSemaphores ? "timeline semaphores" : "fences",
+		m_Synchronization2 ? "vkQueueSubmit2" : "vkQueueSubmit");
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	WaitIdle();
+
+	for (Timeline& timeline : m_Timelines)
+	{
+		if (timeline.semaphore)
+			m_Device.destroySemaphore(timeline.semaphore);
+		for (PendingFence& pending : timeline.pending)
+			m_Device.destroyFence(pending.fence);
+	}
+
+	for (vk::Fence fence : m_FreeFences)
+		m_Device.destroyFence(fence);
+}
+
+TimelinePoint FrameScheduler::Submit(QueueType queue, const QueueSubmission& submission)
+{
+	PROFILE_SCOPE("FrameScheduler::Submit");
+	Timeline& timeline = GetTimeline(queue);
+	uint64_t value = timeline.submitted + 1;
+
+	try
+	{
+		if (m_Synchronization2)
+			Submit2(timeline, value, submission);
+		else if (m_TimelineSemaphores)
+			SubmitTimeline(timeline, value, submission);
+		else
+			SubmitFence(timeline, value, submission);
+	}
+	catch (const vk::SystemError& err)
+	{
+		CONSOLE_ERROR("Failed to submit commands to the %s queue! %s", GetQueueName(queue), err.what());
+		return { queue, timeline.submitted };
+	}
+
+	timeline.submitted = value;
+	return { queue, value };
+}
+
+bool FrameScheduler::Wait(const TimelinePoint& point, uint64_t timeout)
+{
+	Timeline& timeline = GetTimeline(point.queue);
+	if (point.value <= timeline.completed)
+		return true;
+
+	PROFILE_SCOPE("FrameScheduler::Wait");
+	if (!m_TimelineSemaphores)
+	{
+		RetireFences(timeline, true, point.value);
+		return point.value <= timeline.completed;
+	}
+
+	vk::SemaphoreWaitInfo waitInfo(vk::SemaphoreWaitFlags(), 1, &timeline.semaphore, &point.value);
+	if (m_Device.waitSemaphores(waitInfo, timeout) != vk::Result::eSuccess)
+	{
+		CONSOLE_WARN("Timed out waiting for value %llu on the %s queue.", static_cast<unsigned long long>(point.value), GetQueueName(point.queue));
+		return false;
+	}
+
+	timeline.completed = std::max(timeline.completed, point.value);
+	return true;
+}
+
+void FrameScheduler::WaitIdle()
+{
+	for (size_t i = 0; i < m_Timelines.size(); i++)
+		Wait({ static_cast<QueueType>(i), m_Timelines[i].submitted });
+}
+
+bool FrameScheduler::IsComplete(const TimelinePoint& point)
+{
+	return point.value <= GetTimeline(point.queue).completed || point.value <= GetCompletedValue(point.queue);
+}
+
+uint64_t FrameScheduler::GetCompletedValue(QueueType queue)
+{
+	Timeline& timeline = GetTimeline(queue);
+
+	if (m_TimelineSemaphores)
+		timeline.completed = std::max(timeline.completed, m_Device.getSemaphoreCounterValue(timeline.semaphore));
+	else
+		RetireFences(timeline, false, timeline.submitted);
+
+	return timeline.completed;
+}
+
+void FrameScheduler::Submit2(Timeline& timeline, uint64_t value, const QueueSubmission& submission)
+{
+	std::vector<vk::SemaphoreSubmitInfo> waits;
+	for (const TimelinePoint& point : submission.waitPoints)
+		waits.emplace_back(GetTimeline(point.queue).semaphore, point.value, submission.waitStages);
+	if (submission.waitSemaphore)
+		waits.emplace_back(submission.waitSemaphore, 0, submission.waitSemaphoreStages);
+
+	std::vector<vk::SemaphoreSubmitInfo> signals;
+	signals.emplace_back(timeline.semaphore, value, vk::PipelineStageFlagBits2::eAllCommands);
+	if (submission.signalSemaphore)
+		signals.emplace_back(submission.signalSemaphore, 0, vk::PipelineStageFlagBits2::eAllCommands);
+
+	std::vector<vk::CommandBufferSubmitInfo> commandBuffers;
+	for (vk::CommandBuffer commandBuffer : submission.commandBuffers)
+		commandBuffers.emplace_back(commandBuffer);
+
+	vk::SubmitInfo2 submitInfo{};
+	submitInfo.waitSemaphoreInfoCount = static_cast<uint32_t>(waits.size());
+	submitInfo.pWaitSemaphoreInfos = waits.data();
+	submitInfo.commandBufferInfoCount = static_cast<uint32_t>(commandBuffers.size());
+	submitInfo.pCommandBufferInfos = commandBuffers.data();
+	submitInfo.signalSemaphoreInfoCount = static_cast<uint32_t>(signals.size());
+	submitInfo.pSignalSemaphoreInfos = signals.data();
+
+	timeline.queue.submit2(submitInfo);
+}
+
+void FrameScheduler::SubmitTimeline(Timeline& timeline, uint64_t value, const QueueSubmission& submission)
+{
+	// Values of binary semaphores are ignored, but the arrays have to line up with the semaphores.
+	std::vector<vk::Semaphore> waitSemaphores;
+	std::vector<uint64_t> waitValues;
+	std::vector<vk::PipelineStageFlags> waitStages;
+	for (const TimelinePoint& point : submission.waitPoints)
+	{
+		waitSemaphores.push_back(GetTimeline(point.queue).semaphore);
+		waitValues.push_back(point.value);
+		waitStages.push_back(ToLegacyStages(submission.waitStages));
+	}
+	if (submission.waitSemaphore)
+	{
+		waitSemaphores.push_back(submission.waitSemaphore);
+		waitValues.push_back(0);
+		waitStages.push_back(ToLegacyStages(submission.waitSemaphoreStages));
+	}
+
+	std::vector<vk::Semaphore> signalSemaphores = { timeline.semaphore };
+	std::vector<uint64_t> signalValues = { value };
+	if (submission.signalSemaphore)
+	{
+		signalSemaphores.push_back(submission.signalSemaphore);
+		signalValues.push_back(0);
+	}
+
+	vk::TimelineSemaphoreSubmitInfo timelineInfo(waitValues, signalValues);
+
+	vk::SubmitInfo submitInfo(waitSemaphores, waitStages, submission.commandBuffers, signalSemaphores);
+	submitInfo.pNext = &timelineInfo;
+
+	timeline.queue.submit(submitInfo);
+}
+
+void FrameScheduler::SubmitFence(Timeline& timeline, uint64_t value, const QueueSubmission& submission)
+{
+	// Fences can not be waited on by the GPU, so work of other queues is waited for here.
+	for (const TimelinePoint& point : submission.waitPoints)
+		Wait(point);
+
+	std::vector<vk::Semaphore> waitSemaphores;
+	std::vector<vk::PipelineStageFlags> waitStages;
+	if (submission.waitSemaphore)
+	{
+		waitSemaphores.push_back(submission.waitSemaphore);
+		waitStages.push_back(ToLegacyStages(submission.waitSemaphoreStages));
+	}
+
+	std::vector<vk::Semaphore> signalSemaphores;
+	if (submission.signalSemaphore)
+		signalSemaphores.push_back(submission.signalSemaphore);
+
+	vk::Fence fence;
+	if (!m_FreeFences.empty())
+	{
+		fence = m_FreeFences.back();
+		m_FreeFences.pop_back();
+	}
+	else
+	{
+		fence = vkInit::CreateFence(m_Device, false);
+	}
+
+	vk::SubmitInfo submitInfo(waitSemaphores, waitStages, submission.commandBuffers, signalSemaphores);
+	try
+	{
+		timeline.queue.submit(submitInfo, fence);
+	}
+	catch (const vk::SystemError&)
+	{
+		m_FreeFences.push_back(fence);
+		throw;
+	}
+
+	timeline.pending.push_back({ value, fence });
+}
+
+void FrameScheduler::RetireFences(Timeline& timeline, bool block, uint64_t value)
+{
+	// Fences of one queue signal in submission order, so the oldest one bounds the completed value.
+	while (!timeline.pending.empty() && timeline.pending.front().value <= value)
+	{
+		PendingFence& pending = timeline.pending.front();
+		if (block)
+			(void)m_Device.waitForFences(pending.fence, VK_TRUE, UINT64_MAX);
+		else if (m_Device.getFenceStatus(pending.fence) != vk::Result::eSuccess)
+			break;
+
+		m_Device.resetFences(pending.fence);
+		m_FreeFences.push_back(pending.fence);
+		timeline.completed = pending.value;
+		timeline.pending.pop_front();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef FRAME_SCHEDULER_HPP
+#define FRAME_SCHEDULER_HPP
+
+#include "Config.hpp"
+
+#include <deque>
+
+enum class QueueType : uint32_t
+{
+	Graphics,
+	Compute,
+	Transfer,
+	Count
+};
+
+// A value on the timeline of one queue, reached once every submission to that queue up to it has finished.
+struct TimelinePoint
+{
+	QueueType queue = QueueType::Graphics;
+	uint64_t value = 0;
+};
+
+struct QueueSubmission
+{
+	std::vector<vk::CommandBuffer> commandBuffers;
+
+	// Work of this or other queues the submission waits for, at waitStages.
+	std::vector<TimelinePoint> waitPoints;
+	vk::PipelineStageFlags2 waitStages = vk::PipelineStageFlagBits2::eAllCommands;
+
+	// Binary semaphores, only for the swapchain, which can not use timelines.
+	vk::Semaphore waitSemaphore;
+	vk::PipelineStageFlags2 waitSemaphoreStages = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+	vk::Semaphore signalSemaphore;
+};
+
+// Orders GPU work with one timeline semaphore per queue. Every submission signals the next value of its queue's
+// timeline, so "has this work finished" is a single comparison and waiting on another queue is a wait on a value.
+// Submits through vkQueueSubmit2 when synchronization2 is available. Without timeline semaphores each submission
+// gets a fence instead and waits on other queues happen on the CPU before submitting.
+class FrameScheduler
+{
+public:
+	struct Input
+	{
+		vk::Device device;
+		std::array<vk::Queue, static_cast<size_t>(QueueType::Count)> queues;
+		bool timelineSemaphores = false;
+		bool synchronization2 = false;
+	};
+
+	FrameScheduler(const Input& input);
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+	~FrameScheduler();
+
+	/// @brief Submits to queue and returns the point reached once the submission has finished.
+	TimelinePoint Submit(QueueType queue, const QueueSubmission& submission);
+
+	/// @brief Blocks until point is reached. Returns false on timeout.
+	bool Wait(const TimelinePoint& point, uint64_t timeout = UINT64_MAX);
+
+	/// @brief Blocks until everything submitted so far has finished.
+	void WaitIdle();
+
+	/// @brief Never blocks.
+	bool IsComplete(const TimelinePoint& point);
+	uint64_t GetCompletedValue(QueueType queue);
+	uint64_t GetSubmittedValue(QueueType queue) const { return GetTimeline(queue).submitted; }
+
+	vk::Queue GetQueue(QueueType queue) const { return GetTimeline(queue).queue; }
+	bool UsesTimelineSemaphores() const { return m_TimelineSemaphores; }
+private:
+	// Stand-in for a timeline value on devices without timeline semaphores.
+	struct PendingFence
+	{
+		uint64_t value;
+		vk::Fence fence;
+	};
+
+	struct Timeline
+	{
+		vk::Queue queue;
+		vk::Semaphore semaphore;
+		uint64_t submitted = 0;
+		uint64_t completed = 0;		// Cached, only advanced by GetCompletedValue and Wait.
+		std::deque<PendingFence> pending;
+	};
+
+	Timeline& GetTimeline(QueueType queue) { return m_Timelines[static_cast<size_t>(queue)]; }
+	const Timeline& GetTimeline(QueueType queue) const { return m_Timelines[static_cast<size_t>(queue)]; }
+
+	void Submit2(Timeline& timeline, uint64_t value, const QueueSubmission& submission);
+	void SubmitTimeline(Timeline& timeline, uint64_t value, const QueueSubmission& submission);
+	void SubmitFence(Timeline& timeline, uint64_t value, const QueueSubmission& submission);
+	void RetireFences(Timeline& timeline, bool block, uint64_t value);
+private:
+	vk::Device m_Device;
+	bool m_TimelineSemaphores, m_Synchronization2;
+	std::array<Timeline, static_cast<size_t>(QueueType::Count)> m_Timelines;
+	std::vector<vk::Fence> m_FreeFences;
+};
+
+#endif // !FRAME_SCHEDULER_HPP
\ No newline at end of file
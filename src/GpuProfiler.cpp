@@ -0,0 +1,255 @@
+#include "GpuProfiler.hpp"
+
+namespace
+{
+	constexpr vk::QueryPipelineStatisticFlags StatisticFlags =
+		vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices | vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+		vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations | vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+		vk::QueryPipelineStatisticFlagBits::eClippingPrimitives | vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations |
+		vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+
+	void Accumulate(GpuProfiler::PipelineStatistics& sum, const GpuProfiler::PipelineStatistics& value)
+	{
+		sum.inputAssemblyVertices += value.inputAssemblyVertices;
+		sum.inputAssemblyPrimitives += value.inputAssemblyPrimitives;
+		sum.vertexShaderInvocations += value.vertexShaderInvocations;
+		sum.clippingInvocations += value.clippingInvocations;
+		sum.clippingPrimitives += value.clippingPrimitives;
+		sum.fragmentShaderInvocations += value.fragmentShaderInvocations;
+		sum.computeShaderInvocations += value.computeShaderInvocations;
+	}
+
+	void Divide(GpuProfiler::PipelineStatistics& sum, uint32_t count)
+	{
+		sum.inputAssemblyVertices /= count;
+		sum.inputAssemblyPrimitives /= count;
+		sum.vertexShaderInvocations /= count;
+		sum.clippingInvocations /= count;
+		sum.clippingPrimitives /= count;
+		sum.fragmentShaderInvocations /= count;
+		sum.computeShaderInvocations /= count;
+	}
+}
+
+GpuProfiler::GpuProfiler(const Input& input) : m_Device(input.device), m_FramesInFlight(input.framesInFlight), m_WantStatistics(input.pipelineStatistics),
+	m_InheritedQueries(input.inheritedQueries)
+{
+	uint32_t validBits = input.physicalDevice.getQueueFamilyProperties()[input.queueFamily].timestampValidBits;
+	if (validBits == 0)
+	{
+		CONSOLE_WARN("The graphics queue does not support timestamps, GPU timings are disabled.");
+		return;
+	}
+
+	m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	m_TimestampPeriod = input.physicalDevice.getProperties().limits.timestampPeriod;
+
+	if (m_WantStatistics && !input.physicalDevice.getFeatures().pipelineStatisticsQuery)
+	{
+		CONSOLE_WARN("Pipeline statistics queries are not supported, only timing passes.");
+		m_WantStatistics = false;
+	}
+
+	CreatePools();
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	DestroyPools();
+}
+
+void GpuProfiler::Resize(uint32_t framesInFlight)
+{
+	if (!m_TimestampPool)
+		return;
+
+	DestroyPools();
+	m_FramesInFlight = framesInFlight;
+	CreatePools();
+}
+
+void GpuProfiler::CreatePools()
+{
+	m_Slots.assign(m_FramesInFlight, Slot{});
+	m_CurrentSlot = UINT32_MAX;
+
+	try
+	{
+		vk::QueryPoolCreateInfo timestampInfo(vk::QueryPoolCreateFlags(), vk::QueryType::eTimestamp, GetTimestampBase(m_FramesInFlight));
+		m_TimestampPool = m_Device.createQueryPool(timestampInfo);
+
+		if (m_WantStatistics)
+		{
+			vk::QueryPoolCreateInfo statisticsInfo(vk::QueryPoolCreateFlags(), vk::QueryType::ePipelineStatistics, m_FramesInFlight * MaxPasses, StatisticFlags);
+			m_StatisticsPool = m_Device.createQueryPool(statisticsInfo);
+		}
+	}
+	catch (const vk::SystemError& err)
+	{
+		CONSOLE_ERROR("Failed to create GPU profiler query pools! %s", err.what());
+		DestroyPools();
+	}
+}
+
+void GpuProfiler::DestroyPools()
+{
+	if (m_TimestampPool)
+		m_Device.destroyQueryPool(m_TimestampPool);
+	if (m_StatisticsPool)
+		m_Device.destroyQueryPool(m_StatisticsPool);
+	m_TimestampPool = nullptr;
+	m_StatisticsPool = nullptr;
+}
+
+bool GpuProfiler::BeginFrame(vk::CommandBuffer commandBuffer, uint32_t slot)
+{
+	if (!m_TimestampPool || slot >= m_Slots.size())
+		return false;
+
+	bool readBack = m_Slots[slot].pending && ReadBack(m_Slots[slot], slot);
+
+	m_CurrentSlot = slot;
+	m_Slots[slot].pending = true;
+	m_Slots[slot].passes.clear();
+	m_Slots[slot].counted = 0;
+	m_PassOpen = false;
+
+	commandBuffer.resetQueryPool(m_TimestampPool, GetTimestampBase(slot), GetTimestampBase(1));
+	if (m_StatisticsPool)
+		commandBuffer.resetQueryPool(m_StatisticsPool, slot * MaxPasses, MaxPasses);
+
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_TimestampPool, GetTimestampBase(slot));
+	return readBack;
+}
+
+void GpuProfiler::EndFrame(vk::CommandBuffer commandBuffer)
+{
+	if (m_CurrentSlot == UINT32_MAX)
+		return;
+
+	if (m_PassOpen)
+		EndPass(commandBuffer);
+
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_TimestampPool, GetTimestampBase(m_CurrentSlot) + 1);
+	m_CurrentSlot = UINT32_MAX;
+}
+
+vk::QueryPipelineStatisticFlags GpuProfiler::BeginPass(vk::CommandBuffer commandBuffer, const std::string& name, bool secondary)
+{
+	if (m_CurrentSlot == UINT32_MAX || m_PassOpen)
+		return {};
+
+	Slot& slot = m_Slots[m_CurrentSlot];
+	if (slot.passes.size() >= MaxPasses)
+		return {};
+
+	uint32_t pass = static_cast<uint32_t>(slot.passes.size());
+	slot.passes.push_back(name);
+	m_PassOpen = true;
+
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_TimestampPool, GetTimestampBase(m_CurrentSlot) + 2 + 2 * pass);
+	// Executing secondary command buffers inside a statistics query is only valid when they inherit it.
+	if (!m_StatisticsPool || (secondary && !m_InheritedQueries))
+		return {};
+
+	slot.counted |= 1u << pass;
+	commandBuffer.beginQuery(m_StatisticsPool, m_CurrentSlot * MaxPasses + pass, vk::QueryControlFlags());
+	return StatisticFlags;
+}
+
+void GpuProfiler::EndPass(vk::CommandBuffer commandBuffer)
+{
+	if (m_CurrentSlot == UINT32_MAX || !m_PassOpen)
+		return;
+
+	const Slot& slot = m_Slots[m_CurrentSlot];
+	uint32_t pass = static_cast<uint32_t>(slot.passes.size()) - 1;
+	m_PassOpen = false;
+
+	if (slot.counted & (1u << pass))
+		commandBuffer.endQuery(m_StatisticsPool, m_CurrentSlot * MaxPasses + pass);
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_TimestampPool, GetTimestampBase(m_CurrentSlot) + 3 + 2 * pass);
+}
+
+bool GpuProfiler::ReadBack(Slot& slot, uint32_t slotIndex)
+{
+	slot.pending = false;
+	uint32_t passCount = static_cast<uint32_t>(slot.passes.size());
+
+	// The frame that used the slot has finished, so this returns right away. A slot whose submission failed reports
+	// not ready and is skipped.
+	std::array<uint64_t, 2 + 2 * MaxPasses> timestamps;
+	vk::Result result = m_Device.getQueryPoolResults(m_TimestampPool, GetTimestampBase(slotIndex), 2 + 2 * passCount,
+		sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+	if (result != vk::Result::eSuccess)
+		return false;
+
+	// Passes without a query were never begun and would report not ready, they are read one by one when there are any.
+	std::array<PipelineStatistics, MaxPasses> statistics{};
+	uint32_t allPasses = passCount >= 32 ? ~0u : (1u << passCount) - 1;
+	if (m_StatisticsPool && passCount > 0 && slot.counted == allPasses)
+	{
+		result = m_Device.getQueryPoolResults(m_StatisticsPool, slotIndex * MaxPasses, passCount,
+			sizeof(statistics), statistics.data(), sizeof(PipelineStatistics), vk::QueryResultFlagBits::e64);
+		if (result != vk::Result::eSuccess)
+			statistics.fill(PipelineStatistics{});
+	}
+	else if (m_StatisticsPool)
+	{
+		for (uint32_t pass = 0; pass < passCount; pass++)
+		{
+			if (!(slot.counted & (1u << pass)))
+				continue;
+			result = m_Device.getQueryPoolResults(m_StatisticsPool, slotIndex * MaxPasses + pass, 1, sizeof(PipelineStatistics),
+				&statistics[pass], sizeof(PipelineStatistics), vk::QueryResultFlagBits::e64);
+			if (result != vk::Result::eSuccess)
+				statistics[pass] = PipelineStatistics{};
+		}
+	}
+
+	m_LastFrameMilliseconds = ToMilliseconds(timestamps[0], timestamps[1]);
+	m_Window.frames++;
+	m_Window.frameMilliseconds += m_LastFrameMilliseconds;
+	m_Window.maxFrameMilliseconds = std::max(m_Window.maxFrameMilliseconds, m_LastFrameMilliseconds);
+
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		auto found = std::find_if(m_Window.passes.begin(), m_Window.passes.end(),
+			[&](const PassStats& stats) { return stats.name == slot.passes[pass]; });
+		if (found == m_Window.passes.end())
+		{
+			m_Window.passes.push_back(PassStats{ slot.passes[pass] });
+			found = m_Window.passes.end() - 1;
+		}
+
+		found->milliseconds += ToMilliseconds(timestamps[2 + 2 * pass], timestamps[3 + 2 * pass]);
+		Accumulate(found->statistics, statistics[pass]);
+	}
+
+	return true;
+}
+
+double GpuProfiler::ToMilliseconds(uint64_t begin, uint64_t end) const
+{
+	// Masked subtraction stays correct when the counter wraps between the two timestamps.
+	uint64_t ticks = (end - begin) & m_TimestampMask;
+	return ticks * m_TimestampPeriod / 1e6;
+}
+
+GpuProfiler::Stats GpuProfiler::TakeStats()
+{
+	Stats stats = std::move(m_Window);
+	m_Window = Stats{};
+
+	if (stats.frames > 0)
+	{
+		stats.frameMilliseconds /= stats.frames;
+		for (PassStats& pass : stats.passes)
+		{
+			pass.milliseconds /= stats.frames;
+			Divide(pass.statistics, stats.frames);
+		}
+	}
+
+	return stats;
+}
\ No newline at end of file
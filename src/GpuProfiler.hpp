@@ -0,0 +1,112 @@
+#ifndef GPU_PROFILER_HPP
+#define GPU_PROFILER_HPP
+
+#include "Config.hpp"
+
+// Times the passes of a frame on the GPU with timestamp queries, optionally counting pipeline statistics as well.
+// Each frame in flight owns a slice of the query pools. Results are read when the slice comes around again, at which
+// point its frame has finished, so reading them never waits on the GPU.
+class GpuProfiler
+{
+public:
+	// Counters of VK_QUERY_TYPE_PIPELINE_STATISTICS, in the order the queries return them.
+	struct PipelineStatistics
+	{
+		uint64_t inputAssemblyVertices = 0;
+		uint64_t inputAssemblyPrimitives = 0;
+		uint64_t vertexShaderInvocations = 0;
+		uint64_t clippingInvocations = 0;
+		uint64_t clippingPrimitives = 0;
+		uint64_t fragmentShaderInvocations = 0;
+		uint64_t computeShaderInvocations = 0;
+	};
+
+	struct PassStats
+	{
+		std::string name;
+		double milliseconds = 0.0;
+		PipelineStatistics statistics;
+	};
+
+	// Averages per frame over the frames read back since the last TakeStats.
+	struct Stats
+	{
+		uint32_t frames = 0;
+		double frameMilliseconds = 0.0, maxFrameMilliseconds = 0.0;		// Whole command buffer.
+		std::vector<PassStats> passes;
+	};
+
+	struct Input
+	{
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		uint32_t queueFamily;		// Family the timed command buffers are submitted to.
+		uint32_t framesInFlight;
+		bool pipelineStatistics;	// Also collect pipeline statistics, if the device supports the queries.
+		bool inheritedQueries;		// The inheritedQueries feature is enabled, secondary command buffers can run inside the queries.
+	};
+
+	static constexpr uint32_t MaxPasses = 32;
+
+	GpuProfiler(const Input& input);
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+	~GpuProfiler();
+
+	/// @brief False if the queue family cannot write timestamps, every other call is then a no-op.
+	bool IsSupported() const { return static_cast<bool>(m_TimestampPool); }
+	bool CollectsPipelineStatistics() const { return static_cast<bool>(m_StatisticsPool); }
+
+	/// @brief Recreates the pools for a new number of frames in flight, dropping unread results. The device must be idle.
+	void Resize(uint32_t framesInFlight);
+
+	/// @brief Reads back the results slot held, whose frame must have finished, then resets the slot and
+	/// starts timing commandBuffer. Call right after beginning it. Returns true if results were read back.
+	bool BeginFrame(vk::CommandBuffer commandBuffer, uint32_t slot);
+
+	/// @brief Stops timing the command buffer, call right before ending it.
+	void EndFrame(vk::CommandBuffer commandBuffer);
+
+	/// @brief Brackets a pass, outside of render passes. Returns the statistics the pass is counted with, which the secondary
+	/// command buffers it executes have to inherit. Passes of secondary command buffers are only timed without inheritedQueries.
+	vk::QueryPipelineStatisticFlags BeginPass(vk::CommandBuffer commandBuffer, const std::string& name, bool secondary = false);
+	void EndPass(vk::CommandBuffer commandBuffer);
+
+	/// @brief GPU time of the most recent frame read back, 0 before the first.
+	double GetLastFrameMilliseconds() const { return m_LastFrameMilliseconds; }
+
+	/// @brief Returns the stats gathered since the last call.
+	Stats TakeStats();
+private:
+	struct Slot
+	{
+		bool pending = false;
+		std::vector<std::string> passes;
+		uint32_t counted = 0;		// Bit per pass with a statistics query.
+	};
+
+	void CreatePools();
+	void DestroyPools();
+	bool ReadBack(Slot& slot, uint32_t slotIndex);
+	uint32_t GetTimestampBase(uint32_t slot) const { return slot * (2 + 2 * MaxPasses); }
+	double ToMilliseconds(uint64_t begin, uint64_t end) const;
+private:
+	vk::Device m_Device;
+	uint32_t m_FramesInFlight;
+	bool m_WantStatistics;
+	bool m_InheritedQueries;
+
+	vk::QueryPool m_TimestampPool;		// Frame begin and end, then begin and end of each pass, per slot.
+	vk::QueryPool m_StatisticsPool;		// One query per pass, per slot.
+	double m_TimestampPeriod = 1.0;		// Nanoseconds per tick.
+	uint64_t m_TimestampMask = ~0ull;	// Bits the queue family actually writes.
+
+	std::vector<Slot> m_Slots;
+	uint32_t m_CurrentSlot = UINT32_MAX;
+	bool m_PassOpen = false;
+
+	double m_LastFrameMilliseconds = 0.0;
+	Stats m_Window;		// Sums since the last TakeStats.
+};
+
+#endif // !GPU_PROFILER_HPP
\ No newline at end of file
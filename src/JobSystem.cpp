@@ -0,0 +1,332 @@
+#include "JobSystem.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	// Queue owned by the current thread, only valid while t_Owner matches the job system asking.
+	thread_local const JobSystem* t_Owner = nullptr;
+	thread_local uint32_t t_QueueIndex = 0;
+
+	// Rounds spent looking for work before a worker or a waiting thread goes to sleep.
+	constexpr uint32_t IdleSpinCount = 64;
+}
+
+bool JobSystem::WorkQueue::Push(Job* job)
+{
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	if (bottom - top >= Capacity)
+		return false;
+
+	m_Jobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	m_Bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job* JobSystem::WorkQueue::Pop()
+{
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_Top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_Jobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// Last job, race the thieves for it.
+		if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+Job* JobSystem::WorkQueue::Steal()
+{
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+		return nullptr;
+
+	Job* job = m_Jobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+
+	return job;
+}
+
+JobSystem::JobSystem(const JobSystemSettings& settings)
+{
+	uint32_t threadCount = settings.threadCount;
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	for (uint32_t i = 0; i < threadCount + 1; i++)
+		m_Queues.push_back(std::make_unique<WorkQueue>());
+
+	// The creating thread owns queue 0, so jobs it submits skip the shared queue.
+	t_Owner = this;
+	t_QueueIndex = 0;
+
+	m_Workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		m_Workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+		if (settings.pinThreads)
+			PinThread(m_Workers.back(), settings.firstCore + i);
+	}
+
+	CONSOLE_INFO("Job system started with %u worker threads%s.", threadCount, settings.pinThreads ? " (pinned)" : "");
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::scoped_lock lock(m_SleepLock);
+		m_Running = false;
+	}
+	m_WakeUp.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+
+	if (t_Owner == this)
+		t_Owner = nullptr;
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter* counter)
+{
+	if (counter)
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+
+	Submit(new Job{ std::move(function), counter });
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter)
+{
+	if (counter)
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+
+	Job* job = new Job{ std::move(function), counter };
+
+	// Finish takes the same lock after the last decrement, so the job is either parked here or submitted now.
+	{
+		std::scoped_lock lock(dependency.m_Lock);
+		if (!dependency.IsDone())
+		{
+			dependency.m_Continuations.push_back(job);
+			return;
+		}
+	}
+
+	Submit(job);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	uint32_t spin = 0;
+	while (!counter.IsDone())
+	{
+		if (Job* job = FindJob())
+		{
+			Execute(job);
+			spin = 0;
+		}
+		else if (spin++ < IdleSpinCount)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			// Nothing left to help with, sleep like an idle worker until a job is submitted or a counter finishes.
+			std::unique_lock lock(m_SleepLock);
+			m_SleepingWaiters.fetch_add(1);
+			m_WakeUp.wait(lock, [this, &counter]() { return counter.m_Pending.load() == 0 || m_QueuedJobs.load() > 0; });
+			m_SleepingWaiters.fetch_sub(1);
+			spin = 0;
+		}
+	}
+
+	// The thread that finished the last job may still be inside Finish, let it leave before the counter can go away.
+	std::scoped_lock lock(counter.m_Lock);
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& function)
+{
+	if (count == 0)
+		return;
+
+	batchSize = std::max(1u, batchSize);
+	uint32_t batchCount = (count + batchSize - 1) / batchSize;
+
+	// Not worth waking anyone up for a single batch.
+	if (batchCount == 1 || m_Workers.empty())
+	{
+		function(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	for (uint32_t batch = 1; batch < batchCount; batch++)
+	{
+		uint32_t begin = batch * batchSize;
+		uint32_t end = std::min(count, begin + batchSize);
+		Run([&function, begin, end]() { function(begin, end); }, &counter);
+	}
+
+	// The first batch runs here, the rest is either picked up by thieves or popped back by Wait.
+	function(0, std::min(count, batchSize));
+	Wait(counter);
+}
+
+void JobSystem::WorkerLoop(uint32_t queueIndex)
+{
+	t_Owner = this;
+	t_QueueIndex = queueIndex;
+	PROFILE_THREAD("Worker " + std::to_string(queueIndex));
+
+	while (m_Running.load(std::memory_order_relaxed))
+	{
+		Job* job = nullptr;
+		for (uint32_t spin = 0; spin < IdleSpinCount && !job; spin++)
+		{
+			job = FindJob();
+			if (!job)
+				std::this_thread::yield();
+		}
+
+		if (job)
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock lock(m_SleepLock);
+		m_SleepingWorkers.fetch_add(1);
+		m_WakeUp.wait(lock, [this]() { return !m_Running.load() || m_QueuedJobs.load() > 0; });
+		m_SleepingWorkers.fetch_sub(1);
+	}
+}
+
+void JobSystem::Submit(Job* job)
+{
+	bool queued = t_Owner == this && m_Queues[t_QueueIndex]->Push(job);
+	if (!queued)
+	{
+		std::scoped_lock lock(m_SharedJobsLock);
+		m_SharedJobs.push_back(job);
+	}
+
+	// Pairs with the sleeping counts in WorkerLoop and Wait: either the sleeper sees the job or we see the sleeper.
+	m_QueuedJobs.fetch_add(1);
+	if (m_SleepingWorkers.load() > 0 || m_SleepingWaiters.load() > 0)
+	{
+		std::scoped_lock lock(m_SleepLock);
+		m_WakeUp.notify_one();
+	}
+}
+
+Job* JobSystem::FindJob()
+{
+	Job* job = nullptr;
+	const bool ownsQueue = t_Owner == this;
+	const uint32_t queueCount = static_cast<uint32_t>(m_Queues.size());
+
+	if (ownsQueue)
+		job = m_Queues[t_QueueIndex]->Pop();
+
+	if (!job)
+	{
+		std::scoped_lock lock(m_SharedJobsLock);
+		if (!m_SharedJobs.empty())
+		{
+			job = m_SharedJobs.front();
+			m_SharedJobs.pop_front();
+		}
+	}
+
+	// Steal from the others, starting next to our own queue so thieves spread out.
+	uint32_t start = ownsQueue ? t_QueueIndex + 1 : 0;
+	for (uint32_t i = 0; i < queueCount && !job; i++)
+	{
+		uint32_t victim = (start + i) % queueCount;
+		if (!ownsQueue || victim != t_QueueIndex)
+			job = m_Queues[victim]->Steal();
+	}
+
+	if (job)
+		m_QueuedJobs.fetch_sub(1);
+
+	return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->function();
+
+	if (job->counter)
+		Finish(*job->counter);
+
+	delete job;
+}
+
+void JobSystem::Finish(JobCounter& counter)
+{
+	std::vector<Job*> continuations;
+	bool done = false;
+	{
+		std::scoped_lock lock(counter.m_Lock);
+		if (counter.m_Pending.fetch_sub(1) == 1)
+		{
+			continuations.swap(counter.m_Continuations);
+			done = true;
+		}
+	}
+
+	for (Job* continuation : continuations)
+		Submit(continuation);
+
+	// The counter may be gone once a waiter sees it done, only the job system is touched from here on. Pairs with the
+	// waiting count in Wait like Submit does.
+	if (done && m_SleepingWaiters.load() > 0)
+	{
+		std::scoped_lock lock(m_SleepLock);
+		m_WakeUp.notify_all();
+	}
+}
+
+void JobSystem::PinThread(std::thread& thread, uint32_t core)
+{
+	uint32_t coreCount = std::max(1u, std::thread::hardware_concurrency());
+	core %= coreCount;
+
+#if defined(_WIN32)
+	if (core < 64 && !SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << core))
+		CONSOLE_WARN("Failed to pin worker thread to core %u.", core);
+#elif defined(__linux__)
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(core, &cpuSet);
+	if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuSet) != 0)
+		CONSOLE_WARN("Failed to pin worker thread to core %u.", core);
+#else
+	CONSOLE_WARN("Thread affinity is not supported on this platform, worker for core %u is not pinned.", core);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include "Config.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class JobCounter;
+
+struct Job
+{
+	std::function<void()> function;
+	JobCounter* counter;
+};
+
+// Counts the unfinished jobs of a group. Other threads wait on it through JobSystem::Wait,
+// jobs queued with JobSystem::RunAfter start once it reaches zero.
+// A counter must outlive its jobs, only destroy it after JobSystem::Wait has returned.
+class JobCounter
+{
+public:
+	bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+private:
+	friend class JobSystem;
+	std::atomic<uint32_t> m_Pending{ 0 };
+	std::mutex m_Lock;
+	std::vector<Job*> m_Continuations;
+};
+
+struct JobSystemSettings
+{
+	uint32_t threadCount = 0;		// Worker threads, 0 uses one per hardware thread minus the main thread.
+	bool pinThreads = false;		// Pin worker i to core firstCore + i.
+	uint32_t firstCore = 1;			// Core 0 is left to the main thread.
+};
+
+// Work-stealing job system. Every worker (and the thread that created the system) owns a deque,
+// pushes and pops its own jobs at the bottom and steals from the top of the others when it runs dry.
+class JobSystem
+{
+public:
+	JobSystem(const JobSystemSettings& settings = JobSystemSettings());
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem();
+
+	/// @brief Queues function. counter, if given, stays non-zero until the job has finished.
+	void Run(std::function<void()> function, JobCounter* counter = nullptr);
+
+	/// @brief Queues function to run once every job counted by dependency has finished.
+	void RunAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr);
+
+	/// @brief Runs other jobs on the calling thread until counter reaches zero.
+	void Wait(JobCounter& counter);
+
+	/// @brief Calls function(begin, end) over [0, count) in batches of batchSize, on the workers and the calling thread.
+	/// Returns once every batch has finished.
+	void ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& function);
+
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+private:
+	// Chase-Lev deque of fixed capacity. Only the owning thread calls Push and Pop, any thread may Steal.
+	class WorkQueue
+	{
+	public:
+		static constexpr int64_t Capacity = 4096;
+
+		bool Push(Job* job);
+		Job* Pop();
+		Job* Steal();
+	private:
+		alignas(64) std::atomic<int64_t> m_Top{ 0 };
+		alignas(64) std::atomic<int64_t> m_Bottom{ 0 };
+		std::array<std::atomic<Job*>, Capacity> m_Jobs{};
+	};
+
+	void WorkerLoop(uint32_t queueIndex);
+	void Submit(Job* job);
+	Job* FindJob();
+	void Execute(Job* job);
+	void Finish(JobCounter& counter);
+	void PinThread(std::thread& thread, uint32_t core);
+private:
+	std::vector<std::thread> m_Workers;
+
+	// Queue 0 belongs to the thread that created the job system, queue i + 1 to worker i.
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+
+	// Jobs submitted from threads that own no queue.
+	std::deque<Job*> m_SharedJobs;
+	std::mutex m_SharedJobsLock;
+
+	// Idle workers sleep here until new jobs are submitted, threads in Wait with nothing to run until a counter finishes.
+	std::atomic<uint32_t> m_QueuedJobs{ 0 };
+	std::atomic<uint32_t> m_SleepingWorkers{ 0 };
+	std::atomic<uint32_t> m_SleepingWaiters{ 0 };
+	std::mutex m_SleepLock;
+	std::condition_variable m_WakeUp;
+	std::atomic<bool> m_Running{ true };
+};
+
+#endif // !JOB_SYSTEM_HPP
\ No newline at end of file
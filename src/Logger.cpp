@@ -1,5 +1,7 @@
 #include "Logger.hpp"
 
+#include <algorithm>
+
 std::shared_ptr<Logger> Logger::s_Logger = std::make_shared<Logger>();
 
 const char* Logger::NormalColorCode = "\x1B[0m";
@@ -8,10 +10,240 @@ const char* Logger::GreenColorCode = "\x1B[32m";
 const char* Logger::YellowColorCode = "\x1B[33m";
 const char* Logger::RedColorCode = "\x1B[31m";
 
-Logger::Logger() : m_Priority(Logger::Priority::DebugPriority), m_InitialString(""), m_FilePath(nullptr), m_File(nullptr),
-    m_TimeBuffer(), m_TimestampFormat("[%T]") {}
+namespace
+{
+    // Ring of the current thread, only valid while t_RingOwner matches the logger asking.
+    thread_local const Logger* t_RingOwner = nullptr;
+    thread_local void* t_Ring = nullptr;
+
+    // How long the writer sleeps between batches unless it is woken up.
+    constexpr std::chrono::milliseconds WriteInterval(5);
+}
+
+uint8_t* Logger::Ring::Reserve(uint32_t size)
+{
+    uint64_t head = m_Head.load(std::memory_order_relaxed);
+    uint64_t tail = m_Tail.load(std::memory_order_acquire);
+    uint32_t offset = static_cast<uint32_t>(head % Capacity);
+
+    // Records never wrap, the end of the ring is skipped with a padding record instead.
+    uint32_t padding = offset + size > Capacity ? Capacity - offset : 0;
+    if (Capacity - (head - tail) < padding + size)
+        return nullptr;
+
+    if (padding)
+    {
+        RecordHeader* header = GetRecord(head);
+        header->size = padding;
+        header->flags = PaddingRecord;
+        head += padding;
+    }
+
+    m_Pending = head + size;
+    return m_Data.get() + head % Capacity;
+}
+
+void Logger::Ring::Commit()
+{
+    m_Head.store(m_Pending, std::memory_order_release);
+}
+
+Logger::Logger() : m_Priority(Logger::Priority::DebugPriority), m_InitialString(""), m_TimestampFormat("[%T]"), m_FilePath(nullptr),
+    m_File(nullptr), m_TimeBuffer()
+{
+    m_Writer = std::thread(&Logger::WriterLoop, this);
+}
+
+Logger::~Logger()
+{
+    {
+        std::scoped_lock lock(m_WakeLock);
+        m_Running = false;
+    }
+    m_WakeUp.notify_one();
+    m_Writer.join();
+
+    if (t_RingOwner == this)
+        t_RingOwner = nullptr;
+
+    std::fflush(stdout);
+    std::scoped_lock lock(m_FileLock);
+    FreeFile();
+}
+
+uint64_t Logger::GetDroppedCount() const
+{
+    std::scoped_lock lock(m_RingsLock);
+
+    uint64_t dropped = 0;
+    for (const std::unique_ptr<Ring>& ring : m_Rings)
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+
+    return dropped;
+}
+
+void Logger::Flush()
+{
+    std::unique_lock lock(m_WakeLock);
+    uint64_t request = ++m_FlushRequests;
+    m_WakeUp.notify_one();
+    m_Flushed.wait(lock, [&]() { return m_FlushesDone >= request; });
+}
+
+Logger::Ring& Logger::GetThreadRing()
+{
+    if (t_RingOwner != this)
+    {
+        std::scoped_lock lock(m_RingsLock);
+        m_Rings.push_back(std::make_unique<Ring>());
+        t_Ring = m_Rings.back().get();
+        t_RingOwner = this;
+    }
+
+    return *static_cast<Ring*>(t_Ring);
+}
+
+void Logger::WriterLoop()
+{
+    while (true)
+    {
+        uint64_t flushRequests;
+        bool running;
+        {
+            std::unique_lock lock(m_WakeLock);
+            if (m_Running && m_FlushRequests == m_FlushesDone)
+                m_WakeUp.wait_for(lock, WriteInterval);
+
+            flushRequests = m_FlushRequests;
+            running = m_Running;
+        }
+
+        // Everything committed before the flush request was taken is written by this pass.
+        while (WriteBatch() && !running) {}
+
+        {
+            std::scoped_lock lock(m_WakeLock);
+            m_FlushesDone = flushRequests;
+        }
+        m_Flushed.notify_all();
+
+        if (!running)
+            break;
+    }
+}
+
+bool Logger::WriteBatch()
+{
+    std::vector<std::pair<Ring*, uint64_t>> rings;
+    {
+        std::scoped_lock lock(m_RingsLock);
+        rings.reserve(m_Rings.size());
+        for (const std::unique_ptr<Ring>& ring : m_Rings)
+            rings.emplace_back(ring.get(), ring->GetHead());
+    }
+
+    m_Batch.clear();
+    uint64_t dropped = 0;
+    for (auto [ring, head] : rings)
+    {
+        for (uint64_t position = ring->GetTail(); position < head;)
+        {
+            RecordHeader* record = ring->GetRecord(position);
+            if (!(record->flags & PaddingRecord))
+                m_Batch.push_back(record);
+            position += record->size;
+        }
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+
+    // Threads log into separate rings, merge them back into the order the messages were made in.
+    std::stable_sort(m_Batch.begin(), m_Batch.end(), [](const RecordHeader* a, const RecordHeader* b)
+    {
+        return a->timestamp < b->timestamp;
+    });
+
+    m_ConsoleOutput.clear();
+    m_FileOutput.clear();
+    bool writeFile;
+    {
+        std::scoped_lock lock(m_FileLock);
+        writeFile = m_File != nullptr;
+    }
+    const char* initialString = m_InitialString;
+    const char* timestampFormat = m_TimestampFormat;
+
+    for (RecordHeader* record : m_Batch)
+    {
+        if (m_Message.empty())
+            m_Message.resize(256);
+
+        const uint8_t* payload = reinterpret_cast<const uint8_t*>(record) + sizeof(RecordHeader);
+        int length = record->formatter(m_Message.data(), m_Message.size(), record->format, payload);
+        if (length >= static_cast<int>(m_Message.size()))
+        {
+            m_Message.resize(length + 1);
+            length = record->formatter(m_Message.data(), m_Message.size(), record->format, payload);
+        }
+        length = std::max(length, 0);
+
+        if (record->flags & PlainRecord)
+        {
+            m_ConsoleOutput.append(m_Message.data(), length).push_back('\n');
+            if (writeFile)
+                m_FileOutput.append(m_Message.data(), length).push_back('\n');
+            continue;
+        }
+
+        // Most records of a batch share their second, only format the time once per second.
+        std::chrono::system_clock::time_point time{ std::chrono::system_clock::duration(record->timestamp) };
+        std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+        if (seconds != m_TimeBufferSecond || timestampFormat != m_TimeBufferFormat)
+        {
+            std::strftime(m_TimeBuffer, sizeof(m_TimeBuffer), timestampFormat, std::localtime(&seconds));
+            m_TimeBufferSecond = seconds;
+            m_TimeBufferFormat = timestampFormat;
+        }
+
+        Priority priority = static_cast<Priority>(record->priority);
+        const char* priorityString = MessagePriorityToString(priority);
+        m_ConsoleOutput.append(GetColor(priority)).append(m_TimeBuffer).append(" ").append(priorityString).append(initialString)
+            .append(m_Message.data(), length).append("\n").append(NormalColorCode);
+
+        if (writeFile)
+            m_FileOutput.append(m_TimeBuffer).append(" ").append(priorityString).append(initialString)
+                .append(m_Message.data(), length).append("\n");
+    }
+
+    if (dropped != m_ReportedDrops)
+    {
+        char report[96];
+        int length = std::snprintf(report, sizeof(report), "%llu log messages dropped, the log rings were full.",
+            static_cast<unsigned long long>(dropped - m_ReportedDrops));
+        m_ConsoleOutput.append(YellowColorCode).append(report, length).append("\n").append(NormalColorCode);
+        if (writeFile)
+            m_FileOutput.append(report, length).append("\n");
+        m_ReportedDrops = dropped;
+    }
+
+    if (!m_ConsoleOutput.empty())
+    {
+        std::fwrite(m_ConsoleOutput.data(), 1, m_ConsoleOutput.size(), stdout);
+        std::fflush(stdout);
+    }
 
-Logger::~Logger() { FreeFile(); }
+    if (!m_FileOutput.empty())
+    {
+        std::scoped_lock lock(m_FileLock);
+        if (m_File)
+            std::fwrite(m_FileOutput.data(), 1, m_FileOutput.size(), m_File);
+    }
+
+    // Hand the space back to the producers only after the records have been formatted.
+    for (auto [ring, head] : rings)
+        ring->SetTail(head);
+
+    return !m_Batch.empty();
+}
 
 void Logger::FreeFile()
 {
@@ -47,7 +279,7 @@ const char* Logger::MessagePriorityToString(Priority messagePriority)
     return priorityString;
 }
 
-void Logger::SetColor(Priority messagePriority)
+const char* Logger::GetColor(Priority messagePriority)
 {
     const char* color;
     switch (messagePriority)
@@ -60,5 +292,5 @@ void Logger::SetColor(Priority messagePriority)
     default: color = NormalColorCode; break;
     }
 
-    std::printf("%s", color);
+    return color;
 }
\ No newline at end of file
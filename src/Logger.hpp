@@ -1,4 +1,6 @@
 // A Simple Thread-safe logger with color coding & output to file options.
+// Producers only copy the format pointer, a timestamp and the raw arguments into a per-thread lock-free ring,
+// a background thread formats and writes the records in batches.
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
@@ -7,10 +9,116 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
-#include <mutex>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Lowest priority compiled in, calls below it compile to nothing. Debug builds keep everything,
+// release builds keep Info and above. Override with -DLOG_MIN_PRIORITY=<0..5>, 5 removes all logging.
+#ifndef LOG_MIN_PRIORITY
+    #ifndef NDEBUG
+        #define LOG_MIN_PRIORITY 0
+    #else
+        #define LOG_MIN_PRIORITY 2
+    #endif
+#endif
+
+namespace LogDetail
+{
+    // Strings are copied behind the arguments, the argument tuple only keeps their offset.
+    struct StringOffset
+    {
+        uint32_t offset;
+    };
+
+    // Longer strings are cut off, so a single record always fits into a ring.
+    constexpr uint32_t MaxStringLength = 1024;
+
+    template<typename T> struct Encode { using Type = T; };
+    template<> struct Encode<const char*> { using Type = StringOffset; };
+    template<> struct Encode<char*> { using Type = StringOffset; };
+
+    template<typename T>
+    using EncodedType = typename Encode<std::decay_t<T>>::Type;
+
+    inline uint32_t StringBytes(const char* value)
+    {
+        size_t length = value ? strnlen(value, MaxStringLength) : 6;
+        return static_cast<uint32_t>(length) + 1;
+    }
+
+    template<typename T>
+    uint32_t ArgumentBytes(const T& value)
+    {
+        if constexpr (std::is_same_v<EncodedType<T>, StringOffset>)
+            return StringBytes(value);
+        else
+            return 0;
+    }
+
+    template<typename T>
+    EncodedType<T> EncodeArgument(const T& value, uint8_t* payload, uint32_t& cursor)
+    {
+        if constexpr (std::is_same_v<EncodedType<T>, StringOffset>)
+        {
+            const char* string = value;
+            uint32_t bytes = StringBytes(string);
+            if (!string)
+                string = "(null)";
+            std::memcpy(payload + cursor, string, bytes - 1);
+            payload[cursor + bytes - 1] = '\0';
+
+            StringOffset offset{ cursor };
+            cursor += bytes;
+            return offset;
+        }
+        else
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "Log arguments are copied as raw bytes.");
+            return value;
+        }
+    }
+
+    template<typename T>
+    const T& DecodeArgument(const T& value, const uint8_t*) { return value; }
+
+    inline const char* DecodeArgument(const StringOffset& value, const uint8_t* payload)
+    {
+        return reinterpret_cast<const char*>(payload + value.offset);
+    }
+
+    // Formats a record whose payload holds a std::tuple<Encoded...> followed by its strings.
+    using FormatFunction = int(*)(char* buffer, size_t size, const char* format, const uint8_t* payload);
+
+    template<typename... Encoded>
+    int FormatRecord(char* buffer, size_t size, const char* format, const uint8_t* payload)
+    {
+        const std::tuple<Encoded...>& arguments = *reinterpret_cast<const std::tuple<Encoded...>*>(payload);
+        return std::apply([&](const auto&... argument)
+        {
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-security"
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+            return std::snprintf(buffer, size, format, DecodeArgument(argument, payload)...);
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+        }, arguments);
+    }
+}
 
 class Logger
 {
@@ -29,6 +137,12 @@ public:
         TracePriority, DebugPriority, InfoPriority, WarnPriority, ErrorPriority
     };
 
+    /// @brief What a thread does when its ring is full. Errors always block.
+    enum OverflowPolicy
+    {
+        DropOnOverflow, BlockOnOverflow
+    };
+
     /// @brief Set The Priority to the given value.
     /// @param priority: new priority
     void SetPriority(Priority priority) { m_Priority = priority; }
@@ -36,6 +150,12 @@ public:
     /// @brief Returns the Current Priority.
     const Priority GetPriority() const { return m_Priority; }
 
+    void SetOverflowPolicy(OverflowPolicy policy) { m_OverflowPolicy = policy; }
+    OverflowPolicy GetOverflowPolicy() const { return m_OverflowPolicy; }
+
+    // Messages lost to full rings since startup.
+    uint64_t GetDroppedCount() const;
+
     // By setting this to the given string, this string will be printed every line after the time stamp and message priority.
     void SetInitialString(const char* initialString) { m_InitialString = initialString; }
 
@@ -51,8 +171,7 @@ public:
     /// @return Returns true if file was successfully opened.
     bool OutputToFile()
     {
-        m_FilePath = "log.txt";
-        return EnableFileOutput();
+        return OutputToFile("log.txt");
     }
 
     // Enable file output
@@ -62,6 +181,7 @@ public:
     // Returns true if a file was successfully opened, false otherwise
     bool OutputToFile(const char* filepath)
     {
+        std::scoped_lock lock(m_FileLock);
         m_FilePath = filepath;
         return EnableFileOutput();
     }
@@ -78,11 +198,12 @@ public:
     // Just prints a new line.
     void NewLine()
     {
-        std::printf("\n");
-        if (m_File)
-            std::fprintf(m_File, "\n");
+        Log<true>(InfoPriority, "");
     }
 
+    /// @brief Blocks until everything logged before the call has been written.
+    void Flush();
+
     // Log a message (format + optional args, follow printf specification)
     // with log priority level Log::Trace
     template<typename... Args>
@@ -124,54 +245,137 @@ public:
     }
 
 private:
-    void FreeFile();
-    bool EnableFileOutput();
-
-    const char* MessagePriorityToString(Priority messagePriority);
+    // Fixed part of every record in a ring, followed by the arguments.
+    struct alignas(16) RecordHeader
+    {
+        uint32_t size;          // Bytes including the header, a multiple of the alignment.
+        uint8_t priority;
+        uint8_t flags;
+        int64_t timestamp;      // System clock ticks.
+        const char* format;
+        LogDetail::FormatFunction formatter;
+    };
 
-    void SetColor(Priority messagePriority);
+    static constexpr uint8_t PaddingRecord = 1;     // Fills the end of the ring when a record does not fit there.
+    static constexpr uint8_t PlainRecord = 2;       // Written without timestamp, priority or color.
 
-    template<typename... Args>
-    void Log(Priority messagePriority, const char* message, Args&& ... args)
+    // Single producer, single consumer byte ring owned by one logging thread.
+    class Ring
     {
-        if (m_Priority <= messagePriority)
-        {
-            std::time_t currentTime = std::time(0);
-            std::tm* timestamp = std::localtime(&currentTime);
+    public:
+        static constexpr uint32_t Capacity = 1 << 16;
+
+        Ring() : m_Data(new uint8_t[Capacity]) {}
+
+        /// @brief Space for size contiguous bytes, or null when the consumer has not caught up. Producer only.
+        uint8_t* Reserve(uint32_t size);
+        void Commit();
+
+        /// @brief Consumer side, records in [tail, head) are complete.
+        uint64_t GetHead() const { return m_Head.load(std::memory_order_acquire); }
+        uint64_t GetTail() const { return m_Tail.load(std::memory_order_relaxed); }
+        void SetTail(uint64_t tail) { m_Tail.store(tail, std::memory_order_release); }
+        RecordHeader* GetRecord(uint64_t position) { return reinterpret_cast<RecordHeader*>(m_Data.get() + position % Capacity); }
+
+        std::atomic<uint64_t> dropped{ 0 };
+    private:
+        alignas(64) std::atomic<uint64_t> m_Head{ 0 };
+        alignas(64) std::atomic<uint64_t> m_Tail{ 0 };
+        uint64_t m_Pending = 0;
+        std::unique_ptr<uint8_t[]> m_Data;
+    };
 
-            std::scoped_lock lock(m_LogLock);
+    template<bool Plain = false, typename... Args>
+    void Log(Priority messagePriority, const char* message, const Args& ... args)
+    {
+        if (!Plain && m_Priority.load(std::memory_order_relaxed) > messagePriority)
+            return;
 
-            SetColor(messagePriority);
-            std::strftime(m_TimeBuffer, 80, m_TimestampFormat, timestamp);
-            std::printf("%s ", m_TimeBuffer);
+        using Arguments = std::tuple<LogDetail::EncodedType<Args>...>;
+        uint32_t size = sizeof(RecordHeader) + sizeof(Arguments);
+        ((size += LogDetail::ArgumentBytes(args)), ...);
+        size = (size + alignof(RecordHeader) - 1) & ~uint32_t(alignof(RecordHeader) - 1);
 
-            const char* messagePriorityString = MessagePriorityToString(messagePriority);
-            std::printf("%s", messagePriorityString);
-            std::printf("%s", m_InitialString);
-            std::printf(message, args...);
-            std::printf("\n");
+        Ring& ring = GetThreadRing();
+        uint8_t* memory = ring.Reserve(size);
+        if (!memory)
+        {
+            if (m_OverflowPolicy.load(std::memory_order_relaxed) == DropOnOverflow && messagePriority != ErrorPriority)
+            {
+                ring.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
 
-            std::printf("%s", NormalColorCode);
+            // A record larger than the whole ring can never be written.
+            if (size > Ring::Capacity)
+            {
+                ring.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
 
-            if (m_File)
+            while (!(memory = ring.Reserve(size)))
             {
-                std::fprintf(m_File, "%s ", m_TimeBuffer);
-                std::fprintf(m_File, "%s", messagePriorityString);
-                std::fprintf(m_File, "%s", m_InitialString);
-                std::fprintf(m_File, message, args...);
-                std::fprintf(m_File, "\n");
+                m_WakeUp.notify_one();
+                std::this_thread::yield();
             }
         }
+
+        RecordHeader* header = new (memory) RecordHeader();
+        header->size = size;
+        header->priority = static_cast<uint8_t>(messagePriority);
+        header->flags = Plain ? PlainRecord : 0;
+        header->timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+        header->format = message;
+        header->formatter = &LogDetail::FormatRecord<LogDetail::EncodedType<Args>...>;
+
+        uint8_t* payload = memory + sizeof(RecordHeader);
+        [[maybe_unused]] uint32_t cursor = sizeof(Arguments);
+        new (payload) Arguments{ LogDetail::EncodeArgument(args, payload, cursor)... };
+        ring.Commit();
+
+        if (messagePriority == ErrorPriority)
+            m_WakeUp.notify_one();
     }
 
+    Ring& GetThreadRing();
+    void WriterLoop();
+    bool WriteBatch();
+    void FreeFile();
+    bool EnableFileOutput();
+
+    const char* MessagePriorityToString(Priority messagePriority);
+
+    const char* GetColor(Priority messagePriority);
+
 private:
-    Priority m_Priority;
-    std::mutex m_LogLock;
-    const char* m_InitialString;
-    char m_TimeBuffer[80];
-    const char* m_TimestampFormat;
+    std::atomic<Priority> m_Priority;
+    std::atomic<OverflowPolicy> m_OverflowPolicy{ DropOnOverflow };
+    std::atomic<const char*> m_InitialString;
+    std::atomic<const char*> m_TimestampFormat;
     const char* m_FilePath;
     FILE* m_File;
+    std::mutex m_FileLock;
+
+    // One ring per thread that ever logged, they live as long as the logger.
+    std::vector<std::unique_ptr<Ring>> m_Rings;
+    mutable std::mutex m_RingsLock;
+
+    // Background writer, polls the rings and is woken early for errors, blocked producers and flushes.
+    std::thread m_Writer;
+    std::atomic<bool> m_Running{ true };
+    std::mutex m_WakeLock;
+    std::condition_variable m_WakeUp;
+    std::condition_variable m_Flushed;
+    uint64_t m_FlushRequests = 0, m_FlushesDone = 0;
+
+    // Writer thread state.
+    std::vector<RecordHeader*> m_Batch;
+    std::vector<char> m_Message;
+    std::string m_ConsoleOutput, m_FileOutput;
+    char m_TimeBuffer[80];
+    int64_t m_TimeBufferSecond = -1;
+    const char* m_TimeBufferFormat = nullptr;
+    uint64_t m_ReportedDrops = 0;
 
     static std::shared_ptr<Logger> s_Logger;
 
@@ -183,20 +387,40 @@ private:
 
 };
 
-#ifndef NDEBUG
+#if LOG_MIN_PRIORITY <= 2
     #define CONSOLE_NEWLINE() Logger::GetLogger()->NewLine()
+#else
+    #define CONSOLE_NEWLINE() ((void)0)
+#endif
+
+#if LOG_MIN_PRIORITY <= 0
     #define CONSOLE_TRACE(...) Logger::GetLogger()->Trace(__VA_ARGS__)
+#else
+    #define CONSOLE_TRACE(...) ((void)0)
+#endif
+
+#if LOG_MIN_PRIORITY <= 1
     #define CONSOLE_DEBUG(...) Logger::GetLogger()->Debug(__VA_ARGS__)
+#else
+    #define CONSOLE_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_MIN_PRIORITY <= 2
     #define CONSOLE_INFO(...)  Logger::GetLogger()->Info(__VA_ARGS__)
+#else
+    #define CONSOLE_INFO(...) ((void)0)
+#endif
+
+#if LOG_MIN_PRIORITY <= 3
     #define CONSOLE_WARN(...)  Logger::GetLogger()->Warn(__VA_ARGS__)
+#else
+    #define CONSOLE_WARN(...) ((void)0)
+#endif
+
+#if LOG_MIN_PRIORITY <= 4
     #define CONSOLE_ERROR(...) Logger::GetLogger()->Error(__VA_ARGS__)
 #else
-    #define CONSOLE_NEWLINE()
-    #define CONSOLE_TRACE(...) 
-    #define CONSOLE_DEBUG(...) 
-    #define CONSOLE_INFO(...) 
-    #define CONSOLE_WARN(...) 
-    #define CONSOLE_ERROR(...)  
+    #define CONSOLE_ERROR(...) ((void)0)
 #endif
 
 #endif // !LOG_HPP
\ No newline at end of file
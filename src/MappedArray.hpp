@@ -0,0 +1,104 @@
+#ifndef MAPPED_ARRAY_HPP
+#define MAPPED_ARRAY_HPP
+
+#include <utility>
+#include <vector>
+
+// Array that either owns its elements or views memory owned by someone else, such as a section of a mapped scene file.
+// Writes through a view go straight to the viewed memory, anything that changes the size copies the elements into
+// owned storage first.
+template<typename T>
+class MappedArray
+{
+public:
+	MappedArray() = default;
+	MappedArray(const MappedArray& other) : m_Owned(other.m_Owned), m_Viewing(other.m_Viewing)
+	{
+		if (m_Viewing)
+		{
+			m_Data = other.m_Data;
+			m_Size = other.m_Size;
+		}
+		else
+			Sync();
+	}
+	MappedArray& operator=(const MappedArray& other)
+	{
+		if (this != &other)
+		{
+			MappedArray copy(other);
+			*this = std::move(copy);
+		}
+		return *this;
+	}
+	MappedArray(MappedArray&& other) noexcept { *this = std::move(other); }
+	MappedArray& operator=(MappedArray&& other) noexcept
+	{
+		m_Owned = std::move(other.m_Owned);
+		m_Data = other.m_Data;
+		m_Size = other.m_Size;
+		m_Viewing = other.m_Viewing;
+		other.m_Data = nullptr;
+		other.m_Size = 0;
+		other.m_Viewing = false;
+		return *this;
+	}
+
+	/// @brief Views count elements at data, which must outlive the array or the next call that changes its size.
+	void View(T* data, size_t count)
+	{
+		m_Owned = std::vector<T>();
+		m_Data = data;
+		m_Size = count;
+		m_Viewing = true;
+	}
+	bool IsView() const { return m_Viewing; }
+
+	void push_back(const T& value) { Own(); m_Owned.push_back(value); Sync(); }
+	void reserve(size_t count) { Own(); m_Owned.reserve(count); Sync(); }
+	void clear() { m_Owned.clear(); m_Viewing = false; Sync(); }
+
+	// Keeps a view of the right size, so callers can resize every frame without copying it.
+	void resize(size_t count)
+	{
+		if (count == m_Size)
+			return;
+		Own();
+		m_Owned.resize(count);
+		Sync();
+	}
+
+	T& operator[](size_t index) { return m_Data[index]; }
+	const T& operator[](size_t index) const { return m_Data[index]; }
+
+	T* data() { return m_Data; }
+	const T* data() const { return m_Data; }
+	size_t size() const { return m_Size; }
+	bool empty() const { return m_Size == 0; }
+
+	T* begin() { return m_Data; }
+	T* end() { return m_Data + m_Size; }
+	const T* begin() const { return m_Data; }
+	const T* end() const { return m_Data + m_Size; }
+private:
+	void Own()
+	{
+		if (!m_Viewing)
+			return;
+		m_Owned.assign(m_Data, m_Data + m_Size);
+		m_Viewing = false;
+	}
+
+	void Sync()
+	{
+		m_Data = m_Owned.data();
+		m_Size = m_Owned.size();
+	}
+private:
+	std::vector<T> m_Owned;
+	T* m_Data = nullptr;
+	size_t m_Size = 0;
+	bool m_Viewing = false;
+};
+
+#endif // !MAPPED_ARRAY_HPP
\ No newline at end of file
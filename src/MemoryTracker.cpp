@@ -0,0 +1,250 @@
+#include "MemoryTracker.hpp"
+
+#include <algorithm>
+
+MemoryTracker MemoryTracker::s_Tracker;
+
+namespace
+{
+	// Without the driver's budget, leave room for other processes and for what the driver allocates itself.
+	constexpr float HeapBudgetFraction = 0.8f;
+
+	double Megabytes(vk::DeviceSize bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+void MemoryTracker::Initialize(vk::PhysicalDevice physicalDevice, bool memoryBudget)
+{
+	std::scoped_lock lock(m_Lock);
+	m_PhysicalDevice = physicalDevice;
+	m_MemoryProperties = physicalDevice.getMemoryProperties();
+	m_DriverBudget = memoryBudget;
+
+	m_Heaps.assign(m_MemoryProperties.memoryHeapCount, HeapStats{});
+	for (uint32_t heap = 0; heap < m_MemoryProperties.memoryHeapCount; heap++)
+	{
+		m_Heaps[heap].size = m_MemoryProperties.memoryHeaps[heap].size;
+		m_Heaps[heap].deviceLocal = static_cast<bool>(m_MemoryProperties.memoryHeaps[heap].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+	}
+
+	QueryBudget();
+	CONSOLE_INFO("Memory budget %s.", m_DriverBudget ? "reported by VK_EXT_memory_budget" : "estimated from the heap sizes");
+}
+
+void MemoryTracker::SetSoftBudget(float fraction)
+{
+	std::scoped_lock lock(m_Lock);
+	m_SoftBudget = std::clamp(fraction, 0.0f, 1.0f);
+}
+
+uint32_t MemoryTracker::AddBudgetCallback(BudgetCallback callback)
+{
+	std::scoped_lock lock(m_Lock);
+	m_Callbacks.emplace_back(m_NextCallback, std::move(callback));
+	return m_NextCallback++;
+}
+
+void MemoryTracker::RemoveBudgetCallback(uint32_t id)
+{
+	std::scoped_lock lock(m_Lock);
+	m_Callbacks.erase(std::remove_if(m_Callbacks.begin(), m_Callbacks.end(),
+		[id](const std::pair<uint32_t, BudgetCallback>& callback) { return callback.first == id; }), m_Callbacks.end());
+}
+
+void MemoryTracker::OnAllocate(vk::DeviceMemory memory, vk::DeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category, const char* name)
+{
+	if (!memory)
+		return;
+
+	std::vector<std::pair<uint32_t, vk::DeviceSize>> overBudget;
+	{
+		std::scoped_lock lock(m_Lock);
+		if (m_Heaps.empty())
+			return;
+
+		uint32_t heap = m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		m_Allocations[memory] = Allocation{ size, heap, category, name };
+
+		HeapStats& heapStats = m_Heaps[heap];
+		heapStats.tracked += size;
+		heapStats.usage += size;
+		heapStats.peak = std::max(heapStats.peak, heapStats.tracked);
+
+		CategoryStats& stats = m_Categories[static_cast<size_t>(category)];
+		stats.bytes += size;
+		stats.allocations++;
+		stats.totalAllocations++;
+		stats.peakBytes = std::max(stats.peakBytes, stats.bytes);
+		stats.peakAllocations = std::max(stats.peakAllocations, stats.allocations);
+
+		if (heapStats.usage > GetSoftBudget(heap))
+			overBudget.emplace_back(heap, heapStats.usage);
+	}
+
+	// Outside the lock, callbacks are expected to free memory.
+	NotifyOverBudget(overBudget);
+}
+
+void MemoryTracker::OnFree(vk::DeviceMemory memory)
+{
+	if (!memory)
+		return;
+
+	std::scoped_lock lock(m_Lock);
+	auto found = m_Allocations.find(memory);
+	if (found == m_Allocations.end())
+		return;
+
+	const Allocation& allocation = found->second;
+	HeapStats& heapStats = m_Heaps[allocation.heap];
+	heapStats.tracked -= allocation.size;
+	heapStats.usage -= std::min(heapStats.usage, allocation.size);
+
+	CategoryStats& stats = m_Categories[static_cast<size_t>(allocation.category)];
+	stats.bytes -= allocation.size;
+	stats.allocations--;
+
+	m_Allocations.erase(found);
+}
+
+void MemoryTracker::Update()
+{
+	std::vector<std::pair<uint32_t, vk::DeviceSize>> overBudget;
+	{
+		std::scoped_lock lock(m_Lock);
+		if (m_Heaps.empty())
+			return;
+
+		QueryBudget();
+		CollectOverBudget(overBudget);
+	}
+
+	NotifyOverBudget(overBudget);
+}
+
+bool MemoryTracker::FitsBudget(vk::DeviceSize size, uint32_t memoryTypeIndex)
+{
+	std::scoped_lock lock(m_Lock);
+	if (m_Heaps.empty() || memoryTypeIndex >= m_MemoryProperties.memoryTypeCount)
+		return true;
+
+	uint32_t heap = m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	return m_Heaps[heap].usage + size <= GetSoftBudget(heap);
+}
+
+MemoryTracker::Report MemoryTracker::GetReport()
+{
+	std::scoped_lock lock(m_Lock);
+
+	Report report;
+	report.driverBudget = m_DriverBudget;
+	report.heaps = m_Heaps;
+	report.categories = m_Categories;
+
+	return report;
+}
+
+void MemoryTracker::LogReport()
+{
+	Report report = GetReport();
+
+	for (uint32_t heap = 0; heap < report.heaps.size(); heap++)
+	{
+		const HeapStats& stats = report.heaps[heap];
+		CONSOLE_INFO("Heap %u (%s): %.1f of %.1f MB budget used, %.1f MB tracked (peak %.1f MB), %.1f MB heap.", heap,
+			stats.deviceLocal ? "device local" : "host", Megabytes(stats.usage), Megabytes(stats.budget), Megabytes(stats.tracked),
+			Megabytes(stats.peak), Megabytes(stats.size));
+	}
+
+	for (size_t category = 0; category < report.categories.size(); category++)
+	{
+		const CategoryStats& stats = report.categories[category];
+		CONSOLE_INFO("%s: %.2f MB in %u allocations (peak %.2f MB in %u), %llu allocated in total.", GetCategoryName(static_cast<MemoryCategory>(category)),
+			Megabytes(stats.bytes), stats.allocations, Megabytes(stats.peakBytes), stats.peakAllocations,
+			static_cast<unsigned long long>(stats.totalAllocations));
+	}
+}
+
+uint32_t MemoryTracker::ReportLeaks()
+{
+	std::scoped_lock lock(m_Lock);
+
+	for (const auto& [memory, allocation] : m_Allocations)
+		CONSOLE_ERROR("Leaked %s allocation \"%s\" of %llu bytes in heap %u.", GetCategoryName(allocation.category),
+			allocation.name ? allocation.name : "unnamed", static_cast<unsigned long long>(allocation.size), allocation.heap);
+
+	if (m_Allocations.empty())
+		CONSOLE_INFO("No device memory leaked.");
+
+	return static_cast<uint32_t>(m_Allocations.size());
+}
+
+const char* MemoryTracker::GetCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Geometry: return "Geometry";
+	case MemoryCategory::Textures: return "Textures";
+	case MemoryCategory::Staging: return "Staging";
+	case MemoryCategory::Transient: return "Transient";
+	default: return "Other";
+	}
+}
+
+void MemoryTracker::QueryBudget()
+{
+	// The driver's numbers lag behind, allocations made since the query are added to its usage as they happen.
+	if (!m_DriverBudget)
+	{
+		for (HeapStats& heap : m_Heaps)
+		{
+			heap.budget = static_cast<vk::DeviceSize>(heap.size * HeapBudgetFraction);
+			heap.usage = heap.tracked;
+		}
+		return;
+	}
+
+	vk::StructureChain<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT> properties =
+		m_PhysicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+	const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& budget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+	for (uint32_t heap = 0; heap < m_Heaps.size(); heap++)
+	{
+		m_Heaps[heap].budget = budget.heapBudget[heap];
+		m_Heaps[heap].usage = budget.heapUsage[heap];
+	}
+}
+
+vk::DeviceSize MemoryTracker::GetSoftBudget(uint32_t heap) const
+{
+	return static_cast<vk::DeviceSize>(m_Heaps[heap].budget * static_cast<double>(m_SoftBudget));
+}
+
+void MemoryTracker::CollectOverBudget(std::vector<std::pair<uint32_t, vk::DeviceSize>>& overBudget) const
+{
+	for (uint32_t heap = 0; heap < m_Heaps.size(); heap++)
+		if (m_Heaps[heap].usage > GetSoftBudget(heap))
+			overBudget.emplace_back(heap, m_Heaps[heap].usage);
+}
+
+void MemoryTracker::NotifyOverBudget(const std::vector<std::pair<uint32_t, vk::DeviceSize>>& overBudget)
+{
+	if (overBudget.empty())
+		return;
+
+	std::vector<BudgetCallback> callbacks;
+	vk::DeviceSize softBudget[VK_MAX_MEMORY_HEAPS];
+	{
+		std::scoped_lock lock(m_Lock);
+		for (const auto& [id, callback] : m_Callbacks)
+			callbacks.push_back(callback);
+		for (const auto& [heap, usage] : overBudget)
+			softBudget[heap] = GetSoftBudget(heap);
+	}
+
+	for (const auto& [heap, usage] : overBudget)
+		for (const BudgetCallback& callback : callbacks)
+			callback(heap, usage, softBudget[heap]);
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef MEMORY_TRACKER_HPP
+#define MEMORY_TRACKER_HPP
+
+#include "Config.hpp"
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+// What an allocation is used for, allocations are counted per category.
+enum class MemoryCategory
+{
+	Geometry,
+	Textures,
+	Staging,	// Host visible memory the CPU writes every frame or uploads from.
+	Transient,	// Render graph attachments and buffers, aliased between passes.
+	Other,
+	Count
+};
+
+// Accounts every device memory allocation per heap and per category, and tracks the budget of each heap.
+// With VK_EXT_memory_budget the budget and the usage of the whole process come from the driver, otherwise the budget
+// is a fraction of the heap size and only the tracked allocations count. Callbacks fire while a heap is above its
+// soft budget, so memory can be released before an allocation fails.
+class MemoryTracker
+{
+public:
+	struct HeapStats
+	{
+		vk::DeviceSize size = 0;
+		vk::DeviceSize budget = 0;
+		vk::DeviceSize usage = 0;		// Estimated current usage, driver reported plus what was allocated since.
+		vk::DeviceSize tracked = 0;		// Allocated through the tracker.
+		vk::DeviceSize peak = 0;		// Highest tracked.
+		bool deviceLocal = false;
+	};
+
+	struct CategoryStats
+	{
+		vk::DeviceSize bytes = 0;
+		vk::DeviceSize peakBytes = 0;
+		uint32_t allocations = 0;
+		uint32_t peakAllocations = 0;
+		uint64_t totalAllocations = 0;	// Since startup.
+	};
+
+	struct Report
+	{
+		bool driverBudget = false;
+		std::vector<HeapStats> heaps;
+		std::array<CategoryStats, static_cast<size_t>(MemoryCategory::Count)> categories;
+	};
+
+	// Called with the heap over its soft budget, the estimated usage and the soft budget.
+	using BudgetCallback = std::function<void(uint32_t heap, vk::DeviceSize usage, vk::DeviceSize softBudget)>;
+
+	MemoryTracker() = default;
+	MemoryTracker(const MemoryTracker&) = delete;
+	MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+	static MemoryTracker& Get() { return s_Tracker; }
+
+	/// @brief Reads the heaps of physicalDevice. memoryBudget tells whether VK_EXT_memory_budget is enabled on the device.
+	void Initialize(vk::PhysicalDevice physicalDevice, bool memoryBudget);
+
+	/// @brief Fraction of each heap's budget above which the budget callbacks fire, 0.9 by default.
+	void SetSoftBudget(float fraction);
+
+	uint32_t AddBudgetCallback(BudgetCallback callback);
+	void RemoveBudgetCallback(uint32_t id);
+
+	void OnAllocate(vk::DeviceMemory memory, vk::DeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category, const char* name);
+	void OnFree(vk::DeviceMemory memory);
+
+	/// @brief Refreshes the driver's budget and usage, then fires the callbacks of heaps above their soft budget.
+	/// Call once per frame.
+	void Update();
+
+	/// @brief True if size more bytes of memoryTypeIndex would stay within the soft budget of its heap.
+	bool FitsBudget(vk::DeviceSize size, uint32_t memoryTypeIndex);
+
+	Report GetReport();
+	void LogReport();
+
+	/// @brief Logs every allocation that has not been freed and returns their number, call once everything is destroyed.
+	uint32_t ReportLeaks();
+
+	static const char* GetCategoryName(MemoryCategory category);
+private:
+	struct Allocation
+	{
+		vk::DeviceSize size;
+		uint32_t heap;
+		MemoryCategory category;
+		const char* name;
+	};
+
+	void QueryBudget();
+	vk::DeviceSize GetSoftBudget(uint32_t heap) const;
+	void CollectOverBudget(std::vector<std::pair<uint32_t, vk::DeviceSize>>& overBudget) const;
+	void NotifyOverBudget(const std::vector<std::pair<uint32_t, vk::DeviceSize>>& overBudget);
+private:
+	std::mutex m_Lock;
+	vk::PhysicalDevice m_PhysicalDevice;
+	vk::PhysicalDeviceMemoryProperties m_MemoryProperties;
+	bool m_DriverBudget = false;
+	float m_SoftBudget = 0.9f;
+
+	std::vector<HeapStats> m_Heaps;
+	std::array<CategoryStats, static_cast<size_t>(MemoryCategory::Count)> m_Categories;
+	std::unordered_map<VkDeviceMemory, Allocation> m_Allocations;
+
+	std::vector<std::pair<uint32_t, BudgetCallback>> m_Callbacks;
+	uint32_t m_NextCallback = 0;
+
+	static MemoryTracker s_Tracker;
+};
+
+#endif // !MEMORY_TRACKER_HPP
\ No newline at end of file
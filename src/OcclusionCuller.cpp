@@ -0,0 +1,432 @@
+#include "OcclusionCuller.hpp"
+#include "Vulkan/Image.hpp"
+
+namespace
+{
+	constexpr uint32_t CullGroupSize = 64;
+	constexpr uint32_t PyramidGroupSize = 8;
+	constexpr uint32_t MinimumCapacity = 64;
+	constexpr vk::Format PyramidFormat = vk::Format::eR32Sfloat;
+
+	uint32_t GroupCount(uint32_t count, uint32_t groupSize) { return (count + groupSize - 1) / groupSize; }
+}
+
+OcclusionCuller::OcclusionCuller(const Input& input) : m_Device(input.device), m_PhysicalDevice(input.physicalDevice), m_Heap(*input.heap),
+	m_DeletionQueue(*input.deletionQueue), m_SceneBuffers(*input.sceneBuffers)
+{
+	vkInit::ComputePipelineInBundle specification{};
+	specification.device = m_Device;
+	specification.descriptorSetLayouts.push_back(m_Heap.layout);
+
+	specification.shaderFilePath = PROJECT_DIR"/src/Shaders/OcclusionCullComp.spv";
+	specification.pushConstantSize = sizeof(CullConstants);
+	m_CullPipeline = vkInit::MakeComputePipeline(specification);
+
+	specification.shaderFilePath = PROJECT_DIR"/src/Shaders/DepthPyramidComp.spv";
+	specification.pushConstantSize = sizeof(PyramidConstants);
+	m_PyramidPipeline = vkInit::MakeComputePipeline(specification);
+
+	// Only ever read with texelFetch, the sampler just has to exist.
+	vk::SamplerCreateInfo samplerInfo{};
+	samplerInfo.magFilter = vk::Filter::eNearest;
+	samplerInfo.minFilter = vk::Filter::eNearest;
+	samplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+	samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+	samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+	samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	try
+	{
+		m_Sampler = m_Device.createSampler(samplerInfo);
+	}
+	catch (const vk::SystemError& err)
+	{
+		CONSOLE_ERROR("Failed to create the depth pyramid sampler! %s", err.what());
+	}
+	m_SamplerSlot = vkInit::RegisterSampler(m_Heap, m_Sampler);
+
+	Resize(input.extent, input.framesInFlight);
+	CONSOLE_INFO("Occlusion culling enabled, %ux%u depth pyramid with %zu levels.",
+		m_PyramidExtent.width, m_PyramidExtent.height, m_PyramidLevelViews.size());
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	for (Frame& frame : m_Frames)
+		DestroyFrame(frame);
+	DestroyPyramid();
+	DestroyBuffer(m_Visibility);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_VisibilitySlot);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessSampledImages, m_DepthSlot);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessSamplers, m_SamplerSlot);
+
+	m_Device.destroySampler(m_Sampler);
+	m_Device.destroyPipeline(m_CullPipeline.pipeline);
+	m_Device.destroyPipelineLayout(m_CullPipeline.layout);
+	m_Device.destroyPipeline(m_PyramidPipeline.pipeline);
+	m_Device.destroyPipelineLayout(m_PyramidPipeline.layout);
+}
+
+bool OcclusionCuller::IsSupported(vk::PhysicalDevice physicalDevice, const vkInit::DeviceCapabilities& capabilities, bool bindlessSupported, vk::Format depthFormat)
+{
+	vk::FormatFeatureFlags depthFeatures = physicalDevice.getFormatProperties(depthFormat).optimalTilingFeatures;
+	vk::FormatFeatureFlags pyramidFeatures = physicalDevice.getFormatProperties(PyramidFormat).optimalTilingFeatures;
+
+	// Depth with stencil can not be sampled through a view of both aspects.
+	return bindlessSupported && capabilities.multiDrawIndirect && capabilities.drawIndirectFirstInstance &&
+		vkInit::GetDepthAspect(depthFormat) == vk::ImageAspectFlags(vk::ImageAspectFlagBits::eDepth) &&
+		(depthFeatures & vk::FormatFeatureFlagBits::eSampledImage) &&
+		(pyramidFeatures & vk::FormatFeatureFlagBits::eStorageImage) && (pyramidFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+}
+
+void OcclusionCuller::Resize(vk::Extent2D extent, uint32_t framesInFlight)
+{
+	DestroyPyramid();
+	CreatePyramid(extent);
+
+	for (Frame& frame : m_Frames)
+		DestroyFrame(frame);
+	m_Frames.resize(framesInFlight);
+	for (Frame& frame : m_Frames)
+		CreateFrame(frame, MinimumCapacity);
+
+	m_CurrentFrame = 0;
+}
+
+void OcclusionCuller::BeginFrame(uint32_t frame, const FramePacket& packet)
+{
+	m_CurrentFrame = frame;
+	Frame& current = m_Frames[frame];
+
+	// The completion point of this frame has been waited on, so the copy recorded with its last use has landed.
+	if (current.statsPending)
+	{
+		m_Stats = *current.mappedStats;
+		current.statsPending = false;
+	}
+
+	ReserveVisibility(packet.objectCount);
+
+	m_InstanceCount = static_cast<uint32_t>(packet.draws.size());
+	m_ViewProjection = packet.viewProjection;
+	if (m_InstanceCount > current.capacity)
+	{
+		DestroyFrame(current);
+		CreateFrame(current, std::max(m_InstanceCount, current.capacity * 2));
+	}
+}
+
+OcclusionCuller::FrameResources OcclusionCuller::Import(RenderGraph& graph)
+{
+	const Frame& frame = m_Frames[m_CurrentFrame];
+	const vk::DeviceSize drawSize = sizeof(vk::DrawIndirectCommand) * frame.capacity;
+
+	FrameResources resources{};
+	resources.instances = m_SceneBuffers.ImportDraws(graph);
+	resources.earlyDraws = graph.ImportBuffer("OcclusionEarlyDraws", frame.earlyDraws.buffer, drawSize);
+	resources.lateDraws = graph.ImportBuffer("OcclusionLateDraws", frame.lateDraws.buffer, drawSize);
+	resources.stats = graph.ImportBuffer("OcclusionStats", frame.stats.buffer, sizeof(Stats));
+	resources.statsReadback = graph.ImportBuffer("OcclusionStatsReadback", frame.statsReadback.buffer, sizeof(Stats));
+
+	// Shared between frames, the late cull of the previous frame wrote it last.
+	resources.visibility = graph.ImportBuffer("OcclusionVisibility", m_Visibility.buffer, sizeof(uint32_t) * m_VisibilityCapacity,
+		vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite);
+
+	RenderImageDesc pyramidDesc{};
+	pyramidDesc.format = PyramidFormat;
+	pyramidDesc.extent = m_PyramidExtent;
+	pyramidDesc.mipLevels = static_cast<uint32_t>(m_PyramidLevelViews.size());
+
+	RenderImageImport pyramidImport{};
+	pyramidImport.image = m_Pyramid;
+	pyramidImport.view = m_PyramidView;
+	pyramidImport.initialLayout = m_PyramidInitialized ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eUndefined;
+	pyramidImport.finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	pyramidImport.initialStages = vk::PipelineStageFlagBits::eComputeShader;
+	resources.pyramid = graph.ImportImage("DepthPyramid", pyramidDesc, pyramidImport);
+	m_PyramidInitialized = true;
+
+	return resources;
+}
+
+void OcclusionCuller::AddEarlyCullPass(RenderGraph& graph, const FrameResources& resources)
+{
+	graph.AddPass("CullEarly", RenderGraph::PassType::Compute)
+		.Read(resources.instances, ResourceUsage::StorageRead)
+		.Read(resources.visibility, ResourceUsage::StorageRead)
+		.Write(resources.earlyDraws, ResourceUsage::StorageWrite)
+		.Write(resources.stats, ResourceUsage::StorageWrite)
+		.SetExecute([this](const RenderGraph::PassContext& context)
+		{
+			const Frame& frame = m_Frames[m_CurrentFrame];
+			vk::CommandBuffer commandBuffer = context.commandBuffer;
+
+			// Reset inside the pass, the graph only knows the shader accesses.
+			commandBuffer.fillBuffer(frame.stats.buffer, 0, sizeof(Stats), 0);
+			if (m_ClearVisibility)
+			{
+				commandBuffer.fillBuffer(m_Visibility.buffer, 0, VK_WHOLE_SIZE, 0);
+				m_ClearVisibility = false;
+			}
+
+			vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), barrier, nullptr, nullptr);
+
+			Dispatch(commandBuffer, 0, frame.earlyDrawSlot);
+		});
+}
+
+void OcclusionCuller::AddDepthPyramidPass(RenderGraph& graph, const FrameResources& resources, RenderResource depth)
+{
+	graph.AddPass("DepthPyramid", RenderGraph::PassType::Compute)
+		.Read(depth, ResourceUsage::Sampled)
+		.Write(resources.pyramid, ResourceUsage::StorageWrite)
+		.SetExecute([this, depth](const RenderGraph::PassContext& context)
+		{
+			vk::ImageView depthView = context.graph->GetImageView(depth);
+			// The graph recompiles without waiting for idle, frames in flight may still sample the old slot.
+			if (depthView != m_DepthView)
+			{
+				m_DeletionQueue.Retire(vkInit::BindlessSampledImages, m_DepthSlot);
+				m_DepthSlot = vkInit::RegisterSampledImage(m_Heap, depthView);
+				m_DepthView = depthView;
+			}
+
+			vk::CommandBuffer commandBuffer = context.commandBuffer;
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_PyramidPipeline.pipeline);
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_PyramidPipeline.layout, 0, m_Heap.set, nullptr);
+
+			vk::Extent2D source = m_PyramidExtent;
+			for (uint32_t level = 0; level < m_PyramidLevelSlots.size(); level++)
+			{
+				vk::Extent2D destination(std::max(1u, m_PyramidExtent.width >> level), std::max(1u, m_PyramidExtent.height >> level));
+
+				PyramidConstants constants{};
+				constants.source = level == 0 ? m_DepthSlot : m_PyramidLevelSlots[level - 1];
+				constants.depthSampler = m_SamplerSlot;
+				constants.destination = m_PyramidLevelSlots[level];
+				constants.level = level;
+				constants.sourceWidth = source.width;
+				constants.sourceHeight = source.height;
+				constants.destinationWidth = destination.width;
+				constants.destinationHeight = destination.height;
+				commandBuffer.pushConstants(m_PyramidPipeline.layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+				commandBuffer.dispatch(GroupCount(destination.width, PyramidGroupSize), GroupCount(destination.height, PyramidGroupSize), 1);
+
+				// Each level reads the one before it.
+				vk::MemoryBarrier barrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+				commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), barrier, nullptr, nullptr);
+				source = destination;
+			}
+		});
+}
+
+void OcclusionCuller::AddLateCullPass(RenderGraph& graph, const FrameResources& resources)
+{
+	graph.AddPass("CullLate", RenderGraph::PassType::Compute)
+		.Read(resources.instances, ResourceUsage::StorageRead)
+		.Read(resources.pyramid, ResourceUsage::Sampled)
+		.Write(resources.visibility, ResourceUsage::StorageWrite)
+		.Write(resources.lateDraws, ResourceUsage::StorageWrite)
+		.Write(resources.stats, ResourceUsage::StorageWrite)
+		.SetExecute([this](const RenderGraph::PassContext& context)
+		{
+			Dispatch(context.commandBuffer, 1, m_Frames[m_CurrentFrame].lateDrawSlot);
+		});
+}
+
+void OcclusionCuller::AddStatsReadbackPass(RenderGraph& graph, const FrameResources& resources)
+{
+	graph.AddPass("OcclusionStatsReadback", RenderGraph::PassType::Transfer)
+		.Read(resources.stats, ResourceUsage::TransferSrc)
+		.Write(resources.statsReadback, ResourceUsage::TransferDst)
+		.SetSideEffects()
+		.SetExecute([this](const RenderGraph::PassContext& context)
+		{
+			Frame& frame = m_Frames[m_CurrentFrame];
+			vk::BufferCopy region(0, 0, sizeof(Stats));
+			context.commandBuffer.copyBuffer(frame.stats.buffer, frame.statsReadback.buffer, region);
+
+			vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+			context.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+				vk::DependencyFlags(), barrier, nullptr, nullptr);
+			frame.statsPending = true;
+		});
+}
+
+void OcclusionCuller::DrawIndirect(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, bool late, uint32_t viewBuffer) const
+{
+	if (m_InstanceCount == 0)
+		return;
+
+	const Frame& frame = m_Frames[m_CurrentFrame];
+	vkInit::Constants constants{};
+	constants.instanceBuffer = m_SceneBuffers.GetDrawBuffer();
+	constants.viewBuffer = viewBuffer;
+	constants.transformBuffer = m_SceneBuffers.GetTransformBuffer();
+	commandBuffer.pushConstants(layout, vkInit::ConstantsStages, 0, sizeof(constants), &constants);
+
+	// One command per instance, culled ones have an instance count of zero.
+	commandBuffer.drawIndirect(late ? frame.lateDraws.buffer : frame.earlyDraws.buffer, 0, m_InstanceCount, sizeof(vk::DrawIndirectCommand));
+}
+
+vkInit::Buffer OcclusionCuller::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+	MemoryCategory category, const char* name)
+{
+	vkInit::BufferInput input{};
+	input.size = size;
+	input.usage = usage;
+	input.device = m_Device;
+	input.physicalDevice = m_PhysicalDevice;
+	input.properties = properties;
+	input.category = category;
+	input.name = name;
+	return vkInit::CreateBuffer(input);
+}
+
+void OcclusionCuller::DestroyBuffer(vkInit::Buffer& buffer)
+{
+	m_Device.destroyBuffer(buffer.buffer);
+	vkInit::FreeMemory(m_Device, buffer.bufferMemory);
+	buffer = vkInit::Buffer{};
+}
+
+void OcclusionCuller::CreateFrame(Frame& frame, uint32_t capacity)
+{
+	using Usage = vk::BufferUsageFlagBits;
+	const vk::MemoryPropertyFlags hostVisible = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	const vk::MemoryPropertyFlags deviceLocal = vk::MemoryPropertyFlagBits::eDeviceLocal;
+
+	frame.capacity = capacity;
+	frame.earlyDraws = CreateBuffer(sizeof(vk::DrawIndirectCommand) * capacity, Usage::eStorageBuffer | Usage::eIndirectBuffer, deviceLocal,
+		MemoryCategory::Other, "Early indirect draws");
+	frame.lateDraws = CreateBuffer(sizeof(vk::DrawIndirectCommand) * capacity, Usage::eStorageBuffer | Usage::eIndirectBuffer, deviceLocal,
+		MemoryCategory::Other, "Late indirect draws");
+
+	frame.stats = CreateBuffer(sizeof(Stats), Usage::eStorageBuffer | Usage::eTransferSrc | Usage::eTransferDst, deviceLocal,
+		MemoryCategory::Other, "Culling stats");
+	frame.statsReadback = CreateBuffer(sizeof(Stats), Usage::eTransferDst, hostVisible, MemoryCategory::Staging, "Culling stats readback");
+	frame.mappedStats = static_cast<const Stats*>(m_Device.mapMemory(frame.statsReadback.bufferMemory, 0, VK_WHOLE_SIZE));
+	frame.statsPending = false;
+
+	frame.earlyDrawSlot = vkInit::RegisterStorageBuffer(m_Heap, frame.earlyDraws.buffer);
+	frame.lateDrawSlot = vkInit::RegisterStorageBuffer(m_Heap, frame.lateDraws.buffer);
+	frame.statsSlot = vkInit::RegisterStorageBuffer(m_Heap, frame.stats.buffer);
+}
+
+void OcclusionCuller::DestroyFrame(Frame& frame)
+{
+	if (frame.statsReadback.bufferMemory)
+		m_Device.unmapMemory(frame.statsReadback.bufferMemory);
+
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, frame.earlyDrawSlot);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, frame.lateDrawSlot);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, frame.statsSlot);
+
+	DestroyBuffer(frame.earlyDraws);
+	DestroyBuffer(frame.lateDraws);
+	DestroyBuffer(frame.stats);
+	DestroyBuffer(frame.statsReadback);
+	frame = Frame{};
+}
+
+void OcclusionCuller::CreatePyramid(vk::Extent2D extent)
+{
+	m_PyramidExtent = extent;
+	uint32_t levels = 1;
+	while ((std::max(extent.width, extent.height) >> levels) > 0)
+		levels++;
+
+	vkInit::ImageInput input{};
+	input.device = m_Device;
+	input.format = PyramidFormat;
+	input.extent = extent;
+	input.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+	input.mipLevels = levels;
+	m_Pyramid = vkInit::CreateImage(input);
+
+	vk::MemoryRequirements requirements = m_Device.getImageMemoryRequirements(m_Pyramid);
+	uint32_t typeIndex = vkInit::FindMemoryTypeIndex(m_PhysicalDevice, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_PyramidMemory = vkInit::AllocateDeviceMemory(m_Device, typeIndex, requirements.size, MemoryCategory::Textures, "Depth pyramid");
+	m_Device.bindImageMemory(m_Pyramid, m_PyramidMemory, 0);
+
+	m_PyramidView = vkInit::CreateImageView(m_Device, m_Pyramid, PyramidFormat, vk::ImageAspectFlagBits::eColor, 0, levels);
+	m_PyramidSlot = vkInit::RegisterSampledImage(m_Heap, m_PyramidView);
+	for (uint32_t level = 0; level < levels; level++)
+	{
+		m_PyramidLevelViews.push_back(vkInit::CreateImageView(m_Device, m_Pyramid, PyramidFormat, vk::ImageAspectFlagBits::eColor, level));
+		m_PyramidLevelSlots.push_back(vkInit::RegisterStorageImage(m_Heap, m_PyramidLevelViews.back()));
+	}
+
+	m_PyramidInitialized = false;
+}
+
+void OcclusionCuller::DestroyPyramid()
+{
+	// Retired like everything else the heap indexes, its slots must not be written again while a frame may read them.
+	for (uint32_t level = 0; level < m_PyramidLevelViews.size(); level++)
+	{
+		m_DeletionQueue.Retire(vkInit::BindlessStorageImages, m_PyramidLevelSlots[level]);
+		m_DeletionQueue.Retire(m_PyramidLevelViews[level]);
+	}
+	m_PyramidLevelViews.clear();
+	m_PyramidLevelSlots.clear();
+
+	m_DeletionQueue.Retire(vkInit::BindlessSampledImages, m_PyramidSlot);
+	m_PyramidSlot = vkInit::InvalidBindlessIndex;
+	m_DeletionQueue.Retire(m_PyramidView);
+	m_DeletionQueue.Retire(m_Pyramid);
+	m_DeletionQueue.Retire(m_PyramidMemory);
+	m_PyramidView = nullptr;
+	m_Pyramid = nullptr;
+	m_PyramidMemory = nullptr;
+}
+
+void OcclusionCuller::ReserveVisibility(uint32_t objectCount)
+{
+	if (objectCount <= m_VisibilityCapacity && m_Visibility.buffer)
+		return;
+
+	// Every frame in flight reads this buffer, it is freed once they have finished. Only happens when the scene grows.
+	m_DeletionQueue.Retire(m_Visibility, m_VisibilitySlot);
+
+	m_VisibilityCapacity = std::max({ objectCount, m_VisibilityCapacity * 2, MinimumCapacity });
+	m_Visibility = CreateBuffer(sizeof(uint32_t) * m_VisibilityCapacity,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Other, "Visibility");
+	m_VisibilitySlot = vkInit::RegisterStorageBuffer(m_Heap, m_Visibility.buffer);
+
+	// Nothing counts as visible yet, the late phase draws whatever passes the test.
+	m_ClearVisibility = true;
+}
+
+void OcclusionCuller::Dispatch(vk::CommandBuffer commandBuffer, uint32_t phase, uint32_t drawBuffer)
+{
+	if (m_InstanceCount == 0)
+		return;
+
+	const Frame& frame = m_Frames[m_CurrentFrame];
+
+	CullConstants constants{};
+	constants.viewProjection = m_ViewProjection;
+	constants.instanceCount = m_InstanceCount;
+	constants.phase = phase;
+	constants.instanceBuffer = m_SceneBuffers.GetDrawBuffer();
+	constants.boundsBuffer = m_SceneBuffers.GetBoundsBuffer();
+	constants.visibilityBuffer = m_VisibilitySlot;
+	constants.drawBuffer = drawBuffer;
+	constants.statsBuffer = frame.statsSlot;
+	constants.pyramid = m_PyramidSlot;
+	constants.pyramidSampler = m_SamplerSlot;
+	constants.pyramidWidth = m_PyramidExtent.width;
+	constants.pyramidHeight = m_PyramidExtent.height;
+	constants.pyramidLevels = static_cast<uint32_t>(m_PyramidLevelViews.size());
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_CullPipeline.pipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_CullPipeline.layout, 0, m_Heap.set, nullptr);
+	commandBuffer.pushConstants(m_CullPipeline.layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+	commandBuffer.dispatch(GroupCount(m_InstanceCount, CullGroupSize), 1, 1);
+}
\ No newline at end of file
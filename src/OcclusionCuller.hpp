@@ -0,0 +1,152 @@
+#ifndef OCCLUSION_CULLER_HPP
+#define OCCLUSION_CULLER_HPP
+
+#include "Config.hpp"
+#include "FramePipeline.hpp"
+#include "DeletionQueue.hpp"
+#include "RenderGraph.hpp"
+#include "SceneBuffers.hpp"
+#include "Vulkan/Memory.hpp"
+#include "Vulkan/Device.hpp"
+#include "Vulkan/Descriptors.hpp"
+#include "Vulkan/Compute.hpp"
+
+// Two-phase occlusion culling against a hierarchical depth pyramid, run entirely on the GPU.
+// The first phase draws what was visible last frame, the pyramid is reduced from the resulting depth and the second
+// phase tests every object against it, drawing the ones that just became visible. Draws reach the GPU as indirect
+// commands, the counters come back a few frames late so the CPU never waits on them.
+class OcclusionCuller
+{
+public:
+	// Counters written by the culling shader, in the layout of its stats buffer.
+	struct Stats
+	{
+		uint32_t tested = 0;
+		uint32_t occluded = 0;
+		uint32_t drawnEarly = 0;
+		uint32_t drawnLate = 0;
+	};
+
+	// Graph handles of the resources used by the current frame.
+	struct FrameResources
+	{
+		RenderResource instances, visibility, earlyDraws, lateDraws, stats, statsReadback, pyramid;
+	};
+
+	struct Input
+	{
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		vkInit::BindlessHeap* heap;
+		DeletionQueue* deletionQueue;
+		const SceneBuffers* sceneBuffers;	// Objects, bounds and transforms of the draws that are culled.
+		vk::Extent2D extent;
+		uint32_t framesInFlight;
+	};
+
+	OcclusionCuller(const Input& input);
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+	~OcclusionCuller();
+
+	/// @brief Needs the bindless heap, multi-draw indirect with firstInstance and a sampleable depth format without stencil.
+	static bool IsSupported(vk::PhysicalDevice physicalDevice, const vkInit::DeviceCapabilities& capabilities, bool bindlessSupported, vk::Format depthFormat);
+
+	/// @brief Recreates the depth pyramid and the per-frame resources. The device must be idle.
+	void Resize(vk::Extent2D extent, uint32_t framesInFlight);
+
+	/// @brief Picks the resources of frame, whose previous submission must have finished, and reads back its counters.
+	/// One indirect command is culled per draw of packet, the scene buffers must have begun the frame with it.
+	void BeginFrame(uint32_t frame, const FramePacket& packet);
+
+	FrameResources Import(RenderGraph& graph);
+
+	void AddEarlyCullPass(RenderGraph& graph, const FrameResources& resources);
+	void AddDepthPyramidPass(RenderGraph& graph, const FrameResources& resources, RenderResource depth);
+	void AddLateCullPass(RenderGraph& graph, const FrameResources& resources);
+	void AddStatsReadbackPass(RenderGraph& graph, const FrameResources& resources);
+
+	/// @brief Records the indirect draws of one phase. The caller binds the pipeline, the bindless set and the vertex buffers.
+	/// viewBuffer is the view projections slot the vertex shader reads.
+	void DrawIndirect(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, bool late, uint32_t viewBuffer) const;
+
+	/// @brief Registers the depth view again on the next pyramid pass, a recompiled graph may reuse the handle of a destroyed view.
+	void OnGraphCompiled() { m_DepthView = nullptr; }
+
+	// Counters of the most recent frame that has been read back.
+	const Stats& GetStats() const { return m_Stats; }
+private:
+	struct Frame
+	{
+		vkInit::Buffer earlyDraws, lateDraws;
+		uint32_t capacity = 0;
+		uint32_t earlyDrawSlot = vkInit::InvalidBindlessIndex;
+		uint32_t lateDrawSlot = vkInit::InvalidBindlessIndex;
+
+		vkInit::Buffer stats, statsReadback;
+		const Stats* mappedStats = nullptr;
+		uint32_t statsSlot = vkInit::InvalidBindlessIndex;
+		bool statsPending = false;
+	};
+
+	struct PyramidConstants
+	{
+		uint32_t source, depthSampler, destination, level;
+		uint32_t sourceWidth, sourceHeight, destinationWidth, destinationHeight;
+	};
+
+	struct CullConstants
+	{
+		glm::mat4 viewProjection;
+		uint32_t instanceCount, phase, instanceBuffer, visibilityBuffer, drawBuffer, statsBuffer;
+		uint32_t pyramid, pyramidSampler, pyramidWidth, pyramidHeight, pyramidLevels, boundsBuffer;
+	};
+
+	vkInit::Buffer CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, const char* name);
+	void DestroyBuffer(vkInit::Buffer& buffer);
+	void CreateFrame(Frame& frame, uint32_t capacity);
+	void DestroyFrame(Frame& frame);
+	void CreatePyramid(vk::Extent2D extent);
+	void DestroyPyramid();
+	void ReserveVisibility(uint32_t objectCount);
+	void Dispatch(vk::CommandBuffer commandBuffer, uint32_t phase, uint32_t drawBuffer);
+private:
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+	vkInit::BindlessHeap& m_Heap;
+	DeletionQueue& m_DeletionQueue;
+	const SceneBuffers& m_SceneBuffers;
+
+	vkInit::ComputePipelineOutBundle m_CullPipeline, m_PyramidPipeline;
+	vk::Sampler m_Sampler;
+	uint32_t m_SamplerSlot = vkInit::InvalidBindlessIndex;
+
+	std::vector<Frame> m_Frames;
+	uint32_t m_CurrentFrame = 0;
+	uint32_t m_InstanceCount = 0;
+	glm::mat4 m_ViewProjection{ 1.0f };
+
+	// Visibility of every object in the last frame, shared by all frames in flight.
+	vkInit::Buffer m_Visibility;
+	uint32_t m_VisibilityCapacity = 0;
+	uint32_t m_VisibilitySlot = vkInit::InvalidBindlessIndex;
+	bool m_ClearVisibility = false;
+
+	// R32 max-depth pyramid, one storage view per level and a sampled view of the whole chain.
+	vk::Image m_Pyramid;
+	vk::DeviceMemory m_PyramidMemory;
+	vk::ImageView m_PyramidView;
+	std::vector<vk::ImageView> m_PyramidLevelViews;
+	std::vector<uint32_t> m_PyramidLevelSlots;
+	uint32_t m_PyramidSlot = vkInit::InvalidBindlessIndex;
+	vk::Extent2D m_PyramidExtent;
+	bool m_PyramidInitialized = false;
+
+	// The graph only replaces the depth view when it compiles again.
+	vk::ImageView m_DepthView;
+	uint32_t m_DepthSlot = vkInit::InvalidBindlessIndex;
+
+	Stats m_Stats;
+};
+
+#endif // !OCCLUSION_CULLER_HPP
\ No newline at end of file
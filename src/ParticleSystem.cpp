@@ -0,0 +1,271 @@
+#include "ParticleSystem.hpp"
+
+#include <cstddef>
+
+namespace
+{
+	constexpr uint32_t SimulateGroupSize = 64;
+
+	// Longest step the simulation takes, e.g. after a stall or while the window is being resized.
+	constexpr float MaxDeltaTime = 0.1f;
+
+	// Position and size of each particle, matches ParticleInstance in Particle.vert.
+	struct ParticleInstance
+	{
+		glm::vec4 positionSize;
+		glm::vec4 color;
+	};
+
+	// Matches Particle in ParticleSimulate.comp.
+	struct Particle
+	{
+		glm::vec4 positionAge;
+		glm::vec4 velocityLifetime;
+		glm::vec4 color;
+	};
+
+	uint32_t GroupCount(uint32_t count, uint32_t groupSize) { return (count + groupSize - 1) / groupSize; }
+
+	// Makes the writes of one phase visible to the shader and indirect reads of the next.
+	void PhaseBarrier(vk::CommandBuffer commandBuffer)
+	{
+		vk::MemoryBarrier barrier(vk::AccessFlagBits::eShaderWrite,
+			vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eIndirectCommandRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect, vk::DependencyFlags(), barrier, nullptr, nullptr);
+	}
+}
+
+ParticleSystem::ParticleSystem(const Input& input) : m_Device(input.device), m_PhysicalDevice(input.physicalDevice), m_Heap(*input.heap),
+	m_Settings(input.settings)
+{
+	vkInit::ComputePipelineInBundle specification{};
+	specification.device = m_Device;
+	specification.descriptorSetLayouts.push_back(m_Heap.layout);
+	specification.shaderFilePath = PROJECT_DIR"/src/Shaders/ParticleSimulateComp.spv";
+	specification.pushConstantSize = sizeof(SimulateConstants);
+	m_SimulatePipeline = vkInit::MakeComputePipeline(specification);
+
+	using Usage = vk::BufferUsageFlagBits;
+	const vk::MemoryPropertyFlags deviceLocal = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	const uint32_t capacity = m_Settings.capacity;
+
+	m_Particles = CreateBuffer(sizeof(Particle) * capacity, Usage::eStorageBuffer, deviceLocal, MemoryCategory::Geometry, "Particles");
+	m_DeadList = CreateBuffer(sizeof(uint32_t) * capacity, Usage::eStorageBuffer, deviceLocal, MemoryCategory::Geometry, "Particle dead list");
+	m_AliveLists[0] = CreateBuffer(sizeof(uint32_t) * capacity, Usage::eStorageBuffer, deviceLocal, MemoryCategory::Geometry, "Particle alive list");
+	m_AliveLists[1] = CreateBuffer(sizeof(uint32_t) * capacity, Usage::eStorageBuffer, deviceLocal, MemoryCategory::Geometry, "Particle alive list");
+	m_Instances = CreateBuffer(sizeof(ParticleInstance) * capacity, Usage::eStorageBuffer, deviceLocal, MemoryCategory::Geometry, "Particle instances");
+	m_Control = CreateBuffer(sizeof(Control), Usage::eStorageBuffer | Usage::eIndirectBuffer | Usage::eTransferSrc, deviceLocal,
+		MemoryCategory::Other, "Particle control");
+
+	m_ParticleSlot = vkInit::RegisterStorageBuffer(m_Heap, m_Particles.buffer);
+	m_DeadSlot = vkInit::RegisterStorageBuffer(m_Heap, m_DeadList.buffer);
+	m_AliveSlots[0] = vkInit::RegisterStorageBuffer(m_Heap, m_AliveLists[0].buffer);
+	m_AliveSlots[1] = vkInit::RegisterStorageBuffer(m_Heap, m_AliveLists[1].buffer);
+	m_InstanceSlot = vkInit::RegisterStorageBuffer(m_Heap, m_Instances.buffer);
+	m_ControlSlot = vkInit::RegisterStorageBuffer(m_Heap, m_Control.buffer);
+
+	Resize(input.framesInFlight);
+	CONSOLE_INFO("GPU particles enabled, %u particles emitted at %.0f per second.", capacity, m_Settings.emitRate);
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	Resize(0);
+
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_ParticleSlot);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_DeadSlot);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_AliveSlots[0]);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_AliveSlots[1]);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_InstanceSlot);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_ControlSlot);
+
+	DestroyBuffer(m_Particles);
+	DestroyBuffer(m_DeadList);
+	DestroyBuffer(m_AliveLists[0]);
+	DestroyBuffer(m_AliveLists[1]);
+	DestroyBuffer(m_Instances);
+	DestroyBuffer(m_Control);
+
+	m_Device.destroyPipeline(m_SimulatePipeline.pipeline);
+	m_Device.destroyPipelineLayout(m_SimulatePipeline.layout);
+}
+
+void ParticleSystem::Resize(uint32_t framesInFlight)
+{
+	for (Frame& frame : m_Frames)
+	{
+		if (frame.controlReadback.bufferMemory)
+			m_Device.unmapMemory(frame.controlReadback.bufferMemory);
+		DestroyBuffer(frame.controlReadback);
+	}
+
+	m_Frames.assign(framesInFlight, Frame{});
+	for (Frame& frame : m_Frames)
+	{
+		frame.controlReadback = CreateBuffer(sizeof(Control), vk::BufferUsageFlagBits::eTransferDst,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging, "Particle control readback");
+		frame.mappedControl = static_cast<const Control*>(m_Device.mapMemory(frame.controlReadback.bufferMemory, 0, VK_WHOLE_SIZE));
+	}
+
+	m_CurrentFrame = 0;
+}
+
+void ParticleSystem::BeginFrame(uint32_t frame)
+{
+	m_CurrentFrame = frame;
+	Frame& current = m_Frames[frame];
+
+	// The completion point of this frame has been waited on, so the copy recorded with its last use has landed.
+	if (current.pending)
+	{
+		m_AliveCount = current.mappedControl->draw.instanceCount;
+		current.pending = false;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	m_DeltaTime = m_Started ? std::min(std::chrono::duration<float>(now - m_LastFrameTime).count(), MaxDeltaTime) : 0.0f;
+	m_LastFrameTime = now;
+	m_Started = true;
+
+	// Fractions carry over, so low rates still emit on average what was asked for. The GPU clamps to the free slots.
+	float emit = m_Settings.emitRate * m_DeltaTime + m_EmitRemainder;
+	m_EmitCount = static_cast<uint32_t>(std::min(emit, static_cast<float>(m_Settings.capacity)));
+	m_EmitRemainder = emit - std::floor(emit);
+	m_Seed++;
+}
+
+ParticleSystem::FrameResources ParticleSystem::Import(RenderGraph& graph)
+{
+	FrameResources resources{};
+
+	// Carried over from the previous frame, whose draw and readback still read them.
+	resources.control = graph.ImportBuffer("ParticleControl", m_Control.buffer, sizeof(Control),
+		vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eTransfer,
+		vk::AccessFlagBits::eShaderWrite);
+	resources.instances = graph.ImportBuffer("ParticleInstances", m_Instances.buffer, sizeof(ParticleInstance) * m_Settings.capacity,
+		vk::PipelineStageFlagBits::eVertexShader);
+	resources.controlReadback = graph.ImportBuffer("ParticleControlReadback", m_Frames[m_CurrentFrame].controlReadback.buffer, sizeof(Control));
+
+	return resources;
+}
+
+void ParticleSystem::AddSimulatePass(RenderGraph& graph, const FrameResources& resources)
+{
+	graph.AddPass("ParticleSimulate", RenderGraph::PassType::Compute)
+		.Write(resources.control, ResourceUsage::StorageWrite)
+		.Write(resources.instances, ResourceUsage::StorageWrite)
+		.SetExecute([this](const RenderGraph::PassContext& context)
+		{
+			vk::CommandBuffer commandBuffer = context.commandBuffer;
+
+			// The particle and list buffers are only ever touched here, so the graph does not know about them.
+			// Make the previous frame's simulation visible before this one continues it.
+			PhaseBarrier(commandBuffer);
+
+			SimulateConstants constants{};
+			constants.emitterPosition = glm::vec4(m_Settings.emitterPosition, m_Settings.emitterRadius);
+			constants.emitterVelocity = glm::vec4(m_Settings.emitterVelocity, m_Settings.velocitySpread);
+			constants.gravity = glm::vec4(m_Settings.gravity, m_Settings.drag);
+			constants.deltaTime = m_DeltaTime;
+			constants.lifetime = m_Settings.lifetime;
+			constants.size = m_Settings.size;
+			constants.capacity = m_Settings.capacity;
+			constants.emitCount = m_EmitCount;
+			constants.seed = m_Seed;
+			constants.current = m_CurrentList;
+			constants.particleBuffer = m_ParticleSlot;
+			constants.deadBuffer = m_DeadSlot;
+			constants.aliveBuffer = m_AliveSlots[m_CurrentList];
+			constants.nextAliveBuffer = m_AliveSlots[1 - m_CurrentList];
+			constants.instanceBuffer = m_InstanceSlot;
+			constants.controlBuffer = m_ControlSlot;
+
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_SimulatePipeline.pipeline);
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_SimulatePipeline.layout, 0, m_Heap.set, nullptr);
+
+			if (m_Reset)
+			{
+				Dispatch(commandBuffer, constants, PhaseReset, GroupCount(m_Settings.capacity, SimulateGroupSize));
+				PhaseBarrier(commandBuffer);
+				m_Reset = false;
+			}
+
+			// Every count past this point is only known to the GPU, the dispatches take theirs from the control buffer.
+			Dispatch(commandBuffer, constants, PhasePrepare, 1);
+			PhaseBarrier(commandBuffer);
+			DispatchIndirect(commandBuffer, constants, PhaseEmit, offsetof(Control, emitDispatch));
+			PhaseBarrier(commandBuffer);
+			DispatchIndirect(commandBuffer, constants, PhaseSimulate, offsetof(Control, simulateDispatch));
+			PhaseBarrier(commandBuffer);
+			Dispatch(commandBuffer, constants, PhaseFinish, 1);
+
+			m_CurrentList = 1 - m_CurrentList;
+		});
+}
+
+void ParticleSystem::AddReadbackPass(RenderGraph& graph, const FrameResources& resources)
+{
+	graph.AddPass("ParticleReadback", RenderGraph::PassType::Transfer)
+		.Read(resources.control, ResourceUsage::TransferSrc)
+		.Write(resources.controlReadback, ResourceUsage::TransferDst)
+		.SetSideEffects()
+		.SetExecute([this](const RenderGraph::PassContext& context)
+		{
+			Frame& frame = m_Frames[m_CurrentFrame];
+			vk::BufferCopy region(0, 0, sizeof(Control));
+			context.commandBuffer.copyBuffer(m_Control.buffer, frame.controlReadback.buffer, region);
+
+			vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+			context.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+				vk::DependencyFlags(), barrier, nullptr, nullptr);
+			frame.pending = true;
+		});
+}
+
+void ParticleSystem::Draw(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, const glm::mat4& viewProjection, uint32_t viewBuffer) const
+{
+	// Particles are already in world space, so the model matrix is only the view projection.
+	vkInit::Constants constants{};
+	constants.model = viewProjection;
+	constants.instanceBuffer = m_InstanceSlot;
+	constants.viewBuffer = viewBuffer;
+	commandBuffer.pushConstants(layout, vkInit::ConstantsStages, 0, sizeof(constants), &constants);
+
+	commandBuffer.drawIndirect(m_Control.buffer, offsetof(Control, draw), 1, sizeof(vk::DrawIndirectCommand));
+}
+
+vkInit::Buffer ParticleSystem::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+	MemoryCategory category, const char* name)
+{
+	vkInit::BufferInput input{};
+	input.size = size;
+	input.usage = usage;
+	input.device = m_Device;
+	input.physicalDevice = m_PhysicalDevice;
+	input.properties = properties;
+	input.category = category;
+	input.name = name;
+	return vkInit::CreateBuffer(input);
+}
+
+void ParticleSystem::DestroyBuffer(vkInit::Buffer& buffer)
+{
+	m_Device.destroyBuffer(buffer.buffer);
+	vkInit::FreeMemory(m_Device, buffer.bufferMemory);
+	buffer = vkInit::Buffer{};
+}
+
+void ParticleSystem::Dispatch(vk::CommandBuffer commandBuffer, SimulateConstants& constants, Phase phase, uint32_t groupCount)
+{
+	constants.phase = phase;
+	commandBuffer.pushConstants(m_SimulatePipeline.layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+	commandBuffer.dispatch(groupCount, 1, 1);
+}
+
+void ParticleSystem::DispatchIndirect(vk::CommandBuffer commandBuffer, SimulateConstants& constants, Phase phase, vk::DeviceSize offset)
+{
+	constants.phase = phase;
+	commandBuffer.pushConstants(m_SimulatePipeline.layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+	commandBuffer.dispatchIndirect(m_Control.buffer, offset);
+}
\ No newline at end of file
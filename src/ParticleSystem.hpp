@@ -0,0 +1,149 @@
+#ifndef PARTICLE_SYSTEM_HPP
+#define PARTICLE_SYSTEM_HPP
+
+#include "Config.hpp"
+#include "RenderGraph.hpp"
+#include "Vulkan/Memory.hpp"
+#include "Vulkan/Descriptors.hpp"
+#include "Vulkan/Compute.hpp"
+#include "Vulkan/PushConstants.hpp"
+
+#include <chrono>
+
+struct ParticleSettings
+{
+	uint32_t capacity = 0;			// Particles alive at once, 0 disables the system.
+	float emitRate = 100000.0f;		// Particles emitted per second, while dead ones are left to reuse.
+	float lifetime = 2.0f;			// Seconds, 0 keeps emitted particles alive forever as animated instances.
+	float size = 0.15f;				// Scale applied to the triangle mesh.
+
+	glm::vec3 emitterPosition{ 0.0f, 0.5f, 0.0f };
+	float emitterRadius = 0.02f;
+	glm::vec3 emitterVelocity{ 0.0f, -1.2f, 0.0f };
+	float velocitySpread = 0.5f;	// Random speed added in every direction.
+	glm::vec3 gravity{ 0.0f, 1.5f, 0.0f };
+	float drag = 0.1f;
+};
+
+// Particles simulated and drawn entirely on the GPU. State lives in device local storage buffers, a compute pass emits
+// into free slots taken from a dead list, integrates the alive ones and compacts the survivors into the next frame's
+// alive list and an instance buffer, all through atomic counters. The draw reads its instance count from the same
+// counters, so the CPU never touches a particle and only learns the alive count a few frames late.
+class ParticleSystem
+{
+public:
+	// Counters and indirect arguments written by the simulation, matches Control in ParticleSimulate.comp.
+	struct Control
+	{
+		vk::DispatchIndirectCommand emitDispatch;
+		vk::DispatchIndirectCommand simulateDispatch;
+		vk::DrawIndirectCommand draw;
+		uint32_t deadCount;
+		uint32_t aliveCount[2];
+		uint32_t emitCount;
+		uint32_t padding[2];
+	};
+
+	// Graph handles of the resources used by the current frame.
+	struct FrameResources
+	{
+		RenderResource control, instances, controlReadback;
+	};
+
+	struct Input
+	{
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		vkInit::BindlessHeap* heap;
+		uint32_t framesInFlight;
+		ParticleSettings settings;
+	};
+
+	ParticleSystem(const Input& input);
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+	~ParticleSystem();
+
+	/// @brief Recreates the per-frame readback buffers. The device must be idle.
+	void Resize(uint32_t framesInFlight);
+
+	/// @brief Picks the readback buffer of frame, whose previous submission must have finished, and advances the simulation clock.
+	void BeginFrame(uint32_t frame);
+
+	FrameResources Import(RenderGraph& graph);
+
+	void AddSimulatePass(RenderGraph& graph, const FrameResources& resources);
+	void AddReadbackPass(RenderGraph& graph, const FrameResources& resources);
+
+	/// @brief Records the single indirect draw of every alive particle. The caller binds the pipeline, the bindless set and the vertex buffers.
+	/// viewBuffer is the view projections slot read by multiview pipelines.
+	void Draw(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, const glm::mat4& viewProjection, uint32_t viewBuffer = 0) const;
+
+	// Alive particles of the most recent frame that has been read back.
+	uint32_t GetAliveCount() const { return m_AliveCount; }
+	uint32_t GetCapacity() const { return m_Settings.capacity; }
+private:
+	struct Frame
+	{
+		vkInit::Buffer controlReadback;
+		const Control* mappedControl = nullptr;
+		bool pending = false;
+	};
+
+	enum Phase : uint32_t
+	{
+		PhaseReset = 0,		// Fills the dead list with every slot.
+		PhasePrepare = 1,	// Clamps the emit count to the dead list and writes the dispatch arguments.
+		PhaseEmit = 2,
+		PhaseSimulate = 3,
+		PhaseFinish = 4		// Writes the draw arguments.
+	};
+
+	struct SimulateConstants
+	{
+		glm::vec4 emitterPosition;	// w is the emitter radius.
+		glm::vec4 emitterVelocity;	// w is the velocity spread.
+		glm::vec4 gravity;			// w is the drag.
+		float deltaTime, lifetime, size;
+		uint32_t phase, capacity, emitCount, seed, current;
+		uint32_t particleBuffer, deadBuffer, aliveBuffer, nextAliveBuffer, instanceBuffer, controlBuffer;
+	};
+
+	vkInit::Buffer CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, const char* name);
+	void DestroyBuffer(vkInit::Buffer& buffer);
+	void Dispatch(vk::CommandBuffer commandBuffer, SimulateConstants& constants, Phase phase, uint32_t groupCount);
+	void DispatchIndirect(vk::CommandBuffer commandBuffer, SimulateConstants& constants, Phase phase, vk::DeviceSize offset);
+private:
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+	vkInit::BindlessHeap& m_Heap;
+	ParticleSettings m_Settings;
+
+	vkInit::ComputePipelineOutBundle m_SimulatePipeline;
+
+	// Shared by every frame in flight, each frame's simulation continues where the previous one left off.
+	vkInit::Buffer m_Particles, m_DeadList, m_Instances, m_Control;
+	std::array<vkInit::Buffer, 2> m_AliveLists;
+	uint32_t m_ParticleSlot = vkInit::InvalidBindlessIndex;
+	uint32_t m_DeadSlot = vkInit::InvalidBindlessIndex;
+	uint32_t m_InstanceSlot = vkInit::InvalidBindlessIndex;
+	uint32_t m_ControlSlot = vkInit::InvalidBindlessIndex;
+	std::array<uint32_t, 2> m_AliveSlots{ vkInit::InvalidBindlessIndex, vkInit::InvalidBindlessIndex };
+	bool m_Reset = true;
+
+	std::vector<Frame> m_Frames;
+	uint32_t m_CurrentFrame = 0;
+
+	// Alive list read by this frame's simulation, the other one receives the survivors.
+	uint32_t m_CurrentList = 0;
+	uint32_t m_Seed = 0;
+	float m_DeltaTime = 0.0f;
+	float m_EmitRemainder = 0.0f;
+	uint32_t m_EmitCount = 0;
+	std::chrono::steady_clock::time_point m_LastFrameTime;
+	bool m_Started = false;
+
+	uint32_t m_AliveCount = 0;
+};
+
+#endif // !PARTICLE_SYSTEM_HPP
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <cstdio>
+
+Profiler Profiler::s_Profiler;
+
+namespace
+{
+	// Buffer of the current thread, only valid while t_BufferOwner matches the profiler asking.
+	thread_local const Profiler* t_BufferOwner = nullptr;
+	thread_local void* t_Buffer = nullptr;
+
+	// Scopes still open when a capture ends may write past its end, leave them room before the oldest exported event.
+	constexpr uint64_t OpenScopeReserve = 256;
+
+	void AppendEscaped(std::string& output, const char* text)
+	{
+		for (; *text; text++)
+		{
+			if (*text == '"' || *text == '\\')
+				output.push_back('\\');
+			if (static_cast<unsigned char>(*text) >= 0x20)
+				output.push_back(*text);
+		}
+	}
+}
+
+void Profiler::SetThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+	std::scoped_lock lock(m_BuffersLock);
+	buffer.name = name;
+}
+
+void Profiler::BeginCapture()
+{
+	{
+		std::scoped_lock lock(m_BuffersLock);
+		for (const std::unique_ptr<ThreadBuffer>& buffer : m_Buffers)
+			buffer->captureStart = buffer->count.load(std::memory_order_acquire);
+		m_CaptureBegin = Now();
+	}
+
+	m_Capturing.store(true, std::memory_order_relaxed);
+}
+
+bool Profiler::EndCapture(const std::string& path)
+{
+	if (!m_Capturing.exchange(false, std::memory_order_relaxed))
+		return false;
+
+	uint64_t lostEvents = 0;
+	std::string json = ExportJson(lostEvents);
+
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		CONSOLE_ERROR("Failed to open %s for writing the trace!", path.c_str());
+		return false;
+	}
+	bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+	std::fclose(file);
+
+	if (lostEvents)
+		CONSOLE_WARN("Trace buffers overflowed, the oldest %llu events are missing from %s.", static_cast<unsigned long long>(lostEvents), path.c_str());
+	CONSOLE_INFO("Trace of %.2f ms written to %s.", (Now() - m_CaptureBegin) / 1e6, path.c_str());
+
+	return written;
+}
+
+void Profiler::CaptureFrames(uint64_t first, uint32_t count, const std::string& path)
+{
+	m_FirstFrame = first;
+	m_EndFrame = first + count;
+	m_FramesPath = path;
+}
+
+void Profiler::OnFrame(uint64_t frame)
+{
+	if (m_FramesPath.empty())
+		return;
+
+	if (frame == m_FirstFrame && !IsCapturing())
+		BeginCapture();
+	else if (frame >= m_EndFrame)
+	{
+		EndCapture(m_FramesPath);
+		m_FramesPath.clear();
+	}
+}
+
+void Profiler::Record(const char* name, uint64_t begin, uint64_t end)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+	uint64_t index = buffer.count.load(std::memory_order_relaxed);
+	buffer.events[index % ThreadBuffer::Capacity] = { name, begin, end };
+	buffer.count.store(index + 1, std::memory_order_release);
+}
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer()
+{
+	if (t_BufferOwner != this)
+	{
+		std::scoped_lock lock(m_BuffersLock);
+		m_Buffers.push_back(std::make_unique<ThreadBuffer>());
+		ThreadBuffer& buffer = *m_Buffers.back();
+		buffer.id = static_cast<uint32_t>(m_Buffers.size());
+		buffer.name = "Thread " + std::to_string(buffer.id);
+
+		t_Buffer = &buffer;
+		t_BufferOwner = this;
+	}
+
+	return *static_cast<ThreadBuffer*>(t_Buffer);
+}
+
+std::string Profiler::ExportJson(uint64_t& lostEvents)
+{
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	char number[160];
+
+	std::scoped_lock lock(m_BuffersLock);
+	for (const std::unique_ptr<ThreadBuffer>& buffer : m_Buffers)
+	{
+		json.append(first ? "" : ",").append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+		json.append(std::to_string(buffer->id)).append(",\"args\":{\"name\":\"");
+		AppendEscaped(json, buffer->name.c_str());
+		json.append("\"}}");
+		first = false;
+
+		uint64_t end = buffer->count.load(std::memory_order_acquire);
+		uint64_t begin = buffer->captureStart;
+		if (end - begin > ThreadBuffer::Capacity - OpenScopeReserve)
+		{
+			lostEvents += end - begin - (ThreadBuffer::Capacity - OpenScopeReserve);
+			begin = end - (ThreadBuffer::Capacity - OpenScopeReserve);
+		}
+
+		for (uint64_t i = begin; i < end; i++)
+		{
+			const Event& event = buffer->events[i % ThreadBuffer::Capacity];
+			json.append(",{\"name\":\"");
+			AppendEscaped(json, event.name);
+
+			// Relative to the capture in microseconds, as the format expects.
+			int64_t start = static_cast<int64_t>(event.begin - m_CaptureBegin);
+			std::snprintf(number, sizeof(number), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->id, start / 1000.0, (event.end - event.begin) / 1000.0);
+			json.append(number);
+		}
+	}
+	json.append("]}");
+
+	return json;
+}
\ No newline at end of file
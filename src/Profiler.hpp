@@ -0,0 +1,114 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU tracing profiler. Scopes record their begin and end time into a buffer owned by the recording thread,
+// without locks, and a capture exports the scopes recorded meanwhile as Chrome trace event JSON
+// (chrome://tracing, ui.perfetto.dev).
+// Scopes only cost a relaxed load outside of captures, and nothing at all when built without ENABLE_PROFILING.
+class Profiler
+{
+public:
+	Profiler() = default;
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	static Profiler& Get() { return s_Profiler; }
+
+	/// @brief Names the calling thread in exported traces.
+	void SetThreadName(const std::string& name);
+
+	/// @brief Starts recording scopes on every thread.
+	void BeginCapture();
+
+	/// @brief Stops recording and writes everything recorded since BeginCapture to path. Returns false if the file could not be written.
+	bool EndCapture(const std::string& path);
+
+	/// @brief Captures frames [first, first + count) into path, OnFrame has to be called at the start of every frame.
+	void CaptureFrames(uint64_t first, uint32_t count, const std::string& path);
+	void OnFrame(uint64_t frame);
+
+	bool IsCapturing() const { return m_Capturing.load(std::memory_order_relaxed); }
+
+	uint64_t Now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// @brief Adds a finished scope to the calling thread's buffer. name must outlive the capture, e.g. a string literal.
+	void Record(const char* name, uint64_t begin, uint64_t end);
+private:
+	struct Event
+	{
+		const char* name;
+		uint64_t begin, end;	// Steady clock nanoseconds.
+	};
+
+	// Ring of the events of one thread. Only the owning thread writes, captures read [captureStart, count).
+	struct ThreadBuffer
+	{
+		static constexpr uint64_t Capacity = 1 << 16;
+
+		std::unique_ptr<Event[]> events{ new Event[Capacity] };
+		std::atomic<uint64_t> count{ 0 };
+		uint64_t captureStart = 0;
+		uint32_t id = 0;
+		std::string name;
+	};
+
+	ThreadBuffer& GetThreadBuffer();
+	std::string ExportJson(uint64_t& lostEvents);
+private:
+	std::atomic<bool> m_Capturing{ false };
+	uint64_t m_CaptureBegin = 0;
+
+	// Every thread that ever recorded, buffers live as long as the profiler.
+	std::vector<std::unique_ptr<ThreadBuffer>> m_Buffers;
+	std::mutex m_BuffersLock;
+
+	// Frame range of a scheduled capture.
+	uint64_t m_FirstFrame = 0, m_EndFrame = 0;
+	std::string m_FramesPath;
+
+	static Profiler s_Profiler;
+};
+
+// Records the time from its construction to the end of the enclosing scope, if a capture was running when it started.
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) : m_Name(name), m_Begin(Profiler::Get().IsCapturing() ? Profiler::Get().Now() : 0) {}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	~ProfileScope()
+	{
+		if (m_Begin)
+			Profiler::Get().Record(m_Name, m_Begin, Profiler::Get().Now());
+	}
+private:
+	const char* m_Name;
+	uint64_t m_Begin;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_PROFILING
+	#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+	#define PROFILE_THREAD(name) Profiler::Get().SetThreadName(name)
+	#define PROFILE_FRAME(frame) Profiler::Get().OnFrame(frame)
+#else
+	#define PROFILE_SCOPE(name) ((void)0)
+	#define PROFILE_THREAD(name) ((void)0)
+	#define PROFILE_FRAME(frame) ((void)0)
+#endif
+
+#endif // !PROFILER_HPP
\ No newline at end of file
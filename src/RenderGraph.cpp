@@ -0,0 +1,1010 @@
+#include "RenderGraph.hpp"
+#include "GpuProfiler.hpp"
+#include "DeletionQueue.hpp"
+#include "Vulkan/Memory.hpp"
+#include "Vulkan/Image.hpp"
+
+namespace
+{
+	struct UsageState
+	{
+		vk::PipelineStageFlags stages;
+		vk::AccessFlags access;
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	};
+
+	const vk::AccessFlags WriteAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite |
+		vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferWrite |
+		vk::AccessFlagBits::eHostWrite | vk::AccessFlagBits::eMemoryWrite;
+
+	UsageState GetUsageState(ResourceUsage usage, RenderGraph::PassType type)
+	{
+		using Stage = vk::PipelineStageFlagBits;
+		using Access = vk::AccessFlagBits;
+		using Layout = vk::ImageLayout;
+
+		vk::PipelineStageFlags shaderStages = type == RenderGraph::PassType::Compute ?
+			vk::PipelineStageFlags(Stage::eComputeShader) : Stage::eVertexShader | Stage::eFragmentShader;
+
+		switch (usage)
+		{
+		case ResourceUsage::ColorAttachment:
+			return { Stage::eColorAttachmentOutput, Access::eColorAttachmentRead | Access::eColorAttachmentWrite, Layout::eColorAttachmentOptimal };
+		case ResourceUsage::DepthAttachment:
+			return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+				Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite, Layout::eDepthStencilAttachmentOptimal };
+		case ResourceUsage::DepthRead:
+			return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Access::eDepthStencilAttachmentRead, Layout::eDepthStencilReadOnlyOptimal };
+		case ResourceUsage::Sampled:
+			return { shaderStages, Access::eShaderRead, Layout::eShaderReadOnlyOptimal };
+		case ResourceUsage::StorageRead:
+			return { shaderStages, Access::eShaderRead, Layout::eGeneral };
+		case ResourceUsage::StorageWrite:
+			return { shaderStages, Access::eShaderRead | Access::eShaderWrite, Layout::eGeneral };
+		case ResourceUsage::UniformBuffer:
+			return { shaderStages, Access::eUniformRead };
+		case ResourceUsage::VertexBuffer:
+			return { Stage::eVertexInput, Access::eVertexAttributeRead };
+		case ResourceUsage::IndexBuffer:
+			return { Stage::eVertexInput, Access::eIndexRead };
+		case ResourceUsage::IndirectBuffer:
+			return { Stage::eDrawIndirect, Access::eIndirectCommandRead };
+		case ResourceUsage::TransferSrc:
+			return { Stage::eTransfer, Access::eTransferRead, Layout::eTransferSrcOptimal };
+		case ResourceUsage::TransferDst:
+			return { Stage::eTransfer, Access::eTransferWrite, Layout::eTransferDstOptimal };
+		}
+
+		return { Stage::eAllCommands, Access::eMemoryRead | Access::eMemoryWrite, Layout::eGeneral };
+	}
+
+	vk::ImageUsageFlags GetImageUsage(ResourceUsage usage)
+	{
+		switch (usage)
+		{
+		case ResourceUsage::ColorAttachment:	return vk::ImageUsageFlagBits::eColorAttachment;
+		case ResourceUsage::DepthAttachment:
+		case ResourceUsage::DepthRead:			return vk::ImageUsageFlagBits::eDepthStencilAttachment;
+		case ResourceUsage::Sampled:			return vk::ImageUsageFlagBits::eSampled;
+		case ResourceUsage::StorageRead:
+		case ResourceUsage::StorageWrite:		return vk::ImageUsageFlagBits::eStorage;
+		case ResourceUsage::TransferSrc:		return vk::ImageUsageFlagBits::eTransferSrc;
+		case ResourceUsage::TransferDst:		return vk::ImageUsageFlagBits::eTransferDst;
+		default:								return vk::ImageUsageFlags();
+		}
+	}
+
+	vk::BufferUsageFlags GetBufferUsage(ResourceUsage usage)
+	{
+		switch (usage)
+		{
+		case ResourceUsage::StorageRead:
+		case ResourceUsage::StorageWrite:		return vk::BufferUsageFlagBits::eStorageBuffer;
+		case ResourceUsage::UniformBuffer:		return vk::BufferUsageFlagBits::eUniformBuffer;
+		case ResourceUsage::VertexBuffer:		return vk::BufferUsageFlagBits::eVertexBuffer;
+		case ResourceUsage::IndexBuffer:		return vk::BufferUsageFlagBits::eIndexBuffer;
+		case ResourceUsage::IndirectBuffer:		return vk::BufferUsageFlagBits::eIndirectBuffer;
+		case ResourceUsage::TransferSrc:		return vk::BufferUsageFlagBits::eTransferSrc;
+		case ResourceUsage::TransferDst:		return vk::BufferUsageFlagBits::eTransferDst;
+		default:								return vk::BufferUsageFlags();
+		}
+	}
+
+	template<typename T>
+	void HashCombine(size_t& seed, const T& value)
+	{
+		seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteColor(RenderResource image, std::optional<vk::ClearColorValue> clear)
+{
+	std::optional<vk::ClearValue> value;
+	if (clear)
+		value = vk::ClearValue(*clear);
+	return AddAccess(image, ResourceUsage::ColorAttachment, true, true, value);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteDepth(RenderResource image, std::optional<vk::ClearDepthStencilValue> clear)
+{
+	std::optional<vk::ClearValue> value;
+	if (clear)
+		value = vk::ClearValue(*clear);
+	return AddAccess(image, ResourceUsage::DepthAttachment, true, true, value);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadDepth(RenderResource image)
+{
+	return AddAccess(image, ResourceUsage::DepthRead, false, true);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(RenderResource resource, ResourceUsage usage)
+{
+	return AddAccess(resource, usage, false, false);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(RenderResource resource, ResourceUsage usage)
+{
+	return AddAccess(resource, usage, true, false);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetSideEffects()
+{
+	m_Graph.m_Passes[m_Pass].sideEffects = true;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetSecondaryCommandBuffers(bool secondary)
+{
+	m_Graph.m_Passes[m_Pass].secondary = secondary;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetViewMask(uint32_t viewMask)
+{
+	m_Graph.m_Passes[m_Pass].viewMask = viewMask;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetRenderArea(vk::Extent2D extent)
+{
+	m_Graph.m_Passes[m_Pass].renderArea = extent;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetExecute(ExecuteFunction function)
+{
+	m_Graph.m_Passes[m_Pass].execute = std::move(function);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::AddAccess(RenderResource resource, ResourceUsage usage, bool write, bool attachment,
+	std::optional<vk::ClearValue> clear)
+{
+	if (resource >= m_Graph.m_Resources.size())
+	{
+		CONSOLE_ERROR("Render graph pass %s uses an invalid resource!", m_Graph.m_Passes[m_Pass].name.c_str());
+		return *this;
+	}
+
+	m_Graph.m_Passes[m_Pass].accesses.push_back({ resource, usage, write, attachment, clear });
+	return *this;
+}
+
+RenderGraph::RenderGraph(vk::Device device, vk::PhysicalDevice physicalDevice) : m_Device(device), m_PhysicalDevice(physicalDevice)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+	ReleaseCompiled();
+}
+
+void RenderGraph::Begin()
+{
+	m_Resources.clear();
+	m_Passes.clear();
+}
+
+RenderResource RenderGraph::CreateImage(const std::string& name, const RenderImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.imageDesc = desc;
+	m_Resources.push_back(resource);
+	return static_cast<RenderResource>(m_Resources.size() - 1);
+}
+
+RenderResource RenderGraph::CreateBuffer(const std::string& name, const RenderBufferDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.image = false;
+	resource.bufferDesc = desc;
+	m_Resources.push_back(resource);
+	return static_cast<RenderResource>(m_Resources.size() - 1);
+}
+
+RenderResource RenderGraph::ImportImage(const std::string& name, const RenderImageDesc& desc, const RenderImageImport& import)
+{
+	Resource resource;
+	resource.name = name;
+	resource.imported = true;
+	resource.imageDesc = desc;
+	resource.import = import;
+	m_Resources.push_back(resource);
+	return static_cast<RenderResource>(m_Resources.size() - 1);
+}
+
+RenderResource RenderGraph::ImportBuffer(const std::string& name, vk::Buffer buffer, vk::DeviceSize size,
+	vk::PipelineStageFlags initialStages, vk::AccessFlags initialAccess)
+{
+	Resource resource;
+	resource.name = name;
+	resource.image = false;
+	resource.imported = true;
+	resource.bufferDesc.size = size;
+	resource.importedBuffer = buffer;
+	resource.bufferInitialStages = initialStages;
+	resource.bufferInitialAccess = initialAccess;
+	m_Resources.push_back(resource);
+	return static_cast<RenderResource>(m_Resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(const std::string& name, PassType type)
+{
+	Pass pass;
+	pass.name = name;
+	pass.type = type;
+	m_Passes.push_back(std::move(pass));
+	return PassBuilder(*this, static_cast<uint32_t>(m_Passes.size() - 1));
+}
+
+bool RenderGraph::Compile()
+{
+	size_t hash = HashDeclaration();
+	if (m_Compiled && hash == m_CompiledHash)
+		return false;
+
+	PROFILE_SCOPE("RenderGraph::Compile");
+
+	// Frames in flight may still use the previous render passes and transient memory, they are either retired until those
+	// frames finish or the device has to go idle first.
+	if (m_Compiled)
+	{
+		if (!m_DeletionQueue)
+			m_Device.waitIdle();
+		ReleaseCompiled();
+	}
+
+	std::vector<uint32_t> order;
+	CullPasses(order);
+
+	for (uint32_t pass : order)
+	{
+		CompiledPass compiled{};
+		compiled.pass = pass;
+		m_CompiledPasses.push_back(std::move(compiled));
+	}
+
+	CreateTransients();
+	BuildBarriers();
+	CreateRenderPasses();
+
+	m_CompiledHash = hash;
+	m_Compiled = true;
+
+	m_Stats.passCount = static_cast<uint32_t>(m_CompiledPasses.size());
+	m_Stats.culledPassCount = static_cast<uint32_t>(m_Passes.size() - m_CompiledPasses.size());
+	m_Stats.barrierBatchCount = m_Stats.imageBarrierCount = m_Stats.bufferBarrierCount = 0;
+	auto countBatch = [this](const BarrierBatch& batch)
+	{
+		if (batch.IsEmpty())
+			return;
+		m_Stats.barrierBatchCount++;
+		for (const Barrier& barrier : batch.barriers)
+			(m_Resources[barrier.resource].image ? m_Stats.imageBarrierCount : m_Stats.bufferBarrierCount)++;
+	};
+	for (const CompiledPass& compiled : m_CompiledPasses)
+		countBatch(compiled.barriers);
+	countBatch(m_FinalBarriers);
+	m_Stats.compileCount++;
+
+	CONSOLE_DEBUG("Compiled render graph: %u passes (%u culled), %u barrier batches with %u image and %u buffer barriers, "
+		"%u transient resources in %llu KiB (%llu KiB without aliasing).",
+		m_Stats.passCount, m_Stats.culledPassCount, m_Stats.barrierBatchCount, m_Stats.imageBarrierCount, m_Stats.bufferBarrierCount,
+		m_Stats.transientResourceCount, static_cast<unsigned long long>(m_Stats.transientAllocatedBytes / 1024),
+		static_cast<unsigned long long>(m_Stats.transientRequestedBytes / 1024));
+
+	return true;
+}
+
+void RenderGraph::Execute(vk::CommandBuffer commandBuffer)
+{
+	PROFILE_SCOPE("RenderGraph::Execute");
+	if (!m_Compiled)
+	{
+		CONSOLE_ERROR("Render graph executed before it was compiled!");
+		return;
+	}
+
+	for (CompiledPass& compiled : m_CompiledPasses)
+	{
+		RecordBarriers(commandBuffer, compiled.barriers);
+
+		const Pass& pass = m_Passes[compiled.pass];
+		PassContext context{ commandBuffer, compiled.renderPass, nullptr, compiled.extent, this };
+
+		// Barriers stay outside the timed range, a pass is measured from its first to its last command.
+		if (m_GpuProfiler)
+			context.pipelineStatistics = m_GpuProfiler->BeginPass(commandBuffer, pass.name, pass.secondary);
+
+		if (!compiled.renderPass)
+		{
+			if (pass.execute)
+				pass.execute(context);
+			if (m_GpuProfiler)
+				m_GpuProfiler->EndPass(commandBuffer);
+			continue;
+		}
+
+		// Clear values are read from this frame's declaration, they are not part of the compiled graph.
+		std::vector<vk::ClearValue> clearValues;
+		for (uint32_t access : compiled.attachments)
+			clearValues.push_back(pass.accesses[access].clear.value_or(vk::ClearValue()));
+
+		vk::RenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.renderPass = compiled.renderPass;
+		renderPassInfo.framebuffer = GetFramebuffer(compiled);
+		context.framebuffer = renderPassInfo.framebuffer;
+		renderPassInfo.renderArea.offset.x = 0;
+		renderPassInfo.renderArea.offset.y = 0;
+		renderPassInfo.renderArea.extent = compiled.extent;
+		if (pass.renderArea)
+		{
+			renderPassInfo.renderArea.extent.width = std::min(pass.renderArea->width, compiled.extent.width);
+			renderPassInfo.renderArea.extent.height = std::min(pass.renderArea->height, compiled.extent.height);
+		}
+		context.extent = renderPassInfo.renderArea.extent;
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues = clearValues.data();
+
+		// Not part of the compiled graph either, the render pass is compatible with both.
+		commandBuffer.beginRenderPass(&renderPassInfo, pass.secondary ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+		if (pass.execute)
+			pass.execute(context);
+		commandBuffer.endRenderPass();
+
+		if (m_GpuProfiler)
+			m_GpuProfiler->EndPass(commandBuffer);
+	}
+
+	RecordBarriers(commandBuffer, m_FinalBarriers);
+}
+
+void RenderGraph::Invalidate()
+{
+	ReleaseCompiled();
+}
+
+vk::RenderPass RenderGraph::GetRenderPass(const std::string& pass) const
+{
+	for (const CompiledPass& compiled : m_CompiledPasses)
+		if (m_Passes[compiled.pass].name == pass)
+			return compiled.renderPass;
+
+	return nullptr;
+}
+
+vk::Image RenderGraph::GetImage(RenderResource resource) const
+{
+	const Resource& declared = m_Resources[resource];
+	if (declared.imported)
+		return declared.import.image;
+	return resource < m_Transients.size() ? m_Transients[resource].image : nullptr;
+}
+
+vk::ImageView RenderGraph::GetImageView(RenderResource resource) const
+{
+	const Resource& declared = m_Resources[resource];
+	if (declared.imported)
+		return declared.import.view;
+	return resource < m_Transients.size() ? m_Transients[resource].view : nullptr;
+}
+
+vk::Buffer RenderGraph::GetBuffer(RenderResource resource) const
+{
+	const Resource& declared = m_Resources[resource];
+	if (declared.imported)
+		return declared.importedBuffer;
+	return resource < m_Transients.size() ? m_Transients[resource].buffer : nullptr;
+}
+
+size_t RenderGraph::HashDeclaration() const
+{
+	// Only what changes the compiled result is hashed, imported handles and clear values may change every frame.
+	size_t hash = 0;
+	for (const Resource& resource : m_Resources)
+	{
+		HashCombine(hash, resource.name);
+		HashCombine(hash, resource.image);
+		HashCombine(hash, resource.imported);
+		HashCombine(hash, static_cast<uint32_t>(resource.imageDesc.format));
+		HashCombine(hash, resource.imageDesc.extent.width);
+		HashCombine(hash, resource.imageDesc.extent.height);
+		HashCombine(hash, static_cast<VkImageAspectFlags>(resource.imageDesc.aspect));
+		HashCombine(hash, resource.imageDesc.mipLevels);
+		HashCombine(hash, resource.imageDesc.arrayLayers);
+		HashCombine(hash, resource.bufferDesc.size);
+		HashCombine(hash, static_cast<uint32_t>(resource.import.initialLayout));
+		HashCombine(hash, static_cast<uint32_t>(resource.import.finalLayout));
+		HashCombine(hash, static_cast<VkPipelineStageFlags>(resource.import.initialStages));
+		HashCombine(hash, static_cast<VkPipelineStageFlags>(resource.bufferInitialStages));
+		HashCombine(hash, static_cast<VkAccessFlags>(resource.bufferInitialAccess));
+	}
+
+	for (const Pass& pass : m_Passes)
+	{
+		HashCombine(hash, pass.name);
+		HashCombine(hash, static_cast<uint32_t>(pass.type));
+		HashCombine(hash, pass.sideEffects);
+		HashCombine(hash, pass.viewMask);
+		for (const ResourceAccess& access : pass.accesses)
+		{
+			HashCombine(hash, access.resource);
+			HashCombine(hash, static_cast<uint32_t>(access.usage));
+			HashCombine(hash, access.write);
+			HashCombine(hash, access.attachment);
+			HashCombine(hash, access.clear.has_value());
+		}
+	}
+
+	return hash;
+}
+
+void RenderGraph::CullPasses(std::vector<uint32_t>& order) const
+{
+	// Walk backwards from the passes that write imported resources or have side effects, keeping every pass
+	// that writes something a kept pass reads later on.
+	std::vector<uint8_t> needed(m_Resources.size(), 0);
+	for (size_t i = 0; i < m_Resources.size(); i++)
+		needed[i] = m_Resources[i].imported;
+
+	std::vector<uint8_t> keep(m_Passes.size(), 0);
+	for (size_t p = m_Passes.size(); p-- > 0;)
+	{
+		const Pass& pass = m_Passes[p];
+
+		bool kept = pass.sideEffects;
+		for (const ResourceAccess& access : pass.accesses)
+			kept |= access.write && needed[access.resource];
+
+		if (!kept)
+			continue;
+		keep[p] = 1;
+
+		// A cleared attachment is fully overwritten, whatever wrote it before is not needed for this pass.
+		for (const ResourceAccess& access : pass.accesses)
+			if (access.attachment && access.clear)
+				needed[access.resource] = m_Resources[access.resource].imported;
+
+		// Attachments that are loaded count as reads.
+		for (const ResourceAccess& access : pass.accesses)
+			if (!access.write || (access.attachment && !access.clear))
+				needed[access.resource] = 1;
+	}
+
+	for (uint32_t p = 0; p < m_Passes.size(); p++)
+	{
+		if (keep[p])
+			order.push_back(p);
+		else
+			CONSOLE_DEBUG("Render graph culled pass %s.", m_Passes[p].name.c_str());
+	}
+}
+
+void RenderGraph::CreateTransients()
+{
+	const size_t resourceCount = m_Resources.size();
+	m_Transients.assign(resourceCount, Transient{});
+	m_FirstUse.assign(resourceCount, UINT32_MAX);
+	m_LastUse.assign(resourceCount, UINT32_MAX);
+
+	std::vector<vk::ImageUsageFlags> imageUsage(resourceCount);
+	std::vector<vk::BufferUsageFlags> bufferUsage(resourceCount);
+	for (uint32_t i = 0; i < m_CompiledPasses.size(); i++)
+	{
+		for (const ResourceAccess& access : m_Passes[m_CompiledPasses[i].pass].accesses)
+		{
+			RenderResource resource = access.resource;
+			if (m_FirstUse[resource] == UINT32_MAX)
+				m_FirstUse[resource] = i;
+			m_LastUse[resource] = i;
+			imageUsage[resource] |= GetImageUsage(access.usage);
+			bufferUsage[resource] |= GetBufferUsage(access.usage);
+		}
+	}
+
+	// Transients in order of first use, so each one can take over the memory of one that is already dead.
+	std::vector<RenderResource> transients;
+	for (RenderResource resource = 0; resource < resourceCount; resource++)
+		if (!m_Resources[resource].imported && m_FirstUse[resource] != UINT32_MAX)
+			transients.push_back(resource);
+	std::sort(transients.begin(), transients.end(), [this](RenderResource a, RenderResource b) { return m_FirstUse[a] < m_FirstUse[b]; });
+
+	struct Block
+	{
+		vk::DeviceSize size = 0;
+		uint32_t memoryTypeBits = ~0u;
+		uint32_t lastUse = 0;
+		std::vector<RenderResource> resources;
+	};
+	std::vector<Block> blocks;
+	std::vector<vk::MemoryRequirements> requirements(resourceCount);
+
+	m_Stats.transientResourceCount = static_cast<uint32_t>(transients.size());
+	m_Stats.transientRequestedBytes = 0;
+	m_Stats.transientAllocatedBytes = 0;
+
+	for (RenderResource resource : transients)
+	{
+		const Resource& declared = m_Resources[resource];
+		Transient& transient = m_Transients[resource];
+
+		if (declared.image)
+		{
+			vkInit::ImageInput input{};
+			input.device = m_Device;
+			input.format = declared.imageDesc.format;
+			input.extent = declared.imageDesc.extent;
+			input.usage = imageUsage[resource];
+			input.mipLevels = declared.imageDesc.mipLevels;
+			input.arrayLayers = declared.imageDesc.arrayLayers;
+			transient.image = vkInit::CreateImage(input);
+			if (!transient.image)
+				continue;
+			requirements[resource] = m_Device.getImageMemoryRequirements(transient.image);
+		}
+		else
+		{
+			vk::BufferCreateInfo bufferInfo{};
+			bufferInfo.size = declared.bufferDesc.size;
+			bufferInfo.usage = bufferUsage[resource];
+			bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+			try
+			{
+				transient.buffer = m_Device.createBuffer(bufferInfo);
+			}
+			catch (const vk::SystemError& err)
+			{
+				CONSOLE_ERROR("Failed to create render graph buffer %s! %s", declared.name.c_str(), err.what());
+				continue;
+			}
+			requirements[resource] = m_Device.getBufferMemoryRequirements(transient.buffer);
+		}
+
+		const vk::MemoryRequirements& required = requirements[resource];
+		m_Stats.transientRequestedBytes += required.size;
+
+		// Best fit among the blocks whose last user is done before this resource starts, growing the largest one if none fits.
+		uint32_t best = UINT32_MAX;
+		for (uint32_t b = 0; b < blocks.size(); b++)
+		{
+			const Block& block = blocks[b];
+			if (block.lastUse >= m_FirstUse[resource] || !(block.memoryTypeBits & required.memoryTypeBits))
+				continue;
+
+			if (best == UINT32_MAX)
+			{
+				best = b;
+				continue;
+			}
+
+			bool fits = block.size >= required.size;
+			bool bestFits = blocks[best].size >= required.size;
+			if ((fits && (!bestFits || block.size < blocks[best].size)) || (!fits && !bestFits && block.size > blocks[best].size))
+				best = b;
+		}
+
+		if (best == UINT32_MAX)
+		{
+			best = static_cast<uint32_t>(blocks.size());
+			blocks.emplace_back();
+		}
+
+		Block& block = blocks[best];
+		block.size = std::max(block.size, required.size);
+		block.memoryTypeBits &= required.memoryTypeBits;
+		block.lastUse = m_LastUse[resource];
+		block.resources.push_back(resource);
+		transient.block = best;
+	}
+
+	for (uint32_t b = 0; b < blocks.size(); b++)
+	{
+		const Block& block = blocks[b];
+		uint32_t memoryType = vkInit::FindMemoryTypeIndex(m_PhysicalDevice, block.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		vk::DeviceMemory memory = vkInit::AllocateDeviceMemory(m_Device, memoryType, block.size, MemoryCategory::Transient, "Render graph transients");
+		m_Memory.push_back(memory);
+		m_Stats.transientAllocatedBytes += block.size;
+
+		for (size_t i = 0; i < block.resources.size(); i++)
+		{
+			RenderResource resource = block.resources[i];
+			Transient& transient = m_Transients[resource];
+			transient.previous = block.resources[(i + block.resources.size() - 1) % block.resources.size()];
+
+			if (!memory)
+				continue;
+
+			const Resource& declared = m_Resources[resource];
+			if (declared.image)
+			{
+				m_Device.bindImageMemory(transient.image, memory, 0);
+				transient.view = vkInit::CreateImageView(m_Device, transient.image, declared.imageDesc.format, declared.imageDesc.aspect,
+					0, declared.imageDesc.mipLevels, declared.imageDesc.arrayLayers);
+			}
+			else
+			{
+				m_Device.bindBufferMemory(transient.buffer, memory, 0);
+			}
+		}
+	}
+}
+
+void RenderGraph::BuildBarriers()
+{
+	struct State
+	{
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+		vk::PipelineStageFlags writeStages;	// Stages of the last write or layout transition.
+		vk::AccessFlags writeAccess;
+		vk::PipelineStageFlags readStages;	// Stages and accesses the last write has been made visible to.
+		vk::AccessFlags readAccess;
+	};
+
+	const size_t resourceCount = m_Resources.size();
+
+	// Everything a transient does within the frame, the next user of its memory has to wait for all of it.
+	std::vector<vk::PipelineStageFlags> usedStages(resourceCount);
+	std::vector<vk::AccessFlags> writtenAccess(resourceCount);
+	for (const CompiledPass& compiled : m_CompiledPasses)
+	{
+		const Pass& pass = m_Passes[compiled.pass];
+		for (const ResourceAccess& access : pass.accesses)
+		{
+			UsageState usage = GetUsageState(access.usage, pass.type);
+			usedStages[access.resource] |= usage.stages;
+			if (access.write)
+				writtenAccess[access.resource] |= usage.access & WriteAccessMask;
+		}
+	}
+
+	std::vector<State> states(resourceCount);
+	for (RenderResource resource = 0; resource < resourceCount; resource++)
+	{
+		const Resource& declared = m_Resources[resource];
+		State& state = states[resource];
+
+		if (declared.imported)
+		{
+			if (declared.image)
+			{
+				state.layout = declared.import.initialLayout;
+				state.writeStages = declared.import.initialStages;
+			}
+			else
+			{
+				state.writeStages = declared.bufferInitialStages;
+				state.writeAccess = declared.bufferInitialAccess;
+			}
+		}
+		else if (m_Transients[resource].previous != InvalidRenderResource)
+		{
+			// Aliasing barrier against the previous user of the memory, in this frame or the last one.
+			RenderResource previous = m_Transients[resource].previous;
+			state.writeStages = usedStages[previous];
+			state.writeAccess = writtenAccess[previous];
+		}
+	}
+
+	for (CompiledPass& compiled : m_CompiledPasses)
+	{
+		const Pass& pass = m_Passes[compiled.pass];
+		BarrierBatch& batch = compiled.barriers;
+
+		// A pass may use the same resource more than once, merge its uses into one state.
+		struct Use
+		{
+			RenderResource resource;
+			UsageState usage;
+			bool write;
+		};
+		std::vector<Use> uses;
+		for (const ResourceAccess& access : pass.accesses)
+		{
+			UsageState usage = GetUsageState(access.usage, pass.type);
+			auto use = std::find_if(uses.begin(), uses.end(), [&access](const Use& other) { return other.resource == access.resource; });
+			if (use == uses.end())
+			{
+				uses.push_back({ access.resource, usage, access.write });
+				continue;
+			}
+
+			use->usage.stages |= usage.stages;
+			use->usage.access |= usage.access;
+			use->write |= access.write;
+			if (use->usage.layout != usage.layout)
+				use->usage.layout = vk::ImageLayout::eGeneral;
+		}
+
+		for (const Use& use : uses)
+		{
+			State& state = states[use.resource];
+			const bool image = m_Resources[use.resource].image;
+			const bool transition = image && state.layout != use.usage.layout;
+
+			if (use.write || transition)
+			{
+				// Write after write or read, or a layout transition: wait for everything since the last write.
+				vk::PipelineStageFlags srcStages = state.writeStages | state.readStages;
+				if (transition || state.writeAccess)
+				{
+					batch.barriers.push_back({ use.resource, state.writeAccess, use.usage.access,
+						image ? state.layout : vk::ImageLayout::eUndefined, image ? use.usage.layout : vk::ImageLayout::eUndefined });
+					batch.srcStages |= srcStages;
+					batch.dstStages |= use.usage.stages;
+				}
+				else if (srcStages)
+				{
+					// Write after read only needs an execution dependency.
+					batch.srcStages |= srcStages;
+					batch.dstStages |= use.usage.stages;
+				}
+
+				state.layout = image ? use.usage.layout : vk::ImageLayout::eUndefined;
+				state.writeStages = use.usage.stages;
+				state.writeAccess = use.write ? use.usage.access & WriteAccessMask : vk::AccessFlags();
+				state.readStages = use.write ? vk::PipelineStageFlags() : use.usage.stages;
+				state.readAccess = use.write ? vk::AccessFlags() : use.usage.access;
+				continue;
+			}
+
+			// Read after write, skipped if an earlier barrier already made the write visible to these stages.
+			bool visible = !(use.usage.stages & ~state.readStages) && !(use.usage.access & ~state.readAccess);
+			if (!visible && state.writeStages)
+			{
+				if (state.writeAccess)
+					batch.barriers.push_back({ use.resource, state.writeAccess, use.usage.access, state.layout, state.layout });
+				batch.srcStages |= state.writeStages;
+				batch.dstStages |= use.usage.stages;
+			}
+
+			state.readStages |= use.usage.stages;
+			state.readAccess |= use.usage.access;
+		}
+	}
+
+	// Hand imported images over in the layout their owner expects, e.g. for presentation.
+	for (RenderResource resource = 0; resource < resourceCount; resource++)
+	{
+		const Resource& declared = m_Resources[resource];
+		const State& state = states[resource];
+		if (!declared.imported || !declared.image || declared.import.finalLayout == vk::ImageLayout::eUndefined ||
+			declared.import.finalLayout == state.layout)
+			continue;
+
+		m_FinalBarriers.barriers.push_back({ resource, state.writeAccess, vk::AccessFlags(), state.layout, declared.import.finalLayout });
+		m_FinalBarriers.srcStages |= state.writeStages | state.readStages;
+		m_FinalBarriers.dstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+	}
+}
+
+void RenderGraph::CreateRenderPasses()
+{
+	for (uint32_t i = 0; i < m_CompiledPasses.size(); i++)
+	{
+		CompiledPass& compiled = m_CompiledPasses[i];
+		const Pass& pass = m_Passes[compiled.pass];
+		if (pass.type != PassType::Graphics)
+			continue;
+
+		std::vector<vk::AttachmentDescription> attachments;
+		std::vector<vk::AttachmentReference> colorReferences;
+		std::optional<vk::AttachmentReference> depthReference;
+
+		for (uint32_t a = 0; a < pass.accesses.size(); a++)
+		{
+			const ResourceAccess& access = pass.accesses[a];
+			if (!access.attachment)
+				continue;
+
+			const Resource& declared = m_Resources[access.resource];
+			UsageState usage = GetUsageState(access.usage, pass.type);
+
+			// Contents are only worth loading if something wrote them before, and only worth storing if someone reads them later.
+			bool firstUse = m_FirstUse[access.resource] == i;
+			bool hasContents = !firstUse || (declared.imported && declared.import.initialLayout != vk::ImageLayout::eUndefined);
+			bool usedLater = declared.imported || m_LastUse[access.resource] > i;
+
+			vk::AttachmentDescription attachment{};
+			attachment.flags = vk::AttachmentDescriptionFlags();
+			attachment.format = declared.imageDesc.format;
+			attachment.samples = vk::SampleCountFlagBits::e1;
+			attachment.loadOp = access.clear ? vk::AttachmentLoadOp::eClear : hasContents ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eDontCare;
+			attachment.storeOp = usedLater ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+			attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+			attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+
+			// Layout transitions are done by the graph's barriers, not by the render pass.
+			attachment.initialLayout = usage.layout;
+			attachment.finalLayout = usage.layout;
+
+			vk::AttachmentReference reference{};
+			reference.attachment = static_cast<uint32_t>(attachments.size());
+			reference.layout = usage.layout;
+
+			if (access.usage == ResourceUsage::ColorAttachment)
+				colorReferences.push_back(reference);
+			else
+				depthReference = reference;
+
+			attachments.push_back(attachment);
+			compiled.attachments.push_back(a);
+
+			compiled.extent = compiled.attachments.size() == 1 ? declared.imageDesc.extent :
+				vk::Extent2D(std::min(compiled.extent.width, declared.imageDesc.extent.width), std::min(compiled.extent.height, declared.imageDesc.extent.height));
+		}
+
+		vk::SubpassDescription subpass{};
+		subpass.flags = vk::SubpassDescriptionFlags();
+		subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.pDepthStencilAttachment = depthReference ? &depthReference.value() : nullptr;
+
+		vk::RenderPassCreateInfo renderpassInfo{};
+		renderpassInfo.flags = vk::RenderPassCreateFlags();
+		renderpassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderpassInfo.pAttachments = attachments.data();
+		renderpassInfo.subpassCount = 1;
+		renderpassInfo.pSubpasses = &subpass;
+
+		// Views are expected to see mostly the same things, like the eyes of a stereo pair, which lets the driver share work between them.
+		vk::RenderPassMultiviewCreateInfo multiviewInfo{};
+		multiviewInfo.subpassCount = 1;
+		multiviewInfo.pViewMasks = &pass.viewMask;
+		multiviewInfo.correlationMaskCount = 1;
+		multiviewInfo.pCorrelationMasks = &pass.viewMask;
+		if (pass.viewMask)
+			renderpassInfo.pNext = &multiviewInfo;
+
+		try
+		{
+			compiled.renderPass = m_Device.createRenderPass(renderpassInfo);
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to create render pass for render graph pass %s! %s", pass.name.c_str(), err.what());
+		}
+	}
+}
+
+vk::Framebuffer RenderGraph::GetFramebuffer(CompiledPass& compiled)
+{
+	const Pass& pass = m_Passes[compiled.pass];
+
+	std::vector<VkImageView> views;
+	for (uint32_t access : compiled.attachments)
+		views.push_back(static_cast<VkImageView>(GetImageView(pass.accesses[access].resource)));
+
+	auto cached = compiled.framebuffers.find(views);
+	if (cached != compiled.framebuffers.end())
+		return cached->second;
+
+	std::vector<vk::ImageView> attachments(views.begin(), views.end());
+
+	vk::FramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.flags = vk::FramebufferCreateFlags();
+	framebufferInfo.renderPass = compiled.renderPass;
+	framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	framebufferInfo.pAttachments = attachments.data();
+	framebufferInfo.width = compiled.extent.width;
+	framebufferInfo.height = compiled.extent.height;
+	framebufferInfo.layers = 1;	// Also for multiview passes, the view mask picks the layers.
+
+	vk::Framebuffer framebuffer;
+	try
+	{
+		framebuffer = m_Device.createFramebuffer(framebufferInfo);
+	}
+	catch (const vk::SystemError& err)
+	{
+		CONSOLE_ERROR("Failed to create framebuffer for render graph pass %s! %s", pass.name.c_str(), err.what());
+		return nullptr;
+	}
+
+	compiled.framebuffers[views] = framebuffer;
+	return framebuffer;
+}
+
+void RenderGraph::RecordBarriers(vk::CommandBuffer commandBuffer, const BarrierBatch& batch)
+{
+	if (batch.IsEmpty())
+		return;
+
+	std::vector<vk::ImageMemoryBarrier> imageBarriers;
+	std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+
+	for (const Barrier& barrier : batch.barriers)
+	{
+		const Resource& declared = m_Resources[barrier.resource];
+		if (declared.image)
+		{
+			vk::ImageMemoryBarrier imageBarrier{};
+			imageBarrier.srcAccessMask = barrier.srcAccess;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = GetImage(barrier.resource);
+			imageBarrier.subresourceRange.aspectMask = declared.imageDesc.aspect;
+			imageBarrier.subresourceRange.baseMipLevel = 0;
+			imageBarrier.subresourceRange.levelCount = declared.imageDesc.mipLevels;
+			imageBarrier.subresourceRange.baseArrayLayer = 0;
+			imageBarrier.subresourceRange.layerCount = declared.imageDesc.arrayLayers;
+			imageBarriers.push_back(imageBarrier);
+		}
+		else
+		{
+			vk::BufferMemoryBarrier bufferBarrier{};
+			bufferBarrier.srcAccessMask = barrier.srcAccess;
+			bufferBarrier.dstAccessMask = barrier.dstAccess;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = GetBuffer(barrier.resource);
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			bufferBarriers.push_back(bufferBarrier);
+		}
+	}
+
+	vk::PipelineStageFlags srcStages = batch.srcStages ? batch.srcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+	vk::PipelineStageFlags dstStages = batch.dstStages ? batch.dstStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe);
+	commandBuffer.pipelineBarrier(srcStages, dstStages, vk::DependencyFlags(), nullptr, bufferBarriers, imageBarriers);
+}
+
+void RenderGraph::ReleaseCompiled()
+{
+	if (m_DeletionQueue)
+	{
+		for (CompiledPass& compiled : m_CompiledPasses)
+		{
+			for (auto& [views, framebuffer] : compiled.framebuffers)
+				m_DeletionQueue->Retire(framebuffer);
+			m_DeletionQueue->Retire(compiled.renderPass);
+		}
+		for (Transient& transient : m_Transients)
+		{
+			m_DeletionQueue->Retire(transient.view);
+			m_DeletionQueue->Retire(transient.image);
+			m_DeletionQueue->Retire(transient.buffer);
+		}
+		for (vk::DeviceMemory memory : m_Memory)
+			m_DeletionQueue->Retire(memory);
+	}
+	else
+	{
+		for (CompiledPass& compiled : m_CompiledPasses)
+		{
+			for (auto& [views, framebuffer] : compiled.framebuffers)
+				m_Device.destroyFramebuffer(framebuffer);
+			if (compiled.renderPass)
+				m_Device.destroyRenderPass(compiled.renderPass);
+		}
+
+		for (Transient& transient : m_Transients)
+		{
+			if (transient.view)
+				m_Device.destroyImageView(transient.view);
+			if (transient.image)
+				m_Device.destroyImage(transient.image);
+			if (transient.buffer)
+				m_Device.destroyBuffer(transient.buffer);
+		}
+
+		for (vk::DeviceMemory memory : m_Memory)
+			if (memory)
+				vkInit::FreeMemory(m_Device, memory);
+	}
+
+	m_CompiledPasses.clear();
+	m_FinalBarriers = BarrierBatch();
+	m_Transients.clear();
+	m_Memory.clear();
+	m_FirstUse.clear();
+	m_LastUse.clear();
+	m_Compiled = false;
+}
\ No newline at end of file
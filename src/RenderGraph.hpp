@@ -0,0 +1,281 @@
+#ifndef RENDER_GRAPH_HPP
+#define RENDER_GRAPH_HPP
+
+#include "Config.hpp"
+
+#include <functional>
+#include <map>
+
+class GpuProfiler;
+class DeletionQueue;
+
+// How a pass uses a resource. Each usage maps to the stages, access mask and image layout the graph synchronizes against.
+enum class ResourceUsage
+{
+	ColorAttachment,
+	DepthAttachment,	// Depth test and write.
+	DepthRead,			// Depth test without writes.
+	Sampled,
+	StorageRead,
+	StorageWrite,
+	UniformBuffer,
+	VertexBuffer,
+	IndexBuffer,
+	IndirectBuffer,
+	TransferSrc,
+	TransferDst
+};
+
+using RenderResource = uint32_t;
+constexpr RenderResource InvalidRenderResource = UINT32_MAX;
+
+struct RenderImageDesc
+{
+	vk::Format format = vk::Format::eUndefined;
+	vk::Extent2D extent;
+	vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+	uint32_t mipLevels = 1;
+	uint32_t arrayLayers = 1;	// Layered attachments hold one layer per view of a multiview pass.
+};
+
+struct RenderBufferDesc
+{
+	vk::DeviceSize size = 0;
+};
+
+// An image owned outside the graph, such as the current swapchain image.
+struct RenderImageImport
+{
+	vk::Image image;
+	vk::ImageView view;
+	vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
+	vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined;	// Left in the layout of its last use when undefined.
+
+	// Stages the first barrier waits on, e.g. the wait stage of the acquire semaphore for swapchain images.
+	vk::PipelineStageFlags initialStages = vk::PipelineStageFlagBits::eAllCommands;
+};
+
+// Frame graph of passes declaring the images and buffers they read and write.
+// Compiling orders the passes, culls the ones whose results are never used, derives batched pipeline barriers and
+// layout transitions, creates render passes for graphics passes and places transient resources in shared memory
+// whenever their lifetimes do not overlap.
+// The graph is declared again every frame, but only compiled again when the declaration differs from the last one.
+class RenderGraph
+{
+public:
+	enum class PassType
+	{
+		Graphics,
+		Compute,
+		Transfer
+	};
+
+	struct PassContext
+	{
+		vk::CommandBuffer commandBuffer;
+		vk::RenderPass renderPass;	// Null outside graphics passes.
+		vk::Framebuffer framebuffer;
+		vk::Extent2D extent;		// Render area of graphics passes, the attachment extent unless the pass limits it.
+		const RenderGraph* graph;
+		vk::QueryPipelineStatisticFlags pipelineStatistics;		// Of the query open around the pass, secondary command buffers inherit it.
+	};
+
+	using ExecuteFunction = std::function<void(const PassContext&)>;
+
+	class PassBuilder
+	{
+	public:
+		/// @brief Renders to image, clearing it first when clear is given and loading its contents otherwise.
+		PassBuilder& WriteColor(RenderResource image, std::optional<vk::ClearColorValue> clear = std::nullopt);
+		PassBuilder& WriteDepth(RenderResource image, std::optional<vk::ClearDepthStencilValue> clear = std::nullopt);
+		PassBuilder& ReadDepth(RenderResource image);
+
+		PassBuilder& Read(RenderResource resource, ResourceUsage usage);
+		PassBuilder& Write(RenderResource resource, ResourceUsage usage);
+
+		// Passes with side effects are never culled.
+		PassBuilder& SetSideEffects();
+
+		// The render pass of a graphics pass is begun for secondary command buffers, execute may only record vkCmdExecuteCommands.
+		PassBuilder& SetSecondaryCommandBuffers(bool secondary = true);
+
+		// Draws every view in viewMask at once with VK_KHR_multiview, view i into layer i of the attachments. 0 draws a single view.
+		PassBuilder& SetViewMask(uint32_t viewMask);
+
+		// Renders to the top left extent of the attachments only, e.g. at a dynamic resolution. Not part of the compiled
+		// graph, so it may change every frame.
+		PassBuilder& SetRenderArea(vk::Extent2D extent);
+		PassBuilder& SetExecute(ExecuteFunction function);
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, uint32_t pass) : m_Graph(graph), m_Pass(pass) {}
+		PassBuilder& AddAccess(RenderResource resource, ResourceUsage usage, bool write, bool attachment,
+			std::optional<vk::ClearValue> clear = std::nullopt);
+
+		RenderGraph& m_Graph;
+		uint32_t m_Pass;
+	};
+
+	struct Stats
+	{
+		uint32_t passCount = 0;
+		uint32_t culledPassCount = 0;
+		uint32_t barrierBatchCount = 0;
+		uint32_t imageBarrierCount = 0;
+		uint32_t bufferBarrierCount = 0;
+		uint32_t transientResourceCount = 0;
+		vk::DeviceSize transientRequestedBytes = 0;	// Without aliasing.
+		vk::DeviceSize transientAllocatedBytes = 0;	// With aliasing.
+		uint32_t compileCount = 0;
+	};
+
+	RenderGraph(vk::Device device, vk::PhysicalDevice physicalDevice);
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+	~RenderGraph();
+
+	/// @brief Forgets every declared pass and resource. The compiled graph is kept for Compile to compare against.
+	void Begin();
+
+	RenderResource CreateImage(const std::string& name, const RenderImageDesc& desc);
+	RenderResource CreateBuffer(const std::string& name, const RenderBufferDesc& desc);
+	RenderResource ImportImage(const std::string& name, const RenderImageDesc& desc, const RenderImageImport& import);
+	// initialStages and initialAccess describe the last write before the graph runs, e.g. by the previous frame.
+	RenderResource ImportBuffer(const std::string& name, vk::Buffer buffer, vk::DeviceSize size,
+		vk::PipelineStageFlags initialStages = vk::PipelineStageFlags(), vk::AccessFlags initialAccess = vk::AccessFlags());
+
+	PassBuilder AddPass(const std::string& name, PassType type);
+
+	/// @brief Compiles the declared graph unless it matches the compiled one. Returns true if it was compiled again.
+	/// The resources of the previous compilation are retired into the deletion queue, or without one released after
+	/// waiting for the device to go idle.
+	bool Compile();
+
+	/// @brief Records every surviving pass with its barriers into commandBuffer.
+	void Execute(vk::CommandBuffer commandBuffer);
+
+	/// @brief Drops the compiled graph, e.g. before imported images are destroyed. Its resources are retired into the
+	/// deletion queue, without one the device must be idle.
+	void Invalidate();
+
+	/// @brief Times every executed pass with profiler, null stops timing.
+	void SetGpuProfiler(GpuProfiler* profiler) { m_GpuProfiler = profiler; }
+
+	/// @brief Compiling again retires the previous render passes and transient images into queue instead of waiting for the
+	/// device to go idle, null waits.
+	void SetDeletionQueue(DeletionQueue* queue) { m_DeletionQueue = queue; }
+
+	vk::RenderPass GetRenderPass(const std::string& pass) const;
+	vk::Image GetImage(RenderResource resource) const;
+	vk::ImageView GetImageView(RenderResource resource) const;
+	vk::Buffer GetBuffer(RenderResource resource) const;
+
+	const Stats& GetStats() const { return m_Stats; }
+private:
+	struct Resource
+	{
+		std::string name;
+		bool image = true;
+		bool imported = false;
+		RenderImageDesc imageDesc;
+		RenderBufferDesc bufferDesc;
+		RenderImageImport import;
+		vk::Buffer importedBuffer;
+		vk::PipelineStageFlags bufferInitialStages;
+		vk::AccessFlags bufferInitialAccess;
+	};
+
+	struct ResourceAccess
+	{
+		RenderResource resource;
+		ResourceUsage usage;
+		bool write;
+		bool attachment;
+		std::optional<vk::ClearValue> clear;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		PassType type;
+		std::vector<ResourceAccess> accesses;
+		bool sideEffects = false;
+		bool secondary = false;
+		uint32_t viewMask = 0;
+		std::optional<vk::Extent2D> renderArea;
+		ExecuteFunction execute;
+	};
+
+	struct Barrier
+	{
+		RenderResource resource;
+		vk::AccessFlags srcAccess, dstAccess;
+		vk::ImageLayout oldLayout, newLayout;
+	};
+
+	// Every barrier needed before a pass goes into one vkCmdPipelineBarrier.
+	struct BarrierBatch
+	{
+		vk::PipelineStageFlags srcStages, dstStages;
+		std::vector<Barrier> barriers;
+
+		bool IsEmpty() const { return !srcStages && barriers.empty(); }
+	};
+
+	struct CompiledPass
+	{
+		uint32_t pass;
+		BarrierBatch barriers;
+		vk::RenderPass renderPass;
+		std::vector<uint32_t> attachments;	// Indices into the accesses of the pass, in attachment order.
+		vk::Extent2D extent;
+
+		// Framebuffers by attachment views, imported views change from frame to frame.
+		std::map<std::vector<VkImageView>, vk::Framebuffer> framebuffers;
+	};
+
+	// Physical resource backing a transient resource.
+	struct Transient
+	{
+		vk::Image image;
+		vk::ImageView view;
+		vk::Buffer buffer;
+		uint32_t block = UINT32_MAX;
+
+		// Resource that used the same memory before this one, the last one of the block wraps around to the first.
+		RenderResource previous = InvalidRenderResource;
+	};
+
+	size_t HashDeclaration() const;
+	void CullPasses(std::vector<uint32_t>& order) const;
+	void CreateTransients();
+	void BuildBarriers();
+	void CreateRenderPasses();
+	vk::Framebuffer GetFramebuffer(CompiledPass& pass);
+	void RecordBarriers(vk::CommandBuffer commandBuffer, const BarrierBatch& batch);
+	void ReleaseCompiled();
+private:
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+
+	// Declaration of the current frame.
+	std::vector<Resource> m_Resources;
+	std::vector<Pass> m_Passes;
+
+	// Result of the last compilation.
+	size_t m_CompiledHash = 0;
+	bool m_Compiled = false;
+	std::vector<CompiledPass> m_CompiledPasses;
+	BarrierBatch m_FinalBarriers;
+	std::vector<Transient> m_Transients;
+	std::vector<vk::DeviceMemory> m_Memory;
+
+	// First and last compiled pass using each resource, UINT32_MAX if no surviving pass does.
+	std::vector<uint32_t> m_FirstUse, m_LastUse;
+
+	Stats m_Stats;
+	GpuProfiler* m_GpuProfiler = nullptr;
+	DeletionQueue* m_DeletionQueue = nullptr;
+};
+
+#endif // !RENDER_GRAPH_HPP
\ No newline at end of file
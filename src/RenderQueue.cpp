@@ -0,0 +1,140 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	constexpr uint32_t DigitBits = 8;
+	constexpr uint32_t DigitCount = 1u << DigitBits;
+
+	// Items each job histograms and scatters, every batch keeps its own histogram.
+	constexpr uint32_t SortBatchSize = 8192;
+}
+
+uint64_t RenderQueue::MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+{
+	auto clamp = [](uint32_t value, uint32_t bits) { return static_cast<uint64_t>(std::min(value, (1u << bits) - 1)); };
+
+	const uint32_t maxDepth = (1u << DepthBits) - 1;
+	uint32_t quantized = static_cast<uint32_t>(glm::clamp(depth, 0.0f, 1.0f) * maxDepth);
+
+	uint64_t key = clamp(pass, PassBits);
+	key = (key << PipelineBits) | clamp(pipeline, PipelineBits);
+	key = (key << MaterialBits) | clamp(material, MaterialBits);
+	key = (key << MeshBits) | clamp(mesh, MeshBits);
+	key = (key << DepthBits) | quantized;
+	return key;
+}
+
+void RenderQueue::Sort(JobSystem& jobs)
+{
+	PROFILE_SCOPE("RenderQueue::Sort");
+	auto start = std::chrono::steady_clock::now();
+
+	RadixSort(jobs);
+	BuildBatches();
+
+	m_Stats.sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RenderQueue::RadixSort(JobSystem& jobs)
+{
+	const uint32_t count = static_cast<uint32_t>(m_Items.size());
+	if (count < 2)
+		return;
+
+	// Digits that are the same in every key, such as the pass of a frame with a single pass, are already sorted.
+	uint64_t allSet = ~0ull, anySet = 0;
+	for (const Item& item : m_Items)
+	{
+		allSet &= item.key;
+		anySet |= item.key;
+	}
+	const uint64_t varying = allSet ^ anySet;
+
+	const uint32_t batchCount = (count + SortBatchSize - 1) / SortBatchSize;
+	m_SortedItems.resize(count);
+	m_Histograms.resize(static_cast<size_t>(batchCount) * DigitCount);
+
+	Item* source = m_Items.data();
+	Item* destination = m_SortedItems.data();
+	for (uint32_t shift = 0; shift < 64; shift += DigitBits)
+	{
+		if (((varying >> shift) & (DigitCount - 1)) == 0)
+			continue;
+
+		jobs.ParallelFor(batchCount, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t batch = begin; batch < end; batch++)
+			{
+				uint32_t* histogram = &m_Histograms[static_cast<size_t>(batch) * DigitCount];
+				std::fill(histogram, histogram + DigitCount, 0u);
+				uint32_t last = std::min(count, (batch + 1) * SortBatchSize);
+				for (uint32_t i = batch * SortBatchSize; i < last; i++)
+					histogram[(source[i].key >> shift) & (DigitCount - 1)]++;
+			}
+		});
+
+		// Digit-major prefix sum, so each batch scatters into its own range of every digit and the sort stays stable.
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < DigitCount; digit++)
+		{
+			for (uint32_t batch = 0; batch < batchCount; batch++)
+			{
+				uint32_t& entry = m_Histograms[static_cast<size_t>(batch) * DigitCount + digit];
+				uint32_t digitCount = entry;
+				entry = offset;
+				offset += digitCount;
+			}
+		}
+
+		jobs.ParallelFor(batchCount, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t batch = begin; batch < end; batch++)
+			{
+				uint32_t* offsets = &m_Histograms[static_cast<size_t>(batch) * DigitCount];
+				uint32_t last = std::min(count, (batch + 1) * SortBatchSize);
+				for (uint32_t i = batch * SortBatchSize; i < last; i++)
+					destination[offsets[(source[i].key >> shift) & (DigitCount - 1)]++] = source[i];
+			}
+		});
+
+		std::swap(source, destination);
+	}
+
+	// An odd number of passes left the result in the scratch array.
+	if (source != m_Items.data())
+		m_Items.swap(m_SortedItems);
+}
+
+void RenderQueue::BuildBatches()
+{
+	m_Batches.clear();
+	m_Stats = Stats{};
+	m_Stats.items = static_cast<uint32_t>(m_Items.size());
+
+	const uint64_t stateMask = ~((1ull << DepthBits) - 1);
+	for (uint32_t i = 0; i < m_Items.size(); i++)
+	{
+		uint64_t key = m_Items[i].key;
+		if (!m_Batches.empty() && (m_Batches.back().key & stateMask) == (key & stateMask))
+		{
+			m_Batches.back().count++;
+			continue;
+		}
+
+		// The first batch binds everything, every later one only what differs from the batch before it.
+		if (m_Batches.empty() || GetPipeline(key) != GetPipeline(m_Batches.back().key) || GetPass(key) != GetPass(m_Batches.back().key))
+			m_Stats.pipelineChanges++;
+		if (m_Batches.empty() || GetMaterial(key) != GetMaterial(m_Batches.back().key))
+			m_Stats.materialChanges++;
+		if (m_Batches.empty() || GetMesh(key) != GetMesh(m_Batches.back().key))
+			m_Stats.meshChanges++;
+
+		m_Batches.push_back({ key, i, 1 });
+	}
+
+	m_Stats.batches = static_cast<uint32_t>(m_Batches.size());
+	m_Stats.mergedDraws = m_Stats.items - m_Stats.batches;
+}
\ No newline at end of file
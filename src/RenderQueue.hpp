@@ -0,0 +1,84 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include "Config.hpp"
+#include "JobSystem.hpp"
+
+// Draws of a frame ordered by 64-bit sort keys, most significant first:
+//   pass (4 bits) | pipeline (8) | material (16) | mesh (12) | depth (24)
+// Sorting groups every draw sharing a pipeline, material and mesh, nearest first within a group, so consecutive draws
+// with the same state merge into one instanced draw and the record stage changes state as rarely as possible.
+class RenderQueue
+{
+public:
+	static constexpr uint32_t DepthBits = 24;
+	static constexpr uint32_t MeshBits = 12;
+	static constexpr uint32_t MaterialBits = 16;
+	static constexpr uint32_t PipelineBits = 8;
+	static constexpr uint32_t PassBits = 4;
+
+	// Draw lists, in the order they are recorded.
+	enum Pass : uint32_t
+	{
+		PassOpaque = 0
+	};
+
+	struct Item
+	{
+		uint64_t key;
+		uint32_t index;		// Of the draw the item was pushed for.
+	};
+
+	// Consecutive sorted items with the same pass, pipeline, material and mesh.
+	struct Batch
+	{
+		uint64_t key;		// Of the first item.
+		uint32_t first;
+		uint32_t count;
+	};
+
+	struct Stats
+	{
+		uint32_t items = 0;
+		uint32_t batches = 0;
+		uint32_t mergedDraws = 0;		// Items drawn as part of another item's batch.
+		uint32_t pipelineChanges = 0;
+		uint32_t materialChanges = 0;
+		uint32_t meshChanges = 0;
+		double sortMilliseconds = 0.0;
+	};
+
+	/// @brief Builds a key, fields wider than their bits are clamped. depth is 0 to 1, anything outside sorts to the ends.
+	static uint64_t MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+	static uint32_t GetPass(uint64_t key) { return static_cast<uint32_t>(key >> (PipelineBits + MaterialBits + MeshBits + DepthBits)); }
+	static uint32_t GetPipeline(uint64_t key) { return Field(key, MaterialBits + MeshBits + DepthBits, PipelineBits); }
+	static uint32_t GetMaterial(uint64_t key) { return Field(key, MeshBits + DepthBits, MaterialBits); }
+	static uint32_t GetMesh(uint64_t key) { return Field(key, DepthBits, MeshBits); }
+
+	void Clear() { m_Items.clear(); m_Batches.clear(); }
+	void Reserve(uint32_t count) { m_Items.reserve(count); }
+	void Push(uint64_t key, uint32_t index) { m_Items.push_back({ key, index }); }
+
+	/// @brief Radix sorts the items by key on the job system, keeping items with equal keys in push order, then batches them.
+	void Sort(JobSystem& jobs);
+
+	const std::vector<Item>& GetItems() const { return m_Items; }
+	const std::vector<Batch>& GetBatches() const { return m_Batches; }
+	const Stats& GetStats() const { return m_Stats; }
+private:
+	static uint32_t Field(uint64_t key, uint32_t shift, uint32_t bits) { return static_cast<uint32_t>(key >> shift) & ((1u << bits) - 1); }
+
+	void RadixSort(JobSystem& jobs);
+	void BuildBatches();
+private:
+	std::vector<Item> m_Items;
+	std::vector<Batch> m_Batches;
+	Stats m_Stats;
+
+	// Scratch of the sort, kept between frames.
+	std::vector<Item> m_SortedItems;
+	std::vector<uint32_t> m_Histograms;
+};
+
+#endif // !RENDER_QUEUE_HPP
\ No newline at end of file
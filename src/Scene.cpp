@@ -1,8 +1,167 @@
 #include "Scene.hpp"
 
-Scene::Scene()
+#include <chrono>
+#include <type_traits>
+
+Scene::Scene(uint32_t overdrawLayers)
 {
+	meshBounds.Grow(glm::vec3(-0.05f, -0.05f, 0.0f));
+	meshBounds.Grow(glm::vec3(0.05f, 0.05f, 0.0f));
+
 	for (float x = -1.0f; x < 1.0f; x += 0.2f)
 		for (float y = -1.0f; y < 1.0f; y += 0.2f)
-			trianglePositions.push_back(glm::vec3(x, y, 0.0f));
+			transforms.Create(glm::vec3(x, y, 0.0f));
+
+	// Submitted far to near, the worst order for depth testing.
+	for (uint32_t layer = 0; layer < overdrawLayers; layer++)
+	{
+		float depth = 0.9f - 0.8f * layer / std::max(1u, overdrawLayers);
+		transforms.Create(glm::vec3(0.0f, 0.0f, depth), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(30.0f, 30.0f, 1.0f));
+	}
+
+	meshIds.resize(transforms.Size());
+	materialIds.resize(transforms.Size());
+}
+
+bool Scene::Load(const std::string& path)
+{
+	PROFILE_SCOPE("Scene::Load");
+	auto start = std::chrono::steady_clock::now();
+
+	std::unique_ptr<SceneFile> file = SceneFile::Open(path);
+	if (!file)
+		return false;
+
+	const uint64_t instanceCount = file->GetInstanceCount();
+	if (instanceCount >= TransformStore::NoParent)
+	{
+		CONSOLE_ERROR("Scene file %s has %llu instances, more than a scene can index.", path.c_str(), static_cast<unsigned long long>(instanceCount));
+		return false;
+	}
+
+	// Every section has to be there with one element per instance.
+	bool complete = true;
+	auto section = [&](SceneSection type, auto* elementType)
+	{
+		using T = std::remove_pointer_t<decltype(elementType)>;
+		uint64_t count = 0;
+		T* data = file->GetSection<T>(type, count);
+		if (!data || count != instanceCount)
+			complete = false;
+		return data;
+	};
+
+	std::array<float*, TransformStore::StreamCount> streams;
+	for (uint32_t stream = 0; stream < TransformStore::StreamCount; stream++)
+		streams[stream] = section(static_cast<SceneSection>(stream), static_cast<float*>(nullptr));
+	uint32_t* parents = section(SceneSection::Parent, static_cast<uint32_t*>(nullptr));
+	uint32_t* depths = section(SceneSection::Depth, static_cast<uint32_t*>(nullptr));
+	uint32_t* meshes = section(SceneSection::Mesh, static_cast<uint32_t*>(nullptr));
+	uint32_t* materials = section(SceneSection::Material, static_cast<uint32_t*>(nullptr));
+	AABB* bounds = section(SceneSection::Bounds, static_cast<AABB*>(nullptr));
+	if (!complete)
+	{
+		CONSOLE_ERROR("Scene file %s is missing sections or has sections of the wrong size.", path.c_str());
+		return false;
+	}
+
+	// Only the header and the table of contents are checked here, a full scan would read every hierarchy page. The first
+	// transform update repairs broken parents and depths, debug builds refuse such files right away.
+	const uint32_t count = static_cast<uint32_t>(instanceCount);
+#ifndef NDEBUG
+	for (uint32_t i = 0; i < count; i++)
+	{
+		bool root = parents[i] == TransformStore::NoParent;
+		if ((!root && parents[i] >= i) || depths[i] != (root ? 0 : depths[parents[i]] + 1))
+		{
+			CONSOLE_ERROR("Scene file %s has a broken hierarchy at instance %u.", path.c_str(), i);
+			return false;
+		}
+	}
+#endif
+
+	transforms.View(count, streams, parents, depths);
+	meshIds.View(meshes, count);
+	materialIds.View(materials, count);
+	objectBounds.View(bounds, count);
+	m_File = std::move(file);
+	m_BoundsLoaded = true;
+	visibleObjects.clear();
+
+	CONSOLE_INFO("Mapped scene %s, %u instances in %.1f MB, in %.2f ms.", path.c_str(), count, m_File->GetSize() / (1024.0 * 1024.0),
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	return true;
+}
+
+bool Scene::Save(const std::string& path) const
+{
+	PROFILE_SCOPE("Scene::Save");
+	const uint64_t count = transforms.Size();
+
+	std::vector<SceneFile::SectionData> sections;
+	for (uint32_t stream = 0; stream < TransformStore::StreamCount; stream++)
+		sections.push_back({ static_cast<SceneSection>(stream), sizeof(float), count, transforms.GetStream(static_cast<TransformStore::Stream>(stream)) });
+	sections.push_back({ SceneSection::Parent, sizeof(uint32_t), count, transforms.GetParents() });
+	sections.push_back({ SceneSection::Depth, sizeof(uint32_t), count, transforms.GetDepths() });
+	sections.push_back({ SceneSection::Mesh, sizeof(uint32_t), count, meshIds.data() });
+	sections.push_back({ SceneSection::Material, sizeof(uint32_t), count, materialIds.data() });
+
+	// Bounds are only current after an update, compute them for a scene that was never updated. Parents come before
+	// their children, so one forward pass resolves every world matrix.
+	std::vector<AABB> bounds;
+	const AABB* boundsData = objectBounds.data();
+	if (objectBounds.size() != count)
+	{
+		std::vector<glm::mat4> world(count);
+		bounds.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), transforms.GetPosition(i)) * glm::mat4_cast(transforms.GetRotation(i));
+			local = glm::scale(local, transforms.GetScale(i));
+
+			uint32_t parent = transforms.GetParent(i);
+			world[i] = parent == TransformStore::NoParent ? local : world[parent] * local;
+			bounds[i] = TransformAABB(meshBounds, world[i]);
+		}
+		boundsData = bounds.data();
+	}
+	sections.push_back({ SceneSection::Bounds, sizeof(AABB), count, boundsData });
+
+	if (!SceneFile::Write(path, count, sections))
+		return false;
+
+	CONSOLE_INFO("Saved scene with %llu instances to %s.", static_cast<unsigned long long>(count), path.c_str());
+	return true;
+}
+
+void Scene::Update(JobSystem& jobs)
+{
+	transforms.Update(jobs);
+
+	bool rebuild = objectBounds.size() != transforms.Size() || m_BoundsLoaded;
+	objectBounds.resize(transforms.Size());
+
+	m_MovedObjects.clear();
+	for (const std::vector<uint32_t>& level : transforms.GetLastUpdatedLevels())
+	{
+		if (m_BoundsLoaded)
+			break;
+
+		jobs.ParallelFor(static_cast<uint32_t>(level.size()), 1024, [this, &level](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+				objectBounds[level[i]] = TransformAABB(meshBounds, transforms.GetWorldMatrix(level[i]));
+		});
+		m_MovedObjects.insert(m_MovedObjects.end(), level.begin(), level.end());
+	}
+
+	const uint32_t objectCount = static_cast<uint32_t>(objectBounds.size());
+	if (rebuild || bvh.NeedsRebuild())
+		bvh.Build(objectBounds.data(), objectCount, jobs);
+	else
+		bvh.Refit(objectBounds.data(), objectCount, m_MovedObjects);
+	m_BoundsLoaded = false;
+
+	visibleObjects.clear();
+	bvh.QueryFrustum(camera.GetFrustum(), visibleObjects);
 }
\ No newline at end of file
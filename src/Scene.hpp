@@ -2,12 +2,62 @@
 #define SCENE_HPP
 
 #include "Config.hpp"
+#include "Transforms.hpp"
+#include "SceneBVH.hpp"
+#include "Camera.hpp"
+#include "SceneFile.hpp"
+
+// How the objects referencing a material are drawn.
+struct Material
+{
+	uint32_t pipeline = 0;	// Scene pipeline of the engine, ids it does not have draw with the first.
+};
 
 class Scene
 {
 public:
-	Scene();
-	std::vector<glm::vec3> trianglePositions;
+	/// @brief Creates a grid of small triangles, plus overdrawLayers screen-covering ones stacked back to front
+	/// to stress fragment shading.
+	Scene(uint32_t overdrawLayers = 0);
+
+	/// @brief Replaces the scene with the one in a scene file. The file stays mapped and the transforms, ids and bounds
+	/// are used straight out of it, so only the pages the scene touches are read. Keeps the current scene on failure.
+	bool Load(const std::string& path);
+
+	/// @brief Writes the scene to path in the format Load maps.
+	bool Save(const std::string& path) const;
+
+	// Recomputes the world matrices and bounds of everything that moved since the last update,
+	// keeps the BVH in sync and collects the objects inside the camera frustum.
+	void Update(JobSystem& jobs);
+
+	TransformStore transforms;
+	SceneBVH bvh;
+	Camera camera;
+
+	// Local bounds of the triangle mesh every object draws.
+	AABB meshBounds;
+
+	// Mesh and material of every object, indexed like transforms.
+	MappedArray<uint32_t> meshIds;
+	MappedArray<uint32_t> materialIds;
+
+	// Indexed by materialIds, ids past the end use the first material.
+	std::vector<Material> materials{ Material{} };
+
+	// World space bounds, indexed like transforms.
+	MappedArray<AABB> objectBounds;
+
+	// Objects that passed frustum culling in the last update.
+	std::vector<uint32_t> visibleObjects;
+private:
+	std::vector<uint32_t> m_MovedObjects;
+
+	// Backs every viewed array while the scene came from a file.
+	std::unique_ptr<SceneFile> m_File;
+
+	// The loaded bounds are current, so the first update only builds the BVH over them.
+	bool m_BoundsLoaded = false;
 };
 
 #endif // !SCENE_HPP
\ No newline at end of file
@@ -0,0 +1,814 @@
+#include "SceneBVH.hpp"
+#include "Simd.hpp"
+
+#include <numeric>
+
+namespace
+{
+	constexpr uint32_t BinCount = 16;
+	constexpr uint32_t MaxLeafSize = 4;
+	constexpr float TraversalCost = 1.0f;
+	constexpr float IntersectionCost = 1.0f;
+
+	// Nodes above this size are split on the calling thread with parallel binning,
+	// everything below is handed out as independent subtrees.
+	constexpr uint32_t SubtreeSize = 8192;
+	constexpr uint32_t BinningBatchSize = 16384;
+
+	struct Bin
+	{
+		AABB bounds;
+		uint32_t count = 0;
+	};
+
+	using AxisBins = std::array<std::array<Bin, BinCount>, 3>;
+
+	inline uint32_t BinIndex(float centroid, float minimum, float scale)
+	{
+		return std::min(BinCount - 1, static_cast<uint32_t>((centroid - minimum) * scale));
+	}
+
+	inline float SphereBoxDistance2(const Sphere& sphere, const AABB& box)
+	{
+		glm::vec3 delta = glm::max(glm::max(box.min - sphere.center, sphere.center - box.max), glm::vec3(0.0f));
+		return glm::dot(delta, delta);
+	}
+
+	// Entry distance of the ray into box, or a negative value on a miss.
+	inline float IntersectRayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const AABB& box)
+	{
+		glm::vec3 t0 = (box.min - origin) * inverseDirection;
+		glm::vec3 t1 = (box.max - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+
+		float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		return entry <= exit ? entry : -1.0f;
+	}
+}
+
+void SceneBVH::Build(const AABB* objectBounds, uint32_t objectCount, JobSystem& jobs)
+{
+	m_ObjectBounds.assign(objectBounds, objectBounds + objectCount);
+	m_Nodes.clear();
+	m_ObjectIndices.resize(objectCount);
+	std::iota(m_ObjectIndices.begin(), m_ObjectIndices.end(), 0u);
+	m_ObjectSlot.assign(objectCount, UINT32_MAX);
+	m_DirtyNodes.clear();
+	m_SlotAreaSum = 0.0;
+	m_BuildCost = 0.0f;
+
+	if (objectCount == 0)
+		return;
+
+	std::vector<glm::vec3> centroids(objectCount);
+	jobs.ParallelFor(objectCount, BinningBatchSize, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			centroids[i] = m_ObjectBounds[i].Center();
+	});
+
+	std::vector<BuildTree> trees(1);
+
+	BuildNode root;
+	root.count = objectCount;
+	for (const AABB& bounds : m_ObjectBounds)
+		root.bounds.Grow(bounds);
+	trees[0].push_back(root);
+
+	// Split the top of the tree here until the nodes are small enough to be built independently.
+	std::vector<uint32_t> pending = { 0 };
+	std::vector<uint32_t> subtreeRoots;
+	while (!pending.empty())
+	{
+		uint32_t nodeIndex = pending.back();
+		pending.pop_back();
+
+		if (trees[0][nodeIndex].count <= SubtreeSize)
+		{
+			subtreeRoots.push_back(nodeIndex);
+			continue;
+		}
+
+		if (SplitNode(trees[0], nodeIndex, centroids, &jobs))
+		{
+			pending.push_back(trees[0][nodeIndex].left);
+			pending.push_back(trees[0][nodeIndex].right);
+		}
+	}
+
+	// Subtrees own disjoint ranges of m_ObjectIndices, so they can be built concurrently.
+	std::vector<BuildRef> links(trees[0].size(), BuildRef{ UINT32_MAX, 0 });
+	trees.resize(1 + subtreeRoots.size());
+	for (uint32_t i = 0; i < subtreeRoots.size(); i++)
+	{
+		trees[i + 1].push_back(trees[0][subtreeRoots[i]]);
+		links[subtreeRoots[i]] = BuildRef{ i + 1, 0 };
+	}
+
+	jobs.ParallelFor(static_cast<uint32_t>(subtreeRoots.size()), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			BuildSubtree(trees[i + 1], 0, centroids);
+	});
+
+	m_Nodes.reserve(objectCount / 2 + 1);
+	Collapse(trees, links, BuildRef{ 0, 0 }, UINT32_MAX);
+	m_BuildCost = GetCost();
+
+	CONSOLE_DEBUG("Built scene BVH over %u objects: %u nodes, %u subtrees, cost %.2f.", objectCount, GetNodeCount(),
+		static_cast<uint32_t>(subtreeRoots.size()), m_BuildCost);
+}
+
+bool SceneBVH::SplitNode(BuildTree& tree, uint32_t nodeIndex, const std::vector<glm::vec3>& centroids, JobSystem* jobs)
+{
+	const BuildNode node = tree[nodeIndex];
+	if (node.count <= 1)
+		return false;
+
+	const uint32_t* objects = m_ObjectIndices.data() + node.first;
+	const bool parallel = jobs && node.count > BinningBatchSize;
+	const uint32_t batchCount = parallel ? (node.count + BinningBatchSize - 1) / BinningBatchSize : 1;
+
+	// Runs function over the node's objects, per batch when the node is big enough to be worth it.
+	auto forEachBatch = [&](const std::function<void(uint32_t, uint32_t, uint32_t)>& function)
+	{
+		if (parallel)
+		{
+			jobs->ParallelFor(node.count, BinningBatchSize, [&](uint32_t begin, uint32_t end)
+			{
+				function(begin / BinningBatchSize, begin, end);
+			});
+		}
+		else
+		{
+			function(0, 0, node.count);
+		}
+	};
+
+	std::vector<AABB> partialCentroidBounds(batchCount);
+	forEachBatch([&](uint32_t batch, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			partialCentroidBounds[batch].Grow(centroids[objects[i]]);
+	});
+
+	AABB centroidBounds;
+	for (const AABB& bounds : partialCentroidBounds)
+		centroidBounds.Grow(bounds);
+
+	glm::vec3 extent = centroidBounds.Extent();
+	glm::vec3 scale;
+	for (int axis = 0; axis < 3; axis++)
+		scale[axis] = extent[axis] > 0.0f ? BinCount / extent[axis] : 0.0f;
+
+	std::vector<AxisBins> partialBins(batchCount);
+	forEachBatch([&](uint32_t batch, uint32_t begin, uint32_t end)
+	{
+		AxisBins& bins = partialBins[batch];
+		for (uint32_t i = begin; i < end; i++)
+		{
+			uint32_t object = objects[i];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				Bin& bin = bins[axis][BinIndex(centroids[object][axis], centroidBounds.min[axis], scale[axis])];
+				bin.bounds.Grow(m_ObjectBounds[object]);
+				bin.count++;
+			}
+		}
+	});
+
+	AxisBins bins = partialBins[0];
+	for (uint32_t batch = 1; batch < batchCount; batch++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (uint32_t b = 0; b < BinCount; b++)
+			{
+				bins[axis][b].bounds.Grow(partialBins[batch][axis][b].bounds);
+				bins[axis][b].count += partialBins[batch][axis][b].count;
+			}
+		}
+	}
+
+	// Sweep every axis for the cheapest split plane between two bins.
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+	float bestCost = std::numeric_limits<float>::max();
+	AABB bestLeft, bestRight;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (extent[axis] <= 0.0f)
+			continue;
+
+		std::array<AABB, BinCount> rightBounds;
+		std::array<uint32_t, BinCount> rightCounts;
+		AABB accumulated;
+		uint32_t count = 0;
+		for (uint32_t b = BinCount - 1; b > 0; b--)
+		{
+			accumulated.Grow(bins[axis][b].bounds);
+			count += bins[axis][b].count;
+			rightBounds[b] = accumulated;
+			rightCounts[b] = count;
+		}
+
+		AABB leftBounds;
+		uint32_t leftCount = 0;
+		for (uint32_t split = 1; split < BinCount; split++)
+		{
+			leftBounds.Grow(bins[axis][split - 1].bounds);
+			leftCount += bins[axis][split - 1].count;
+
+			if (leftCount == 0 || rightCounts[split] == 0)
+				continue;
+
+			float cost = leftBounds.SurfaceArea() * leftCount + rightBounds[split].SurfaceArea() * rightCounts[split];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+				bestLeft = leftBounds;
+				bestRight = rightBounds[split];
+			}
+		}
+	}
+
+	uint32_t middle = node.first;
+	const uint32_t end = node.first + node.count;
+
+	if (bestAxis >= 0)
+	{
+		float area = std::max(node.bounds.SurfaceArea(), std::numeric_limits<float>::min());
+		float splitCost = TraversalCost + IntersectionCost * bestCost / area;
+		float leafCost = IntersectionCost * node.count;
+		if (node.count <= MaxLeafSize && leafCost <= splitCost)
+			return false;
+
+		auto first = m_ObjectIndices.begin() + node.first;
+		auto partitioned = std::partition(first, m_ObjectIndices.begin() + end, [&](uint32_t object)
+		{
+			return BinIndex(centroids[object][bestAxis], centroidBounds.min[bestAxis], scale[bestAxis]) < bestSplit;
+		});
+		middle = static_cast<uint32_t>(partitioned - m_ObjectIndices.begin());
+	}
+	else if (node.count <= MaxLeafSize)
+	{
+		return false;
+	}
+
+	// Every centroid in the same spot, split the range in half.
+	if (middle == node.first || middle == end)
+	{
+		middle = node.first + node.count / 2;
+		bestLeft = bestRight = AABB{};
+		for (uint32_t i = node.first; i < middle; i++)
+			bestLeft.Grow(m_ObjectBounds[m_ObjectIndices[i]]);
+		for (uint32_t i = middle; i < end; i++)
+			bestRight.Grow(m_ObjectBounds[m_ObjectIndices[i]]);
+	}
+
+	BuildNode left, right;
+	left.bounds = bestLeft;
+	left.first = node.first;
+	left.count = middle - node.first;
+	right.bounds = bestRight;
+	right.first = middle;
+	right.count = end - middle;
+
+	tree[nodeIndex].left = static_cast<uint32_t>(tree.size());
+	tree.push_back(left);
+	tree[nodeIndex].right = static_cast<uint32_t>(tree.size());
+	tree.push_back(right);
+
+	return true;
+}
+
+void SceneBVH::BuildSubtree(BuildTree& tree, uint32_t nodeIndex, const std::vector<glm::vec3>& centroids)
+{
+	std::vector<uint32_t> pending = { nodeIndex };
+	while (!pending.empty())
+	{
+		uint32_t index = pending.back();
+		pending.pop_back();
+
+		if (SplitNode(tree, index, centroids, nullptr))
+		{
+			pending.push_back(tree[index].left);
+			pending.push_back(tree[index].right);
+		}
+	}
+}
+
+uint32_t SceneBVH::Collapse(const std::vector<BuildTree>& trees, const std::vector<BuildRef>& links, BuildRef ref, uint32_t parent)
+{
+	// Nodes of the top tree that were handed out continue in their own subtree.
+	auto resolve = [&](BuildRef r)
+	{
+		if (r.tree == 0 && links[r.node].tree != UINT32_MAX)
+			return links[r.node];
+		return r;
+	};
+	auto get = [&](BuildRef r) -> const BuildNode& { return trees[r.tree][r.node]; };
+
+	ref = resolve(ref);
+
+	uint32_t index = static_cast<uint32_t>(m_Nodes.size());
+	m_Nodes.emplace_back();
+	m_Nodes[index].parent = parent;
+
+	// Pull grandchildren up until the node has four children, opening the largest ones first.
+	std::array<BuildRef, 4> children;
+	uint32_t childCount = 0;
+	if (get(ref).IsLeaf())
+	{
+		children[childCount++] = ref;
+	}
+	else
+	{
+		children[childCount++] = resolve(BuildRef{ ref.tree, get(ref).left });
+		children[childCount++] = resolve(BuildRef{ ref.tree, get(ref).right });
+	}
+
+	while (childCount < 4)
+	{
+		int largest = -1;
+		float largestArea = -1.0f;
+		for (uint32_t i = 0; i < childCount; i++)
+		{
+			const BuildNode& child = get(children[i]);
+			if (!child.IsLeaf() && child.bounds.SurfaceArea() > largestArea)
+			{
+				largest = static_cast<int>(i);
+				largestArea = child.bounds.SurfaceArea();
+			}
+		}
+
+		if (largest < 0)
+			break;
+
+		BuildRef opened = children[largest];
+		children[largest] = resolve(BuildRef{ opened.tree, get(opened).left });
+		children[childCount++] = resolve(BuildRef{ opened.tree, get(opened).right });
+	}
+
+	for (uint32_t slot = 0; slot < 4; slot++)
+	{
+		if (slot >= childCount)
+		{
+			Node& node = m_Nodes[index];
+			SetSlot(node, slot, AABB{});
+			node.child[slot] = EmptySlot;
+			node.first[slot] = node.count[slot] = 0;
+			continue;
+		}
+
+		const BuildNode& child = get(children[slot]);
+		SetSlot(m_Nodes[index], slot, child.bounds);
+		m_Nodes[index].first[slot] = child.first;
+		m_Nodes[index].count[slot] = child.count;
+		m_SlotAreaSum += child.bounds.SurfaceArea();
+
+		if (child.IsLeaf())
+		{
+			m_Nodes[index].child[slot] = LeafSlot;
+			for (uint32_t i = child.first; i < child.first + child.count; i++)
+				m_ObjectSlot[m_ObjectIndices[i]] = index * 4 + slot;
+		}
+		else
+		{
+			// Collapse may grow m_Nodes, so only index it after the call.
+			uint32_t childIndex = Collapse(trees, links, children[slot], index);
+			m_Nodes[index].child[slot] = childIndex;
+		}
+	}
+
+	return index;
+}
+
+void SceneBVH::Refit(const AABB* objectBounds, uint32_t objectCount, const std::vector<uint32_t>& movedObjects)
+{
+	if (objectCount != m_ObjectBounds.size())
+	{
+		CONSOLE_ERROR("Scene BVH refit with %u objects, but it was built over %zu. Rebuild it instead.", objectCount, m_ObjectBounds.size());
+		return;
+	}
+
+	if (m_Nodes.empty() || movedObjects.empty())
+		return;
+
+	m_DirtyNodes.resize(m_Nodes.size(), 0);
+	std::vector<uint32_t> dirtyList;
+
+	// Mark the leaves that hold a moved object and every ancestor up to the first one already marked.
+	for (uint32_t object : movedObjects)
+	{
+		m_ObjectBounds[object] = objectBounds[object];
+
+		uint32_t nodeIndex = m_ObjectSlot[object] / 4;
+		while (nodeIndex != UINT32_MAX && !m_DirtyNodes[nodeIndex])
+		{
+			m_DirtyNodes[nodeIndex] = 1;
+			dirtyList.push_back(nodeIndex);
+			nodeIndex = m_Nodes[nodeIndex].parent;
+		}
+	}
+
+	// Children always have a higher index than their parent, so this refits bottom-up.
+	std::sort(dirtyList.begin(), dirtyList.end(), std::greater<uint32_t>());
+	for (uint32_t nodeIndex : dirtyList)
+	{
+		Node& node = m_Nodes[nodeIndex];
+		for (uint32_t slot = 0; slot < 4; slot++)
+		{
+			if (node.child[slot] == EmptySlot)
+				continue;
+
+			AABB bounds;
+			if (node.child[slot] == LeafSlot)
+			{
+				for (uint32_t i = node.first[slot]; i < node.first[slot] + node.count[slot]; i++)
+					bounds.Grow(m_ObjectBounds[m_ObjectIndices[i]]);
+			}
+			else
+			{
+				bounds = GetNodeBounds(m_Nodes[node.child[slot]]);
+			}
+
+			m_SlotAreaSum += bounds.SurfaceArea() - GetSlotBounds(node, slot).SurfaceArea();
+			SetSlot(node, slot, bounds);
+		}
+
+		m_DirtyNodes[nodeIndex] = 0;
+	}
+}
+
+float SceneBVH::GetCost() const
+{
+	if (m_Nodes.empty())
+		return 0.0f;
+
+	float rootArea = GetNodeBounds(m_Nodes[0]).SurfaceArea();
+	return rootArea > 0.0f ? static_cast<float>(m_SlotAreaSum / rootArea) : 0.0f;
+}
+
+void SceneBVH::SetSlot(Node& node, uint32_t slot, const AABB& bounds)
+{
+	node.minX[slot] = bounds.min.x;
+	node.minY[slot] = bounds.min.y;
+	node.minZ[slot] = bounds.min.z;
+	node.maxX[slot] = bounds.max.x;
+	node.maxY[slot] = bounds.max.y;
+	node.maxZ[slot] = bounds.max.z;
+}
+
+AABB SceneBVH::GetSlotBounds(const Node& node, uint32_t slot) const
+{
+	AABB bounds;
+	bounds.min = glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]);
+	bounds.max = glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]);
+	return bounds;
+}
+
+AABB SceneBVH::GetNodeBounds(const Node& node) const
+{
+	AABB bounds;
+	for (uint32_t slot = 0; slot < 4; slot++)
+		if (node.child[slot] != EmptySlot)
+			bounds.Grow(GetSlotBounds(node, slot));
+	return bounds;
+}
+
+void SceneBVH::AppendSlot(const Node& node, uint32_t slot, std::vector<uint32_t>& result) const
+{
+	auto first = m_ObjectIndices.begin() + node.first[slot];
+	result.insert(result.end(), first, first + node.count[slot]);
+}
+
+void SceneBVH::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const
+{
+	if (m_Nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		const Node& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		// outside: the corner farthest along a plane normal is behind it.
+		// intersecting: the nearest corner is behind a plane, so the slot is not fully inside.
+		uint32_t outside = 0, intersecting = 0;
+#ifdef ENGINE_SIMD_SSE
+		__m128 outsideMask = _mm_setzero_ps(), intersectingMask = _mm_setzero_ps();
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+
+			__m128 farX = _mm_load_ps(plane.x >= 0.0f ? node.maxX : node.minX);
+			__m128 farY = _mm_load_ps(plane.y >= 0.0f ? node.maxY : node.minY);
+			__m128 farZ = _mm_load_ps(plane.z >= 0.0f ? node.maxZ : node.minZ);
+			__m128 nearX = _mm_load_ps(plane.x >= 0.0f ? node.minX : node.maxX);
+			__m128 nearY = _mm_load_ps(plane.y >= 0.0f ? node.minY : node.maxY);
+			__m128 nearZ = _mm_load_ps(plane.z >= 0.0f ? node.minZ : node.maxZ);
+
+			__m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, farX), _mm_mul_ps(ny, farY)), _mm_add_ps(_mm_mul_ps(nz, farZ), d));
+			__m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nearX), _mm_mul_ps(ny, nearY)), _mm_add_ps(_mm_mul_ps(nz, nearZ), d));
+
+			outsideMask = _mm_or_ps(outsideMask, _mm_cmplt_ps(farDistance, _mm_setzero_ps()));
+			intersectingMask = _mm_or_ps(intersectingMask, _mm_cmplt_ps(nearDistance, _mm_setzero_ps()));
+		}
+		outside = static_cast<uint32_t>(_mm_movemask_ps(outsideMask));
+		intersecting = static_cast<uint32_t>(_mm_movemask_ps(intersectingMask));
+#else
+		for (uint32_t slot = 0; slot < 4; slot++)
+		{
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				float farDistance = plane.x * (plane.x >= 0.0f ? node.maxX[slot] : node.minX[slot]) +
+					plane.y * (plane.y >= 0.0f ? node.maxY[slot] : node.minY[slot]) +
+					plane.z * (plane.z >= 0.0f ? node.maxZ[slot] : node.minZ[slot]) + plane.w;
+				float nearDistance = plane.x * (plane.x >= 0.0f ? node.minX[slot] : node.maxX[slot]) +
+					plane.y * (plane.y >= 0.0f ? node.minY[slot] : node.maxY[slot]) +
+					plane.z * (plane.z >= 0.0f ? node.minZ[slot] : node.maxZ[slot]) + plane.w;
+				if (farDistance < 0.0f) outside |= 1u << slot;
+				if (nearDistance < 0.0f) intersecting |= 1u << slot;
+			}
+		}
+#endif
+
+		for (uint32_t slot = 0; slot < 4; slot++)
+		{
+			if (node.child[slot] == EmptySlot || (outside & (1u << slot)))
+				continue;
+
+			if (!(intersecting & (1u << slot)))
+			{
+				AppendSlot(node, slot, result);
+			}
+			else if (node.child[slot] == LeafSlot)
+			{
+				for (uint32_t i = node.first[slot]; i < node.first[slot] + node.count[slot]; i++)
+					if (FrustumContainsBox(frustum, m_ObjectBounds[m_ObjectIndices[i]]))
+						result.push_back(m_ObjectIndices[i]);
+			}
+			else
+			{
+				stack.push_back(node.child[slot]);
+			}
+		}
+	}
+}
+
+void SceneBVH::QueryAABB(const AABB& box, std::vector<uint32_t>& result) const
+{
+	if (m_Nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		const Node& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		uint32_t overlapping = 0, contained = 0;
+#ifdef ENGINE_SIMD_SSE
+		__m128 queryMinX = _mm_set1_ps(box.min.x), queryMinY = _mm_set1_ps(box.min.y), queryMinZ = _mm_set1_ps(box.min.z);
+		__m128 queryMaxX = _mm_set1_ps(box.max.x), queryMaxY = _mm_set1_ps(box.max.y), queryMaxZ = _mm_set1_ps(box.max.z);
+		__m128 minX = _mm_load_ps(node.minX), minY = _mm_load_ps(node.minY), minZ = _mm_load_ps(node.minZ);
+		__m128 maxX = _mm_load_ps(node.maxX), maxY = _mm_load_ps(node.maxY), maxZ = _mm_load_ps(node.maxZ);
+
+		__m128 overlapMask = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(minX, queryMaxX), _mm_cmpge_ps(maxX, queryMinX)),
+			_mm_and_ps(_mm_and_ps(_mm_cmple_ps(minY, queryMaxY), _mm_cmpge_ps(maxY, queryMinY)),
+			_mm_and_ps(_mm_cmple_ps(minZ, queryMaxZ), _mm_cmpge_ps(maxZ, queryMinZ))));
+		__m128 containMask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(minX, queryMinX), _mm_cmple_ps(maxX, queryMaxX)),
+			_mm_and_ps(_mm_and_ps(_mm_cmpge_ps(minY, queryMinY), _mm_cmple_ps(maxY, queryMaxY)),
+			_mm_and_ps(_mm_cmpge_ps(minZ, queryMinZ), _mm_cmple_ps(maxZ, queryMaxZ))));
+
+		overlapping = static_cast<uint32_t>(_mm_movemask_ps(overlapMask));
+		contained = static_cast<uint32_t>(_mm_movemask_ps(containMask));
+#else
+		for (uint32_t slot = 0; slot < 4; slot++)
+		{
+			AABB bounds = GetSlotBounds(node, slot);
+			if (bounds.Overlaps(box)) overlapping |= 1u << slot;
+			if (glm::all(glm::greaterThanEqual(bounds.min, box.min)) && glm::all(glm::lessThanEqual(bounds.max, box.max))) contained |= 1u << slot;
+		}
+#endif
+
+		for (uint32_t slot = 0; slot < 4; slot++)
+		{
+			if (node.child[slot] == EmptySlot || !(overlapping & (1u << slot)))
+				continue;
+
+			if (contained & (1u << slot))
+			{
+				AppendSlot(node, slot, result);
+			}
+			else if (node.child[slot] == LeafSlot)
+			{
+				for (uint32_t i = node.first[slot]; i < node.first[slot] + node.count[slot]; i++)
+					if (m_ObjectBounds[m_ObjectIndices[i]].Overlaps(box))
+						result.push_back(m_ObjectIndices[i]);
+			}
+			else
+			{
+				stack.push_back(node.child[slot]);
+			}
+		}
+	}
+}
+
+void SceneBVH::QuerySphere(const Sphere& sphere, std::vector<uint32_t>& result) const
+{
+	if (m_Nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	const float radius2 = sphere.radius * sphere.radius;
+
+	while (!stack.empty())
+	{
+		const Node& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		uint32_t overlapping = 0, contained = 0;
+#ifdef ENGINE_SIMD_SSE
+		__m128 zero = _mm_setzero_ps(), radius = _mm_set1_ps(radius2);
+		__m128 centerX = _mm_set1_ps(sphere.center.x), centerY = _mm_set1_ps(sphere.center.y), centerZ = _mm_set1_ps(sphere.center.z);
+		__m128 minX = _mm_load_ps(node.minX), minY = _mm_load_ps(node.minY), minZ = _mm_load_ps(node.minZ);
+		__m128 maxX = _mm_load_ps(node.maxX), maxY = _mm_load_ps(node.maxY), maxZ = _mm_load_ps(node.maxZ);
+
+		// Distance to the closest point decides overlap, distance to the farthest corner decides containment.
+		__m128 nearX = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, centerX), _mm_sub_ps(centerX, maxX)), zero);
+		__m128 nearY = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, centerY), _mm_sub_ps(centerY, maxY)), zero);
+		__m128 nearZ = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, centerZ), _mm_sub_ps(centerZ, maxZ)), zero);
+		__m128 farX = _mm_max_ps(_mm_sub_ps(centerX, minX), _mm_sub_ps(maxX, centerX));
+		__m128 farY = _mm_max_ps(_mm_sub_ps(centerY, minY), _mm_sub_ps(maxY, centerY));
+		__m128 farZ = _mm_max_ps(_mm_sub_ps(centerZ, minZ), _mm_sub_ps(maxZ, centerZ));
+
+		__m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nearX, nearX), _mm_mul_ps(nearY, nearY)), _mm_mul_ps(nearZ, nearZ));
+		__m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(farX, farX), _mm_mul_ps(farY, farY)), _mm_mul_ps(farZ, farZ));
+
+		overlapping = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(nearDistance, radius)));
+		contained = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(farDistance, radius)));
+#else
+		for (uint32_t slot = 0; slot < 4; slot++)
+		{
+			AABB bounds = GetSlotBounds(node, slot);
+			glm::vec3 farCorner = glm::max(sphere.center - bounds.min, bounds.max - sphere.center);
+			if (SphereBoxDistance2(sphere, bounds) <= radius2) overlapping |= 1u << slot;
+			if (glm::dot(farCorner, farCorner) <= radius2) contained |= 1u << slot;
+		}
+#endif
+
+		for (uint32_t slot = 0; slot < 4; slot++)
+		{
+			if (node.child[slot] == EmptySlot || !(overlapping & (1u << slot)))
+				continue;
+
+			if (contained & (1u << slot))
+			{
+				AppendSlot(node, slot, result);
+			}
+			else if (node.child[slot] == LeafSlot)
+			{
+				for (uint32_t i = node.first[slot]; i < node.first[slot] + node.count[slot]; i++)
+					if (SphereBoxDistance2(sphere, m_ObjectBounds[m_ObjectIndices[i]]) <= radius2)
+						result.push_back(m_ObjectIndices[i]);
+			}
+			else
+			{
+				stack.push_back(node.child[slot]);
+			}
+		}
+	}
+}
+
+void SceneBVH::QueryRay(const Ray& ray, float maxDistance, std::vector<uint32_t>& result) const
+{
+	if (m_Nodes.empty())
+		return;
+
+	const glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		const Node& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		for (uint32_t slot = 0; slot < 4; slot++)
+		{
+			if (node.child[slot] == EmptySlot || IntersectRayBox(ray.origin, inverseDirection, maxDistance, GetSlotBounds(node, slot)) < 0.0f)
+				continue;
+
+			if (node.child[slot] == LeafSlot)
+			{
+				for (uint32_t i = node.first[slot]; i < node.first[slot] + node.count[slot]; i++)
+					if (IntersectRayBox(ray.origin, inverseDirection, maxDistance, m_ObjectBounds[m_ObjectIndices[i]]) >= 0.0f)
+						result.push_back(m_ObjectIndices[i]);
+			}
+			else
+			{
+				stack.push_back(node.child[slot]);
+			}
+		}
+	}
+}
+
+SceneBVH::RayHit SceneBVH::Raycast(const Ray& ray, float maxDistance) const
+{
+	RayHit hit;
+	hit.distance = maxDistance;
+
+	if (m_Nodes.empty())
+		return hit;
+
+	const glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+	struct Entry
+	{
+		uint32_t node;
+		float distance;
+	};
+	std::vector<Entry> stack;
+	stack.reserve(64);
+	stack.push_back({ 0, 0.0f });
+
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+
+		// Skip subtrees that start behind the closest hit found since they were pushed.
+		if (entry.distance > hit.distance)
+			continue;
+
+		const Node& node = m_Nodes[entry.node];
+		float distances[4];
+#ifdef ENGINE_SIMD_SSE
+		__m128 originX = _mm_set1_ps(ray.origin.x), originY = _mm_set1_ps(ray.origin.y), originZ = _mm_set1_ps(ray.origin.z);
+		__m128 inverseX = _mm_set1_ps(inverseDirection.x), inverseY = _mm_set1_ps(inverseDirection.y), inverseZ = _mm_set1_ps(inverseDirection.z);
+
+		__m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), originX), inverseX);
+		__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), originX), inverseX);
+		__m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), originY), inverseY);
+		__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), originY), inverseY);
+		__m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), originZ), inverseZ);
+		__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), originZ), inverseZ);
+
+		__m128 entryDistance = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+		__m128 exitDistance = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(hit.distance)));
+
+		__m128 missMask = _mm_cmpgt_ps(entryDistance, exitDistance);
+		_mm_storeu_ps(distances, _mm_or_ps(_mm_andnot_ps(missMask, entryDistance), _mm_and_ps(missMask, _mm_set1_ps(-1.0f))));
+#else
+		for (uint32_t slot = 0; slot < 4; slot++)
+			distances[slot] = IntersectRayBox(ray.origin, inverseDirection, hit.distance, GetSlotBounds(node, slot));
+#endif
+
+		// Push the hit children farthest first so the nearest one is visited next.
+		std::array<uint32_t, 4> order = { 0, 1, 2, 3 };
+		std::sort(order.begin(), order.end(), [&distances](uint32_t a, uint32_t b) { return distances[a] > distances[b]; });
+
+		for (uint32_t slot : order)
+		{
+			if (node.child[slot] == EmptySlot || distances[slot] < 0.0f)
+				continue;
+
+			if (node.child[slot] == LeafSlot)
+			{
+				for (uint32_t i = node.first[slot]; i < node.first[slot] + node.count[slot]; i++)
+				{
+					float distance = IntersectRayBox(ray.origin, inverseDirection, hit.distance, m_ObjectBounds[m_ObjectIndices[i]]);
+					if (distance >= 0.0f && distance < hit.distance)
+					{
+						hit.object = m_ObjectIndices[i];
+						hit.distance = distance;
+					}
+				}
+			}
+			else
+			{
+				stack.push_back({ node.child[slot], distances[slot] });
+			}
+		}
+	}
+
+	return hit;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef SCENE_BVH_HPP
+#define SCENE_BVH_HPP
+
+#include "Config.hpp"
+#include "Bounds.hpp"
+#include "JobSystem.hpp"
+
+// 4-wide bounding volume hierarchy over scene objects.
+// Built with a binned SAH builder, refit in place when objects move and rebuilt when refitting has degraded it too much.
+class SceneBVH
+{
+public:
+	static constexpr uint32_t EmptySlot = UINT32_MAX;
+	static constexpr uint32_t LeafSlot = UINT32_MAX - 1;
+
+	// Child boxes are stored as SoA so one node is tested against a query with a single SIMD pass.
+	struct alignas(64) Node
+	{
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		uint32_t child[4];	// Node index, LeafSlot or EmptySlot.
+		uint32_t first[4];	// Every object below a slot is in GetObjectIndices()[first, first + count).
+		uint32_t count[4];
+		uint32_t parent;
+	};
+
+	struct RayHit
+	{
+		uint32_t object = UINT32_MAX;
+		float distance = std::numeric_limits<float>::max();
+	};
+
+	/// @brief Builds the hierarchy over the objectCount boxes of objectBounds, indexed by object.
+	void Build(const AABB* objectBounds, uint32_t objectCount, JobSystem& jobs);
+
+	/// @brief Updates the boxes of the given objects and their ancestors, the topology is left untouched.
+	void Refit(const AABB* objectBounds, uint32_t objectCount, const std::vector<uint32_t>& movedObjects);
+
+	/// @brief True once refitting has inflated the SAH cost past rebuildThreshold times the cost right after the build.
+	bool NeedsRebuild() const { return m_BuildCost > 0.0f && GetCost() > m_BuildCost * rebuildThreshold; }
+
+	// Each query appends the indices of the objects whose boxes pass the test to result.
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const;
+	void QueryAABB(const AABB& box, std::vector<uint32_t>& result) const;
+	void QuerySphere(const Sphere& sphere, std::vector<uint32_t>& result) const;
+	void QueryRay(const Ray& ray, float maxDistance, std::vector<uint32_t>& result) const;
+
+	/// @brief Closest object box hit by the ray, object is UINT32_MAX on a miss.
+	RayHit Raycast(const Ray& ray, float maxDistance = std::numeric_limits<float>::max()) const;
+
+	// SAH cost of the current tree relative to its root box.
+	float GetCost() const;
+
+	uint32_t GetObjectCount() const { return static_cast<uint32_t>(m_ObjectBounds.size()); }
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Nodes.size()); }
+	const std::vector<uint32_t>& GetObjectIndices() const { return m_ObjectIndices; }
+
+	float rebuildThreshold = 1.5f;
+private:
+	struct BuildNode
+	{
+		AABB bounds;
+		uint32_t first = 0, count = 0;
+		uint32_t left = UINT32_MAX, right = UINT32_MAX;
+
+		bool IsLeaf() const { return left == UINT32_MAX; }
+	};
+
+	// Binary nodes of one subtree, the top of the tree and every subtree built in parallel have their own.
+	using BuildTree = std::vector<BuildNode>;
+
+	struct BuildRef
+	{
+		uint32_t tree, node;
+	};
+
+	bool SplitNode(BuildTree& tree, uint32_t nodeIndex, const std::vector<glm::vec3>& centroids, JobSystem* jobs);
+	void BuildSubtree(BuildTree& tree, uint32_t nodeIndex, const std::vector<glm::vec3>& centroids);
+	uint32_t Collapse(const std::vector<BuildTree>& trees, const std::vector<BuildRef>& links, BuildRef ref, uint32_t parent);
+	void SetSlot(Node& node, uint32_t slot, const AABB& bounds);
+	AABB GetSlotBounds(const Node& node, uint32_t slot) const;
+	AABB GetNodeBounds(const Node& node) const;
+	void AppendSlot(const Node& node, uint32_t slot, std::vector<uint32_t>& result) const;
+private:
+	std::vector<Node> m_Nodes;
+	std::vector<AABB> m_ObjectBounds;
+	std::vector<uint32_t> m_ObjectIndices;
+	std::vector<uint32_t> m_ObjectSlot;	// Leaf slot of each object, packed as node * 4 + slot.
+
+	// Sum of the surface area of every slot, updated while refitting.
+	double m_SlotAreaSum = 0.0;
+	float m_BuildCost = 0.0f;
+
+	// Scratch used by Refit.
+	std::vector<uint8_t> m_DirtyNodes;
+};
+
+#endif // !SCENE_BVH_HPP
\ No newline at end of file
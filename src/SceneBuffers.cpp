@@ -0,0 +1,253 @@
+#include "SceneBuffers.hpp"
+
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t MinimumCapacity = 1024;
+
+	// Bounds are copied as the scene stores them, the shaders read six floats per object.
+	static_assert(sizeof(AABB) == 6 * sizeof(float), "Scene bounds must be tightly packed");
+}
+
+SceneBuffers::SceneBuffers(const Input& input) : m_Device(input.device), m_PhysicalDevice(input.physicalDevice), m_Heap(*input.heap),
+	m_DeletionQueue(*input.deletionQueue)
+{
+	Resize(input.framesInFlight);
+}
+
+SceneBuffers::~SceneBuffers()
+{
+	Resize(0);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_TransformSlot);
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, m_BoundsSlot);
+	DestroyBuffer(m_Transforms);
+	DestroyBuffer(m_Bounds);
+}
+
+void SceneBuffers::Resize(uint32_t framesInFlight)
+{
+	for (Frame& frame : m_Frames)
+		DestroyFrame(frame);
+	m_Frames.resize(framesInFlight);
+
+	// Created up front, the render graph imports the current frame's draws before anything was drawn.
+	for (Frame& frame : m_Frames)
+		ReserveDraws(frame, 0);
+
+	m_CurrentFrame = 0;
+	m_Copies.clear();
+	m_SceneUploadNeeded = true;
+	m_SceneUploaded = false;
+}
+
+void SceneBuffers::UploadScene(const Scene& scene)
+{
+	const uint32_t count = std::min(scene.transforms.Size(), static_cast<uint32_t>(scene.objectBounds.size()));
+	m_Copies.clear();
+	m_SceneUploadNeeded = !ReserveObjects(count);
+	m_SceneUploaded = !m_SceneUploadNeeded;
+	if (m_SceneUploadNeeded || count == 0)
+		return;
+
+	const vk::DeviceSize worldBytes = sizeof(glm::mat4) * count;
+	const vk::DeviceSize boundsBytes = sizeof(AABB) * count;
+	vkInit::Buffer staging = CreateBuffer(worldBytes + boundsBytes, vk::BufferUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging, "Scene staging");
+	if (!staging.bufferMemory)
+	{
+		DestroyBuffer(staging);
+		m_SceneUploadNeeded = true;
+		m_SceneUploaded = false;
+		return;
+	}
+
+	// Both arrays are contiguous, the bounds of a loaded scene are its mapped section.
+	uint8_t* mapped = static_cast<uint8_t*>(m_Device.mapMemory(staging.bufferMemory, 0, VK_WHOLE_SIZE));
+	memcpy(mapped, scene.transforms.GetWorldMatrices().data(), worldBytes);
+	memcpy(mapped + worldBytes, scene.objectBounds.data(), boundsBytes);
+	m_Device.unmapMemory(staging.bufferMemory);
+
+	m_Copies.push_back({ staging.buffer, m_Transforms.buffer, vk::BufferCopy(0, 0, worldBytes) });
+	m_Copies.push_back({ staging.buffer, m_Bounds.buffer, vk::BufferCopy(worldBytes, 0, boundsBytes) });
+
+	// Done with once the frame recording the copies has finished.
+	m_DeletionQueue.Retire(staging);
+}
+
+void SceneBuffers::BeginFrame(uint32_t frame, const FramePacket& packet)
+{
+	m_CurrentFrame = frame;
+	Frame& current = m_Frames[frame];
+
+	// Moved objects past the capacity only come with a scene upload the caller skipped, they can not be placed.
+	const bool stage = !m_SceneUploaded && !packet.movedRanges.empty() &&
+		packet.movedRanges.back().first + packet.movedRanges.back().count <= m_Capacity;
+	m_SceneUploaded = false;
+
+	const vk::DeviceSize worldBytes = sizeof(glm::mat4) * packet.movedWorld.size();
+	const vk::DeviceSize boundsBytes = sizeof(AABB) * packet.movedBounds.size();
+	if (stage && ReserveStaging(current, worldBytes + boundsBytes))
+	{
+		memcpy(current.mappedStaging, packet.movedWorld.data(), worldBytes);
+		memcpy(current.mappedStaging + worldBytes, packet.movedBounds.data(), boundsBytes);
+
+		// Moved objects are packed in the order of their ranges.
+		vk::DeviceSize offset = 0;
+		for (const TransformStore::Range& range : packet.movedRanges)
+		{
+			m_Copies.push_back({ current.staging.buffer, m_Transforms.buffer,
+				vk::BufferCopy(sizeof(glm::mat4) * offset, sizeof(glm::mat4) * range.first, sizeof(glm::mat4) * range.count) });
+			m_Copies.push_back({ current.staging.buffer, m_Bounds.buffer,
+				vk::BufferCopy(worldBytes + sizeof(AABB) * offset, sizeof(AABB) * range.first, sizeof(AABB) * range.count) });
+			offset += range.count;
+		}
+	}
+
+	const uint32_t drawCount = static_cast<uint32_t>(packet.draws.size());
+	if (!ReserveDraws(current, drawCount))
+		return;
+	for (uint32_t i = 0; i < drawCount; i++)
+		current.mappedDraws[i] = packet.draws[i].objectIndex;
+}
+
+void SceneBuffers::AddUploadPass(RenderGraph& graph)
+{
+	// Declared every frame, copies or not, so the graph only compiles once. The object buffers are not graph resources.
+	graph.AddPass("SceneUpload", RenderGraph::PassType::Transfer)
+		.SetSideEffects()
+		.SetExecute([this](const RenderGraph::PassContext& context)
+		{
+			if (m_Copies.empty())
+				return;
+
+			// Earlier frames may still read the objects being overwritten.
+			const vk::PipelineStageFlags readers = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eComputeShader;
+			context.commandBuffer.pipelineBarrier(readers, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), nullptr, nullptr, nullptr);
+
+			for (const Copy& copy : m_Copies)
+				context.commandBuffer.copyBuffer(copy.source, copy.destination, copy.region);
+			m_Copies.clear();
+
+			vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+			context.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, readers, vk::DependencyFlags(), barrier, nullptr, nullptr);
+		});
+}
+
+RenderResource SceneBuffers::ImportDraws(RenderGraph& graph) const
+{
+	const Frame& frame = m_Frames[m_CurrentFrame];
+	return graph.ImportBuffer("SceneDraws", frame.draws.buffer, sizeof(uint32_t) * std::max(frame.drawCapacity, 1u));
+}
+
+vkInit::Buffer SceneBuffers::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+	MemoryCategory category, const char* name)
+{
+	vkInit::BufferInput input{};
+	input.size = size;
+	input.usage = usage;
+	input.device = m_Device;
+	input.physicalDevice = m_PhysicalDevice;
+	input.properties = properties;
+	input.category = category;
+	input.name = name;
+	return vkInit::CreateBuffer(input);
+}
+
+void SceneBuffers::DestroyBuffer(vkInit::Buffer& buffer)
+{
+	m_Device.destroyBuffer(buffer.buffer);
+	vkInit::FreeMemory(m_Device, buffer.bufferMemory);
+	buffer = vkInit::Buffer{};
+}
+
+void SceneBuffers::DestroyFrame(Frame& frame)
+{
+	if (frame.staging.bufferMemory)
+		m_Device.unmapMemory(frame.staging.bufferMemory);
+	if (frame.draws.bufferMemory)
+		m_Device.unmapMemory(frame.draws.bufferMemory);
+
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, frame.drawSlot);
+	DestroyBuffer(frame.staging);
+	DestroyBuffer(frame.draws);
+	frame = Frame{};
+}
+
+bool SceneBuffers::ReserveObjects(uint32_t count)
+{
+	if (count <= m_Capacity && m_Transforms.buffer)
+		return true;
+
+	// Frames in flight still read the old buffers, they are freed once those have finished. Nothing is copied over,
+	// growing always comes with a scene upload.
+	m_DeletionQueue.Retire(m_Transforms, m_TransformSlot);
+	m_DeletionQueue.Retire(m_Bounds, m_BoundsSlot);
+	m_TransformSlot = m_BoundsSlot = vkInit::InvalidBindlessIndex;
+
+	using Usage = vk::BufferUsageFlagBits;
+	m_Capacity = std::max({ count, m_Capacity * 2, MinimumCapacity });
+	m_Transforms = CreateBuffer(sizeof(glm::mat4) * m_Capacity, Usage::eStorageBuffer | Usage::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry, "Scene transforms");
+	m_Bounds = CreateBuffer(sizeof(AABB) * m_Capacity, Usage::eStorageBuffer | Usage::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry, "Scene bounds");
+	if (!m_Transforms.bufferMemory || !m_Bounds.bufferMemory)
+	{
+		DestroyBuffer(m_Transforms);
+		DestroyBuffer(m_Bounds);
+		m_Capacity = 0;
+		return false;
+	}
+
+	m_TransformSlot = vkInit::RegisterStorageBuffer(m_Heap, m_Transforms.buffer);
+	m_BoundsSlot = vkInit::RegisterStorageBuffer(m_Heap, m_Bounds.buffer);
+	return true;
+}
+
+bool SceneBuffers::ReserveStaging(Frame& frame, vk::DeviceSize size)
+{
+	if (size <= frame.stagingCapacity && frame.staging.bufferMemory)
+		return true;
+
+	// The last frame that used it has finished.
+	if (frame.staging.bufferMemory)
+		m_Device.unmapMemory(frame.staging.bufferMemory);
+	DestroyBuffer(frame.staging);
+
+	frame.stagingCapacity = std::max({ size, frame.stagingCapacity * 2, vk::DeviceSize(sizeof(glm::mat4) * MinimumCapacity) });
+	frame.staging = CreateBuffer(frame.stagingCapacity, vk::BufferUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging, "Scene staging");
+	if (!frame.staging.bufferMemory)
+	{
+		frame.stagingCapacity = 0;
+		return false;
+	}
+	frame.mappedStaging = static_cast<uint8_t*>(m_Device.mapMemory(frame.staging.bufferMemory, 0, VK_WHOLE_SIZE));
+	return true;
+}
+
+bool SceneBuffers::ReserveDraws(Frame& frame, uint32_t count)
+{
+	if (count <= frame.drawCapacity && frame.draws.bufferMemory)
+		return true;
+
+	// The last frame that used it has finished, so its slot can be written again right away.
+	vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, frame.drawSlot);
+	if (frame.draws.bufferMemory)
+		m_Device.unmapMemory(frame.draws.bufferMemory);
+	DestroyBuffer(frame.draws);
+
+	// Written by the CPU every frame and read straight from the shaders, so it stays mapped.
+	frame.drawCapacity = std::max({ count, frame.drawCapacity * 2, MinimumCapacity });
+	frame.draws = CreateBuffer(sizeof(uint32_t) * frame.drawCapacity, vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Other, "Scene draws");
+	if (!frame.draws.bufferMemory)
+	{
+		frame.drawCapacity = 0;
+		frame.drawSlot = vkInit::InvalidBindlessIndex;
+		return false;
+	}
+	frame.mappedDraws = static_cast<uint32_t*>(m_Device.mapMemory(frame.draws.bufferMemory, 0, VK_WHOLE_SIZE));
+	frame.drawSlot = vkInit::RegisterStorageBuffer(m_Heap, frame.draws.buffer);
+	return true;
+}
\ No newline at end of file
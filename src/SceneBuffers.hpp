@@ -0,0 +1,101 @@
+#ifndef SCENE_BUFFERS_HPP
+#define SCENE_BUFFERS_HPP
+
+#include "Config.hpp"
+#include "Scene.hpp"
+#include "FramePipeline.hpp"
+#include "DeletionQueue.hpp"
+#include "RenderGraph.hpp"
+#include "Vulkan/Memory.hpp"
+#include "Vulkan/Descriptors.hpp"
+
+// World matrices and world space bounds of every scene object in device local buffers of the bindless heap, indexed by
+// object like the scene's own arrays, plus the objects each frame draws. Each frame only copies in what its update moved,
+// one copy per run of consecutive objects, so a scene that stands still is uploaded once. A full upload copies the world
+// matrices and the bounds as one range each, the bounds of a scene loaded from a file straight out of its mapped section.
+class SceneBuffers
+{
+public:
+	struct Input
+	{
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		vkInit::BindlessHeap* heap;
+		DeletionQueue* deletionQueue;
+		uint32_t framesInFlight;
+	};
+
+	SceneBuffers(const Input& input);
+	SceneBuffers(const SceneBuffers&) = delete;
+	SceneBuffers& operator=(const SceneBuffers&) = delete;
+	~SceneBuffers();
+
+	/// @brief Recreates the per-frame buffers. The device must be idle. Packets skipped meanwhile never reach the
+	/// buffers, so the next frame uploads the whole scene.
+	void Resize(uint32_t framesInFlight);
+
+	/// @brief True when the frame of packet has to upload the whole scene with UploadScene instead of what it moved.
+	bool NeedsSceneUpload(const FramePacket& packet) const { return m_SceneUploadNeeded || packet.movedAll || packet.objectCount > m_Capacity; }
+
+	/// @brief Stages every world matrix and bounds of scene for the next frame. Nothing may update the scene meanwhile.
+	void UploadScene(const Scene& scene);
+
+	/// @brief Picks the buffers of frame, whose previous submission must have finished, stages what packet moved unless
+	/// the whole scene was staged for it, and writes the objects it draws.
+	void BeginFrame(uint32_t frame, const FramePacket& packet);
+
+	/// @brief Copies everything staged for this frame into the device local buffers, before any pass reads them.
+	void AddUploadPass(RenderGraph& graph);
+
+	/// @brief Imports the objects drawn by the current frame, for passes that read them through the graph.
+	RenderResource ImportDraws(RenderGraph& graph) const;
+
+	// Bindless slots, the draws are the object index of each of the current frame's draws in the order of its packet.
+	uint32_t GetTransformBuffer() const { return m_TransformSlot; }
+	uint32_t GetBoundsBuffer() const { return m_BoundsSlot; }
+	uint32_t GetDrawBuffer() const { return m_Frames[m_CurrentFrame].drawSlot; }
+private:
+	struct Frame
+	{
+		vkInit::Buffer staging, draws;
+		uint8_t* mappedStaging = nullptr;
+		uint32_t* mappedDraws = nullptr;
+		vk::DeviceSize stagingCapacity = 0;
+		uint32_t drawCapacity = 0;
+		uint32_t drawSlot = vkInit::InvalidBindlessIndex;
+	};
+
+	struct Copy
+	{
+		vk::Buffer source, destination;
+		vk::BufferCopy region;
+	};
+
+	vkInit::Buffer CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, const char* name);
+	void DestroyBuffer(vkInit::Buffer& buffer);
+	void DestroyFrame(Frame& frame);
+	bool ReserveObjects(uint32_t count);
+	bool ReserveStaging(Frame& frame, vk::DeviceSize size);
+	bool ReserveDraws(Frame& frame, uint32_t count);
+private:
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+	vkInit::BindlessHeap& m_Heap;
+	DeletionQueue& m_DeletionQueue;
+
+	// Shared by every frame, the upload pass waits for earlier frames to finish reading before it copies.
+	vkInit::Buffer m_Transforms, m_Bounds;
+	uint32_t m_TransformSlot = vkInit::InvalidBindlessIndex;
+	uint32_t m_BoundsSlot = vkInit::InvalidBindlessIndex;
+	uint32_t m_Capacity = 0;
+
+	std::vector<Frame> m_Frames;
+	uint32_t m_CurrentFrame = 0;
+
+	// Recorded by the next upload pass.
+	std::vector<Copy> m_Copies;
+	bool m_SceneUploadNeeded = true;
+	bool m_SceneUploaded = false;	// The next frame's copies hold the whole scene, its packet's moved objects are older.
+};
+
+#endif // !SCENE_BUFFERS_HPP
\ No newline at end of file
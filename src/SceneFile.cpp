@@ -0,0 +1,186 @@
+#include "SceneFile.hpp"
+
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+}
+
+SceneFile::~SceneFile()
+{
+#if defined(_WIN32)
+	if (m_Data)
+		UnmapViewOfFile(m_Data);
+	if (m_Mapping)
+		CloseHandle(m_Mapping);
+	if (m_File && m_File != INVALID_HANDLE_VALUE)
+		CloseHandle(m_File);
+#else
+	if (m_Data)
+		munmap(m_Data, m_Size);
+#endif
+}
+
+std::unique_ptr<SceneFile> SceneFile::Open(const std::string& path)
+{
+	std::unique_ptr<SceneFile> file(new SceneFile());
+
+#if defined(_WIN32)
+	file->m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER size{};
+	if (file->m_File == INVALID_HANDLE_VALUE || !GetFileSizeEx(file->m_File, &size))
+	{
+		CONSOLE_ERROR("Failed to open scene file %s!", path.c_str());
+		return nullptr;
+	}
+	file->m_Size = static_cast<uint64_t>(size.QuadPart);
+	if (file->m_Size >= sizeof(SceneFileHeader))
+	{
+		// Copy on write, like MAP_PRIVATE.
+		file->m_Mapping = CreateFileMappingA(file->m_File, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (file->m_Mapping)
+			file->m_Data = static_cast<uint8_t*>(MapViewOfFile(file->m_Mapping, FILE_MAP_COPY, 0, 0, 0));
+	}
+#else
+	int descriptor = open(path.c_str(), O_RDONLY);
+	struct stat status{};
+	if (descriptor < 0 || fstat(descriptor, &status) != 0)
+	{
+		if (descriptor >= 0)
+			close(descriptor);
+		CONSOLE_ERROR("Failed to open scene file %s!", path.c_str());
+		return nullptr;
+	}
+	file->m_Size = static_cast<uint64_t>(status.st_size);
+	if (file->m_Size >= sizeof(SceneFileHeader))
+	{
+		void* data = mmap(nullptr, file->m_Size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+		if (data != MAP_FAILED)
+		{
+			file->m_Data = static_cast<uint8_t*>(data);
+
+			// Start reading ahead, the scene touches every section on its first update.
+			madvise(data, file->m_Size, MADV_WILLNEED);
+		}
+	}
+
+	// The mapping keeps the file alive on its own.
+	close(descriptor);
+#endif
+
+	if (!file->m_Data)
+	{
+		CONSOLE_ERROR("Failed to map scene file %s, it is empty or too small.", path.c_str());
+		file->m_Size = 0;
+		return nullptr;
+	}
+
+	// Only the header and the table of contents are checked, the sections are used as they are.
+	file->m_Header = reinterpret_cast<const SceneFileHeader*>(file->m_Data);
+	const SceneFileHeader& header = *file->m_Header;
+	if (memcmp(header.magic, SceneFileMagic, sizeof(SceneFileMagic)) != 0)
+	{
+		CONSOLE_ERROR("%s is not a scene file.", path.c_str());
+		return nullptr;
+	}
+	if (header.version != SceneFileVersion)
+	{
+		CONSOLE_ERROR("Scene file %s has version %u, only version %u is supported.", path.c_str(), header.version, SceneFileVersion);
+		return nullptr;
+	}
+
+	uint64_t tableEnd = sizeof(SceneFileHeader) + sizeof(SceneFileSection) * static_cast<uint64_t>(header.sectionCount);
+	if (header.fileSize != file->m_Size || tableEnd > file->m_Size)
+	{
+		CONSOLE_ERROR("Scene file %s is truncated, %llu of %llu bytes.", path.c_str(), static_cast<unsigned long long>(file->m_Size),
+			static_cast<unsigned long long>(header.fileSize));
+		return nullptr;
+	}
+
+	file->m_Sections = reinterpret_cast<const SceneFileSection*>(file->m_Data + sizeof(SceneFileHeader));
+	for (uint32_t i = 0; i < header.sectionCount; i++)
+	{
+		const SceneFileSection& section = file->m_Sections[i];
+		bool fits = section.offset >= tableEnd && section.offset % SceneFileAlignment == 0 && section.size <= file->m_Size &&
+			section.offset <= file->m_Size - section.size;
+		bool whole = section.elementSize > 0 && section.size % section.elementSize == 0;
+		if (!fits || !whole)
+		{
+			CONSOLE_ERROR("Scene file %s has a corrupt section %u.", path.c_str(), i);
+			return nullptr;
+		}
+	}
+
+	return file;
+}
+
+bool SceneFile::Write(const std::string& path, uint64_t instanceCount, const std::vector<SectionData>& sections)
+{
+	SceneFileHeader header{};
+	memcpy(header.magic, SceneFileMagic, sizeof(SceneFileMagic));
+	header.version = SceneFileVersion;
+	header.sectionCount = static_cast<uint32_t>(sections.size());
+	header.instanceCount = instanceCount;
+
+	// Lay the sections out first, the header records the final size.
+	std::vector<SceneFileSection> table(sections.size());
+	uint64_t offset = AlignUp(sizeof(SceneFileHeader) + sizeof(SceneFileSection) * sections.size(), SceneFileAlignment);
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		table[i].type = sections[i].type;
+		table[i].elementSize = sections[i].elementSize;
+		table[i].offset = offset;
+		table[i].size = sections[i].elementSize * sections[i].count;
+		offset = AlignUp(offset + table[i].size, SceneFileAlignment);
+	}
+	header.fileSize = offset;
+
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		CONSOLE_ERROR("Failed to create scene file %s!", path.c_str());
+		return false;
+	}
+
+	const char padding[SceneFileAlignment] = {};
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(reinterpret_cast<const char*>(table.data()), sizeof(SceneFileSection) * table.size());
+	uint64_t written = sizeof(header) + sizeof(SceneFileSection) * table.size();
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		stream.write(padding, static_cast<std::streamsize>(table[i].offset - written));
+		stream.write(static_cast<const char*>(sections[i].data), static_cast<std::streamsize>(table[i].size));
+		written = table[i].offset + table[i].size;
+	}
+	stream.write(padding, static_cast<std::streamsize>(header.fileSize - written));
+
+	if (!stream)
+	{
+		CONSOLE_ERROR("Failed to write scene file %s!", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+const SceneFileSection* SceneFile::FindSection(SceneSection type) const
+{
+	for (uint32_t i = 0; i < m_Header->sectionCount; i++)
+		if (m_Sections[i].type == type)
+			return &m_Sections[i];
+
+	return nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef SCENE_FILE_HPP
+#define SCENE_FILE_HPP
+
+#include "Config.hpp"
+
+#include <memory>
+
+// Binary scene format, laid out to be mapped and used in place:
+//   SceneFileHeader
+//   SceneFileSection[sectionCount]		table of contents
+//   sections, each a flat array starting at a multiple of SceneFileAlignment
+// Every per-instance section holds instanceCount elements, in transform order, so parents come before their children.
+// The file is little endian, like every platform the renderer runs on.
+enum class SceneSection : uint32_t
+{
+	// Local transforms, one float stream each, in the order of TransformStore::Stream.
+	PositionX, PositionY, PositionZ,
+	RotationX, RotationY, RotationZ, RotationW,
+	ScaleX, ScaleY, ScaleZ,
+
+	Parent,		// uint32_t, TransformStore::NoParent for roots.
+	Depth,		// uint32_t, 0 for roots.
+	Mesh,		// uint32_t mesh id.
+	Material,	// uint32_t material id.
+	Bounds,		// AABB, world space bounds at the time the file was written.
+	Count
+};
+
+constexpr char SceneFileMagic[8] = { 'V', 'K', 'S', 'C', 'E', 'N', 'E', '\0' };
+constexpr uint32_t SceneFileVersion = 1;
+
+// Sections start on cache line boundaries, so SIMD loads straight out of the mapping stay aligned.
+constexpr uint64_t SceneFileAlignment = 64;
+
+struct SceneFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t sectionCount;
+	uint64_t instanceCount;
+	uint64_t fileSize;		// Catches truncated files before any section is touched.
+};
+
+struct SceneFileSection
+{
+	SceneSection type;
+	uint32_t elementSize;
+	uint64_t offset;		// From the start of the file.
+	uint64_t size;			// In bytes, elementSize * element count.
+};
+
+// A scene file mapped into memory. Pages are copy on write, so callers may modify sections in place
+// without the changes reaching the file, and only the pages that are touched are ever read from disk.
+class SceneFile
+{
+public:
+	// One section to write, data holds count elements of elementSize bytes.
+	struct SectionData
+	{
+		SceneSection type;
+		uint32_t elementSize;
+		uint64_t count;
+		const void* data;
+	};
+
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+	~SceneFile();
+
+	/// @brief Maps path and checks its header and table of contents. Returns null, after logging why, if the file is
+	/// missing, truncated, of another version or has a section that does not fit.
+	static std::unique_ptr<SceneFile> Open(const std::string& path);
+
+	/// @brief Writes a scene of instanceCount instances made of sections to path.
+	static bool Write(const std::string& path, uint64_t instanceCount, const std::vector<SectionData>& sections);
+
+	/// @brief The section of type as count elements of T, null if the file has no such section or its elements are not of T's size.
+	template<typename T>
+	T* GetSection(SceneSection type, uint64_t& count)
+	{
+		const SceneFileSection* section = FindSection(type);
+		if (!section || section->elementSize != sizeof(T))
+			return nullptr;
+		count = section->size / sizeof(T);
+		return reinterpret_cast<T*>(m_Data + section->offset);
+	}
+
+	uint64_t GetInstanceCount() const { return m_Header->instanceCount; }
+	uint64_t GetSize() const { return m_Size; }
+private:
+	SceneFile() = default;
+	const SceneFileSection* FindSection(SceneSection type) const;
+private:
+	uint8_t* m_Data = nullptr;
+	uint64_t m_Size = 0;
+	const SceneFileHeader* m_Header = nullptr;
+	const SceneFileSection* m_Sections = nullptr;
+
+#ifdef _WIN32
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+#endif
+};
+
+#endif // !SCENE_FILE_HPP
\ No newline at end of file
@@ -1,2 +1,9 @@
 glslc Triangle.vert -o TriangleVert.spv
-glslc Triangle.frag -o TriangleFrag.spv
\ No newline at end of file
+glslc Triangle.frag -o TriangleFrag.spv
+glslc TriangleIndirect.vert -o TriangleIndirectVert.spv
+glslc DepthPyramid.comp -o DepthPyramidComp.spv
+glslc OcclusionCull.comp -o OcclusionCullComp.spv
+glslc ParticleSimulate.comp -o ParticleSimulateComp.spv
+glslc Particle.vert -o ParticleVert.spv
+glslc -DMULTIVIEW TriangleIndirect.vert -o TriangleIndirectMultiviewVert.spv
+glslc -DMULTIVIEW Particle.vert -o ParticleMultiviewVert.spv
\ No newline at end of file
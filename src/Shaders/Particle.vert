@@ -0,0 +1,51 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+#endif
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec3 aColor;
+
+layout (push_constant) uniform Constants
+{
+	mat4 model;
+	uint objectIndex;
+	uint materialIndex;
+	uint instanceBuffer;
+	uint viewBuffer;
+}u_ObjectData;
+
+// Compacted by ParticleSimulate.comp, one entry per alive particle, or uploaded by the world streamer, one per chunk instance.
+struct ParticleInstance
+{
+	vec4 positionSize;
+	vec4 color;
+};
+
+layout (set = 0, binding = 2) readonly buffer InstanceBuffer
+{
+	ParticleInstance instances[];
+}u_Instances[];
+
+#ifdef MULTIVIEW
+// View projection of every view, written by Engine::UploadSceneViews.
+layout (set = 0, binding = 2) readonly buffer ViewBuffer
+{
+	mat4 views[];
+}u_Views[];
+#endif
+
+layout(location = 0) out vec3 fragColor;
+
+void main()
+{
+	ParticleInstance instance = u_Instances[u_ObjectData.instanceBuffer].instances[gl_InstanceIndex];
+	vec4 position = vec4(instance.positionSize.xyz + vec3(aPos * instance.positionSize.w, 0.0), 1.0);
+#ifdef MULTIVIEW
+	gl_Position = u_Views[u_ObjectData.viewBuffer].views[gl_ViewIndex] * position;
+#else
+	gl_Position = u_ObjectData.model * position;
+#endif
+	fragColor = aColor * instance.color.rgb;
+}
\ No newline at end of file
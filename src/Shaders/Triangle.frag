@@ -1,9 +1,22 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout (location = 0) in vec3 fragColor;
 
 layout (location = 0) out vec4 fragmentColor;
 
+layout (push_constant) uniform Constants
+{
+	mat4 model;
+	uint objectIndex;
+	uint materialIndex;
+	uint instanceBuffer;
+}u_ObjectData;
+
+// Global bindless heap, see vkInit::BindlessBinding.
+layout (set = 0, binding = 0) uniform texture2D u_Textures[];
+layout (set = 0, binding = 1) uniform sampler u_Samplers[];
+
 void main()
 {
 	fragmentColor = vec4(fragColor, 1.0);
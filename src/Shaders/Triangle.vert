@@ -6,6 +6,9 @@ layout (location = 1) in vec3 aColor;
 layout (push_constant) uniform Constants
 {
 	mat4 model;
+	uint objectIndex;
+	uint materialIndex;
+	uint instanceBuffer;
 }u_ObjectData;
 
 layout(location = 0) out vec3 fragColor;
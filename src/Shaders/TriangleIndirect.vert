@@ -0,0 +1,51 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+#endif
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec3 aColor;
+
+layout (push_constant) uniform Constants
+{
+	mat4 model;
+	uint objectIndex;
+	uint materialIndex;
+	uint instanceBuffer;
+	uint viewBuffer;
+	uint transformBuffer;
+}u_ObjectData;
+
+// The object of every draw that passed frustum culling, written by SceneBuffers in the order of the frame's draws.
+layout (set = 0, binding = 2) readonly buffer DrawBuffer
+{
+	uint objects[];
+}u_Draws[];
+
+// World matrix of every scene object, indexed by object.
+layout (set = 0, binding = 2) readonly buffer TransformBuffer
+{
+	mat4 world[];
+}u_Transforms[];
+
+// View projection of every view, written by Engine::UploadSceneViews.
+layout (set = 0, binding = 2) readonly buffer ViewBuffer
+{
+	mat4 views[];
+}u_Views[];
+
+layout(location = 0) out vec3 fragColor;
+
+void main()
+{
+	// The culling shaders point firstInstance of each indirect command at its draw, batches at their first one.
+	uint object = u_Draws[u_ObjectData.instanceBuffer].objects[gl_InstanceIndex];
+#ifdef MULTIVIEW
+	mat4 viewProjection = u_Views[u_ObjectData.viewBuffer].views[gl_ViewIndex];
+#else
+	mat4 viewProjection = u_Views[u_ObjectData.viewBuffer].views[0];
+#endif
+	gl_Position = viewProjection * u_Transforms[u_ObjectData.transformBuffer].world[object] * vec4(aPos, 0.0, 1.0);
+	fragColor = aColor;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// SSE is the baseline on x64. AVX paths are additionally compiled in when the compiler targets it (__AVX__), see ENABLE_AVX.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_SIMD_SSE
+#include <immintrin.h>
+#endif
+
+#endif // !SIMD_HPP
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include "SoftwareRenderer.hpp"
+#include "TriangleMesh.hpp"
+#include "Simd.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+namespace
+{
+	constexpr uint32_t TileSize = 64;
+
+	// Draws set up and binned by one job, large enough that a batch's per-tile lists stay short.
+	constexpr uint32_t SetupBatchSize = 4096;
+
+	// Vertices snap to 1/256 of a pixel, the subpixel precision of common GPUs.
+	constexpr float SubpixelScale = 256.0f;
+
+	// The Vulkan path's clear color, 0.02, 0.04 and 0.08 written to a UNORM target.
+	constexpr uint32_t ClearColor = 0xFF140A05u;
+
+#ifdef ENGINE_SIMD_SSE
+	inline __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+	inline __m128 Mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+	inline __m128 Div(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+	inline __m128 And(__m128 a, __m128 b) { return _mm_and_ps(a, b); }
+	inline __m128 Or(__m128 a, __m128 b) { return _mm_or_ps(a, b); }
+	inline __m128 CmpGt(__m128 a, __m128 b) { return _mm_cmpgt_ps(a, b); }
+	inline __m128 CmpGe(__m128 a, __m128 b) { return _mm_cmpge_ps(a, b); }
+	inline __m128 CmpLe(__m128 a, __m128 b) { return _mm_cmple_ps(a, b); }
+	inline __m128 CmpEq(__m128 a, __m128 b) { return _mm_cmpeq_ps(a, b); }
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	inline bool Any(__m128 mask) { return _mm_movemask_ps(mask) != 0; }
+	inline __m128 Splat(float value, __m128) { return _mm_set1_ps(value); }
+	inline __m128 Load(const float* data, __m128) { return _mm_loadu_ps(data); }
+	inline void Store(float* data, __m128 value) { _mm_storeu_ps(data, value); }
+	inline __m128 LaneOffsets(__m128) { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+
+	// Rounded to nearest like a UNORM attachment write, alpha is opaque.
+	inline __m128i PackChannels(__m128i r, __m128i g, __m128i b)
+	{
+		__m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 8));
+		__m128i ba = _mm_or_si128(_mm_slli_epi32(b, 16), _mm_set1_epi32(static_cast<int32_t>(0xFF000000u)));
+		return _mm_or_si128(rg, ba);
+	}
+
+	inline __m128 PackColor(__m128 r, __m128 g, __m128 b)
+	{
+		const __m128 zero = _mm_setzero_ps(), scale = _mm_set1_ps(255.0f);
+		auto unorm = [&](__m128 value) { return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(value, scale), zero), scale)); };
+		return _mm_castsi128_ps(PackChannels(unorm(r), unorm(g), unorm(b)));
+	}
+
+#ifdef __AVX__
+	inline __m256 Add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+	inline __m256 Mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+	inline __m256 Div(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+	inline __m256 And(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+	inline __m256 Or(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+	inline __m256 CmpGt(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	inline __m256 CmpGe(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	inline __m256 CmpLe(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	inline __m256 CmpEq(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	inline __m256 Select(__m256 mask, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, mask); }
+	inline bool Any(__m256 mask) { return _mm256_movemask_ps(mask) != 0; }
+	inline __m256 Splat(float value, __m256) { return _mm256_set1_ps(value); }
+	inline __m256 Load(const float* data, __m256) { return _mm256_loadu_ps(data); }
+	inline void Store(float* data, __m256 value) { _mm256_storeu_ps(data, value); }
+	inline __m256 LaneOffsets(__m256) { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+
+	// Without AVX2 there are no 256-bit integer shifts, the halves are packed with SSE.
+	inline __m256 PackColor(__m256 r, __m256 g, __m256 b)
+	{
+		const __m256 zero = _mm256_setzero_ps(), scale = _mm256_set1_ps(255.0f);
+		auto unorm = [&](__m256 value) { return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(value, scale), zero), scale)); };
+		__m256i ri = unorm(r), gi = unorm(g), bi = unorm(b);
+		__m128i low = PackChannels(_mm256_castsi256_si128(ri), _mm256_castsi256_si128(gi), _mm256_castsi256_si128(bi));
+		__m128i high = PackChannels(_mm256_extractf128_si256(ri, 1), _mm256_extractf128_si256(gi, 1), _mm256_extractf128_si256(bi, 1));
+		return _mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(low), high, 1));
+	}
+#endif
+
+	// Rasterizes the part of triangle inside [x0, x1] x [y0, y1], one row of Width pixels at a time. x0 has to be a
+	// multiple of the width, spans then never cross a tile.
+	template<typename V>
+	void RasterizeSpans(const float* edgeA, const float* edgeB, const float* edgeC, const bool* topLeft, const float* depth,
+		const float* inverseW, const float (*color)[3], int32_t originX, int32_t originY, int32_t x0, int32_t x1, int32_t y0, int32_t y1,
+		float* depthBuffer, uint32_t* colorBuffer, uint32_t stride)
+	{
+		constexpr int32_t Width = static_cast<int32_t>(sizeof(V) / sizeof(float));
+		const V zero = Splat(0.0f, V()), one = Splat(1.0f, V());
+		const V allOnes = CmpEq(zero, zero);
+
+		V a[3], b[3], c[3], edgeInclusive[3];
+		for (int i = 0; i < 3; i++)
+		{
+			a[i] = Splat(edgeA[i], zero);
+			b[i] = Splat(edgeB[i], zero);
+			c[i] = Splat(edgeC[i], zero);
+			edgeInclusive[i] = topLeft[i] ? allOnes : zero;
+		}
+
+		const V lastX = Splat(static_cast<float>(x1 - originX), zero);
+		const V lanes = LaneOffsets(zero);
+
+		for (int32_t y = y0; y <= y1; y++)
+		{
+			const V py = Splat(static_cast<float>(y - originY), zero);
+			V rowStart[3];
+			for (int i = 0; i < 3; i++)
+				rowStart[i] = Add(Mul(b[i], py), c[i]);
+
+			float* depthRow = depthBuffer + static_cast<size_t>(y) * stride;
+			float* colorRow = reinterpret_cast<float*>(colorBuffer + static_cast<size_t>(y) * stride);
+			for (int32_t x = x0; x <= x1; x += Width)
+			{
+				const V px = Add(Splat(static_cast<float>(x - originX), zero), lanes);
+
+				// Inside every edge, or exactly on one that owns its pixels.
+				V weight[3];
+				V mask = CmpLe(px, lastX);
+				for (int i = 0; i < 3; i++)
+				{
+					weight[i] = Add(Mul(a[i], px), rowStart[i]);
+					mask = And(mask, Or(CmpGt(weight[i], zero), And(CmpEq(weight[i], zero), edgeInclusive[i])));
+				}
+				if (!Any(mask))
+					continue;
+
+				// Clipped against the far plane per pixel, the near plane was clipped during setup.
+				V z = Add(Add(Mul(weight[0], Splat(depth[0], zero)), Mul(weight[1], Splat(depth[1], zero))), Mul(weight[2], Splat(depth[2], zero)));
+				V stored = Load(depthRow + x, zero);
+				mask = And(mask, And(And(CmpGe(z, zero), CmpLe(z, one)), CmpLe(z, stored)));
+				if (!Any(mask))
+					continue;
+				Store(depthRow + x, Select(mask, z, stored));
+
+				V w = Add(Add(Mul(weight[0], Splat(inverseW[0], zero)), Mul(weight[1], Splat(inverseW[1], zero))), Mul(weight[2], Splat(inverseW[2], zero)));
+				V channels[3];
+				for (int channel = 0; channel < 3; channel++)
+				{
+					V value = Add(Add(Mul(weight[0], Splat(color[0][channel], zero)), Mul(weight[1], Splat(color[1][channel], zero))),
+						Mul(weight[2], Splat(color[2][channel], zero)));
+					channels[channel] = Div(value, w);
+				}
+
+				V previous = Load(colorRow + x, zero);
+				Store(colorRow + x, Select(mask, PackColor(channels[0], channels[1], channels[2]), previous));
+			}
+		}
+	}
+#else
+	uint32_t ToUnorm8(float value)
+	{
+		return static_cast<uint32_t>(std::nearbyint(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+	}
+#endif
+}
+
+SoftwareRenderer::SoftwareRenderer(const Input& input) : m_Jobs(*input.jobs), m_PipelineDepth(input.pipelineDepth), m_Settings(input.settings)
+{
+	m_Settings.width = std::max(m_Settings.width, 1u);
+	m_Settings.height = std::max(m_Settings.height, 1u);
+
+	m_TilesX = (m_Settings.width + TileSize - 1) / TileSize;
+	m_TilesY = (m_Settings.height + TileSize - 1) / TileSize;
+	m_Stride = m_TilesX * TileSize;
+	m_Depth.resize(static_cast<size_t>(m_Stride) * m_TilesY * TileSize);
+	m_Color.resize(m_Depth.size());
+
+#if defined(__AVX__)
+	const char* path = "AVX";
+#elif defined(ENGINE_SIMD_SSE)
+	const char* path = "SSE";
+#else
+	const char* path = "scalar";
+#endif
+	CONSOLE_INFO("Software renderer: %ux%u in %ux%u tiles, %s rasterization on %u workers.", m_Settings.width, m_Settings.height,
+		m_TilesX, m_TilesY, path, m_Jobs.GetWorkerCount());
+}
+
+void SoftwareRenderer::Run(Scene* scene)
+{
+	if (!m_Settings.directory.empty())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(m_Settings.directory, error);
+		if (error)
+		{
+			CONSOLE_ERROR("Failed to create output directory %s! %s", m_Settings.directory.c_str(), error.message().c_str());
+			m_Settings.directory.clear();
+		}
+	}
+
+	FramePipeline pipeline(m_Jobs, m_PipelineDepth);
+	double setupMilliseconds = 0.0, rasterMilliseconds = 0.0;
+	uint32_t written = 0;
+	for (uint64_t frame = 0; frame < m_Settings.frameCount; frame++)
+	{
+		PROFILE_FRAME(frame);
+		pipeline.Kick(scene, frame);
+		Render(pipeline.Acquire(frame));
+		setupMilliseconds += m_Stats.setupMilliseconds;
+		rasterMilliseconds += m_Stats.rasterMilliseconds;
+
+		if (!m_Settings.directory.empty() && Write(frame))
+			written++;
+	}
+
+	const double frames = std::max(m_Settings.frameCount, 1u);
+	CONSOLE_INFO("Software renderer: %u frames, %.2f ms setup and %.2f ms rasterization per frame, %u triangles in %u tile bins "
+		"in the last one, %u written.", m_Settings.frameCount, setupMilliseconds / frames, rasterMilliseconds / frames,
+		m_Stats.triangles, m_Stats.binned, written);
+}
+
+void SoftwareRenderer::Render(const FramePacket& packet)
+{
+	PROFILE_SCOPE("SoftwareRenderer::Render");
+	auto start = std::chrono::steady_clock::now();
+
+	const uint32_t drawCount = static_cast<uint32_t>(packet.draws.size());
+	const uint32_t tileCount = m_TilesX * m_TilesY;
+	m_BatchCount = (drawCount + SetupBatchSize - 1) / SetupBatchSize;
+	if (m_Batches.size() < m_BatchCount)
+		m_Batches.resize(m_BatchCount);
+	for (uint32_t i = 0; i < m_BatchCount; i++)
+	{
+		m_Batches[i].triangles.clear();
+		m_Batches[i].tiles.resize(tileCount);
+		for (std::vector<uint32_t>& tile : m_Batches[i].tiles)
+			tile.clear();
+	}
+
+	// Batches are filled in parallel, each tile walks them in order afterwards so draws keep their order.
+	m_Jobs.ParallelFor(drawCount, SetupBatchSize, [this, &packet](uint32_t begin, uint32_t end)
+	{
+		Setup(packet, begin, end - begin, m_Batches[begin / SetupBatchSize]);
+	});
+
+	auto setupEnd = std::chrono::steady_clock::now();
+	m_Jobs.ParallelFor(tileCount, 1, [this](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t tile = begin; tile < end; tile++)
+			RasterizeTile(tile);
+	});
+
+	m_Stats.triangles = 0;
+	m_Stats.binned = 0;
+	for (uint32_t i = 0; i < m_BatchCount; i++)
+	{
+		m_Stats.triangles += static_cast<uint32_t>(m_Batches[i].triangles.size());
+		for (const std::vector<uint32_t>& tile : m_Batches[i].tiles)
+			m_Stats.binned += static_cast<uint32_t>(tile.size());
+	}
+	m_Stats.setupMilliseconds = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+	m_Stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupEnd).count();
+}
+
+bool SoftwareRenderer::Write(uint64_t frame)
+{
+	PROFILE_SCOPE("SoftwareRenderer::Write");
+	const size_t rowBytes = static_cast<size_t>(m_Settings.width) * 4;
+	m_Output.resize(rowBytes * m_Settings.height);
+	for (uint32_t y = 0; y < m_Settings.height; y++)
+		memcpy(m_Output.data() + y * rowBytes, m_Color.data() + static_cast<size_t>(y) * m_Stride, rowBytes);
+
+	vk::Extent2D extent(m_Settings.width, m_Settings.height);
+	if (!FrameCapture::WriteImage(m_Settings.directory, m_Settings.format, frame, extent, m_Output.data()))
+	{
+		CONSOLE_ERROR("Failed to write software rendered frame %llu to %s!", static_cast<unsigned long long>(frame), m_Settings.directory.c_str());
+		return false;
+	}
+	return true;
+}
+
+void SoftwareRenderer::Setup(const FramePacket& packet, uint32_t first, uint32_t count, Batch& batch) const
+{
+	PROFILE_SCOPE("SoftwareRenderer::Setup");
+	const std::vector<float>& mesh = TriangleMesh::GetVertices();
+	const size_t vertexCount = mesh.size() / TriangleMesh::VertexFloats;
+
+	// Every mesh id draws the triangle mesh, like on the GPU.
+	for (uint32_t draw = first; draw < first + count; draw++)
+	{
+		const glm::mat4& model = packet.draws[draw].model;
+		for (size_t v = 0; v + 3 <= vertexCount; v += 3)
+		{
+			Vertex vertices[3];
+			for (size_t i = 0; i < 3; i++)
+			{
+				const float* source = mesh.data() + (v + i) * TriangleMesh::VertexFloats;
+				vertices[i].position = model * glm::vec4(source[0], source[1], 0.0f, 1.0f);
+				vertices[i].color = glm::vec3(source[2], source[3], source[4]);
+			}
+
+			// Entirely outside one clip plane.
+			bool outside = false;
+			for (int axis = 0; axis < 3 && !outside; axis++)
+			{
+				bool below = true, above = true;
+				for (const Vertex& vertex : vertices)
+				{
+					float lower = axis == 2 ? 0.0f : -vertex.position.w;
+					below = below && vertex.position[axis] < lower;
+					above = above && vertex.position[axis] > vertex.position.w;
+				}
+				outside = below || above;
+			}
+			if (outside)
+				continue;
+
+			if (vertices[0].position.z >= 0.0f && vertices[1].position.z >= 0.0f && vertices[2].position.z >= 0.0f)
+			{
+				SetupTriangle(vertices, batch);
+				continue;
+			}
+
+			// Clipped against z = 0, which leaves a triangle or a quad that is split into two.
+			Vertex clipped[4];
+			uint32_t clippedCount = 0;
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				const Vertex& current = vertices[i];
+				const Vertex& next = vertices[(i + 1) % 3];
+				if (current.position.z >= 0.0f)
+					clipped[clippedCount++] = current;
+				if ((current.position.z >= 0.0f) != (next.position.z >= 0.0f))
+				{
+					float t = current.position.z / (current.position.z - next.position.z);
+					clipped[clippedCount].position = glm::mix(current.position, next.position, t);
+					clipped[clippedCount].color = glm::mix(current.color, next.color, t);
+					clippedCount++;
+				}
+			}
+
+			for (uint32_t i = 2; i < clippedCount; i++)
+			{
+				Vertex fan[3] = { clipped[0], clipped[i - 1], clipped[i] };
+				SetupTriangle(fan, batch);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::SetupTriangle(const Vertex* vertices, Batch& batch) const
+{
+	Triangle triangle{};
+	double x[3], y[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec4& position = vertices[i].position;
+		float inverseW = 1.0f / position.w;
+
+		// Vulkan's viewport transform, y points down.
+		float screenX = (position.x * inverseW * 0.5f + 0.5f) * m_Settings.width;
+		float screenY = (position.y * inverseW * 0.5f + 0.5f) * m_Settings.height;
+		x[i] = std::round(screenX * SubpixelScale) / SubpixelScale;
+		y[i] = std::round(screenY * SubpixelScale) / SubpixelScale;
+
+		triangle.depth[i] = position.z * inverseW;
+		triangle.inverseW[i] = inverseW;
+		for (int channel = 0; channel < 3; channel++)
+			triangle.color[i][channel] = vertices[i].color[channel] * inverseW;
+	}
+
+	// Clockwise triangles are front facing and back faces are culled, which in y down screen space leaves the positive areas.
+	double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (!(area > 0.0))
+		return;
+
+	// Conservative pixel bounds, clamped before converting since vertices near w = 0 land far outside the target.
+	const double width = m_Settings.width, height = m_Settings.height;
+	triangle.minX = static_cast<int32_t>(std::clamp(std::floor(std::min({ x[0], x[1], x[2] })), 0.0, width));
+	triangle.minY = static_cast<int32_t>(std::clamp(std::floor(std::min({ y[0], y[1], y[2] })), 0.0, height));
+	triangle.maxX = static_cast<int32_t>(std::clamp(std::floor(std::max({ x[0], x[1], x[2] })), -1.0, width - 1.0));
+	triangle.maxY = static_cast<int32_t>(std::clamp(std::floor(std::max({ y[0], y[1], y[2] })), -1.0, height - 1.0));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	// Edge i is opposite vertex i and positive on the triangle's side, evaluated at pixel centers.
+	const double centerX = triangle.minX + 0.5, centerY = triangle.minY + 0.5;
+	for (int i = 0; i < 3; i++)
+	{
+		int from = (i + 1) % 3, to = (i + 2) % 3;
+		double dx = x[to] - x[from], dy = y[to] - y[from];
+		triangle.edgeA[i] = static_cast<float>(-dy / area);
+		triangle.edgeB[i] = static_cast<float>(dx / area);
+		triangle.edgeC[i] = static_cast<float>((dx * (centerY - y[from]) - dy * (centerX - x[from])) / area);
+		triangle.topLeft[i] = dy < 0.0 || (dy == 0.0 && dx > 0.0);
+	}
+
+	uint32_t index = static_cast<uint32_t>(batch.triangles.size());
+	batch.triangles.push_back(triangle);
+	for (int32_t tileY = triangle.minY / static_cast<int32_t>(TileSize); tileY <= triangle.maxY / static_cast<int32_t>(TileSize); tileY++)
+		for (int32_t tileX = triangle.minX / static_cast<int32_t>(TileSize); tileX <= triangle.maxX / static_cast<int32_t>(TileSize); tileX++)
+			batch.tiles[tileY * m_TilesX + tileX].push_back(index);
+}
+
+void SoftwareRenderer::RasterizeTile(uint32_t tile)
+{
+	PROFILE_SCOPE("SoftwareRenderer::RasterizeTile");
+	const int32_t tileX = static_cast<int32_t>(tile % m_TilesX * TileSize);
+	const int32_t tileY = static_cast<int32_t>(tile / m_TilesX * TileSize);
+	const int32_t lastX = std::min(tileX + static_cast<int32_t>(TileSize), static_cast<int32_t>(m_Settings.width)) - 1;
+	const int32_t lastY = std::min(tileY + static_cast<int32_t>(TileSize), static_cast<int32_t>(m_Settings.height)) - 1;
+
+	// Cleared here rather than in one pass over the frame, so the tile is already in cache when it is drawn.
+	for (int32_t y = tileY; y < tileY + static_cast<int32_t>(TileSize); y++)
+	{
+		size_t row = static_cast<size_t>(y) * m_Stride + tileX;
+		std::fill_n(m_Depth.data() + row, TileSize, 1.0f);
+		std::fill_n(m_Color.data() + row, TileSize, ClearColor);
+	}
+
+	for (uint32_t b = 0; b < m_BatchCount; b++)
+	{
+		const Batch& batch = m_Batches[b];
+		for (uint32_t index : batch.tiles[tile])
+		{
+			const Triangle& triangle = batch.triangles[index];
+			int32_t x0 = std::max(triangle.minX, tileX), x1 = std::min(triangle.maxX, lastX);
+			int32_t y0 = std::max(triangle.minY, tileY), y1 = std::min(triangle.maxY, lastY);
+
+#ifdef ENGINE_SIMD_SSE
+#ifdef __AVX__
+			using Lanes = __m256;
+#else
+			using Lanes = __m128;
+#endif
+			constexpr int32_t Width = static_cast<int32_t>(sizeof(Lanes) / sizeof(float));
+			RasterizeSpans<Lanes>(triangle.edgeA, triangle.edgeB, triangle.edgeC, triangle.topLeft, triangle.depth, triangle.inverseW,
+				triangle.color, triangle.minX, triangle.minY, x0 & ~(Width - 1), x1, y0, y1, m_Depth.data(), m_Color.data(), m_Stride);
+#else
+			for (int32_t y = y0; y <= y1; y++)
+			{
+				for (int32_t x = x0; x <= x1; x++)
+				{
+					float px = static_cast<float>(x - triangle.minX), py = static_cast<float>(y - triangle.minY);
+					float weight[3];
+					bool inside = true;
+					for (int i = 0; i < 3; i++)
+					{
+						weight[i] = triangle.edgeA[i] * px + (triangle.edgeB[i] * py + triangle.edgeC[i]);
+						inside = inside && (weight[i] > 0.0f || (weight[i] == 0.0f && triangle.topLeft[i]));
+					}
+
+					float& stored = m_Depth[static_cast<size_t>(y) * m_Stride + x];
+					float z = weight[0] * triangle.depth[0] + weight[1] * triangle.depth[1] + weight[2] * triangle.depth[2];
+					if (!inside || z < 0.0f || z > 1.0f || z > stored)
+						continue;
+					stored = z;
+
+					float w = weight[0] * triangle.inverseW[0] + weight[1] * triangle.inverseW[1] + weight[2] * triangle.inverseW[2];
+					uint32_t packed = 0xFF000000u;
+					for (int channel = 0; channel < 3; channel++)
+					{
+						float value = weight[0] * triangle.color[0][channel] + weight[1] * triangle.color[1][channel] + weight[2] * triangle.color[2][channel];
+						packed |= ToUnorm8(value / w) << (channel * 8);
+					}
+					m_Color[static_cast<size_t>(y) * m_Stride + x] = packed;
+				}
+			}
+#endif
+		}
+	}
+}
\ No newline at end of file
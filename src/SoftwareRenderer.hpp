@@ -0,0 +1,106 @@
+#ifndef SOFTWARE_RENDERER_HPP
+#define SOFTWARE_RENDERER_HPP
+
+#include "Config.hpp"
+#include "JobSystem.hpp"
+#include "FramePipeline.hpp"
+#include "FrameCapture.hpp"
+
+struct SoftwareSettings
+{
+	bool enabled = false;				// Render on the CPU instead of through Vulkan, for machines without a usable driver.
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	uint32_t frameCount = 1;			// Frames rendered before returning.
+	std::string directory = "captures";	// Every frame is written here, empty only renders.
+	CaptureFormat format = CaptureFormat::Png;
+};
+
+// Renders the scene on the CPU the way the Vulkan scene pipeline does: the mesh's triangles transformed by each draw's
+// baked matrix, clipped against the near plane, back faces culled, depth tested with less or equal and the vertex colors
+// interpolated with perspective correction into an 8-bit UNORM target. Triangles are set up and binned into 64x64 tiles
+// on the job system, then every tile is cleared and rasterized by one job with SIMD edge functions, 8 pixels at a time
+// with AVX and 4 with SSE. Draws keep their order within a tile, so the result matches the GPU's up to rounding.
+class SoftwareRenderer
+{
+public:
+	// Of the last frame.
+	struct Stats
+	{
+		uint32_t triangles = 0;			// Set up, after clipping and culling.
+		uint32_t binned = 0;			// Triangle and tile pairs.
+		double setupMilliseconds = 0.0;
+		double rasterMilliseconds = 0.0;
+	};
+
+	struct Input
+	{
+		JobSystem* jobs;
+		uint32_t pipelineDepth;			// Frames simulated ahead, like the Vulkan path's frame pipeline.
+		SoftwareSettings settings;
+	};
+
+	SoftwareRenderer(const Input& input);
+	SoftwareRenderer(const SoftwareRenderer&) = delete;
+	SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
+
+	/// @brief Simulates and renders frameCount frames of scene, writing each one when a directory is set.
+	void Run(Scene* scene);
+
+	/// @brief Renders the draws of packet into the color and depth buffers.
+	void Render(const FramePacket& packet);
+
+	/// @brief Writes the last rendered frame as frame into the settings' directory.
+	bool Write(uint64_t frame);
+
+	const Stats& GetStats() const { return m_Stats; }
+private:
+	struct Vertex
+	{
+		glm::vec4 position;		// Clip space.
+		glm::vec3 color;
+	};
+
+	struct Triangle
+	{
+		// Edge functions divided by the area, so they are the barycentric weights of the vertices. Evaluated at pixel
+		// offsets from (minX, minY), which keeps them precise in floats.
+		float edgeA[3], edgeB[3], edgeC[3];
+		bool topLeft[3];		// Pixels exactly on a top or left edge are inside, like the GPU's fill rule.
+
+		float depth[3];
+		float inverseW[3];
+		float color[3][3];		// Divided by w, for perspective correct interpolation.
+
+		int32_t minX, minY, maxX, maxY;		// Inclusive, inside the target.
+	};
+
+	// Triangles of one range of draws and, per tile, the ones touching it in draw order.
+	struct Batch
+	{
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<uint32_t>> tiles;
+	};
+
+	void Setup(const FramePacket& packet, uint32_t first, uint32_t count, Batch& batch) const;
+	void SetupTriangle(const Vertex* vertices, Batch& batch) const;
+	void RasterizeTile(uint32_t tile);
+private:
+	JobSystem& m_Jobs;
+	uint32_t m_PipelineDepth;
+	SoftwareSettings m_Settings;
+
+	// Rows are padded to whole tiles, so full SIMD spans never leave the buffers.
+	uint32_t m_Stride = 0;
+	uint32_t m_TilesX = 0, m_TilesY = 0;
+	std::vector<float> m_Depth;
+	std::vector<uint32_t> m_Color;		// RGBA8.
+
+	std::vector<Batch> m_Batches;		// Kept between frames to reuse their allocations.
+	uint32_t m_BatchCount = 0;
+
+	std::vector<uint8_t> m_Output;		// Unpadded rows for the writer.
+	Stats m_Stats;
+};
+
+#endif // !SOFTWARE_RENDERER_HPP
\ No newline at end of file
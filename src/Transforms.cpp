@@ -0,0 +1,343 @@
+#include "Transforms.hpp"
+#include "Simd.hpp"
+
+namespace
+{
+	// Multiple of the SIMD width so batches only have a partial group at the end of a level.
+	constexpr uint32_t UpdateBatchSize = 256;
+
+#ifdef ENGINE_SIMD_SSE
+	inline __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+	inline __m128 Sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+	inline __m128 Mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+	inline __m128 Splat(float value, __m128) { return _mm_set1_ps(value); }
+
+#ifdef __AVX__
+	inline __m256 Add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+	inline __m256 Sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+	inline __m256 Mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+	inline __m256 Splat(float value, __m256) { return _mm256_set1_ps(value); }
+#endif
+
+	// Rotation matrix of quaternion q scaled by s, as the column-major 3x3 basis, one transform per lane.
+	template<typename V>
+	inline void ComposeBasis(V qx, V qy, V qz, V qw, V sx, V sy, V sz, V basis[9])
+	{
+		const V one = Splat(1.0f, qx), two = Splat(2.0f, qx);
+
+		V xx = Mul(qx, qx), yy = Mul(qy, qy), zz = Mul(qz, qz);
+		V xy = Mul(qx, qy), xz = Mul(qx, qz), yz = Mul(qy, qz);
+		V wx = Mul(qw, qx), wy = Mul(qw, qy), wz = Mul(qw, qz);
+
+		basis[0] = Mul(Sub(one, Mul(two, Add(yy, zz))), sx);
+		basis[1] = Mul(Mul(two, Add(xy, wz)), sx);
+		basis[2] = Mul(Mul(two, Sub(xz, wy)), sx);
+
+		basis[3] = Mul(Mul(two, Sub(xy, wz)), sy);
+		basis[4] = Mul(Sub(one, Mul(two, Add(xx, zz))), sy);
+		basis[5] = Mul(Mul(two, Add(yz, wx)), sy);
+
+		basis[6] = Mul(Mul(two, Add(xz, wy)), sz);
+		basis[7] = Mul(Mul(two, Sub(yz, wx)), sz);
+		basis[8] = Mul(Sub(one, Mul(two, Add(xx, yy))), sz);
+	}
+
+	// Transposes four lanes of basis and translation into four column-major matrices.
+	inline void StoreMatrices(const __m128 basis[9], __m128 px, __m128 py, __m128 pz, glm::mat4* out)
+	{
+		__m128 columns[4][4] =
+		{
+			{ basis[0], basis[1], basis[2], _mm_setzero_ps() },
+			{ basis[3], basis[4], basis[5], _mm_setzero_ps() },
+			{ basis[6], basis[7], basis[8], _mm_setzero_ps() },
+			{ px, py, pz, _mm_set1_ps(1.0f) }
+		};
+
+		for (int column = 0; column < 4; column++)
+		{
+			__m128* rows = columns[column];
+			_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+			for (int lane = 0; lane < 4; lane++)
+				_mm_storeu_ps(&out[lane][column][0], rows[lane]);
+		}
+	}
+
+	// out = a * b for column-major 4x4 matrices. out must not alias a or b.
+	inline void MultiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+	{
+		__m128 a0 = _mm_loadu_ps(&a[0][0]);
+		__m128 a1 = _mm_loadu_ps(&a[1][0]);
+		__m128 a2 = _mm_loadu_ps(&a[2][0]);
+		__m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+		for (int column = 0; column < 4; column++)
+		{
+			__m128 result = _mm_mul_ps(a0, _mm_set1_ps(b[column][0]));
+			result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(b[column][1])));
+			result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(b[column][2])));
+			result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(b[column][3])));
+			_mm_storeu_ps(&out[column][0], result);
+		}
+	}
+#endif
+}
+
+uint32_t TransformStore::Create(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, uint32_t parent)
+{
+	uint32_t index = Size();
+
+	if (parent != NoParent && parent >= index)
+	{
+		CONSOLE_ERROR("Transform parent %u does not exist yet, creating %u as a root.", parent, index);
+		parent = NoParent;
+	}
+
+	m_PositionX.push_back(position.x);
+	m_PositionY.push_back(position.y);
+	m_PositionZ.push_back(position.z);
+	m_RotationX.push_back(rotation.x);
+	m_RotationY.push_back(rotation.y);
+	m_RotationZ.push_back(rotation.z);
+	m_RotationW.push_back(rotation.w);
+	m_ScaleX.push_back(scale.x);
+	m_ScaleY.push_back(scale.y);
+	m_ScaleZ.push_back(scale.z);
+	m_Parent.push_back(parent);
+	m_Depth.push_back(parent == NoParent ? 0 : m_Depth[parent] + 1);
+	m_Dirty.push_back(1);
+	m_World.push_back(glm::mat4(1.0f));
+
+	m_AnyDirty = true;
+	return index;
+}
+
+void TransformStore::Reserve(uint32_t count)
+{
+	for (MappedArray<float>* stream : GetStreams())
+		stream->reserve(count);
+
+	m_Parent.reserve(count);
+	m_Depth.reserve(count);
+	m_Dirty.reserve(count);
+	m_World.reserve(count);
+}
+
+void TransformStore::View(uint32_t count, const std::array<float*, StreamCount>& streams, uint32_t* parents, uint32_t* depths)
+{
+	std::array<MappedArray<float>*, StreamCount> owned = GetStreams();
+	for (uint32_t stream = 0; stream < StreamCount; stream++)
+		owned[stream]->View(streams[stream], count);
+	m_Parent.View(parents, count);
+	m_Depth.View(depths, count);
+
+	// Derived state is always owned, world matrices only exist once the first update has computed them.
+	m_Dirty.assign(count, 1);
+	m_World.assign(count, glm::mat4(1.0f));
+	m_AnyDirty = count > 0;
+	m_HierarchyUnchecked = count > 0;
+}
+
+void TransformStore::SetPosition(uint32_t index, const glm::vec3& position)
+{
+	m_PositionX[index] = position.x;
+	m_PositionY[index] = position.y;
+	m_PositionZ[index] = position.z;
+	MarkDirty(index);
+}
+
+void TransformStore::SetRotation(uint32_t index, const glm::quat& rotation)
+{
+	m_RotationX[index] = rotation.x;
+	m_RotationY[index] = rotation.y;
+	m_RotationZ[index] = rotation.z;
+	m_RotationW[index] = rotation.w;
+	MarkDirty(index);
+}
+
+void TransformStore::SetScale(uint32_t index, const glm::vec3& scale)
+{
+	m_ScaleX[index] = scale.x;
+	m_ScaleY[index] = scale.y;
+	m_ScaleZ[index] = scale.z;
+	MarkDirty(index);
+}
+
+void TransformStore::MarkDirty(uint32_t index)
+{
+	m_Dirty[index] = 1;
+	m_AnyDirty = true;
+}
+
+bool TransformStore::RepairHierarchy(uint32_t index)
+{
+	// Only broken entries are written, so the pages of a mapped file stay shared.
+	uint32_t parent = m_Parent[index];
+	bool broken = parent != NoParent && parent >= index;
+	if (broken)
+		m_Parent[index] = parent = NoParent;
+
+	uint32_t depth = parent == NoParent ? 0 : m_Depth[parent] + 1;
+	if (m_Depth[index] != depth)
+	{
+		m_Depth[index] = depth;
+		broken = true;
+	}
+	return broken;
+}
+
+std::array<MappedArray<float>*, TransformStore::StreamCount> TransformStore::GetStreams()
+{
+	return { &m_PositionX, &m_PositionY, &m_PositionZ, &m_RotationX, &m_RotationY, &m_RotationZ, &m_RotationW, &m_ScaleX, &m_ScaleY, &m_ScaleZ };
+}
+
+std::array<const MappedArray<float>*, TransformStore::StreamCount> TransformStore::GetStreams() const
+{
+	return { &m_PositionX, &m_PositionY, &m_PositionZ, &m_RotationX, &m_RotationY, &m_RotationZ, &m_RotationW, &m_ScaleX, &m_ScaleY, &m_ScaleZ };
+}
+
+void TransformStore::Update(JobSystem& jobs)
+{
+	m_LastUpdateCount = 0;
+	for (std::vector<uint32_t>& level : m_Levels)
+		level.clear();
+	m_UpdatedRanges.clear();
+
+	if (!m_AnyDirty)
+		return;
+
+	// Parents come before children, so one forward pass pushes dirtiness down whole subtrees.
+	// A viewed hierarchy is checked by the first pass, which visits every transform anyway.
+	const uint32_t count = Size();
+	uint32_t repaired = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (m_HierarchyUnchecked && RepairHierarchy(i))
+			repaired++;
+
+		uint32_t parent = m_Parent[i];
+		if (parent != NoParent && m_Dirty[parent])
+			m_Dirty[i] = 1;
+
+		if (m_Dirty[i])
+		{
+			if (m_Depth[i] >= m_Levels.size())
+				m_Levels.resize(m_Depth[i] + 1);
+			m_Levels[m_Depth[i]].push_back(i);
+
+			if (!m_UpdatedRanges.empty() && m_UpdatedRanges.back().first + m_UpdatedRanges.back().count == i)
+				m_UpdatedRanges.back().count++;
+			else
+				m_UpdatedRanges.push_back({ i, 1 });
+		}
+	}
+
+	if (repaired > 0)
+		CONSOLE_WARN("%u transforms had a parent after them or a wrong depth, they were turned into roots or given their parent's depth + 1.", repaired);
+	m_HierarchyUnchecked = false;
+
+	// A level only reads world matrices of the previous one, so each level is one parallel pass.
+	for (const std::vector<uint32_t>& level : m_Levels)
+	{
+		jobs.ParallelFor(static_cast<uint32_t>(level.size()), UpdateBatchSize, [this, &level](uint32_t begin, uint32_t end)
+		{
+			ComputeWorldMatrices(level.data() + begin, end - begin);
+		});
+
+		for (uint32_t index : level)
+			m_Dirty[index] = 0;
+
+		m_LastUpdateCount += static_cast<uint32_t>(level.size());
+	}
+
+	m_AnyDirty = false;
+}
+
+void TransformStore::ComputeWorldMatrices(const uint32_t* indices, uint32_t count)
+{
+#ifdef ENGINE_SIMD_SSE
+	glm::mat4 local[8];
+	uint32_t i = 0;
+
+	// Writes the world matrices of one group, lanes past the end of the range are padding and get dropped.
+	auto resolve = [this, &local](const uint32_t* group, uint32_t lanes)
+	{
+		for (uint32_t lane = 0; lane < lanes; lane++)
+		{
+			uint32_t index = group[lane];
+			uint32_t parent = m_Parent[index];
+			if (parent == NoParent)
+				m_World[index] = local[lane];
+			else
+				MultiplyMatrices(m_World[parent], local[lane], m_World[index]);
+		}
+	};
+
+	// Levels list their transforms in ascending order, so a group spanning as many indices as it has lanes is one
+	// contiguous run of every stream and loads straight from it. Scattered groups gather lane by lane.
+#ifdef __AVX__
+	for (; i + 8 <= count; i += 8)
+	{
+		const uint32_t* id = indices + i;
+		const bool contiguous = id[7] - id[0] == 7;
+		auto gather = [id, contiguous](const MappedArray<float>& stream)
+		{
+			const float* values = stream.data();
+			if (contiguous)
+				return _mm256_loadu_ps(values + id[0]);
+			return _mm256_setr_ps(values[id[0]], values[id[1]], values[id[2]], values[id[3]],
+				values[id[4]], values[id[5]], values[id[6]], values[id[7]]);
+		};
+
+		__m256 basis[9];
+		ComposeBasis(gather(m_RotationX), gather(m_RotationY), gather(m_RotationZ), gather(m_RotationW),
+			gather(m_ScaleX), gather(m_ScaleY), gather(m_ScaleZ), basis);
+		__m256 px = gather(m_PositionX), py = gather(m_PositionY), pz = gather(m_PositionZ);
+
+		__m128 lowBasis[9], highBasis[9];
+		for (int b = 0; b < 9; b++)
+		{
+			lowBasis[b] = _mm256_castps256_ps128(basis[b]);
+			highBasis[b] = _mm256_extractf128_ps(basis[b], 1);
+		}
+
+		StoreMatrices(lowBasis, _mm256_castps256_ps128(px), _mm256_castps256_ps128(py), _mm256_castps256_ps128(pz), local);
+		StoreMatrices(highBasis, _mm256_extractf128_ps(px, 1), _mm256_extractf128_ps(py, 1), _mm256_extractf128_ps(pz, 1), local + 4);
+		resolve(id, 8);
+	}
+#endif
+
+	for (; i < count; i += 4)
+	{
+		uint32_t lanes = std::min(4u, count - i);
+		uint32_t id[4];
+		for (uint32_t lane = 0; lane < 4; lane++)
+			id[lane] = indices[i + std::min(lane, lanes - 1)];
+
+		const bool contiguous = lanes == 4 && id[3] - id[0] == 3;
+		auto gather = [&id, contiguous](const MappedArray<float>& stream)
+		{
+			const float* values = stream.data();
+			if (contiguous)
+				return _mm_loadu_ps(values + id[0]);
+			return _mm_setr_ps(values[id[0]], values[id[1]], values[id[2]], values[id[3]]);
+		};
+
+		__m128 basis[9];
+		ComposeBasis(gather(m_RotationX), gather(m_RotationY), gather(m_RotationZ), gather(m_RotationW),
+			gather(m_ScaleX), gather(m_ScaleY), gather(m_ScaleZ), basis);
+
+		StoreMatrices(basis, gather(m_PositionX), gather(m_PositionY), gather(m_PositionZ), local);
+		resolve(id, lanes);
+	}
+#else
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t index = indices[i];
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), GetPosition(index)) * glm::mat4_cast(GetRotation(index));
+		local = glm::scale(local, GetScale(index));
+
+		uint32_t parent = m_Parent[index];
+		m_World[index] = parent == NoParent ? local : m_World[parent] * local;
+	}
+#endif
+}
\ No newline at end of file
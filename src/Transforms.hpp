@@ -0,0 +1,99 @@
+#ifndef TRANSFORMS_HPP
+#define TRANSFORMS_HPP
+
+#include "Config.hpp"
+#include "JobSystem.hpp"
+#include "MappedArray.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+// Structure-of-arrays storage for scene transforms.
+// Parents are always created before their children, so index order is hierarchy order.
+class TransformStore
+{
+public:
+	static constexpr uint32_t NoParent = UINT32_MAX;
+
+	// Consecutive transforms [first, first + count).
+	struct Range
+	{
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	// The SoA streams of local transforms, in file order, see SceneFile.
+	enum Stream
+	{
+		PositionX, PositionY, PositionZ,
+		RotationX, RotationY, RotationZ, RotationW,
+		ScaleX, ScaleY, ScaleZ,
+		StreamCount
+	};
+
+	/// @brief Adds a transform and returns its index. parent must be NoParent or an existing index.
+	uint32_t Create(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		const glm::vec3& scale = glm::vec3(1.0f), uint32_t parent = NoParent);
+
+	void Reserve(uint32_t count);
+
+	/// @brief Replaces every transform with count transforms viewed from external arrays, e.g. a mapped scene file.
+	/// depths[i] should be depths[parents[i]] + 1 for children and 0 for roots. Nothing is read here, the first Update
+	/// checks the hierarchy while it visits every transform anyway, turning children of later transforms into roots and
+	/// correcting wrong depths. Every transform starts out dirty.
+	void View(uint32_t count, const std::array<float*, StreamCount>& streams, uint32_t* parents, uint32_t* depths);
+
+	const float* GetStream(Stream stream) const { return GetStreams()[stream]->data(); }
+	const uint32_t* GetParents() const { return m_Parent.data(); }
+	const uint32_t* GetDepths() const { return m_Depth.data(); }
+
+	void SetPosition(uint32_t index, const glm::vec3& position);
+	void SetRotation(uint32_t index, const glm::quat& rotation);
+	void SetScale(uint32_t index, const glm::vec3& scale);
+
+	glm::vec3 GetPosition(uint32_t index) const { return { m_PositionX[index], m_PositionY[index], m_PositionZ[index] }; }
+	glm::quat GetRotation(uint32_t index) const { return { m_RotationW[index], m_RotationX[index], m_RotationY[index], m_RotationZ[index] }; }
+	glm::vec3 GetScale(uint32_t index) const { return { m_ScaleX[index], m_ScaleY[index], m_ScaleZ[index] }; }
+	uint32_t GetParent(uint32_t index) const { return m_Parent[index]; }
+
+	uint32_t Size() const { return static_cast<uint32_t>(m_Parent.size()); }
+
+	/// @brief Recomputes the world matrices of every dirty transform and its descendants, level by level,
+	/// with each level split across the job system.
+	void Update(JobSystem& jobs);
+
+	const glm::mat4& GetWorldMatrix(uint32_t index) const { return m_World[index]; }
+	const std::vector<glm::mat4>& GetWorldMatrices() const { return m_World; }
+
+	// Number of world matrices recomputed by the last Update.
+	uint32_t GetLastUpdateCount() const { return m_LastUpdateCount; }
+
+	// Indices recomputed by the last Update, bucketed by hierarchy depth.
+	const std::vector<std::vector<uint32_t>>& GetLastUpdatedLevels() const { return m_Levels; }
+
+	// The same indices as runs of consecutive indices, in ascending order.
+	const std::vector<Range>& GetLastUpdatedRanges() const { return m_UpdatedRanges; }
+private:
+	void MarkDirty(uint32_t index);
+	bool RepairHierarchy(uint32_t index);
+	std::array<MappedArray<float>*, StreamCount> GetStreams();
+	std::array<const MappedArray<float>*, StreamCount> GetStreams() const;
+	void ComputeWorldMatrices(const uint32_t* indices, uint32_t count);
+private:
+	// Owned, or viewed straight out of a mapped scene file.
+	MappedArray<float> m_PositionX, m_PositionY, m_PositionZ;
+	MappedArray<float> m_RotationX, m_RotationY, m_RotationZ, m_RotationW;
+	MappedArray<float> m_ScaleX, m_ScaleY, m_ScaleZ;
+	MappedArray<uint32_t> m_Parent;
+	MappedArray<uint32_t> m_Depth;
+	std::vector<uint8_t> m_Dirty;
+	std::vector<glm::mat4> m_World;
+
+	// Dirty indices bucketed by hierarchy depth, reused between updates.
+	std::vector<std::vector<uint32_t>> m_Levels;
+	std::vector<Range> m_UpdatedRanges;
+	bool m_AnyDirty = false;
+	bool m_HierarchyUnchecked = false;	// Viewed parents and depths the first update has not checked yet.
+	uint32_t m_LastUpdateCount = 0;
+};
+
+#endif // !TRANSFORMS_HPP
\ No newline at end of file
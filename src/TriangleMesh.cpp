@@ -1,21 +1,30 @@
 #include "TriangleMesh.hpp"
+#include "DeletionQueue.hpp"
 
-TriangleMesh::TriangleMesh(const vk::Device& device, const vk::PhysicalDevice& physicalDevice)
+const std::vector<float>& TriangleMesh::GetVertices()
 {
-	m_LogicalDevice = device;
-
-	std::vector<float> vertices =
+	static const std::vector<float> vertices =
 	{
 		0.0f, -0.05f, 1.0f, 0.0f, 0.0f,
 		0.05f, 0.05f, 0.0f, 1.0f, 0.0f,
 		-0.05f, 0.05f, 0.0f, 0.0f, 1.0f
 	};
+	return vertices;
+}
+
+TriangleMesh::TriangleMesh(const vk::Device& device, const vk::PhysicalDevice& physicalDevice)
+{
+	const std::vector<float>& vertices = GetVertices();
+	for (size_t i = 0; i < vertices.size(); i += VertexFloats)
+		bounds.Grow(glm::vec3(vertices[i], vertices[i + 1], 0.0f));
 
 	vkInit::BufferInput inputChunk;
 	inputChunk.device = device;
 	inputChunk.physicalDevice = physicalDevice;
 	inputChunk.size = sizeof(float) * vertices.size();
 	inputChunk.usage = vk::BufferUsageFlagBits::eVertexBuffer;
+	inputChunk.category = MemoryCategory::Geometry;
+	inputChunk.name = "Triangle vertices";
 
 	vertexBuffer = vkInit::CreateBuffer(inputChunk);
 
@@ -24,10 +33,8 @@ TriangleMesh::TriangleMesh(const vk::Device& device, const vk::PhysicalDevice& p
 	device.unmapMemory(vertexBuffer.bufferMemory);
 }
 
-void TriangleMesh::Destroy()
+void TriangleMesh::Destroy(DeletionQueue& deletionQueue)
 {
-	m_LogicalDevice.waitIdle();
-
-	m_LogicalDevice.destroyBuffer(vertexBuffer.buffer);
-	m_LogicalDevice.freeMemory(vertexBuffer.bufferMemory);
+	deletionQueue.Retire(vertexBuffer);
+	vertexBuffer = vkInit::Buffer{};
 }
\ No newline at end of file
@@ -2,17 +2,26 @@
 #define TRIANGLE_MESH_HPP
 
 #include "Config.hpp"
+#include "Bounds.hpp"
 #include "Vulkan/Memory.hpp"
 
+class DeletionQueue;
+
 class TriangleMesh
 {
 public:
+	// Each vertex is a 2D position followed by a color, every three vertices are a triangle.
+	static constexpr uint32_t VertexFloats = 5;
+
+	/// @brief The vertices uploaded to the vertex buffer, also drawn by the software renderer.
+	static const std::vector<float>& GetVertices();
+
 	TriangleMesh(const vk::Device& device, const vk::PhysicalDevice& physicalDevice);
 	~TriangleMesh() {}
-	void Destroy();
+	/// @brief Retires the vertex buffer, frames in flight may still draw it.
+	void Destroy(DeletionQueue& deletionQueue);
 	vkInit::Buffer vertexBuffer;
-private:
-	vk::Device m_LogicalDevice;
+	AABB bounds; // Of the vertex positions.
 };
 
 #endif // !TRIANGLE_MESH_HPP
\ No newline at end of file
@@ -13,13 +13,11 @@ namespace vkInit
 		std::vector<SwapChainFrame>& frames;
 	};
 
-	inline vk::CommandPool CreateCommandPool(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface)
+	inline vk::CommandPool CreateCommandPool(const vk::Device& device, uint32_t queueFamily)
 	{
-		QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(physicalDevice, surface);
-
 		vk::CommandPoolCreateInfo poolInfo{};
 		poolInfo.flags = vk::CommandPoolCreateFlags() | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+		poolInfo.queueFamilyIndex = queueFamily;
 
 		try
 		{
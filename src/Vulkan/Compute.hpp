@@ -0,0 +1,74 @@
+#ifndef COMPUTE_HPP
+#define COMPUTE_HPP
+
+#include "../Config.hpp"
+#include "../Shader.hpp"
+
+namespace vkInit
+{
+	struct ComputePipelineInBundle
+	{
+		vk::Device device;
+		std::string shaderFilePath;
+		std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+		uint32_t pushConstantSize = 0;
+	};
+
+	struct ComputePipelineOutBundle
+	{
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+	};
+
+	inline ComputePipelineOutBundle MakeComputePipeline(const ComputePipelineInBundle& specification)
+	{
+		ComputePipelineOutBundle output{};
+
+		vk::PushConstantRange pushConstantInfo{};
+		pushConstantInfo.offset = 0;
+		pushConstantInfo.size = specification.pushConstantSize;
+		pushConstantInfo.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+		vk::PipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.flags = vk::PipelineLayoutCreateFlags();
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(specification.descriptorSetLayouts.size());
+		layoutInfo.pSetLayouts = specification.descriptorSetLayouts.data();
+		layoutInfo.pushConstantRangeCount = specification.pushConstantSize > 0 ? 1 : 0;
+		layoutInfo.pPushConstantRanges = &pushConstantInfo;
+
+		try
+		{
+			output.layout = specification.device.createPipelineLayout(layoutInfo);
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to Create Compute Pipeline Layout! %s", err.what());
+			return output;
+		}
+
+		vk::ShaderModule shader = CreateModule(specification.shaderFilePath, specification.device);
+
+		vk::ComputePipelineCreateInfo createInfo{};
+		createInfo.flags = vk::PipelineCreateFlags();
+		createInfo.stage.flags = vk::PipelineShaderStageCreateFlags();
+		createInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+		createInfo.stage.module = shader;
+		createInfo.stage.pName = "main";
+		createInfo.layout = output.layout;
+
+		try
+		{
+			output.pipeline = specification.device.createComputePipeline(nullptr, createInfo).value;
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to Create Compute Pipeline for %s! %s", specification.shaderFilePath.c_str(), err.what());
+		}
+
+		specification.device.destroyShaderModule(shader);
+
+		return output;
+	}
+}
+
+#endif // !COMPUTE_HPP
\ No newline at end of file
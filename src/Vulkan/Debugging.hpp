@@ -5,7 +5,7 @@
 
 namespace vkInit
 {
-    VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
+    inline VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
         VkDebugUtilsMessageTypeFlagsEXT messageType,
         const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
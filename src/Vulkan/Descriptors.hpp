@@ -0,0 +1,258 @@
+#ifndef DESCRIPTORS_HPP
+#define DESCRIPTORS_HPP
+
+#include "../Config.hpp"
+
+namespace vkInit
+{
+	// Binding slots of the global bindless set, shaders declare the same layout at set 0.
+	enum BindlessBinding : uint32_t
+	{
+		BindlessSampledImages = 0,
+		BindlessSamplers = 1,
+		BindlessStorageBuffers = 2,
+		BindlessStorageImages = 3,
+		BindlessBindingCount = 4
+	};
+
+	constexpr uint32_t InvalidBindlessIndex = UINT32_MAX;
+
+	struct BindlessHeapInput
+	{
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		uint32_t maxSampledImages = 16384;
+		uint32_t maxSamplers = 256;
+		uint32_t maxStorageBuffers = 16384;
+		uint32_t maxStorageImages = 1024;
+	};
+
+	// Slots of one descriptor array. Indices stay stable until they are released.
+	struct BindlessSlots
+	{
+		uint32_t capacity = 0;
+		uint32_t highWaterMark = 0;
+		std::vector<uint32_t> freeList;
+	};
+
+	struct BindlessHeap
+	{
+		vk::Device device;
+		vk::DescriptorSetLayout layout;
+		vk::DescriptorPool pool;
+		vk::DescriptorSet set;
+		std::array<BindlessSlots, BindlessBindingCount> slots;
+	};
+
+	inline vk::DescriptorSetLayout CreateBindlessSetLayout(const vk::Device& device, const std::array<uint32_t, BindlessBindingCount>& capacities)
+	{
+		std::array<vk::DescriptorSetLayoutBinding, BindlessBindingCount> bindings;
+		const vk::DescriptorType types[BindlessBindingCount] =
+		{
+			vk::DescriptorType::eSampledImage, vk::DescriptorType::eSampler, vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageImage
+		};
+
+		for (uint32_t i = 0; i < BindlessBindingCount; i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = types[i];
+			bindings[i].descriptorCount = capacities[i];
+			bindings[i].stageFlags = vk::ShaderStageFlagBits::eAll;
+		}
+
+		// Every array is sparse. Update after bind allows writing the set after it was bound in a command buffer that has not
+		// been submitted yet, update unused while pending allows writing slots that submitted command buffers do not index.
+		// Slots they may index are only written again once they finish, see DeletionQueue.
+		vk::DescriptorBindingFlags bindingFlag = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+			vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+		std::array<vk::DescriptorBindingFlags, BindlessBindingCount> bindingFlags;
+		bindingFlags.fill(bindingFlag);
+
+		vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		layoutInfo.pNext = &bindingFlagsInfo;
+
+		try
+		{
+			return device.createDescriptorSetLayout(layoutInfo);
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to Create Bindless Descriptor Set Layout! %s", err.what());
+			return nullptr;
+		}
+	}
+
+	inline BindlessHeap CreateBindlessHeap(const BindlessHeapInput& input)
+	{
+		BindlessHeap heap{};
+		heap.device = input.device;
+
+		// Clamp the requested array sizes to what the device allows for update-after-bind sets.
+		vk::StructureChain<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties> properties =
+			input.physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+		const vk::PhysicalDeviceDescriptorIndexingProperties& limits = properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+
+		std::array<uint32_t, BindlessBindingCount> capacities =
+		{
+			std::min({ input.maxSampledImages, limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages }),
+			std::min({ input.maxSamplers, limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers }),
+			std::min({ input.maxStorageBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers }),
+			std::min({ input.maxStorageImages, limits.maxDescriptorSetUpdateAfterBindStorageImages, limits.maxPerStageDescriptorUpdateAfterBindStorageImages })
+		};
+
+		// Every binding is visible to all stages, so together they also have to fit the per-stage total. Scaled down evenly.
+		uint64_t total = 0;
+		for (uint32_t capacity : capacities)
+			total += capacity;
+		if (total > limits.maxPerStageUpdateAfterBindResources)
+		{
+			for (uint32_t& capacity : capacities)
+				capacity = static_cast<uint32_t>(capacity * static_cast<uint64_t>(limits.maxPerStageUpdateAfterBindResources) / total);
+		}
+
+		heap.layout = CreateBindlessSetLayout(input.device, capacities);
+		if (!heap.layout)
+			return heap;
+
+		std::array<vk::DescriptorPoolSize, BindlessBindingCount> poolSizes =
+		{
+			vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, capacities[BindlessSampledImages]),
+			vk::DescriptorPoolSize(vk::DescriptorType::eSampler, capacities[BindlessSamplers]),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, capacities[BindlessStorageBuffers]),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, capacities[BindlessStorageImages])
+		};
+
+		vk::DescriptorPoolCreateInfo poolInfo{};
+		poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		try
+		{
+			heap.pool = input.device.createDescriptorPool(poolInfo);
+
+			vk::DescriptorSetAllocateInfo allocInfo{};
+			allocInfo.descriptorPool = heap.pool;
+			allocInfo.descriptorSetCount = 1;
+			allocInfo.pSetLayouts = &heap.layout;
+			heap.set = input.device.allocateDescriptorSets(allocInfo)[0];
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to Create Bindless Descriptor Heap! %s", err.what());
+			return heap;
+		}
+
+		for (uint32_t i = 0; i < BindlessBindingCount; i++)
+			heap.slots[i].capacity = capacities[i];
+
+		CONSOLE_INFO("Created bindless descriptor heap: %u sampled images, %u samplers, %u storage buffers, %u storage images.",
+			capacities[BindlessSampledImages], capacities[BindlessSamplers], capacities[BindlessStorageBuffers], capacities[BindlessStorageImages]);
+
+		return heap;
+	}
+
+	inline void DestroyBindlessHeap(BindlessHeap& heap)
+	{
+		// Destroying the pool frees the set as well.
+		heap.device.destroyDescriptorPool(heap.pool);
+		heap.device.destroyDescriptorSetLayout(heap.layout);
+		heap = BindlessHeap{};
+	}
+
+	inline uint32_t AllocateBindlessSlot(BindlessSlots& slots)
+	{
+		if (!slots.freeList.empty())
+		{
+			uint32_t index = slots.freeList.back();
+			slots.freeList.pop_back();
+			return index;
+		}
+
+		if (slots.highWaterMark < slots.capacity)
+			return slots.highWaterMark++;
+
+		return InvalidBindlessIndex;
+	}
+
+	inline uint32_t RegisterSampledImage(BindlessHeap& heap, vk::ImageView imageView, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal)
+	{
+		uint32_t index = AllocateBindlessSlot(heap.slots[BindlessSampledImages]);
+		if (index == InvalidBindlessIndex)
+		{
+			CONSOLE_ERROR("Bindless heap is out of sampled image slots!");
+			return index;
+		}
+
+		vk::DescriptorImageInfo imageInfo(nullptr, imageView, layout);
+		vk::WriteDescriptorSet write(heap.set, BindlessSampledImages, index, 1, vk::DescriptorType::eSampledImage, &imageInfo);
+		heap.device.updateDescriptorSets(write, nullptr);
+
+		return index;
+	}
+
+	inline uint32_t RegisterSampler(BindlessHeap& heap, vk::Sampler sampler)
+	{
+		uint32_t index = AllocateBindlessSlot(heap.slots[BindlessSamplers]);
+		if (index == InvalidBindlessIndex)
+		{
+			CONSOLE_ERROR("Bindless heap is out of sampler slots!");
+			return index;
+		}
+
+		vk::DescriptorImageInfo samplerInfo(sampler, nullptr, vk::ImageLayout::eUndefined);
+		vk::WriteDescriptorSet write(heap.set, BindlessSamplers, index, 1, vk::DescriptorType::eSampler, &samplerInfo);
+		heap.device.updateDescriptorSets(write, nullptr);
+
+		return index;
+	}
+
+	inline uint32_t RegisterStorageBuffer(BindlessHeap& heap, vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE)
+	{
+		uint32_t index = AllocateBindlessSlot(heap.slots[BindlessStorageBuffers]);
+		if (index == InvalidBindlessIndex)
+		{
+			CONSOLE_ERROR("Bindless heap is out of storage buffer slots!");
+			return index;
+		}
+
+		vk::DescriptorBufferInfo bufferInfo(buffer, offset, range);
+		vk::WriteDescriptorSet write(heap.set, BindlessStorageBuffers, index, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfo);
+		heap.device.updateDescriptorSets(write, nullptr);
+
+		return index;
+	}
+
+	inline uint32_t RegisterStorageImage(BindlessHeap& heap, vk::ImageView imageView)
+	{
+		uint32_t index = AllocateBindlessSlot(heap.slots[BindlessStorageImages]);
+		if (index == InvalidBindlessIndex)
+		{
+			CONSOLE_ERROR("Bindless heap is out of storage image slots!");
+			return index;
+		}
+
+		vk::DescriptorImageInfo imageInfo(nullptr, imageView, vk::ImageLayout::eGeneral);
+		vk::WriteDescriptorSet write(heap.set, BindlessStorageImages, index, 1, vk::DescriptorType::eStorageImage, &imageInfo);
+		heap.device.updateDescriptorSets(write, nullptr);
+
+		return index;
+	}
+
+	// Returns the slot to the heap. The caller must make sure no in-flight frame still reads it.
+	inline void ReleaseBindlessSlot(BindlessHeap& heap, BindlessBinding binding, uint32_t index)
+	{
+		if (index != InvalidBindlessIndex)
+			heap.slots[binding].freeList.push_back(index);
+	}
+}
+
+#endif
\ No newline at end of file
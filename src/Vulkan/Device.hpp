@@ -24,46 +24,208 @@ namespace vkInit
         CONSOLE_INFO("%s%s, %s", initString, static_cast<const char*>(properties.deviceName), deviceTypeString);
     }
 
-    inline bool CheckPhysicalDeviceExtenionSupport(const vk::PhysicalDevice& device, const std::vector<const char*> extensions)
+    // What a physical device offers, negotiated once through a single pNext feature chain.
+    // The engine picks its fast paths from these instead of asking the driver again.
+    struct DeviceCapabilities
     {
-        std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
+        uint32_t apiVersion = VK_API_VERSION_1_0;   // Lower of the device's and the instance's version.
+        vk::PhysicalDeviceType type = vk::PhysicalDeviceType::eOther;
+        vk::DeviceSize deviceLocalBytes = 0;        // Largest device local heap.
 
-        for (vk::ExtensionProperties& extension : device.enumerateDeviceExtensionProperties())
-            requiredExtensions.erase(extension.extensionName);
+        // Vulkan 1.0 features.
+        bool multiDrawIndirect = false;
+        bool drawIndirectFirstInstance = false;
+        bool pipelineStatisticsQuery = false;
+        bool inheritedQueries = false;
 
-        return requiredExtensions.empty();
+        // Vulkan 1.1 to 1.3 features and extensions.
+        bool storageBuffer16BitAccess = false;
+        bool multiview = false;
+        uint32_t maxMultiviewViews = 1;
+        bool descriptorIndexing = false;    // Everything the bindless heap needs.
+        bool drawIndirectCount = false;
+        bool timelineSemaphores = false;
+        bool synchronization2 = false;
+        bool dynamicRendering = false;
+        bool presentWait = false;           // VK_KHR_present_id and VK_KHR_present_wait.
+        bool memoryBudget = false;          // VK_EXT_memory_budget.
+        bool swapchain = false;             // VK_KHR_swapchain, devices without it can not present.
+    };
+
+    inline DeviceCapabilities QueryDeviceCapabilities(const vk::PhysicalDevice& device)
+    {
+        DeviceCapabilities capabilities;
+        vk::PhysicalDeviceProperties properties = device.getProperties();
+        capabilities.apiVersion = std::min(properties.apiVersion, vk::enumerateInstanceVersion());
+        capabilities.type = properties.deviceType;
+
+        vk::PhysicalDeviceMemoryProperties memory = device.getMemoryProperties();
+        for (uint32_t heap = 0; heap < memory.memoryHeapCount; heap++)
+            if (memory.memoryHeaps[heap].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+                capabilities.deviceLocalBytes = std::max(capabilities.deviceLocalBytes, memory.memoryHeaps[heap].size);
+
+        vk::PhysicalDeviceFeatures features = device.getFeatures();
+        capabilities.multiDrawIndirect = features.multiDrawIndirect;
+        capabilities.drawIndirectFirstInstance = features.drawIndirectFirstInstance;
+        capabilities.pipelineStatisticsQuery = features.pipelineStatisticsQuery;
+        capabilities.inheritedQueries = features.inheritedQueries;
+
+        std::set<std::string> extensions;
+        for (const vk::ExtensionProperties& extension : device.enumerateDeviceExtensionProperties())
+            extensions.insert(extension.extensionName);
+
+        capabilities.swapchain = extensions.count(VK_KHR_SWAPCHAIN_EXTENSION_NAME) > 0;
+
+        // The budget is read through vkGetPhysicalDeviceMemoryProperties2, core in Vulkan 1.1.
+        capabilities.memoryBudget = capabilities.apiVersion >= VK_API_VERSION_1_1 && extensions.count(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) > 0;
+
+        // The instance only asks for 1.2 or 1.3 when the loader supports it, see CreateInstance.
+        // Everything below needs the 1.2 feature structs.
+        if (capabilities.apiVersion < VK_API_VERSION_1_2)
+            return capabilities;
+
+        bool presentWaitExtensions = extensions.count(VK_KHR_PRESENT_ID_EXTENSION_NAME) && extensions.count(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+        // One query for every feature struct the device knows about, chained back to front.
+        vk::PhysicalDeviceFeatures2 features2{};
+        vk::PhysicalDeviceVulkan11Features vulkan11{};
+        vk::PhysicalDeviceVulkan12Features vulkan12{};
+        vk::PhysicalDeviceVulkan13Features vulkan13{};
+        vk::PhysicalDevicePresentIdFeaturesKHR presentId{};
+        vk::PhysicalDevicePresentWaitFeaturesKHR presentWait{};
+
+        void* next = nullptr;
+        if (presentWaitExtensions)
+        {
+            presentWait.pNext = next;
+            presentId.pNext = &presentWait;
+            next = &presentId;
+        }
+        if (capabilities.apiVersion >= VK_API_VERSION_1_3)
+        {
+            vulkan13.pNext = next;
+            next = &vulkan13;
+        }
+        vulkan12.pNext = next;
+        vulkan11.pNext = &vulkan12;
+        features2.pNext = &vulkan11;
+        device.getFeatures2(&features2);
+
+        capabilities.storageBuffer16BitAccess = vulkan11.storageBuffer16BitAccess;
+        capabilities.multiview = vulkan11.multiview;
+        if (capabilities.multiview)
+        {
+            vk::PhysicalDeviceProperties2 properties2{};
+            vk::PhysicalDeviceMultiviewProperties multiviewProperties{};
+            properties2.pNext = &multiviewProperties;
+            device.getProperties2(&properties2);
+            capabilities.maxMultiviewViews = multiviewProperties.maxMultiviewViewCount;
+        }
+        capabilities.descriptorIndexing = vulkan12.descriptorIndexing && vulkan12.runtimeDescriptorArray && vulkan12.descriptorBindingPartiallyBound &&
+            vulkan12.descriptorBindingSampledImageUpdateAfterBind && vulkan12.descriptorBindingStorageBufferUpdateAfterBind &&
+            vulkan12.descriptorBindingStorageImageUpdateAfterBind && vulkan12.descriptorBindingUpdateUnusedWhilePending &&
+            vulkan12.shaderSampledImageArrayNonUniformIndexing && vulkan12.shaderStorageBufferArrayNonUniformIndexing;
+        capabilities.drawIndirectCount = vulkan12.drawIndirectCount;
+        capabilities.timelineSemaphores = vulkan12.timelineSemaphore;
+        capabilities.synchronization2 = vulkan13.synchronization2;
+        capabilities.dynamicRendering = vulkan13.dynamicRendering;
+        capabilities.presentWait = presentWaitExtensions && presentId.presentId && presentWait.presentWait;
+
+        return capabilities;
     }
 
-    inline bool IsPhysicalDeviceSuitable(const vk::PhysicalDevice& device)
+    inline void LogDeviceCapabilities(const DeviceCapabilities& capabilities)
     {
-        const std::vector<const char*> requestedExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        CONSOLE_INFO("Vulkan %u.%u, %.0f MB device local memory.", VK_API_VERSION_MAJOR(capabilities.apiVersion), VK_API_VERSION_MINOR(capabilities.apiVersion),
+            capabilities.deviceLocalBytes / (1024.0 * 1024.0));
+        CONSOLE_INFO("Timeline semaphores %s, descriptor indexing %s, draw indirect count %s, 16-bit storage %s, synchronization2 %s, dynamic rendering %s.",
+            capabilities.timelineSemaphores ? "on" : "off", capabilities.descriptorIndexing ? "on" : "off", capabilities.drawIndirectCount ? "on" : "off",
+            capabilities.storageBuffer16BitAccess ? "on" : "off", capabilities.synchronization2 ? "on" : "off", capabilities.dynamicRendering ? "on" : "off");
+        if (capabilities.multiview)
+            CONSOLE_INFO("Multiview with up to %u views.", capabilities.maxMultiviewViews);
+    }
+
+    // Devices that can not render to surface score 0, the others by type first, then by memory and features.
+    inline uint64_t ScorePhysicalDevice(const vk::PhysicalDevice& device, const vk::SurfaceKHR surface, const DeviceCapabilities& capabilities,
+        QueueFamilyIndices queueFamilies)
+    {
+        if (!capabilities.swapchain || !queueFamilies.isComplete())
+            return 0;
+
+        if (device.getSurfaceFormatsKHR(surface).empty() || device.getSurfacePresentModesKHR(surface).empty())
+            return 0;
 
-        return CheckPhysicalDeviceExtenionSupport(device, requestedExtensions);
+        uint64_t score = 1;
+        switch (capabilities.type)
+        {
+        case vk::PhysicalDeviceType::eDiscreteGpu: score += 100000; break;
+        case vk::PhysicalDeviceType::eIntegratedGpu: score += 50000; break;
+        case vk::PhysicalDeviceType::eVirtualGpu: score += 20000; break;
+        case vk::PhysicalDeviceType::eCpu: score += 1000; break;
+        default: break;
+        }
+
+        // One point per 16 MB, so a few GB outweigh any single feature but never the device type.
+        score += capabilities.deviceLocalBytes >> 24;
+
+        // GPU-driven culling and the bindless heap are the largest wins.
+        score += capabilities.descriptorIndexing ? 2000 : 0;
+        score += capabilities.multiDrawIndirect && capabilities.drawIndirectFirstInstance ? 1000 : 0;
+        score += capabilities.timelineSemaphores ? 500 : 0;
+        score += capabilities.synchronization2 ? 500 : 0;
+        score += capabilities.drawIndirectCount ? 250 : 0;
+        score += capabilities.dynamicRendering ? 100 : 0;
+        score += capabilities.storageBuffer16BitAccess ? 100 : 0;
+        score += capabilities.presentWait ? 100 : 0;
+        score += capabilities.memoryBudget ? 50 : 0;
+
+        return score;
     }
 
-    inline vk::PhysicalDevice ChoosePhysicalDevice(vk::Instance& instance)
+    // The chosen device with everything the engine asks it about, queried once while choosing.
+    struct PhysicalDeviceChoice
+    {
+        vk::PhysicalDevice device;
+        DeviceCapabilities capabilities;
+        QueueFamilyIndices queueFamilies;
+    };
+
+    inline PhysicalDeviceChoice ChoosePhysicalDevice(vk::Instance& instance, const vk::SurfaceKHR surface)
     {
         std::vector<vk::PhysicalDevice> availableDevices = instance.enumeratePhysicalDevices();
 
+        PhysicalDeviceChoice best{};
+        uint64_t bestScore = 0;
         for (const auto& device : availableDevices)
         {
-            if (IsPhysicalDeviceSuitable(device))
+            PhysicalDeviceChoice candidate{ device, QueryDeviceCapabilities(device), FindQueueFamilies(device, surface) };
+            uint64_t score = ScorePhysicalDevice(device, surface, candidate.capabilities, candidate.queueFamilies);
+            CONSOLE_DEBUG("Physical device %s scored %llu.", static_cast<const char*>(device.getProperties().deviceName), static_cast<unsigned long long>(score));
+
+            if (score > bestScore)
             {
-                LogPhysicalDeviceProperties("Choosing Physical Device: ", device);
-                return device;
+                best = candidate;
+                bestScore = score;
             }
         }
-        
-        return nullptr;
+
+        if (best.device)
+            LogPhysicalDeviceProperties("Choosing Physical Device: ", best.device);
+        else
+            CONSOLE_ERROR("No physical device can present to the surface!");
+
+        return best;
     }
 
-    vk::Device CreateLogicalDevice(const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR surface)
+    /// @brief Creates the device with every feature negotiated into capabilities. Validation layers are only requested when validation is set.
+    inline vk::Device CreateLogicalDevice(const vk::PhysicalDevice& physicalDevice, const QueueFamilyIndices& indices, const DeviceCapabilities& capabilities, bool validation)
     {
-        QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
         std::vector<uint32_t> uniqueIndices;
-        uniqueIndices.push_back(indices.graphicsFamily.value());
-        if (indices.graphicsFamily.value() != indices.presentFamily.value())
-            uniqueIndices.push_back(indices.presentFamily.value());
+        for (std::optional<uint32_t> family : { indices.graphicsFamily, indices.presentFamily, indices.computeFamily, indices.transferFamily })
+        {
+            if (family && std::find(uniqueIndices.begin(), uniqueIndices.end(), family.value()) == uniqueIndices.end())
+                uniqueIndices.push_back(family.value());
+        }
 
         float queuePriority = 1.0f;
         
@@ -74,22 +236,99 @@ namespace vkInit
         }
 
         vk::PhysicalDeviceFeatures deviceFeatures = vk::PhysicalDeviceFeatures();
-        
-        const std::vector<const char*> layers =
+
+        // GPU-driven culling writes one indirect command per object, each addressing its instance through firstInstance.
+        deviceFeatures.multiDrawIndirect = capabilities.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = capabilities.drawIndirectFirstInstance;
+
+        // Lets GpuProfiler count shader invocations per pass.
+        deviceFeatures.pipelineStatisticsQuery = capabilities.pipelineStatisticsQuery;
+
+        // Lets cached secondary command buffers run inside those queries.
+        deviceFeatures.inheritedQueries = capabilities.inheritedQueries;
+
+        // Compact vertex and instance data read straight from storage buffers.
+        vk::PhysicalDeviceVulkan11Features vulkan11Features{};
+        vulkan11Features.storageBuffer16BitAccess = capabilities.storageBuffer16BitAccess;
+
+        // Renders every view of a stereo or multi-camera frame from one set of draws.
+        vulkan11Features.multiview = capabilities.multiview;
+
+        // Descriptor indexing features used by the bindless heap.
+        vk::PhysicalDeviceVulkan12Features vulkan12Features{};
+        if (capabilities.descriptorIndexing)
         {
-            "VK_LAYER_KHRONOS_validation"
-        };
+            vulkan12Features.descriptorIndexing = VK_TRUE;
+            vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+            vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+            vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            vulkan12Features.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+            vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        }
 
-        const std::vector<const char*> extensions =
+        // Submissions signal one timeline per queue, see FrameScheduler.
+        vulkan12Features.timelineSemaphore = capabilities.timelineSemaphores;
+
+        // Lets culling passes write a draw count instead of zero sized draws.
+        vulkan12Features.drawIndirectCount = capabilities.drawIndirectCount;
+
+        vk::PhysicalDeviceVulkan13Features vulkan13Features{};
+        vulkan13Features.synchronization2 = capabilities.synchronization2;
+        vulkan13Features.dynamicRendering = capabilities.dynamicRendering;
+
+        std::vector<const char*> layers;
+        if (validation)
+            layers.push_back("VK_LAYER_KHRONOS_validation");
+
+        // Used by FramePacer to limit latency to what has actually been displayed.
+        vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentIdFeatures.presentId = capabilities.presentWait;
+        presentWaitFeatures.presentWait = capabilities.presentWait;
+
+        std::vector<const char*> extensions =
         {
             VK_KHR_SWAPCHAIN_EXTENSION_NAME
         };
+        if (capabilities.presentWait)
+        {
+            extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
+
+        // Lets MemoryTracker read the driver's budget.
+        if (capabilities.memoryBudget)
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 
         vk::DeviceCreateInfo deviceInfo = vk::DeviceCreateInfo(
             vk::DeviceCreateFlags(), static_cast<uint32_t>(queueCreateInfo.size()), queueCreateInfo.data(), static_cast<uint32_t>(layers.size()), layers.data(),
             static_cast<uint32_t>(extensions.size()), extensions.data(), &deviceFeatures
         );
 
+        // Feature structs are chained back to front, only the ones the device's version knows about.
+        void* next = nullptr;
+        if (capabilities.presentWait)
+        {
+            presentWaitFeatures.pNext = next;
+            presentIdFeatures.pNext = &presentWaitFeatures;
+            next = &presentIdFeatures;
+        }
+        if (capabilities.apiVersion >= VK_API_VERSION_1_3)
+        {
+            vulkan13Features.pNext = next;
+            next = &vulkan13Features;
+        }
+        if (capabilities.apiVersion >= VK_API_VERSION_1_2)
+        {
+            vulkan12Features.pNext = next;
+            vulkan11Features.pNext = &vulkan12Features;
+            next = &vulkan11Features;
+        }
+        deviceInfo.pNext = next;
+
         try
         {
             vk::Device device = physicalDevice.createDevice(deviceInfo);
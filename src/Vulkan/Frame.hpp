@@ -9,10 +9,8 @@ namespace vkInit
     {
         vk::Image image;
         vk::ImageView imageView;
-        vk::Framebuffer framebuffer;
         vk::CommandBuffer commandBuffer;
         vk::Semaphore imageAvailable, renderComplete;
-        vk::Fence inFlight;
     };
 }
 
@@ -0,0 +1,117 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include "../Config.hpp"
+#include "../MemoryTracker.hpp"
+
+namespace vkInit
+{
+	struct ImageInput
+	{
+		vk::Device device;
+		vk::Format format;
+		vk::Extent2D extent;
+		vk::ImageUsageFlags usage;
+		uint32_t mipLevels = 1;
+		uint32_t arrayLayers = 1;
+	};
+
+	// First depth format, in order of preference, usable as an optimal-tiling depth attachment.
+	inline vk::Format FindDepthFormat(const vk::PhysicalDevice& physicalDevice)
+	{
+		for (vk::Format format : { vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint })
+		{
+			vk::FormatProperties properties = physicalDevice.getFormatProperties(format);
+			if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+				return format;
+		}
+
+		CONSOLE_ERROR("Failed to find a supported depth format!");
+		return vk::Format::eUndefined;
+	}
+
+	inline vk::ImageAspectFlags GetDepthAspect(vk::Format format)
+	{
+		bool stencil = format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint || format == vk::Format::eD16UnormS8Uint;
+		return stencil ? vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil : vk::ImageAspectFlags(vk::ImageAspectFlagBits::eDepth);
+	}
+
+	// Creates a 2D optimal-tiling image without memory, the caller binds it.
+	inline vk::Image CreateImage(const ImageInput& input)
+	{
+		vk::ImageCreateInfo imageInfo{};
+		imageInfo.flags = vk::ImageCreateFlags();
+		imageInfo.imageType = vk::ImageType::e2D;
+		imageInfo.format = input.format;
+		imageInfo.extent = vk::Extent3D(input.extent.width, input.extent.height, 1);
+		imageInfo.mipLevels = input.mipLevels;
+		imageInfo.arrayLayers = input.arrayLayers;
+		imageInfo.samples = vk::SampleCountFlagBits::e1;
+		imageInfo.tiling = vk::ImageTiling::eOptimal;
+		imageInfo.usage = input.usage;
+		imageInfo.sharingMode = vk::SharingMode::eExclusive;
+		imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+		try
+		{
+			return input.device.createImage(imageInfo);
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to create Image! %s", err.what());
+			return nullptr;
+		}
+	}
+
+	inline vk::ImageView CreateImageView(const vk::Device& device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspect,
+		uint32_t baseMipLevel = 0, uint32_t mipLevels = 1, uint32_t arrayLayers = 1)
+	{
+		vk::ImageViewCreateInfo viewInfo{};
+		viewInfo.image = image;
+		viewInfo.viewType = arrayLayers > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D;
+		viewInfo.format = format;
+		viewInfo.components.r = vk::ComponentSwizzle::eIdentity;
+		viewInfo.components.g = vk::ComponentSwizzle::eIdentity;
+		viewInfo.components.b = vk::ComponentSwizzle::eIdentity;
+		viewInfo.components.a = vk::ComponentSwizzle::eIdentity;
+		viewInfo.subresourceRange.aspectMask = aspect;
+		viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = arrayLayers;
+
+		try
+		{
+			return device.createImageView(viewInfo);
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to create Image View! %s", err.what());
+			return nullptr;
+		}
+	}
+
+	// Device local memory for an image or a group of images aliasing the same allocation. Free it with vkInit::FreeMemory.
+	inline vk::DeviceMemory AllocateDeviceMemory(const vk::Device& device, uint32_t memoryTypeIndex, vk::DeviceSize size,
+		MemoryCategory category = MemoryCategory::Textures, const char* name = "image")
+	{
+		vk::MemoryAllocateInfo allocInfo{};
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		try
+		{
+			vk::DeviceMemory memory = device.allocateMemory(allocInfo);
+			MemoryTracker::Get().OnAllocate(memory, size, memoryTypeIndex, category, name);
+			return memory;
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to allocate device memory! %s", err.what());
+			MemoryTracker::Get().LogReport();
+			return nullptr;
+		}
+	}
+}
+
+#endif // !IMAGE_HPP
\ No newline at end of file
@@ -10,11 +10,6 @@ namespace vkInit
     {
         std::vector<vk::ExtensionProperties> availableExtensions = vk::enumerateInstanceExtensionProperties();
 
-        CONSOLE_NEWLINE();
-        CONSOLE_DEBUG("Available Extensions: ");
-        for (const auto& extn : availableExtensions)
-            CONSOLE_DEBUG("\t %s", static_cast<const char*>(extn.extensionName));
-
         for (const char* extension : extensions)
         {
             bool found = false;
@@ -30,7 +25,11 @@ namespace vkInit
 
             if (!found)
             {
+                // Everything available is only listed when it helps to tell what is missing.
                 CONSOLE_ERROR("Requested extension \"%s\" not supported.", extension);
+                CONSOLE_DEBUG("Available Extensions: ");
+                for (const auto& extn : availableExtensions)
+                    CONSOLE_DEBUG("\t %s", static_cast<const char*>(extn.extensionName));
                 return false;
             }
         }
@@ -78,12 +77,17 @@ namespace vkInit
         CONSOLE_DEBUG("System can support upto Vulkan %d.%d.%d", VK_API_VERSION_MAJOR(version), VK_API_VERSION_MINOR(version), 
             VK_API_VERSION_PATCH(version));
 
-        // To make sure compatibility with more devices.
-        version = VK_MAKE_API_VERSION(0, 1, 0, 0);
+        // Ask for Vulkan 1.3 (synchronization2) or 1.2 (descriptor indexing, timeline semaphores) when the loader has it,
+        // otherwise stay on 1.0 to make sure compatibility with more devices.
+        if (version >= VK_API_VERSION_1_3)
+            version = VK_API_VERSION_1_3;
+        else
+            version = version >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 : VK_MAKE_API_VERSION(0, 1, 0, 0);
 
         vk::ApplicationInfo appInfo("Vulkan Renderer", version, "Odd Engine", version, version);
 
         vk::InstanceCreateInfo createInfo;
+        createInfo.pApplicationInfo = &appInfo;
         uint32_t glfwExtensionCount = 0;
         const char** glfwExtensions;
 
@@ -2,6 +2,7 @@
 #define MEMORY_HPP
 
 #include "../Config.hpp"
+#include "../MemoryTracker.hpp"
 
 namespace vkInit
 {
@@ -11,6 +12,9 @@ namespace vkInit
 		vk::BufferUsageFlags usage;
 		vk::Device device;
 		vk::PhysicalDevice physicalDevice;
+		vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+		MemoryCategory category = MemoryCategory::Other;
+		const char* name = "buffer";	// Shown in memory leak reports.
 	};
 
 	struct Buffer
@@ -41,8 +45,7 @@ namespace vkInit
 
 		vk::MemoryAllocateInfo allocInfo{};
 		allocInfo.allocationSize = memoryRequirements.size;
-		allocInfo.memoryTypeIndex = FindMemoryTypeIndex(input.physicalDevice, memoryRequirements.memoryTypeBits, 
-									vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		allocInfo.memoryTypeIndex = FindMemoryTypeIndex(input.physicalDevice, memoryRequirements.memoryTypeBits, input.properties);
 		
 		try
 		{
@@ -52,12 +55,22 @@ namespace vkInit
 		catch (const vk::SystemError& err)
 		{
 			CONSOLE_INFO("Failed to allocate memory for buffer! %s", err.what());
+			MemoryTracker::Get().LogReport();
 			return;
 		}
+
+		MemoryTracker::Get().OnAllocate(buffer.bufferMemory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, input.category, input.name);
 		
 		input.device.bindBufferMemory(buffer.buffer, buffer.bufferMemory, 0);
 	}
 
+	// Frees memory allocated by AllocateBufferMemory or AllocateDeviceMemory.
+	inline void FreeMemory(const vk::Device& device, vk::DeviceMemory memory)
+	{
+		MemoryTracker::Get().OnFree(memory);
+		device.freeMemory(memory);
+	}
+
 	inline Buffer CreateBuffer(const BufferInput& bufferInput)
 	{
 		vk::BufferCreateInfo bufferInfo{};
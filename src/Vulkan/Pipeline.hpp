@@ -13,8 +13,20 @@ namespace vkInit
 		vk::Device device;
 		std::string vertexShaderFilePath;
 		std::string fragmentShaderFilePath;
+		vk::ShaderModule vertexShader;		// Used instead of the file when set, e.g. loaded up front. Owned by the caller.
+		vk::ShaderModule fragmentShader;
 		vk::Extent2D swapchainExtent;
 		vk::Format swapchainImageFormat;
+		std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+		vk::RenderPass renderPass;	// Created by MakeGraphicsPipeline when null, e.g. taken from a render graph pass otherwise.
+		uint32_t viewMask = 0;		// Views of the created render pass, see CreateRenderPass.
+		bool dynamicViewport = false;	// Viewport and scissor are set while recording instead of fixed to swapchainExtent.
+		vk::PipelineLayout layout;	// Created when null, pipelines sharing the push constants and sets can share one.
+
+		// Depth state, only used when the render pass has a depth attachment.
+		bool depthTest = false;
+		bool depthWrite = false;
+		vk::CompareOp depthCompare = vk::CompareOp::eLessOrEqual;
 	};
 
 	struct GraphicsPipelineOutBundle
@@ -24,16 +36,17 @@ namespace vkInit
 		vk::Pipeline pipeline;
 	};
 
-	inline vk::PipelineLayout CreatePipelineLayout(const vk::Device& device)
+	inline vk::PipelineLayout CreatePipelineLayout(const vk::Device& device, const std::vector<vk::DescriptorSetLayout>& descriptorSetLayouts)
 	{
 		vk::PipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.flags = vk::PipelineLayoutCreateFlags();
-		layoutInfo.setLayoutCount = 0;
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+		layoutInfo.pSetLayouts = descriptorSetLayouts.data();
 		layoutInfo.pushConstantRangeCount = 1;
 		vk::PushConstantRange pushConstantInfo{};
 		pushConstantInfo.offset = 0;
 		pushConstantInfo.size = sizeof(Constants);
-		pushConstantInfo.stageFlags = vk::ShaderStageFlagBits::eVertex;
+		pushConstantInfo.stageFlags = ConstantsStages;
 		layoutInfo.pPushConstantRanges = &pushConstantInfo;
 
 		try
@@ -47,7 +60,9 @@ namespace vkInit
 		}
 	}
 
-	vk::RenderPass CreateRenderPass(const vk::Device& device, vk::Format swapchainImageFormat)
+	/// @brief Creates a single color attachment render pass. A non-zero viewMask renders every view in it at once with multiview,
+	/// view i into layer i of a layered attachment, which the vertex shaders tell apart by gl_ViewIndex.
+	inline vk::RenderPass CreateRenderPass(const vk::Device& device, vk::Format swapchainImageFormat, uint32_t viewMask = 0)
 	{
 		vk::AttachmentDescription colorAttachment{};
 		colorAttachment.flags = vk::AttachmentDescriptionFlags();
@@ -77,6 +92,14 @@ namespace vkInit
 		renderpassInfo.subpassCount = 1;
 		renderpassInfo.pSubpasses = &subpass;
 
+		vk::RenderPassMultiviewCreateInfo multiviewInfo{};
+		multiviewInfo.subpassCount = 1;
+		multiviewInfo.pViewMasks = &viewMask;
+		multiviewInfo.correlationMaskCount = 1;
+		multiviewInfo.pCorrelationMasks = &viewMask;
+		if (viewMask)
+			renderpassInfo.pNext = &multiviewInfo;
+
 		try
 		{
 			return device.createRenderPass(renderpassInfo);
@@ -114,7 +137,7 @@ namespace vkInit
 		createInfo.pInputAssemblyState = &inputAssemblyInfo;
 
 		// Vertex Shader
-		vk::ShaderModule vertexShader = CreateModule(specification.vertexShaderFilePath, specification.device);
+		vk::ShaderModule vertexShader = specification.vertexShader ? specification.vertexShader : CreateModule(specification.vertexShaderFilePath, specification.device);
 		vk::PipelineShaderStageCreateInfo vertexShaderInfo{};
 		vertexShaderInfo.flags = vk::PipelineShaderStageCreateFlags();
 		vertexShaderInfo.stage = vk::ShaderStageFlagBits::eVertex;
@@ -145,6 +168,13 @@ namespace vkInit
 		viewportState.pScissors = &scissor;
 		createInfo.pViewportState = &viewportState;
 
+		std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+		vk::PipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		dynamicState.pDynamicStates = dynamicStates.data();
+		if (specification.dynamicViewport)
+			createInfo.pDynamicState = &dynamicState;
+
 		// Rasterizer
 		vk::PipelineRasterizationStateCreateInfo rasterizerInfo{};
 		rasterizerInfo.flags = vk::PipelineRasterizationStateCreateFlags();
@@ -157,14 +187,19 @@ namespace vkInit
 		rasterizerInfo.depthBiasEnable = VK_FALSE;
 		createInfo.pRasterizationState = &rasterizerInfo;
 
-		// Fragment Shader
-		vk::ShaderModule fragmentShader = CreateModule(specification.fragmentShaderFilePath, specification.device);
-		vk::PipelineShaderStageCreateInfo fragmentShaderInfo{};
-		fragmentShaderInfo.flags = vk::PipelineShaderStageCreateFlags();
-		fragmentShaderInfo.stage = vk::ShaderStageFlagBits::eFragment;
-		fragmentShaderInfo.module = fragmentShader;
-		fragmentShaderInfo.pName = "main";
-		shaderStages.push_back(fragmentShaderInfo);
+		// Fragment Shader, left out for depth-only pipelines.
+		const bool depthOnly = specification.fragmentShaderFilePath.empty() && !specification.fragmentShader;
+		vk::ShaderModule fragmentShader;
+		if (!depthOnly)
+		{
+			fragmentShader = specification.fragmentShader ? specification.fragmentShader : CreateModule(specification.fragmentShaderFilePath, specification.device);
+			vk::PipelineShaderStageCreateInfo fragmentShaderInfo{};
+			fragmentShaderInfo.flags = vk::PipelineShaderStageCreateFlags();
+			fragmentShaderInfo.stage = vk::ShaderStageFlagBits::eFragment;
+			fragmentShaderInfo.module = fragmentShader;
+			fragmentShaderInfo.pName = "main";
+			shaderStages.push_back(fragmentShaderInfo);
+		}
 
 		// Pass Shader Stages to Pipeline Create Info
 		createInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
@@ -177,6 +212,16 @@ namespace vkInit
 		multisamplingInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
 		createInfo.pMultisampleState = &multisamplingInfo;
 
+		// Depth Testing
+		vk::PipelineDepthStencilStateCreateInfo depthStencilInfo{};
+		depthStencilInfo.flags = vk::PipelineDepthStencilStateCreateFlags();
+		depthStencilInfo.depthTestEnable = specification.depthTest;
+		depthStencilInfo.depthWriteEnable = specification.depthWrite;
+		depthStencilInfo.depthCompareOp = specification.depthCompare;
+		depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
+		depthStencilInfo.stencilTestEnable = VK_FALSE;
+		createInfo.pDepthStencilState = &depthStencilInfo;
+
 		// Color Blending
 		vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
 		colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | 
@@ -187,7 +232,7 @@ namespace vkInit
 		colorBlendInfo.flags = vk::PipelineColorBlendStateCreateFlags();
 		colorBlendInfo.logicOpEnable = VK_FALSE;
 		colorBlendInfo.logicOp = vk::LogicOp::eCopy;
-		colorBlendInfo.attachmentCount = 1;
+		colorBlendInfo.attachmentCount = depthOnly ? 0 : 1;
 		colorBlendInfo.pAttachments = &colorBlendAttachment;
 		colorBlendInfo.blendConstants[0] = 0.0f;
 		colorBlendInfo.blendConstants[1] = 0.0f;
@@ -196,11 +241,11 @@ namespace vkInit
 		createInfo.pColorBlendState = &colorBlendInfo;
 
 		// Pipeline Layout
-		vk::PipelineLayout pipelineLayout = CreatePipelineLayout(specification.device);
+		vk::PipelineLayout pipelineLayout = specification.layout ? specification.layout : CreatePipelineLayout(specification.device, specification.descriptorSetLayouts);
 		createInfo.layout = pipelineLayout;
 
 		// Renderpass
-		vk::RenderPass renderPass = CreateRenderPass(specification.device, specification.swapchainImageFormat);
+		vk::RenderPass renderPass = specification.renderPass ? specification.renderPass : CreateRenderPass(specification.device, specification.swapchainImageFormat, specification.viewMask);
 		createInfo.renderPass = renderPass;
 
 		// Extra Stuff
@@ -224,8 +269,10 @@ namespace vkInit
 		output.renderpass = renderPass;
 		output.pipeline = graphicsPipeline;
 
-		specification.device.destroyShaderModule(vertexShader);
-		specification.device.destroyShaderModule(fragmentShader);
+		if (!specification.vertexShader)
+			specification.device.destroyShaderModule(vertexShader);
+		if (fragmentShader && !specification.fragmentShader)
+			specification.device.destroyShaderModule(fragmentShader);
 
 		return output;
 	}
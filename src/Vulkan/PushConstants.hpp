@@ -5,10 +5,18 @@
 
 namespace vkInit
 {
+	// Per-draw data. The indices select entries of the bindless heap so no per-draw descriptor binds are needed.
 	struct Constants
 	{
 		glm::mat4 model;
+		uint32_t objectIndex = 0;
+		uint32_t materialIndex = 0;
+		uint32_t instanceBuffer = 0;	// Bindless storage buffer with the per-instance data of instanced and indirect draws.
+		uint32_t viewBuffer = 0;		// Bindless storage buffer with the transform of every view, only read by multiview pipelines.
+		uint32_t transformBuffer = 0;	// Bindless storage buffer with the world matrix of every scene object, see SceneBuffers.
 	};
+
+	const vk::ShaderStageFlags ConstantsStages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
 }
 
 #endif
\ No newline at end of file
@@ -10,6 +10,11 @@ namespace vkInit
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
 
+        // Families without graphics (and for transfer without compute) so their work can overlap graphics.
+        // Empty when the device has none, the graphics family takes the work then.
+        std::optional<uint32_t> computeFamily;
+        std::optional<uint32_t> transferFamily;
+
         bool isComplete()
         {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -21,26 +26,34 @@ namespace vkInit
         QueueFamilyIndices indices;
 
         std::vector<vk::QueueFamilyProperties> queueFamilies = device.getQueueFamilyProperties();
-        CONSOLE_DEBUG("Available Queue Families on Selected Physical Device: %d", queueFamilies.size());
 
         int i = 0;
         for (const auto& queueFamily : queueFamilies)
         {
-            if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+            if (!indices.isComplete())
             {
-                indices.graphicsFamily = i;
-                indices.presentFamily = i;
-                CONSOLE_DEBUG("Queue Family %d is suitable for graphics.", i);
+                if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+                {
+                    indices.graphicsFamily = i;
+                    indices.presentFamily = i;
+                }
+
+                if (device.getSurfaceSupportKHR(i, surface))
+                {
+                    indices.presentFamily = i;
+                }
             }
 
-            if (device.getSurfaceSupportKHR(i, surface))
+            bool graphics = static_cast<bool>(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics);
+            bool compute = static_cast<bool>(queueFamily.queueFlags & vk::QueueFlagBits::eCompute);
+            if (!indices.computeFamily && compute && !graphics)
             {
-                indices.presentFamily = i;
-                CONSOLE_DEBUG("Queue Family %d is suitable for presenting.", i);
+                indices.computeFamily = i;
+            }
+            if (!indices.transferFamily && (queueFamily.queueFlags & vk::QueueFlagBits::eTransfer) && !graphics && !compute)
+            {
+                indices.transferFamily = i;
             }
-
-            if (indices.isComplete())
-                break;
 
             i++;
         }
@@ -48,13 +61,16 @@ namespace vkInit
         return indices;
     }
 
-    std::array<vk::Queue, 2> GetQueue(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, const vk::SurfaceKHR surface)
+    // Graphics, present, compute and transfer queue. Compute and transfer are the graphics queue without dedicated families.
+    inline std::array<vk::Queue, 4> GetQueue(const vk::Device& device, const QueueFamilyIndices& indices)
     {
-        QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
+        uint32_t graphicsFamily = indices.graphicsFamily.value();
 
         return {
-            device.getQueue(indices.graphicsFamily.value(), 0),
-            device.getQueue(indices.presentFamily.value(), 0)
+            device.getQueue(graphicsFamily, 0),
+            device.getQueue(indices.presentFamily.value(), 0),
+            device.getQueue(indices.computeFamily.value_or(graphicsFamily), 0),
+            device.getQueue(indices.transferFamily.value_or(graphicsFamily), 0)
         };
     }
 }
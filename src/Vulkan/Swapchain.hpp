@@ -21,14 +21,22 @@ namespace vkInit
         std::vector<SwapChainFrame> frames;
         vk::Format format;
         vk::Extent2D extent;
+        vk::PresentModeKHR presentMode;
+        vk::ImageUsageFlags usage;
     };
 
+    // Formats and present modes of a surface never change, the engine queries them once and keeps them.
     inline SwapChainSupportDetails QuerySwapChainSupport(const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface)
     {
         SwapChainSupportDetails support;
-
         support.capabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
+        support.formats = physicalDevice.getSurfaceFormatsKHR(surface);
+        support.presentModes = physicalDevice.getSurfacePresentModesKHR(surface);
+        return support;
+    }
 
+    inline void LogSwapChainSupport(const SwapChainSupportDetails& support)
+    {
         CONSOLE_DEBUG("Minimum Image Count: %d", support.capabilities.minImageCount);
         CONSOLE_DEBUG("Maximum Image Count: %d", support.capabilities.maxImageCount);
 
@@ -70,23 +78,18 @@ namespace vkInit
 
 #endif // !NDEBUG
 
-        support.formats = physicalDevice.getSurfaceFormatsKHR(surface);
-
         for (vk::SurfaceFormatKHR supportedFormat : support.formats)
         {
             CONSOLE_DEBUG("Supported Pixel Format: %s", vk::to_string(supportedFormat.format).c_str());
             CONSOLE_DEBUG("Supported Color Space: %s", vk::to_string(supportedFormat.colorSpace).c_str());
         }
 
-        support.presentModes = physicalDevice.getSurfacePresentModesKHR(surface);
         CONSOLE_DEBUG("Supported Present Modes: ");
         for (vk::PresentModeKHR presentMode : support.presentModes)
             CONSOLE_DEBUG("\t %s", LogPresentMode(presentMode).c_str());
-
-        return support;
     }
 
-    vk::SurfaceFormatKHR ChooseSwapChainSurfaceFormat(std::vector<vk::SurfaceFormatKHR> formats)
+    inline vk::SurfaceFormatKHR ChooseSwapChainSurfaceFormat(std::vector<vk::SurfaceFormatKHR> formats)
     {
         for (vk::SurfaceFormatKHR format : formats)
             if (format.format == vk::Format::eB8G8R8A8Unorm && format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)
@@ -95,16 +98,18 @@ namespace vkInit
         return formats[0];
     }
 
-    vk::PresentModeKHR ChooseSwapChainPresentMode(std::vector<vk::PresentModeKHR> presentModes)
+    // FIFO is the only mode every device has, so it stands in when the preferred one is missing.
+    inline vk::PresentModeKHR ChooseSwapChainPresentMode(std::vector<vk::PresentModeKHR> presentModes, vk::PresentModeKHR preferred)
     {
         for (vk::PresentModeKHR presentMode : presentModes)
-            if (presentMode == vk::PresentModeKHR::eMailbox)
+            if (presentMode == preferred)
                 return presentMode;
 
+        CONSOLE_WARN("Present mode %s is not supported, falling back to FIFO.", vk::to_string(preferred).c_str());
         return vk::PresentModeKHR::eFifo;
     }
 
-    vk::Extent2D ChooseSwapChainExtent(uint32_t width, uint32_t height, vk::SurfaceCapabilitiesKHR capabilities)
+    inline vk::Extent2D ChooseSwapChainExtent(uint32_t width, uint32_t height, vk::SurfaceCapabilitiesKHR capabilities)
     {
         if (capabilities.currentExtent.width != UINT32_MAX)
         {
@@ -121,21 +126,38 @@ namespace vkInit
         }
     }
 
-    SwapChainBundle CreateSwapChain(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, int width, int height)
+    struct SwapChainInput
     {
-        SwapChainSupportDetails support = QuerySwapChainSupport(physicalDevice, surface);
+        vk::Device device;
+        vk::PhysicalDevice physicalDevice;
+        vk::SurfaceKHR surface;
+        QueueFamilyIndices queueFamilies;
+        SwapChainSupportDetails support;    // Only the capabilities are queried again, the extent changes with the window.
+        int width, height;
+        vk::PresentModeKHR preferredPresentMode = vk::PresentModeKHR::eMailbox;
+    };
+
+    inline SwapChainBundle CreateSwapChain(const SwapChainInput& input)
+    {
+        const vk::Device& device = input.device;
+        SwapChainSupportDetails support = input.support;
+        support.capabilities = input.physicalDevice.getSurfaceCapabilitiesKHR(input.surface);
 
         vk::SurfaceFormatKHR format = ChooseSwapChainSurfaceFormat(support.formats);
-        vk::PresentModeKHR presentMode = ChooseSwapChainPresentMode(support.presentModes);
-        vk::Extent2D extent = ChooseSwapChainExtent(width, height, support.capabilities);
+        vk::PresentModeKHR presentMode = ChooseSwapChainPresentMode(support.presentModes, input.preferredPresentMode);
+        vk::Extent2D extent = ChooseSwapChainExtent(input.width, input.height, support.capabilities);
 
         uint32_t imageCount = std::min(support.capabilities.maxImageCount, support.capabilities.minImageCount + 1);
 
+        // Copying out of the images lets frames be captured and copying into them composes multiview layers, most surfaces allow both.
+        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+        usage |= support.capabilities.supportedUsageFlags & (vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+
         vk::SwapchainCreateInfoKHR createInfo = vk::SwapchainCreateInfoKHR(
-            vk::SwapchainCreateFlagsKHR(), surface, imageCount, format.format, format.colorSpace, extent, 1, vk::ImageUsageFlagBits::eColorAttachment
+            vk::SwapchainCreateFlagsKHR(), input.surface, imageCount, format.format, format.colorSpace, extent, 1, usage
         );
 
-        QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
+        QueueFamilyIndices indices = input.queueFamilies;
         uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
         if (indices.graphicsFamily.value() != indices.presentFamily.value())
@@ -194,6 +216,8 @@ namespace vkInit
 
         bundle.format = format.format;
         bundle.extent = extent;
+        bundle.presentMode = presentMode;
+        bundle.usage = usage;
 
         return bundle;
     }
@@ -5,7 +5,7 @@
 
 namespace vkInit
 {
-	vk::Semaphore CreateSemaphore(const vk::Device& device)
+	inline vk::Semaphore CreateSemaphore(const vk::Device& device)
 	{
 		vk::SemaphoreCreateInfo semaphoreInfo{};
 		semaphoreInfo.flags = vk::SemaphoreCreateFlags();
@@ -21,10 +21,10 @@ namespace vkInit
 		}
 	}
 
-	vk::Fence CreateFence(const vk::Device& device)
+	inline vk::Fence CreateFence(const vk::Device& device, bool signaled = true)
 	{
 		vk::FenceCreateInfo fenceInfo{};
-		fenceInfo.flags = vk::FenceCreateFlags() | vk::FenceCreateFlagBits::eSignaled;
+		fenceInfo.flags = signaled ? vk::FenceCreateFlags(vk::FenceCreateFlagBits::eSignaled) : vk::FenceCreateFlags();
 
 		try
 		{
@@ -36,6 +36,25 @@ namespace vkInit
 			return nullptr;
 		}
 	}
+
+	// Semaphore with a 64-bit counter instead of a signaled state, waited on and signaled by value.
+	inline vk::Semaphore CreateTimelineSemaphore(const vk::Device& device, uint64_t initialValue = 0)
+	{
+		vk::SemaphoreTypeCreateInfo typeInfo(vk::SemaphoreType::eTimeline, initialValue);
+		vk::SemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.flags = vk::SemaphoreCreateFlags();
+		semaphoreInfo.pNext = &typeInfo;
+
+		try
+		{
+			return device.createSemaphore(semaphoreInfo);
+		}
+		catch (const vk::SystemError& err)
+		{
+			CONSOLE_ERROR("Failed to Create Timeline Semaphore! %s", err.what());
+			return nullptr;
+		}
+	}
 }
 
 #endif
\ No newline at end of file
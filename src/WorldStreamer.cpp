@@ -0,0 +1,488 @@
+#include "WorldStreamer.hpp"
+#include "MemoryTracker.hpp"
+#include "SceneFile.hpp"
+#include "Transforms.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+	// Stable color per material id, so chunks from files tell their materials apart.
+	glm::vec4 HashColor(uint32_t value)
+	{
+		value ^= value >> 16;
+		value *= 0x7feb352du;
+		value ^= value >> 15;
+		value *= 0x846ca68bu;
+		value ^= value >> 16;
+		return glm::vec4(0.4f + 0.6f * (value & 0xff) / 255.0f, 0.4f + 0.6f * ((value >> 8) & 0xff) / 255.0f,
+			0.4f + 0.6f * ((value >> 16) & 0xff) / 255.0f, 1.0f);
+	}
+}
+
+WorldStreamer::WorldStreamer(const Input& input) : m_Device(input.device), m_PhysicalDevice(input.physicalDevice), m_Heap(*input.heap),
+	m_Jobs(*input.jobs), m_DeletionQueue(*input.deletionQueue), m_MeshBounds(input.meshBounds), m_Settings(input.settings)
+{
+	m_Settings.chunkSize = std::max(m_Settings.chunkSize, 0.01f);
+	m_Settings.unloadRadius = std::max(m_Settings.unloadRadius, m_Settings.loadRadius);
+	m_Settings.maxDecodes = std::max(m_Settings.maxDecodes, 1u);
+	m_Stats.budget = m_Settings.budget;
+
+	// Only a flag is set here, the callback may fire from inside an allocation.
+	m_BudgetCallback = MemoryTracker::Get().AddBudgetCallback([this](uint32_t heap, vk::DeviceSize usage, vk::DeviceSize softBudget)
+	{
+		m_OverBudget.store(true, std::memory_order_relaxed);
+	});
+
+	CONSOLE_INFO("World streaming enabled, %.2f unit chunks loaded within %.2f and unloaded beyond %.2f, %.1f MB budget, %s.",
+		m_Settings.chunkSize, m_Settings.loadRadius, m_Settings.unloadRadius, m_Settings.budget / (1024.0 * 1024.0),
+		m_Settings.directory.empty() ? "generated chunks" : m_Settings.directory.c_str());
+}
+
+WorldStreamer::~WorldStreamer()
+{
+	// The decode jobs write into chunks owned here.
+	m_Jobs.Wait(m_Decodes);
+	MemoryTracker::Get().RemoveBudgetCallback(m_BudgetCallback);
+
+	for (auto& [key, chunk] : m_Chunks)
+		Unload(*chunk);
+}
+
+void WorldStreamer::BeginFrame(const glm::vec3& cameraPosition, const glm::vec3& cameraForward)
+{
+	PROFILE_SCOPE("WorldStreamer::BeginFrame");
+	m_Abandoned.erase(std::remove_if(m_Abandoned.begin(), m_Abandoned.end(),
+		[](const std::unique_ptr<Chunk>& chunk) { return chunk->decoded.load(std::memory_order_acquire); }), m_Abandoned.end());
+
+	UpdatePriorities(cameraPosition, cameraForward);
+
+	// The border between the radii is left alone, so a camera moving back and forth over a chunk edge does not thrash.
+	for (auto it = m_Chunks.begin(); it != m_Chunks.end();)
+	{
+		Chunk& chunk = *it->second;
+		if (chunk.distance <= m_Settings.unloadRadius)
+		{
+			++it;
+			continue;
+		}
+
+		if (chunk.state == ChunkState::Decoding)
+			m_Abandoned.push_back(std::move(it->second));
+		else if (chunk.state == ChunkState::Resident)
+		{
+			Unload(chunk);
+			m_MemoryReleased = true;
+		}
+		it = m_Chunks.erase(it);
+	}
+
+	// Give up the least important chunk every frame a heap stays over its soft budget.
+	if (m_OverBudget.exchange(false, std::memory_order_relaxed))
+	{
+		Chunk* victim = nullptr;
+		for (auto& [key, chunk] : m_Chunks)
+			if (chunk->state == ChunkState::Resident && chunk->instanceCount > 0 && (!victim || chunk->priority > victim->priority))
+				victim = chunk.get();
+		if (victim)
+		{
+			Unload(*victim);
+			victim->state = ChunkState::Deferred;
+			m_Stats.evictions++;
+		}
+	}
+
+	// Deferred chunks only get another chance once chunks left the radius, not every frame.
+	if (m_MemoryReleased)
+	{
+		for (auto& [key, chunk] : m_Chunks)
+			if (chunk->state == ChunkState::Deferred)
+				chunk->state = ChunkState::Queued;
+		m_MemoryReleased = false;
+	}
+
+	UploadDecoded();
+	StartDecodes();
+
+	m_Stats.resident = m_Stats.queued = m_Stats.decoding = m_Stats.waitingForBudget = 0;
+	for (const auto& [key, chunk] : m_Chunks)
+	{
+		switch (chunk->state)
+		{
+		case ChunkState::Queued: m_Stats.queued++; break;
+		case ChunkState::Decoding: m_Stats.decoding++; break;
+		case ChunkState::Deferred: m_Stats.waitingForBudget++; break;
+		case ChunkState::Resident: m_Stats.resident++; break;
+		}
+	}
+	m_Stats.decoding += static_cast<uint32_t>(m_Abandoned.size());
+	m_Stats.averageDecodeMilliseconds = m_DecodedChunks > 0 ? m_DecodeMilliseconds / m_DecodedChunks : 0.0;
+}
+
+void WorldStreamer::AddUploadPass(RenderGraph& graph)
+{
+	// Declared every frame, uploads or not, so the graph only compiles once. The instance buffers are not graph resources.
+	graph.AddPass("ChunkUpload", RenderGraph::PassType::Transfer)
+		.SetSideEffects()
+		.SetExecute([this](const RenderGraph::PassContext& context)
+		{
+			if (m_Copies.empty())
+				return;
+
+			for (const Copy& copy : m_Copies)
+			{
+				vk::BufferCopy region(0, 0, copy.size);
+				context.commandBuffer.copyBuffer(copy.staging, copy.destination, region);
+			}
+			m_Copies.clear();
+
+			vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+			context.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexShader,
+				vk::DependencyFlags(), barrier, nullptr, nullptr);
+		});
+}
+
+void WorldStreamer::Draw(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, const glm::mat4& viewProjection, uint32_t viewBuffer)
+{
+	Frustum frustum = ExtractFrustum(viewProjection);
+
+	// Instances are in world space, so the model matrix is only the view projection.
+	vkInit::Constants constants{};
+	constants.model = viewProjection;
+	constants.viewBuffer = viewBuffer;
+
+	m_Stats.drawnChunks = 0;
+	for (const auto& [key, chunk] : m_Chunks)
+	{
+		if (chunk->state != ChunkState::Resident || chunk->instanceCount == 0 || !FrustumContainsBox(frustum, chunk->bounds))
+			continue;
+
+		constants.instanceBuffer = chunk->slot;
+		commandBuffer.pushConstants(layout, vkInit::ConstantsStages, 0, sizeof(constants), &constants);
+		commandBuffer.draw(3, chunk->instanceCount, 0, 0);
+		m_Stats.drawnChunks++;
+	}
+}
+
+void WorldStreamer::LogStats() const
+{
+	CONSOLE_INFO("World streaming: %u chunks resident with %llu instances in %.1f of %.1f MB, %u drawn, %u queued, %u decoding, "
+		"%u waiting for budget. %llu loads, %llu unloads, %llu evictions, %.2f ms per decode.",
+		m_Stats.resident, static_cast<unsigned long long>(m_Stats.residentInstances), m_Stats.residentBytes / (1024.0 * 1024.0),
+		m_Stats.budget / (1024.0 * 1024.0), m_Stats.drawnChunks, m_Stats.queued, m_Stats.decoding, m_Stats.waitingForBudget,
+		static_cast<unsigned long long>(m_Stats.loads), static_cast<unsigned long long>(m_Stats.unloads),
+		static_cast<unsigned long long>(m_Stats.evictions), m_Stats.averageDecodeMilliseconds);
+}
+
+void WorldStreamer::Decode(Chunk& chunk) const
+{
+	PROFILE_SCOPE("WorldStreamer::Decode");
+	auto start = std::chrono::steady_clock::now();
+	chunk.instances.clear();
+	chunk.bounds = AABB();
+
+	if (m_Settings.directory.empty())
+		Generate(chunk);
+	else
+	{
+		// Chunks without a file are empty.
+		std::string path = m_Settings.directory + "/chunk_" + std::to_string(chunk.x) + "_" + std::to_string(chunk.y) + ".vkscene";
+		std::error_code error;
+		if (std::filesystem::exists(path, error) && !DecodeFile(chunk, path))
+		{
+			CONSOLE_WARN("Chunk %d, %d could not be decoded and stays empty.", chunk.x, chunk.y);
+			chunk.instances.clear();
+			chunk.bounds = AABB();
+		}
+	}
+
+	chunk.decodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	chunk.decoded.store(true, std::memory_order_release);
+}
+
+bool WorldStreamer::DecodeFile(Chunk& chunk, const std::string& path) const
+{
+	std::unique_ptr<SceneFile> file = SceneFile::Open(path);
+	if (!file)
+		return false;
+
+	const uint64_t count = file->GetInstanceCount();
+	bool complete = true;
+	std::array<const float*, TransformStore::StreamCount> streams;
+	for (uint32_t stream = 0; stream < TransformStore::StreamCount; stream++)
+	{
+		uint64_t streamCount = 0;
+		streams[stream] = file->GetSection<float>(static_cast<SceneSection>(stream), streamCount);
+		complete &= streams[stream] && streamCount == count;
+	}
+
+	uint64_t parentCount = 0, materialCount = 0;
+	const uint32_t* parents = file->GetSection<uint32_t>(SceneSection::Parent, parentCount);
+	const uint32_t* materials = file->GetSection<uint32_t>(SceneSection::Material, materialCount);
+	if (!complete || !parents || parentCount != count)
+	{
+		CONSOLE_ERROR("Chunk file %s is missing transform sections.", path.c_str());
+		return false;
+	}
+	if (materialCount != count)
+		materials = nullptr;
+
+	// Instances are translated and uniformly scaled, the hierarchy only places them.
+	auto stream = [&](TransformStore::Stream type, uint64_t i) { return streams[type][i]; };
+	std::vector<glm::mat4> world(count);
+	chunk.instances.reserve(count);
+	for (uint64_t i = 0; i < count; i++)
+	{
+		glm::mat4 local = glm::translate(glm::mat4(1.0f),
+			glm::vec3(stream(TransformStore::PositionX, i), stream(TransformStore::PositionY, i), stream(TransformStore::PositionZ, i)));
+		local *= glm::mat4_cast(glm::quat(stream(TransformStore::RotationW, i), stream(TransformStore::RotationX, i),
+			stream(TransformStore::RotationY, i), stream(TransformStore::RotationZ, i)));
+		local = glm::scale(local, glm::vec3(stream(TransformStore::ScaleX, i), stream(TransformStore::ScaleY, i), stream(TransformStore::ScaleZ, i)));
+
+		if (parents[i] == TransformStore::NoParent)
+			world[i] = local;
+		else if (parents[i] < i)
+			world[i] = world[parents[i]] * local;
+		else
+		{
+			CONSOLE_ERROR("Chunk file %s has a broken hierarchy at instance %llu.", path.c_str(), static_cast<unsigned long long>(i));
+			return false;
+		}
+
+		AddInstance(chunk, glm::vec3(world[i][3]), glm::length(glm::vec3(world[i][0])), HashColor(materials ? materials[i] : 0));
+	}
+
+	return true;
+}
+
+void WorldStreamer::Generate(Chunk& chunk) const
+{
+	// Seeded by the coordinates, so a chunk looks the same every time it is loaded.
+	std::mt19937 random(static_cast<uint32_t>((ChunkKey(chunk.x, chunk.y) * 0x9e3779b97f4a7c15ull) >> 32));
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	const float size = m_Settings.chunkSize;
+	const glm::vec2 origin(chunk.x * size, chunk.y * size);
+	chunk.instances.reserve(m_Settings.generatedInstances);
+	for (uint32_t i = 0; i < m_Settings.generatedInstances; i++)
+	{
+		glm::vec3 position(origin.x + unit(random) * size, origin.y + unit(random) * size, 0.1f + 0.8f * unit(random));
+		AddInstance(chunk, position, 0.2f + 0.3f * unit(random), HashColor(random()));
+	}
+}
+
+void WorldStreamer::AddInstance(Chunk& chunk, const glm::vec3& position, float size, const glm::vec4& color) const
+{
+	chunk.instances.push_back({ glm::vec4(position, size), color });
+	chunk.bounds.Grow(position + m_MeshBounds.min * size);
+	chunk.bounds.Grow(position + m_MeshBounds.max * size);
+}
+
+void WorldStreamer::UpdatePriorities(const glm::vec3& cameraPosition, const glm::vec3& cameraForward)
+{
+	const float size = m_Settings.chunkSize;
+	const glm::vec2 camera(cameraPosition);
+	glm::vec2 forward(cameraForward);
+	float forwardLength = glm::length(forward);
+	forward = forwardLength > 1e-4f ? forward / forwardLength : glm::vec2(0.0f);
+
+	// Distance to the closest point of the chunk, scaled down by up to half for chunks straight ahead.
+	auto measure = [&](Chunk& chunk)
+	{
+		glm::vec2 min(chunk.x * size, chunk.y * size);
+		glm::vec2 max = min + size;
+		chunk.distance = glm::length(glm::clamp(camera, min, max) - camera);
+
+		glm::vec2 toChunk = (min + max) * 0.5f - camera;
+		float toChunkLength = glm::length(toChunk);
+		float facing = toChunkLength > 1e-4f ? glm::dot(toChunk / toChunkLength, forward) : 0.0f;
+		chunk.priority = chunk.distance * (1.0f - 0.5f * facing);
+	};
+
+	for (auto& [key, chunk] : m_Chunks)
+		measure(*chunk);
+
+	const float radius = m_Settings.loadRadius;
+	glm::ivec2 first(glm::floor((camera - radius) / size));
+	glm::ivec2 last(glm::floor((camera + radius) / size));
+	for (int32_t y = first.y; y <= last.y; y++)
+	{
+		for (int32_t x = first.x; x <= last.x; x++)
+		{
+			uint64_t key = ChunkKey(x, y);
+			if (m_Chunks.count(key))
+				continue;
+
+			auto chunk = std::make_unique<Chunk>();
+			chunk->x = x;
+			chunk->y = y;
+			measure(*chunk);
+			if (chunk->distance <= radius)
+				m_Chunks.emplace(key, std::move(chunk));
+		}
+	}
+}
+
+void WorldStreamer::StartDecodes()
+{
+	uint32_t decoding = static_cast<uint32_t>(m_Abandoned.size());
+	std::vector<Chunk*> queued;
+	for (auto& [key, chunk] : m_Chunks)
+	{
+		if (chunk->state == ChunkState::Decoding)
+			decoding++;
+		else if (chunk->state == ChunkState::Queued)
+			queued.push_back(chunk.get());
+	}
+
+	std::sort(queued.begin(), queued.end(), [](const Chunk* a, const Chunk* b) { return a->priority < b->priority; });
+
+	for (size_t i = 0; i < queued.size() && decoding < m_Settings.maxDecodes; i++, decoding++)
+	{
+		Chunk* chunk = queued[i];
+		chunk->state = ChunkState::Decoding;
+		chunk->decoded.store(false, std::memory_order_relaxed);
+		m_Jobs.Run([this, chunk]() { Decode(*chunk); }, &m_Decodes);
+	}
+}
+
+void WorldStreamer::UploadDecoded()
+{
+	std::vector<Chunk*> decoded;
+	for (auto& [key, chunk] : m_Chunks)
+		if (chunk->state == ChunkState::Decoding && chunk->decoded.load(std::memory_order_acquire))
+			decoded.push_back(chunk.get());
+
+	std::sort(decoded.begin(), decoded.end(), [](const Chunk* a, const Chunk* b) { return a->priority < b->priority; });
+
+	// At least one chunk goes up every frame, however large it is.
+	vk::DeviceSize uploaded = 0;
+	for (Chunk* chunk : decoded)
+	{
+		vk::DeviceSize bytes = sizeof(Instance) * chunk->instances.size();
+		if (uploaded > 0 && uploaded + bytes > m_Settings.uploadBytesPerFrame)
+			break;
+
+		m_DecodedChunks++;
+		m_DecodeMilliseconds += chunk->decodeMilliseconds;
+
+		if (Upload(*chunk))
+			uploaded += bytes;
+		else
+			chunk->state = ChunkState::Deferred;
+
+		// The GPU copy is all that is needed from now on.
+		std::vector<Instance>().swap(chunk->instances);
+	}
+}
+
+bool WorldStreamer::Upload(Chunk& chunk)
+{
+	const vk::DeviceSize bytes = sizeof(Instance) * chunk.instances.size();
+	if (bytes == 0)
+	{
+		chunk.state = ChunkState::Resident;
+		m_Stats.loads++;
+		return true;
+	}
+
+	if (m_Stats.residentBytes + bytes > m_Settings.budget && !EvictFor(chunk, bytes))
+		return false;
+
+	using Usage = vk::BufferUsageFlagBits;
+	vkInit::Buffer buffer = CreateBuffer(bytes, Usage::eStorageBuffer | Usage::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Geometry, "Chunk instances");
+	vkInit::Buffer staging = CreateBuffer(bytes, Usage::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging, "Chunk staging");
+	uint32_t slot = buffer.bufferMemory ? vkInit::RegisterStorageBuffer(m_Heap, buffer.buffer) : vkInit::InvalidBindlessIndex;
+	if (slot == vkInit::InvalidBindlessIndex || !staging.bufferMemory)
+	{
+		if (slot != vkInit::InvalidBindlessIndex)
+			vkInit::ReleaseBindlessSlot(m_Heap, vkInit::BindlessStorageBuffers, slot);
+		DestroyBuffer(buffer);
+		DestroyBuffer(staging);
+		return false;
+	}
+
+	void* mapped = m_Device.mapMemory(staging.bufferMemory, 0, bytes);
+	memcpy(mapped, chunk.instances.data(), bytes);
+	m_Device.unmapMemory(staging.bufferMemory);
+
+	// The staging buffer is done with once this frame has finished.
+	m_Copies.push_back({ staging.buffer, buffer.buffer, bytes });
+	m_DeletionQueue.Retire(staging);
+
+	chunk.buffer = buffer;
+	chunk.slot = slot;
+	chunk.instanceCount = static_cast<uint32_t>(chunk.instances.size());
+	chunk.state = ChunkState::Resident;
+	m_Stats.residentBytes += bytes;
+	m_Stats.residentInstances += chunk.instanceCount;
+	m_Stats.loads++;
+	return true;
+}
+
+bool WorldStreamer::EvictFor(const Chunk& chunk, vk::DeviceSize bytes)
+{
+	// Only chunks less important than the one being loaded make room, farthest first.
+	while (m_Stats.residentBytes + bytes > m_Settings.budget)
+	{
+		Chunk* victim = nullptr;
+		for (auto& [key, resident] : m_Chunks)
+		{
+			if (resident->state == ChunkState::Resident && resident->instanceCount > 0 && resident->priority > chunk.priority &&
+				(!victim || resident->priority > victim->priority))
+				victim = resident.get();
+		}
+		if (!victim)
+			return false;
+
+		Unload(*victim);
+		victim->state = ChunkState::Deferred;
+		m_Stats.evictions++;
+	}
+	return true;
+}
+
+void WorldStreamer::Unload(Chunk& chunk)
+{
+	if (chunk.state != ChunkState::Resident)
+		return;
+
+	// Frames in flight may still draw it.
+	m_DeletionQueue.Retire(chunk.buffer, chunk.slot);
+
+	m_Stats.residentBytes -= sizeof(Instance) * chunk.instanceCount;
+	m_Stats.residentInstances -= chunk.instanceCount;
+	m_Stats.unloads++;
+
+	chunk.buffer = vkInit::Buffer{};
+	chunk.slot = vkInit::InvalidBindlessIndex;
+	chunk.instanceCount = 0;
+	chunk.state = ChunkState::Queued;
+}
+
+vkInit::Buffer WorldStreamer::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+	MemoryCategory category, const char* name)
+{
+	vkInit::BufferInput input{};
+	input.size = size;
+	input.usage = usage;
+	input.device = m_Device;
+	input.physicalDevice = m_PhysicalDevice;
+	input.properties = properties;
+	input.category = category;
+	input.name = name;
+	return vkInit::CreateBuffer(input);
+}
+
+void WorldStreamer::DestroyBuffer(vkInit::Buffer& buffer)
+{
+	m_Device.destroyBuffer(buffer.buffer);
+	vkInit::FreeMemory(m_Device, buffer.bufferMemory);
+	buffer = vkInit::Buffer{};
+}
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef WORLD_STREAMER_HPP
+#define WORLD_STREAMER_HPP
+
+#include "Config.hpp"
+#include "Bounds.hpp"
+#include "JobSystem.hpp"
+#include "DeletionQueue.hpp"
+#include "RenderGraph.hpp"
+#include "Vulkan/Memory.hpp"
+#include "Vulkan/Descriptors.hpp"
+#include "Vulkan/PushConstants.hpp"
+
+#include <atomic>
+#include <unordered_map>
+
+struct StreamingSettings
+{
+	bool enabled = false;
+	std::string directory;					// Holds chunk_<x>_<y>.vkscene scene files, chunks are generated when empty.
+	float chunkSize = 0.5f;					// World units along x and y.
+	float loadRadius = 1.5f;				// Chunks closer to the camera than this are loaded.
+	float unloadRadius = 2.0f;				// Chunks farther than this are unloaded, the gap keeps chunks on the border from thrashing.
+	uint32_t generatedInstances = 4096;		// Instances in each generated chunk.
+	vk::DeviceSize budget = 64ull << 20;	// Bytes of instance data resident at once.
+	uint32_t maxDecodes = 4;				// Chunks decoded on the workers at once.
+	vk::DeviceSize uploadBytesPerFrame = 8ull << 20;
+};
+
+// Streams a world divided into square chunks on the xy plane in and out around the camera. Chunks are decoded on the job
+// system, nearest and most in front of the camera first, uploaded through a staging buffer into a device local instance
+// buffer in the bindless heap and drawn with one instanced draw per visible chunk. Unloaded chunks and used staging buffers
+// go to the deletion queue, which frees them once every frame in flight that could still read them has finished.
+class WorldStreamer
+{
+public:
+	struct Stats
+	{
+		uint32_t resident = 0;
+		uint32_t queued = 0;
+		uint32_t decoding = 0;
+		uint32_t waitingForBudget = 0;		// Evicted or did not fit the budget.
+		uint32_t drawnChunks = 0;			// In the last frame.
+		uint64_t residentInstances = 0;
+		vk::DeviceSize residentBytes = 0;
+		vk::DeviceSize budget = 0;
+		uint64_t loads = 0, unloads = 0, evictions = 0;		// Since startup.
+		double averageDecodeMilliseconds = 0.0;
+	};
+
+	struct Input
+	{
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		vkInit::BindlessHeap* heap;
+		JobSystem* jobs;
+		DeletionQueue* deletionQueue;
+		AABB meshBounds;		// Local bounds of the mesh every instance draws.
+		StreamingSettings settings;
+	};
+
+	WorldStreamer(const Input& input);
+	WorldStreamer(const WorldStreamer&) = delete;
+	WorldStreamer& operator=(const WorldStreamer&) = delete;
+	~WorldStreamer();
+
+	/// @brief Unloads, loads and uploads chunks around the camera.
+	void BeginFrame(const glm::vec3& cameraPosition, const glm::vec3& cameraForward);
+
+	/// @brief Copies the chunks uploaded this frame into their instance buffers.
+	void AddUploadPass(RenderGraph& graph);
+
+	/// @brief Records one instanced draw per resident chunk inside the frustum. The caller binds the pipeline, the bindless set and the vertex buffers.
+	/// viewBuffer is the view projections slot read by multiview pipelines.
+	void Draw(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout, const glm::mat4& viewProjection, uint32_t viewBuffer = 0);
+
+	const Stats& GetStats() const { return m_Stats; }
+	void LogStats() const;
+private:
+	// Matches ParticleInstance in Particle.vert.
+	struct Instance
+	{
+		glm::vec4 positionSize;
+		glm::vec4 color;
+	};
+
+	enum class ChunkState
+	{
+		Queued,
+		Decoding,
+		Deferred,	// Did not fit the budget or was evicted, nothing is kept. Queued again once memory is released.
+		Resident
+	};
+
+	struct Chunk
+	{
+		int32_t x = 0, y = 0;
+		ChunkState state = ChunkState::Queued;
+		float distance = 0.0f;
+		float priority = 0.0f;		// Lower loads first and is evicted last.
+
+		// Written by the decode job, read once decoded is set.
+		std::vector<Instance> instances;
+		AABB bounds;
+		double decodeMilliseconds = 0.0;
+		std::atomic<bool> decoded{ false };
+
+		uint32_t instanceCount = 0;
+		vkInit::Buffer buffer;
+		uint32_t slot = vkInit::InvalidBindlessIndex;
+	};
+
+	// Recorded by the upload pass of the current frame.
+	struct Copy
+	{
+		vk::Buffer staging, destination;
+		vk::DeviceSize size;
+	};
+
+	static uint64_t ChunkKey(int32_t x, int32_t y) { return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y); }
+
+	void Decode(Chunk& chunk) const;
+	bool DecodeFile(Chunk& chunk, const std::string& path) const;
+	void Generate(Chunk& chunk) const;
+	void AddInstance(Chunk& chunk, const glm::vec3& position, float size, const glm::vec4& color) const;
+
+	void UpdatePriorities(const glm::vec3& cameraPosition, const glm::vec3& cameraForward);
+	void StartDecodes();
+	void UploadDecoded();
+	bool Upload(Chunk& chunk);
+	bool EvictFor(const Chunk& chunk, vk::DeviceSize bytes);
+	void Unload(Chunk& chunk);
+
+	vkInit::Buffer CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, const char* name);
+	void DestroyBuffer(vkInit::Buffer& buffer);
+private:
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+	vkInit::BindlessHeap& m_Heap;
+	JobSystem& m_Jobs;
+	DeletionQueue& m_DeletionQueue;
+	AABB m_MeshBounds;
+	StreamingSettings m_Settings;
+
+	std::unordered_map<uint64_t, std::unique_ptr<Chunk>> m_Chunks;
+
+	// Chunks unloaded while their decode was running, dropped once it has finished.
+	std::vector<std::unique_ptr<Chunk>> m_Abandoned;
+	JobCounter m_Decodes;
+
+	std::vector<Copy> m_Copies;
+
+	// Set by the memory tracker while a heap is over its soft budget.
+	std::atomic<bool> m_OverBudget{ false };
+	uint32_t m_BudgetCallback = 0;
+
+	// Chunks left the radius since the deferred ones were last queued again.
+	bool m_MemoryReleased = false;
+
+	Stats m_Stats;
+	uint64_t m_DecodedChunks = 0;
+	double m_DecodeMilliseconds = 0.0;
+};
+
+#endif // !WORLD_STREAMER_HPP
\ No newline at end of file